@@ -21,11 +21,14 @@
 #include "config.h"
 
 #include "flow-application.h"
+#include "flow-location.h"
 #include "flow-window.h"
 
 struct _FlowApplication
 {
 	AdwApplication parent_instance;
+
+	gint64 start_time;
 };
 
 G_DEFINE_FINAL_TYPE (FlowApplication, flow_application, ADW_TYPE_APPLICATION)
@@ -59,12 +62,82 @@ flow_application_activate (GApplication *app)
 	gtk_window_present (window);
 }
 
+/*
+ * Runs in the process that was launched, before arguments are handed to
+ * the primary instance, so a "main.c:42" GIO would take for a URI is
+ * made a path against this process's working directory.
+ */
+static gboolean
+flow_application_local_command_line (GApplication   *app,
+                                     char         ***arguments,
+                                     int            *exit_status)
+{
+	g_autofree char *cwd = g_get_current_dir ();
+	gboolean options_done = FALSE;
+	int i;
+
+	for (i = 1; (*arguments)[i] != NULL; i++) {
+		char *arg = (*arguments)[i];
+		char *path;
+
+		if (!options_done && arg[0] == '-') {
+			options_done = g_str_equal (arg, "--");
+			continue;
+		}
+
+		path = flow_location_resolve_arg (arg, cwd);
+		if (path != NULL) {
+			g_free (arg);
+			(*arguments)[i] = path;
+		}
+	}
+
+	return G_APPLICATION_CLASS (flow_application_parent_class)->local_command_line (app, arguments, exit_status);
+}
+
+/*
+ * Files named on the command line.  A second "flow" only registers with
+ * the session bus, finds this instance and forwards its arguments here,
+ * without ever initializing GTK, so handing off is quick.
+ */
+static void
+flow_application_open (GApplication  *app,
+                       GFile        **files,
+                       int            n_files,
+                       const char    *hint)
+{
+	GtkWindow *window;
+	int i;
+
+	g_assert (FLOW_IS_APPLICATION (app));
+
+	window = gtk_application_get_active_window (GTK_APPLICATION (app));
+
+	if (window == NULL)
+		window = g_object_new (FLOW_TYPE_WINDOW,
+		                       "application", app,
+		                       NULL);
+
+	for (i = 0; i < n_files; i++) {
+		g_autoptr(GFile) file = NULL;
+		int line;
+		int column;
+
+		file = flow_location_split (files[i], &line, &column);
+		flow_window_open_file (FLOW_WINDOW (window), file, line, column, i == n_files - 1);
+	}
+
+	gtk_window_present (window);
+}
+
 static void
 flow_application_class_init (FlowApplicationClass *klass)
 {
 	GApplicationClass *app_class = G_APPLICATION_CLASS (klass);
 
+	app_class->local_command_line = flow_application_local_command_line;
 	app_class->activate = flow_application_activate;
+	app_class->open = flow_application_open;
 }
 
 static void
@@ -107,9 +180,23 @@ static const GActionEntry app_actions[] = {
 	{ "about", flow_application_about_action },
 };
 
+/*
+ * Monotonic time the application was created at, which is as close to
+ * process start as Flow gets; startup timing is measured from here.
+ */
+gint64
+flow_application_get_start_time (FlowApplication *self)
+{
+	g_return_val_if_fail (FLOW_IS_APPLICATION (self), 0);
+
+	return self->start_time;
+}
+
 static void
 flow_application_init (FlowApplication *self)
 {
+	self->start_time = g_get_monotonic_time ();
+
 	g_action_map_add_action_entries (G_ACTION_MAP (self),
 	                                 app_actions,
 	                                 G_N_ELEMENTS (app_actions),
@@ -28,7 +28,8 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (FlowApplication, flow_application, FLOW, APPLICATION, AdwApplication)
 
-FlowApplication *flow_application_new (const char        *application_id,
-                                       GApplicationFlags  flags);
+FlowApplication *flow_application_new            (const char        *application_id,
+                                                  GApplicationFlags  flags);
+gint64           flow_application_get_start_time (FlowApplication   *self);
 
 G_END_DECLS
@@ -0,0 +1,417 @@
+/* flow-compression.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Compressed files are read and written through GConverter streams, so
+ * they are (de)compressed incrementally as the data flows.  gzip uses
+ * GIO's zlib converters; Zstandard and xz get small GConverter wrappers
+ * around their streaming APIs when the libraries were found at build
+ * time.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZMA
+#include <stdint.h>
+#include <lzma.h>
+#endif
+
+#include "flow-compression.h"
+
+/* Shared tail of the convert() implementations: no progress means the
+ * converter needs either more room or more input. */
+static GConverterResult
+converter_no_progress (gboolean has_input, GError **error)
+{
+    if (has_input)
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE, "Output buffer too small");
+    else
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT, "Need more input");
+    return G_CONVERTER_ERROR;
+}
+
+#ifdef HAVE_ZSTD
+
+#define FLOW_TYPE_ZSTD_CONVERTER (flow_zstd_converter_get_type ())
+G_DECLARE_FINAL_TYPE (FlowZstdConverter, flow_zstd_converter, FLOW, ZSTD_CONVERTER, GObject)
+
+struct _FlowZstdConverter
+{
+    GObject parent_instance;
+
+    ZSTD_CCtx *cctx;
+    ZSTD_DCtx *dctx;
+    gboolean frame_ended;
+};
+
+static void flow_zstd_converter_iface_init (GConverterIface *iface);
+
+G_DEFINE_FINAL_TYPE_WITH_CODE (FlowZstdConverter, flow_zstd_converter, G_TYPE_OBJECT,
+                               G_IMPLEMENT_INTERFACE (G_TYPE_CONVERTER, flow_zstd_converter_iface_init))
+
+static GConverterResult
+flow_zstd_converter_convert (GConverter      *converter,
+                             const void      *inbuf,
+                             gsize            inbuf_size,
+                             void            *outbuf,
+                             gsize            outbuf_size,
+                             GConverterFlags  flags,
+                             gsize           *bytes_read,
+                             gsize           *bytes_written,
+                             GError         **error)
+{
+    FlowZstdConverter *self = FLOW_ZSTD_CONVERTER (converter);
+    ZSTD_inBuffer in = { inbuf, inbuf_size, 0 };
+    ZSTD_outBuffer out = { outbuf, outbuf_size, 0 };
+    ZSTD_EndDirective mode = ZSTD_e_continue;
+    size_t ret;
+
+    if (self->cctx) {
+        if (flags & G_CONVERTER_INPUT_AT_END)
+            mode = ZSTD_e_end;
+        else if (flags & G_CONVERTER_FLUSH)
+            mode = ZSTD_e_flush;
+        ret = ZSTD_compressStream2 (self->cctx, &out, &in, mode);
+    } else {
+        ret = ZSTD_decompressStream (self->dctx, &out, &in);
+    }
+
+    if (ZSTD_isError (ret)) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Zstandard: %s", ZSTD_getErrorName (ret));
+        return G_CONVERTER_ERROR;
+    }
+
+    *bytes_read = in.pos;
+    *bytes_written = out.pos;
+
+    if (self->cctx) {
+        /* For the compressor, @ret is what is still waiting to be flushed. */
+        if (ret == 0 && in.pos == in.size && mode == ZSTD_e_end)
+            return G_CONVERTER_FINISHED;
+        if (ret == 0 && in.pos == in.size && mode == ZSTD_e_flush)
+            return G_CONVERTER_FLUSHED;
+        if (in.pos == 0 && out.pos == 0)
+            return converter_no_progress (in.size > 0 || ret > 0, error);
+        return G_CONVERTER_CONVERTED;
+    }
+
+    /* For the decompressor, 0 means a frame just ended; another may
+     * follow.  Once it has, ZSTD asks for the next frame's header, so
+     * whether the input may end here is remembered across calls. */
+    if (ret == 0)
+        self->frame_ended = TRUE;
+    else if (in.pos > 0 || out.pos > 0)
+        self->frame_ended = FALSE;
+
+    if ((flags & G_CONVERTER_INPUT_AT_END) && in.pos == in.size) {
+        if (self->frame_ended)
+            return G_CONVERTER_FINISHED;
+        if (out.pos == 0) {
+            g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Zstandard: truncated data");
+            return G_CONVERTER_ERROR;
+        }
+    }
+    if (in.pos == 0 && out.pos == 0)
+        return converter_no_progress (in.size > 0, error);
+    if ((flags & G_CONVERTER_FLUSH) && in.pos == in.size && out.pos < out.size)
+        return G_CONVERTER_FLUSHED;
+
+    return G_CONVERTER_CONVERTED;
+}
+
+static void
+flow_zstd_converter_reset (GConverter *converter)
+{
+    FlowZstdConverter *self = FLOW_ZSTD_CONVERTER (converter);
+
+    if (self->cctx)
+        ZSTD_CCtx_reset (self->cctx, ZSTD_reset_session_only);
+    if (self->dctx)
+        ZSTD_DCtx_reset (self->dctx, ZSTD_reset_session_only);
+    self->frame_ended = FALSE;
+}
+
+static void
+flow_zstd_converter_iface_init (GConverterIface *iface)
+{
+    iface->convert = flow_zstd_converter_convert;
+    iface->reset = flow_zstd_converter_reset;
+}
+
+static void
+flow_zstd_converter_finalize (GObject *object)
+{
+    FlowZstdConverter *self = FLOW_ZSTD_CONVERTER (object);
+
+    g_clear_pointer (&self->cctx, ZSTD_freeCCtx);
+    g_clear_pointer (&self->dctx, ZSTD_freeDCtx);
+
+    G_OBJECT_CLASS (flow_zstd_converter_parent_class)->finalize (object);
+}
+
+static void
+flow_zstd_converter_class_init (FlowZstdConverterClass *klass)
+{
+    G_OBJECT_CLASS (klass)->finalize = flow_zstd_converter_finalize;
+}
+
+static void
+flow_zstd_converter_init (FlowZstdConverter *self)
+{
+}
+
+static GConverter *
+flow_zstd_converter_new (gboolean compress)
+{
+    FlowZstdConverter *self = g_object_new (FLOW_TYPE_ZSTD_CONVERTER, NULL);
+
+    if (compress)
+        self->cctx = ZSTD_createCCtx ();
+    else
+        self->dctx = ZSTD_createDCtx ();
+
+    return G_CONVERTER (self);
+}
+
+#endif /* HAVE_ZSTD */
+
+#ifdef HAVE_LZMA
+
+#define FLOW_TYPE_XZ_CONVERTER (flow_xz_converter_get_type ())
+G_DECLARE_FINAL_TYPE (FlowXzConverter, flow_xz_converter, FLOW, XZ_CONVERTER, GObject)
+
+struct _FlowXzConverter
+{
+    GObject parent_instance;
+
+    gboolean compress;
+    lzma_stream stream;
+};
+
+static void flow_xz_converter_iface_init (GConverterIface *iface);
+
+G_DEFINE_FINAL_TYPE_WITH_CODE (FlowXzConverter, flow_xz_converter, G_TYPE_OBJECT,
+                               G_IMPLEMENT_INTERFACE (G_TYPE_CONVERTER, flow_xz_converter_iface_init))
+
+static gboolean
+flow_xz_converter_setup (FlowXzConverter *self, GError **error)
+{
+    lzma_stream init = LZMA_STREAM_INIT;
+    lzma_ret ret;
+
+    lzma_end (&self->stream);
+    self->stream = init;
+
+    if (self->compress)
+        ret = lzma_easy_encoder (&self->stream, 6, LZMA_CHECK_CRC64);
+    else
+        ret = lzma_stream_decoder (&self->stream, UINT64_MAX, LZMA_CONCATENATED);
+
+    if (ret != LZMA_OK) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to set up xz stream (error %d)", (gint) ret);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static GConverterResult
+flow_xz_converter_convert (GConverter      *converter,
+                           const void      *inbuf,
+                           gsize            inbuf_size,
+                           void            *outbuf,
+                           gsize            outbuf_size,
+                           GConverterFlags  flags,
+                           gsize           *bytes_read,
+                           gsize           *bytes_written,
+                           GError         **error)
+{
+    FlowXzConverter *self = FLOW_XZ_CONVERTER (converter);
+    lzma_action action = LZMA_RUN;
+    lzma_ret ret;
+
+    if (flags & G_CONVERTER_INPUT_AT_END)
+        action = LZMA_FINISH;
+    else if ((flags & G_CONVERTER_FLUSH) && self->compress)
+        action = LZMA_SYNC_FLUSH;
+
+    self->stream.next_in = inbuf;
+    self->stream.avail_in = inbuf_size;
+    self->stream.next_out = outbuf;
+    self->stream.avail_out = outbuf_size;
+
+    ret = lzma_code (&self->stream, action);
+
+    *bytes_read = inbuf_size - self->stream.avail_in;
+    *bytes_written = outbuf_size - self->stream.avail_out;
+
+    if (ret == LZMA_STREAM_END)
+        return action == LZMA_SYNC_FLUSH ? G_CONVERTER_FLUSHED : G_CONVERTER_FINISHED;
+
+    if (ret != LZMA_OK && ret != LZMA_BUF_ERROR) {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                             ret == LZMA_MEM_ERROR ? "xz: out of memory" : "xz: corrupt or unsupported data");
+        return G_CONVERTER_ERROR;
+    }
+
+    if (*bytes_read == 0 && *bytes_written == 0) {
+        if (action == LZMA_FINISH && !self->compress && inbuf_size == 0) {
+            g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "xz: truncated data");
+            return G_CONVERTER_ERROR;
+        }
+        return converter_no_progress (inbuf_size > 0 || action != LZMA_RUN, error);
+    }
+
+    if ((flags & G_CONVERTER_FLUSH) && !self->compress && self->stream.avail_in == 0 && self->stream.avail_out > 0)
+        return G_CONVERTER_FLUSHED;
+
+    return G_CONVERTER_CONVERTED;
+}
+
+static void
+flow_xz_converter_reset (GConverter *converter)
+{
+    flow_xz_converter_setup (FLOW_XZ_CONVERTER (converter), NULL);
+}
+
+static void
+flow_xz_converter_iface_init (GConverterIface *iface)
+{
+    iface->convert = flow_xz_converter_convert;
+    iface->reset = flow_xz_converter_reset;
+}
+
+static void
+flow_xz_converter_finalize (GObject *object)
+{
+    FlowXzConverter *self = FLOW_XZ_CONVERTER (object);
+
+    lzma_end (&self->stream);
+
+    G_OBJECT_CLASS (flow_xz_converter_parent_class)->finalize (object);
+}
+
+static void
+flow_xz_converter_class_init (FlowXzConverterClass *klass)
+{
+    G_OBJECT_CLASS (klass)->finalize = flow_xz_converter_finalize;
+}
+
+static void
+flow_xz_converter_init (FlowXzConverter *self)
+{
+    lzma_stream init = LZMA_STREAM_INIT;
+
+    self->stream = init;
+}
+
+static GConverter *
+flow_xz_converter_new (gboolean compress, GError **error)
+{
+    FlowXzConverter *self = g_object_new (FLOW_TYPE_XZ_CONVERTER, NULL);
+
+    self->compress = compress;
+    if (!flow_xz_converter_setup (self, error)) {
+        g_object_unref (self);
+        return NULL;
+    }
+
+    return G_CONVERTER (self);
+}
+
+#endif /* HAVE_LZMA */
+
+/* Recognizes a compressed file by its first bytes. */
+FlowCompression
+flow_compression_detect (const gchar *data, gsize len)
+{
+    if (len >= 2 && memcmp (data, "\x1F\x8B", 2) == 0)
+        return FLOW_COMPRESSION_GZIP;
+    if (len >= 4 && memcmp (data, "\x28\xB5\x2F\xFD", 4) == 0)
+        return FLOW_COMPRESSION_ZSTD;
+    if (len >= 6 && memcmp (data, "\xFD" "7zXZ\0", 6) == 0)
+        return FLOW_COMPRESSION_XZ;
+
+    return FLOW_COMPRESSION_NONE;
+}
+
+const gchar *
+flow_compression_get_name (FlowCompression compression)
+{
+    switch (compression) {
+        case FLOW_COMPRESSION_GZIP:
+            return "gzip";
+        case FLOW_COMPRESSION_ZSTD:
+            return "Zstandard";
+        case FLOW_COMPRESSION_XZ:
+            return "xz";
+        case FLOW_COMPRESSION_NONE:
+        default:
+            return NULL;
+    }
+}
+
+static GConverter *
+compression_new_converter (FlowCompression compression, gboolean compress, GError **error)
+{
+    switch (compression) {
+        case FLOW_COMPRESSION_GZIP:
+            if (compress)
+                return G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+            return G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+        case FLOW_COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+            return flow_zstd_converter_new (compress);
+#else
+            break;
+#endif
+        case FLOW_COMPRESSION_XZ:
+#ifdef HAVE_LZMA
+            return flow_xz_converter_new (compress, error);
+#else
+            break;
+#endif
+        case FLOW_COMPRESSION_NONE:
+        default:
+            g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Not a compressed format");
+            return NULL;
+    }
+
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                 "%s support is not available in this build", flow_compression_get_name (compression));
+    return NULL;
+}
+
+GConverter *
+flow_compression_new_decompressor (FlowCompression compression, GError **error)
+{
+    return compression_new_converter (compression, FALSE, error);
+}
+
+GConverter *
+flow_compression_new_compressor (FlowCompression compression, GError **error)
+{
+    return compression_new_converter (compression, TRUE, error);
+}
@@ -0,0 +1,45 @@
+/* flow-compression.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+    FLOW_COMPRESSION_NONE,
+    FLOW_COMPRESSION_GZIP,
+    FLOW_COMPRESSION_ZSTD,
+    FLOW_COMPRESSION_XZ,
+} FlowCompression;
+
+/* Enough leading bytes to recognize any supported format. */
+#define FLOW_COMPRESSION_MAGIC_SIZE 6
+
+FlowCompression flow_compression_detect           (const gchar     *data,
+                                                   gsize            len);
+const gchar    *flow_compression_get_name         (FlowCompression  compression);
+GConverter     *flow_compression_new_decompressor (FlowCompression  compression,
+                                                   GError         **error);
+GConverter     *flow_compression_new_compressor   (FlowCompression  compression,
+                                                   GError         **error);
+
+G_END_DECLS
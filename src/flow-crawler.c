@@ -0,0 +1,603 @@
+/* flow-crawler.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Each worker owns a deque of directories still to walk.  It takes the
+ * newest from its own, so it stays deep in one subtree and its reads
+ * stay close together on disk.  A worker whose deque is empty steals
+ * the oldest directory of another.  Old entries sit near the top of the
+ * tree, so one theft moves a whole subtree of work.  Deques are short
+ * and only locked for a push or a pop, so a mutex each is enough.
+ *
+ * Reads block, so there are more workers than cores; the extra ones
+ * keep more requests in flight for the disk.  A worker with nothing to
+ * take or steal sleeps until another pushes a directory, or until none
+ * is left anywhere and the walk is over.
+ *
+ * Which thread reaches a directory first varies from walk to walk, so
+ * nothing may depend on it.  A link into the folder is not followed at
+ * all, since the directory it names is walked under its own path.  A
+ * link out of it is, and each directory carries the identities of those
+ * above it, so a cycle is cut where it closes, the same way every time.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "flow-crawler.h"
+
+/* Workers per core, and in all. */
+#define CRAWLER_THREADS_PER_CORE 2
+#define CRAWLER_MAX_THREADS 32
+
+#define CRAWLER_DIR_ATTRIBUTES \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC "," \
+    G_FILE_ATTRIBUTE_UNIX_DEVICE "," G_FILE_ATTRIBUTE_UNIX_INODE
+#define CRAWLER_ENTRY_ATTRIBUTES \
+    G_FILE_ATTRIBUTE_STANDARD_NAME "," G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_SYMLINK "," G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC "," \
+    G_FILE_ATTRIBUTE_UNIX_INODE
+
+typedef struct {
+    guint32 device;
+    guint64 inode;
+} DirId;
+
+/* A directory and those above it, shared by its subdirectories. */
+typedef struct _CrawlAncestry CrawlAncestry;
+struct _CrawlAncestry {
+    CrawlAncestry *parent;
+    DirId id;
+};
+
+typedef struct {
+    GFile *dir;
+    gchar *relative;
+    CrawlAncestry *ancestry;    /* of its parent, NULL for the root */
+} CrawlItem;
+
+typedef struct {
+    FlowCrawler *crawler;
+    guint index;
+    GThread *thread;
+    GMutex mutex;
+    GQueue items;           /* CrawlItem, newest at the tail */
+} CrawlerWorker;
+
+struct _FlowCrawler
+{
+    GFile *root;
+    gchar *root_path;       /* with links resolved, if local */
+    FlowIgnore *ignore;
+    FlowCrawlerReuseFunc reuse_func;
+    gpointer reuse_data;
+    GCancellable *cancellable;
+
+    CrawlerWorker *workers;
+    guint n_workers;
+
+    gint n_pending;         /* directories pushed and not yet walked */
+    gint n_queued;          /* of those, the ones still in a deque */
+    gint n_idle;
+    gint stopping;
+    GMutex idle_mutex;
+    GCond idle_cond;
+    gboolean done;
+
+    GAsyncQueue *results;   /* FlowCrawlerDir, then the crawler itself */
+    gboolean finished;
+};
+
+static void
+crawl_ancestry_clear (gpointer data)
+{
+    CrawlAncestry *ancestry = data;
+
+    if (ancestry->parent)
+        g_atomic_rc_box_release_full (ancestry->parent, crawl_ancestry_clear);
+}
+
+static void
+crawl_ancestry_unref (CrawlAncestry *ancestry)
+{
+    if (ancestry)
+        g_atomic_rc_box_release_full (ancestry, crawl_ancestry_clear);
+}
+
+/* Whether the directory @id is @ancestry's or one above it. */
+static gboolean
+crawl_ancestry_contains (CrawlAncestry *ancestry, const DirId *id)
+{
+    for (; ancestry; ancestry = ancestry->parent) {
+        if (ancestry->id.device == id->device && ancestry->id.inode == id->inode)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static gint64
+info_get_mtime (GFileInfo *info)
+{
+    if (!info || !g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED))
+        return 0;
+
+    return (gint64) g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+           g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+}
+
+static gint
+compare_names (gconstpointer a, gconstpointer b)
+{
+    return strcmp (*(const gchar * const *) a, *(const gchar * const *) b);
+}
+
+static gint
+compare_files (gconstpointer a, gconstpointer b)
+{
+    return strcmp (((const FlowCrawlerFile *) a)->name, ((const FlowCrawlerFile *) b)->name);
+}
+
+static void
+crawl_item_free (CrawlItem *item)
+{
+    g_object_unref (item->dir);
+    g_free (item->relative);
+    crawl_ancestry_unref (item->ancestry);
+    g_free (item);
+}
+
+void
+flow_crawler_dir_free (FlowCrawlerDir *dir)
+{
+    if (!dir)
+        return;
+
+    g_free (dir->relative);
+    if (dir->files)
+        g_array_unref (dir->files);
+    g_ptr_array_unref (dir->subdirs);
+    g_free (dir->names);
+    g_free (dir);
+}
+
+/* Queues directory @name of @parent, which is @ancestry, on @worker's
+ * deque. */
+static void
+crawler_push (FlowCrawler   *crawler,
+              CrawlerWorker *worker,
+              CrawlItem     *parent,
+              CrawlAncestry *ancestry,
+              const gchar   *name)
+{
+    CrawlItem *item = g_new (CrawlItem, 1);
+
+    item->dir = g_file_get_child (parent->dir, name);
+    item->relative = *parent->relative ? g_build_filename (parent->relative, name, NULL) : g_strdup (name);
+    item->ancestry = ancestry ? g_atomic_rc_box_acquire (ancestry) : NULL;
+
+    g_atomic_int_inc (&crawler->n_pending);
+    g_mutex_lock (&worker->mutex);
+    g_queue_push_tail (&worker->items, item);
+    g_mutex_unlock (&worker->mutex);
+    g_atomic_int_inc (&crawler->n_queued);
+
+    /* A sleeper counts itself idle before it looks at n_queued, so
+     * either it sees this directory or this sees it. */
+    if (g_atomic_int_get (&crawler->n_idle) > 0) {
+        g_mutex_lock (&crawler->idle_mutex);
+        g_cond_signal (&crawler->idle_cond);
+        g_mutex_unlock (&crawler->idle_mutex);
+    }
+}
+
+static CrawlItem *
+worker_pop (CrawlerWorker *worker, gboolean steal)
+{
+    CrawlItem *item;
+
+    g_mutex_lock (&worker->mutex);
+    item = steal ? g_queue_pop_head (&worker->items) : g_queue_pop_tail (&worker->items);
+    g_mutex_unlock (&worker->mutex);
+
+    if (item)
+        g_atomic_int_add (&worker->crawler->n_queued, -1);
+    return item;
+}
+
+/* Next directory for @worker to walk, or NULL once the walk is over. */
+static CrawlItem *
+crawler_take (FlowCrawler *crawler, CrawlerWorker *worker)
+{
+    CrawlItem *item;
+    gboolean done;
+    guint i;
+
+    for (;;) {
+        item = worker_pop (worker, FALSE);
+        for (i = 1; !item && i < crawler->n_workers; i++)
+            item = worker_pop (&crawler->workers[(worker->index + i) % crawler->n_workers], TRUE);
+        if (item)
+            return item;
+
+        g_mutex_lock (&crawler->idle_mutex);
+        g_atomic_int_inc (&crawler->n_idle);
+        while (!crawler->done && g_atomic_int_get (&crawler->n_queued) == 0)
+            g_cond_wait (&crawler->idle_cond, &crawler->idle_mutex);
+        g_atomic_int_add (&crawler->n_idle, -1);
+        done = crawler->done;
+        g_mutex_unlock (&crawler->idle_mutex);
+
+        if (done)
+            return NULL;
+    }
+}
+
+/*
+ * Sets @ancestry to that of the directory @info describes, as @item, for
+ * its subdirectories; FALSE if it is one of those above it.  Without an
+ * identity, @item's own ancestry stands in.
+ */
+static gboolean
+crawler_enter (CrawlItem *item, GFileInfo *info, CrawlAncestry **ancestry)
+{
+    DirId id;
+
+    if (!info || !g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_INODE)) {
+        *ancestry = item->ancestry ? g_atomic_rc_box_acquire (item->ancestry) : NULL;
+        return TRUE;
+    }
+
+    id.device = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+    id.inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+    if (crawl_ancestry_contains (item->ancestry, &id))
+        return FALSE;
+
+    *ancestry = g_atomic_rc_box_new (CrawlAncestry);
+    (*ancestry)->parent = item->ancestry ? g_atomic_rc_box_acquire (item->ancestry) : NULL;
+    (*ancestry)->id = id;
+    return TRUE;
+}
+
+/* Whether the link @name in @item leads back into the folder. */
+static gboolean
+crawler_link_is_inside (FlowCrawler *crawler, CrawlItem *item, const gchar *name)
+{
+    GFile *link;
+    gchar *path;
+    gchar *target;
+    gboolean inside = FALSE;
+
+    if (!crawler->root_path)
+        return FALSE;
+
+    link = g_file_get_child (item->dir, name);
+    path = g_file_get_path (link);
+    target = path ? realpath (path, NULL) : NULL;
+    if (target) {
+        gsize root_len = strlen (crawler->root_path);
+
+        inside = strncmp (target, crawler->root_path, root_len) == 0 &&
+                 (target[root_len] == '\0' || target[root_len] == G_DIR_SEPARATOR ||
+                  (root_len > 0 && crawler->root_path[root_len - 1] == G_DIR_SEPARATOR));
+        free (target);
+    }
+    g_free (path);
+    g_object_unref (link);
+    return inside;
+}
+
+/* Whether @name in @item is ignored; @path is scratch space. */
+static gboolean
+crawler_ignores (FlowCrawler *crawler, CrawlItem *item, GString *path, const gchar *name, gboolean is_directory)
+{
+    if (!crawler->ignore)
+        return FALSE;
+
+    g_string_assign (path, item->relative);
+    if (path->len > 0)
+        g_string_append_c (path, G_DIR_SEPARATOR);
+    g_string_append (path, name);
+    return flow_ignore_is_ignored (crawler->ignore, path->str, is_directory);
+}
+
+/* Reads @item's entries into @result; returns its subdirectories. */
+static GPtrArray *
+crawler_read_dir (FlowCrawler *crawler, CrawlItem *item, FlowCrawlerDir *result)
+{
+    GFileEnumerator *enumerator;
+    GPtrArray *subdirs = g_ptr_array_new_with_free_func (g_free);
+    GString *names = g_string_new (NULL);
+    GString *path = g_string_new (NULL);
+    GFileInfo *info;
+    guint i;
+
+    result->files = g_array_new (FALSE, FALSE, sizeof (FlowCrawlerFile));
+
+    enumerator = g_file_enumerate_children (item->dir, CRAWLER_ENTRY_ATTRIBUTES, G_FILE_QUERY_INFO_NONE,
+                                            crawler->cancellable, NULL);
+
+    while (enumerator && (info = g_file_enumerator_next_file (enumerator, crawler->cancellable, NULL))) {
+        GFileType type = g_file_info_get_file_type (info);
+        const gchar *name = g_file_info_get_name (info);
+
+        /* A link is only followed out of the folder, and only where
+         * the cycle check can work. */
+        if (type == G_FILE_TYPE_DIRECTORY && g_file_info_get_is_symlink (info) &&
+            (!g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_INODE) ||
+             crawler_link_is_inside (crawler, item, name)))
+            type = G_FILE_TYPE_UNKNOWN;
+
+        if ((type == G_FILE_TYPE_DIRECTORY || type == G_FILE_TYPE_REGULAR) &&
+            crawler_ignores (crawler, item, path, name, type == G_FILE_TYPE_DIRECTORY))
+            type = G_FILE_TYPE_UNKNOWN;
+
+        if (type == G_FILE_TYPE_DIRECTORY) {
+            g_ptr_array_add (subdirs, g_strdup (name));
+        } else if (type == G_FILE_TYPE_REGULAR) {
+            FlowCrawlerFile file;
+
+            /* An offset for now; names may still move. */
+            file.name = GSIZE_TO_POINTER (names->len);
+            file.size = g_file_info_get_size (info);
+            file.mtime = info_get_mtime (info);
+            g_string_append_len (names, name, strlen (name) + 1);
+            g_array_append_val (result->files, file);
+        }
+        g_object_unref (info);
+    }
+    g_clear_object (&enumerator);
+    g_string_free (path, TRUE);
+
+    result->names = g_string_free (names, FALSE);
+    for (i = 0; i < result->files->len; i++) {
+        FlowCrawlerFile *file = &g_array_index (result->files, FlowCrawlerFile, i);
+
+        file->name = result->names + GPOINTER_TO_SIZE (file->name);
+    }
+    g_array_sort (result->files, compare_files);
+
+    return subdirs;
+}
+
+static void
+crawler_visit (FlowCrawler *crawler, CrawlerWorker *worker, CrawlItem *item)
+{
+    FlowCrawlerDir *result;
+    GFileInfo *info;
+    CrawlAncestry *ancestry;
+    GPtrArray *subdirs = NULL;
+    guint i;
+
+    if (g_atomic_int_get (&crawler->stopping) || g_cancellable_is_cancelled (crawler->cancellable))
+        return;
+
+    info = g_file_query_info (item->dir, CRAWLER_DIR_ATTRIBUTES, G_FILE_QUERY_INFO_NONE,
+                              crawler->cancellable, NULL);
+    if (!crawler_enter (item, info, &ancestry)) {
+        g_object_unref (info);
+        return;
+    }
+
+    result = g_new0 (FlowCrawlerDir, 1);
+    result->relative = g_strdup (item->relative);
+    result->mtime = info_get_mtime (info);
+    g_clear_object (&info);
+
+    /* Rules of the directory come before any question about its entries. */
+    if (crawler->ignore)
+        flow_ignore_load_dir (crawler->ignore, item->relative, crawler->cancellable);
+
+    if (crawler->reuse_func && result->mtime != 0)
+        subdirs = crawler->reuse_func (item->relative, result->mtime, crawler->reuse_data);
+
+    if (subdirs) {
+        GString *path = g_string_new (NULL);
+
+        for (i = subdirs->len; i > 0; i--) {
+            if (crawler_ignores (crawler, item, path, subdirs->pdata[i - 1], TRUE))
+                g_ptr_array_remove_index (subdirs, i - 1);
+        }
+        g_string_free (path, TRUE);
+    } else {
+        result->read = TRUE;
+        subdirs = crawler_read_dir (crawler, item, result);
+    }
+
+    g_ptr_array_sort (subdirs, compare_names);
+    result->subdirs = subdirs;
+
+    /* Pushed in reverse so the first subdirectory is walked next. */
+    for (i = subdirs->len; i > 0; i--)
+        crawler_push (crawler, worker, item, ancestry, subdirs->pdata[i - 1]);
+    crawl_ancestry_unref (ancestry);
+
+    g_async_queue_push (crawler->results, result);
+}
+
+static gpointer
+crawler_worker_run (gpointer data)
+{
+    CrawlerWorker *worker = data;
+    FlowCrawler *crawler = worker->crawler;
+    CrawlItem *item;
+
+    while ((item = crawler_take (crawler, worker))) {
+        crawler_visit (crawler, worker, item);
+        crawl_item_free (item);
+
+        if (g_atomic_int_dec_and_test (&crawler->n_pending)) {
+            g_mutex_lock (&crawler->idle_mutex);
+            crawler->done = TRUE;
+            g_cond_broadcast (&crawler->idle_cond);
+            g_mutex_unlock (&crawler->idle_mutex);
+            g_async_queue_push (crawler->results, crawler);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Creates a crawler for @root, leaving out what @ignore does, if given.
+ * Nothing is read before flow_crawler_start().
+ */
+FlowCrawler *
+flow_crawler_new (GFile *root, FlowIgnore *ignore)
+{
+    FlowCrawler *crawler;
+    gchar *path;
+    guint i;
+
+    g_return_val_if_fail (G_IS_FILE (root), NULL);
+
+    crawler = g_new0 (FlowCrawler, 1);
+    crawler->root = g_object_ref (root);
+    path = g_file_get_path (root);
+    if (path) {
+        gchar *resolved = realpath (path, NULL);
+
+        /* From the C library's allocator, so copied for g_free(). */
+        crawler->root_path = g_strdup (resolved);
+        free (resolved);
+        g_free (path);
+    }
+    crawler->ignore = ignore ? flow_ignore_ref (ignore) : NULL;
+    crawler->n_workers = CLAMP (g_get_num_processors () * CRAWLER_THREADS_PER_CORE, 1, CRAWLER_MAX_THREADS);
+    crawler->workers = g_new0 (CrawlerWorker, crawler->n_workers);
+    for (i = 0; i < crawler->n_workers; i++) {
+        crawler->workers[i].crawler = crawler;
+        crawler->workers[i].index = i;
+        g_mutex_init (&crawler->workers[i].mutex);
+        g_queue_init (&crawler->workers[i].items);
+    }
+    g_mutex_init (&crawler->idle_mutex);
+    g_cond_init (&crawler->idle_cond);
+    crawler->results = g_async_queue_new ();
+    return crawler;
+}
+
+/* Sets the function that lets known directories go unread. */
+void
+flow_crawler_set_reuse_func (FlowCrawler *crawler, FlowCrawlerReuseFunc func, gpointer user_data)
+{
+    g_return_if_fail (crawler != NULL);
+    g_return_if_fail (crawler->cancellable == NULL);
+
+    crawler->reuse_func = func;
+    crawler->reuse_data = user_data;
+}
+
+/* Starts the walk at the root.  Call once. */
+void
+flow_crawler_start (FlowCrawler *crawler, GCancellable *cancellable)
+{
+    CrawlItem *root;
+    guint i;
+    guint n_started = 0;
+
+    g_return_if_fail (crawler != NULL);
+    g_return_if_fail (crawler->cancellable == NULL);
+
+    crawler->cancellable = cancellable ? g_object_ref (cancellable) : g_cancellable_new ();
+
+    root = g_new (CrawlItem, 1);
+    root->dir = g_object_ref (crawler->root);
+    root->relative = g_strdup ("");
+    root->ancestry = NULL;
+    crawler->n_pending = 1;
+    crawler->n_queued = 1;
+    g_queue_push_tail (&crawler->workers[0].items, root);
+
+    for (i = 0; i < crawler->n_workers; i++) {
+        crawler->workers[i].thread = g_thread_try_new ("flow-crawler", crawler_worker_run,
+                                                       &crawler->workers[i], NULL);
+        if (crawler->workers[i].thread)
+            n_started++;
+    }
+
+    /* Without threads, this one walks everything before returning. */
+    if (n_started == 0)
+        crawler_worker_run (&crawler->workers[0]);
+}
+
+/*
+ * Waits for the next directory walked, in no particular order, and
+ * returns it; free it with flow_crawler_dir_free().  NULL once every
+ * directory has been returned.
+ */
+FlowCrawlerDir *
+flow_crawler_next (FlowCrawler *crawler)
+{
+    gpointer result;
+
+    g_return_val_if_fail (crawler != NULL, NULL);
+    g_return_val_if_fail (crawler->cancellable != NULL, NULL);
+
+    if (crawler->finished)
+        return NULL;
+
+    result = g_async_queue_pop (crawler->results);
+    if (result == crawler) {
+        crawler->finished = TRUE;
+        return NULL;
+    }
+    return result;
+}
+
+/* Stops a walk still going, waits for its threads, and frees it. */
+void
+flow_crawler_free (FlowCrawler *crawler)
+{
+    gpointer result;
+    guint i;
+
+    if (!crawler)
+        return;
+
+    /* The rest of the walk only drains the deques. */
+    g_atomic_int_set (&crawler->stopping, TRUE);
+    for (i = 0; i < crawler->n_workers; i++) {
+        if (crawler->workers[i].thread)
+            g_thread_join (crawler->workers[i].thread);
+    }
+
+    while ((result = g_async_queue_try_pop (crawler->results))) {
+        if (result != crawler)
+            flow_crawler_dir_free (result);
+    }
+    g_async_queue_unref (crawler->results);
+
+    for (i = 0; i < crawler->n_workers; i++) {
+        g_queue_clear_full (&crawler->workers[i].items, (GDestroyNotify) crawl_item_free);
+        g_mutex_clear (&crawler->workers[i].mutex);
+    }
+    g_free (crawler->workers);
+    g_mutex_clear (&crawler->idle_mutex);
+    g_cond_clear (&crawler->idle_cond);
+    g_clear_object (&crawler->cancellable);
+    if (crawler->ignore)
+        flow_ignore_unref (crawler->ignore);
+    g_object_unref (crawler->root);
+    g_free (crawler->root_path);
+    g_free (crawler);
+}
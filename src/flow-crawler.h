@@ -0,0 +1,81 @@
+/* flow-crawler.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "flow-ignore.h"
+
+G_BEGIN_DECLS
+
+/*
+ * FlowCrawler walks every directory under a folder on a pool of threads
+ * and streams what it finds, one directory at a time, to a consumer on
+ * another thread.  There is no depth limit.  Symbolic links to
+ * directories inside the folder are not followed, so each directory
+ * there is walked once, under its real path.  Links out of the folder
+ * are followed, and a link cycle ends where a directory, by device and
+ * inode, comes round again.  Ignored entries are left out and ignored
+ * directories never read.
+ *
+ * A directory the consumer already knows, by its modification time, can
+ * be passed over: the reuse function then names its subdirectories, and
+ * only those are walked.
+ */
+typedef struct _FlowCrawler FlowCrawler;
+
+typedef struct {
+    const gchar *name;
+    guint64 size;
+    gint64 mtime;           /* microseconds, or 0 if unknown */
+} FlowCrawlerFile;
+
+typedef struct {
+    gchar *relative;        /* path from the folder, empty for the folder */
+    gint64 mtime;           /* microseconds, or 0 if unknown */
+    gboolean read;          /* FALSE if the reuse function knew it */
+    GArray *files;          /* FlowCrawlerFile in name order, if read */
+    GPtrArray *subdirs;     /* names in name order */
+    gchar *names;           /* storage for the file names */
+} FlowCrawlerDir;
+
+/*
+ * Called from the crawler's threads.  Returns a new array, freeing its
+ * names, of the subdirectories of @relative if its contents are known
+ * for @mtime, or NULL to read it.
+ */
+typedef GPtrArray *(*FlowCrawlerReuseFunc) (const gchar *relative,
+                                            gint64       mtime,
+                                            gpointer     user_data);
+
+FlowCrawler    *flow_crawler_new            (GFile                *root,
+                                             FlowIgnore           *ignore);
+void            flow_crawler_set_reuse_func (FlowCrawler          *crawler,
+                                             FlowCrawlerReuseFunc  func,
+                                             gpointer              user_data);
+void            flow_crawler_start          (FlowCrawler          *crawler,
+                                             GCancellable         *cancellable);
+FlowCrawlerDir *flow_crawler_next           (FlowCrawler          *crawler);
+void            flow_crawler_free           (FlowCrawler          *crawler);
+
+void            flow_crawler_dir_free       (FlowCrawlerDir       *dir);
+
+G_END_DECLS
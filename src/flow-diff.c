@@ -0,0 +1,278 @@
+/* flow-diff.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Line diff in the style of Myers' O((N+M)D) algorithm.  Lines common to
+ * the start and end of both texts are stripped first, which leaves little
+ * to compare for the usual case of a few edits in a large file.  Past
+ * DIFF_MAX_EDITS differing lines the remaining middle is reported as a
+ * single hunk rather than searched for a minimal script.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "flow-diff.h"
+
+#define DIFF_MAX_EDITS 2000
+
+typedef struct {
+    const gchar *data;
+    gsize len;
+    guint32 hash;
+} DiffLine;
+
+static guint32
+diff_hash (const gchar *data, gsize len)
+{
+    guint32 hash = 2166136261u;
+    gsize i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (guchar) data[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/* Splits @text after each newline; a final line without one counts too. */
+static GArray *
+diff_split_lines (const gchar *text, gsize len)
+{
+    GArray *lines = g_array_new (FALSE, FALSE, sizeof (DiffLine));
+    const gchar *p = text;
+    const gchar *end = text + len;
+
+    while (p < end) {
+        const gchar *nl = memchr (p, '\n', (gsize) (end - p));
+        DiffLine line;
+
+        line.data = p;
+        line.len = nl ? (gsize) (nl + 1 - p) : (gsize) (end - p);
+        line.hash = diff_hash (line.data, line.len);
+        g_array_append_val (lines, line);
+        p += line.len;
+    }
+
+    return lines;
+}
+
+static gboolean
+diff_line_equal (const DiffLine *a, const DiffLine *b)
+{
+    return a->hash == b->hash && a->len == b->len && memcmp (a->data, b->data, a->len) == 0;
+}
+
+/*
+ * Marks the lines of @a that are deleted and the lines of @b that are
+ * inserted by a shortest edit script.  Returns FALSE if the texts differ
+ * in more than DIFF_MAX_EDITS lines, leaving the marks unset.
+ */
+static gboolean
+diff_myers (const DiffLine *a, gssize n, const DiffLine *b, gssize m,
+            gboolean *deleted, gboolean *inserted, GCancellable *cancellable)
+{
+    gssize max = MIN (n + m, DIFF_MAX_EDITS);
+    gssize *v;
+    GArray *trace;
+    GArray *trace_offsets;
+    gssize d, k;
+    gssize x = 0, y = 0;
+    gboolean found = FALSE;
+
+    v = g_new0 (gssize, 2 * max + 3);
+    trace = g_array_new (FALSE, FALSE, sizeof (gssize));
+    trace_offsets = g_array_new (FALSE, FALSE, sizeof (guint));
+
+#define V(k) v[(k) + max + 1]
+
+    for (d = 0; d <= max && !found; d++) {
+        guint offset;
+
+        if (g_cancellable_is_cancelled (cancellable))
+            break;
+
+        for (k = -d; k <= d; k += 2) {
+            if (k == -d || (k != d && V (k - 1) < V (k + 1)))
+                x = V (k + 1);
+            else
+                x = V (k - 1) + 1;
+            y = x - k;
+
+            while (x < n && y < m && diff_line_equal (&a[x], &b[y])) {
+                x++;
+                y++;
+            }
+
+            V (k) = x;
+            if (x >= n && y >= m) {
+                found = TRUE;
+                break;
+            }
+        }
+
+        /* Keep this step's frontier for walking the path back. */
+        offset = trace->len;
+        g_array_append_val (trace_offsets, offset);
+        g_array_append_vals (trace, &V (-d), (guint) (2 * d + 1));
+    }
+
+    if (found) {
+        gssize last = d - 1;
+
+        x = n;
+        y = m;
+        for (d = last; d > 0; d--) {
+            const gssize *prev = &g_array_index (trace, gssize, g_array_index (trace_offsets, guint, d - 1));
+            gssize prev_k, prev_x, prev_y;
+
+            k = x - y;
+            /* prev holds the frontier of step d - 1, indexed from -(d - 1). */
+            if (k == -d || (k != d && prev[k - 1 + (d - 1)] < prev[k + 1 + (d - 1)]))
+                prev_k = k + 1;
+            else
+                prev_k = k - 1;
+            prev_x = prev[prev_k + (d - 1)];
+            prev_y = prev_x - prev_k;
+
+            while (x > prev_x && y > prev_y) {
+                x--;
+                y--;
+            }
+
+            if (x == prev_x)
+                inserted[prev_y] = TRUE;
+            else
+                deleted[prev_x] = TRUE;
+
+            x = prev_x;
+            y = prev_y;
+        }
+    }
+
+#undef V
+
+    g_array_unref (trace_offsets);
+    g_array_unref (trace);
+    g_free (v);
+
+    return found;
+}
+
+/*
+ * Compares two texts line by line and returns the differing regions as an
+ * array of FlowDiffHunk in document order, or %NULL if @cancellable was
+ * triggered.  Identical texts give an empty array.
+ */
+GArray *
+flow_diff_lines (const gchar  *old_text,
+                 gsize         old_len,
+                 const gchar  *new_text,
+                 gsize         new_len,
+                 GCancellable *cancellable)
+{
+    GArray *hunks = g_array_new (FALSE, FALSE, sizeof (FlowDiffHunk));
+    GArray *a_lines, *b_lines;
+    const DiffLine *a, *b;
+    gboolean *deleted, *inserted;
+    gsize prefix = 0;
+    gsize n, m;
+    gsize i = 0, j = 0;
+    gsize a_base, b_base;
+
+    if (old_len == new_len && memcmp (old_text, new_text, old_len) == 0)
+        return hunks;
+
+    a_lines = diff_split_lines (old_text, old_len);
+    b_lines = diff_split_lines (new_text, new_len);
+    a = (const DiffLine *) (gpointer) a_lines->data;
+    b = (const DiffLine *) (gpointer) b_lines->data;
+    n = a_lines->len;
+    m = b_lines->len;
+
+    while (prefix < n && prefix < m && diff_line_equal (&a[prefix], &b[prefix]))
+        prefix++;
+    while (n > prefix && m > prefix && diff_line_equal (&a[n - 1], &b[m - 1])) {
+        n--;
+        m--;
+    }
+
+    a_base = prefix < a_lines->len ? (gsize) (a[prefix].data - old_text) : old_len;
+    b_base = prefix < b_lines->len ? (gsize) (b[prefix].data - new_text) : new_len;
+    a += prefix;
+    b += prefix;
+    n -= prefix;
+    m -= prefix;
+
+    deleted = g_new0 (gboolean, n + 1);
+    inserted = g_new0 (gboolean, m + 1);
+
+    if (!diff_myers (a, (gssize) n, b, (gssize) m, deleted, inserted, cancellable)) {
+        if (g_cancellable_is_cancelled (cancellable)) {
+            g_clear_pointer (&hunks, g_array_unref);
+            goto out;
+        }
+        /* Too different to be worth a minimal script: replace it all. */
+        for (i = 0; i < n; i++)
+            deleted[i] = TRUE;
+        for (j = 0; j < m; j++)
+            inserted[j] = TRUE;
+        i = j = 0;
+    }
+
+    {
+        gsize a_pos = a_base;
+        gsize b_pos = b_base;
+
+        while (i < n || j < m) {
+            FlowDiffHunk hunk;
+
+            if (i < n && j < m && !deleted[i] && !inserted[j]) {
+                a_pos += a[i++].len;
+                b_pos += b[j++].len;
+                continue;
+            }
+
+            hunk.old_start = a_pos;
+            hunk.new_start = b_pos;
+            while ((i < n && deleted[i]) || (j < m && inserted[j])) {
+                while (i < n && deleted[i])
+                    a_pos += a[i++].len;
+                while (j < m && inserted[j])
+                    b_pos += b[j++].len;
+            }
+            hunk.old_end = a_pos;
+            hunk.new_end = b_pos;
+            if (hunk.old_end == hunk.old_start && hunk.new_end == hunk.new_start)
+                break;
+            g_array_append_val (hunks, hunk);
+        }
+    }
+
+out:
+    g_free (deleted);
+    g_free (inserted);
+    g_array_unref (a_lines);
+    g_array_unref (b_lines);
+
+    return hunks;
+}
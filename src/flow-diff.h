@@ -0,0 +1,45 @@
+/* flow-diff.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A run of whole lines that differs between two texts: bytes
+ * [old_start, old_end) of the old text become [new_start, new_end) of the
+ * new one.  Either range may be empty.
+ */
+typedef struct {
+    gsize old_start;
+    gsize old_end;
+    gsize new_start;
+    gsize new_end;
+} FlowDiffHunk;
+
+GArray *flow_diff_lines (const gchar  *old_text,
+                         gsize         old_len,
+                         const gchar  *new_text,
+                         gsize         new_len,
+                         GCancellable *cancellable);
+
+G_END_DECLS
@@ -0,0 +1,211 @@
+/* flow-encoding.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "flow-encoding.h"
+
+#define ASCII_HIGH_BITS G_GUINT64_CONSTANT (0x8080808080808080)
+/* How much of the sample the UTF-16 heuristic looks at. */
+#define UTF16_SAMPLE_BYTES 4096
+
+/*
+ * TRUE if @data is pure 7-bit ASCII.  Works on eight bytes at a time and
+ * only ORs them together, a loop compilers turn into vector code; most
+ * source files take this path and never reach full UTF-8 validation.
+ */
+gboolean
+flow_encoding_is_ascii (const gchar *data, gsize len)
+{
+    guint64 acc = 0;
+    gsize i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        guint64 w[4];
+
+        memcpy (w, data + i, sizeof w);
+        acc |= w[0] | w[1] | w[2] | w[3];
+        if (acc & ASCII_HIGH_BITS)
+            return FALSE;
+    }
+
+    for (; i + 8 <= len; i += 8) {
+        guint64 w;
+
+        memcpy (&w, data + i, sizeof w);
+        acc |= w;
+    }
+
+    for (; i < len; i++)
+        acc |= (guchar) data[i];
+
+    return (acc & ASCII_HIGH_BITS) == 0;
+}
+
+/* Valid UTF-8, except possibly for a sequence cut off at the end. */
+static gboolean
+utf8_validate_prefix (const gchar *data, gsize len)
+{
+    const gchar *end;
+    gsize rest;
+
+    if (g_utf8_validate_len (data, len, &end))
+        return TRUE;
+
+    rest = len - (gsize) (end - data);
+    if (rest == 0 || rest > 3 || (guchar) *end < 0xC0)
+        return FALSE;
+
+    return (gsize) g_utf8_skip[(guchar) *end] > rest;
+}
+
+/* Text encoded as UTF-16 without a BOM is mostly ASCII with every other
+ * byte zero. */
+static const gchar *
+detect_utf16 (const gchar *data, gsize len)
+{
+    gsize even_zeros = 0;
+    gsize odd_zeros = 0;
+    gsize pairs;
+    gsize i;
+
+    len = MIN (len, UTF16_SAMPLE_BYTES) & ~(gsize) 1;
+    pairs = len / 2;
+    if (pairs < 2)
+        return NULL;
+
+    for (i = 0; i < len; i += 2) {
+        even_zeros += data[i] == 0;
+        odd_zeros += data[i + 1] == 0;
+    }
+
+    if (odd_zeros * 10 >= pairs * 4 && even_zeros * 20 <= pairs)
+        return FLOW_ENCODING_UTF16LE;
+    if (even_zeros * 10 >= pairs * 4 && odd_zeros * 20 <= pairs)
+        return FLOW_ENCODING_UTF16BE;
+
+    return NULL;
+}
+
+/*
+ * Single-byte fallback for text that is not UTF-8.  Windows-1252 is what
+ * such files nearly always are; the few bytes it leaves undefined fall
+ * back to ISO-8859-1, which decodes anything.  Only @data is judged, so
+ * callers that see the file in pieces must settle on the whole of it.
+ */
+const gchar *
+flow_encoding_detect_legacy (const gchar *data, gsize len)
+{
+    gsize i;
+
+    for (i = 0; i < len; i++) {
+        guchar c = (guchar) data[i];
+
+        if (c == 0x81 || c == 0x8D || c == 0x8F || c == 0x90 || c == 0x9D)
+            return FLOW_ENCODING_LATIN1;
+    }
+
+    return FLOW_ENCODING_LEGACY;
+}
+
+/*
+ * Guesses the encoding of a file from its first @len bytes.  @bom_len is
+ * set to the size of a byte order mark to skip, or 0.
+ */
+const gchar *
+flow_encoding_detect (const gchar *data, gsize len, gsize *bom_len)
+{
+    const gchar *charset;
+
+    *bom_len = 0;
+
+    if (len >= 3 && memcmp (data, "\xEF\xBB\xBF", 3) == 0) {
+        *bom_len = 3;
+        return FLOW_ENCODING_UTF8;
+    }
+    if (len >= 2 && memcmp (data, "\xFF\xFE", 2) == 0) {
+        *bom_len = 2;
+        return FLOW_ENCODING_UTF16LE;
+    }
+    if (len >= 2 && memcmp (data, "\xFE\xFF", 2) == 0) {
+        *bom_len = 2;
+        return FLOW_ENCODING_UTF16BE;
+    }
+
+    /* Before the ASCII check: UTF-16 text is ASCII bytes and zeros. */
+    charset = detect_utf16 (data, len);
+    if (charset)
+        return charset;
+
+    if (flow_encoding_is_ascii (data, len))
+        return FLOW_ENCODING_UTF8;
+
+    if (utf8_validate_prefix (data, len))
+        return FLOW_ENCODING_UTF8;
+
+    return flow_encoding_detect_legacy (data, len);
+}
+
+/*
+ * TRUE if the first @len bytes of a file look like binary data rather
+ * than text in any encoding flow_encoding_detect() understands: NUL bytes
+ * outside of UTF-16, or many control characters text never contains.
+ */
+gboolean
+flow_encoding_looks_binary (const gchar *data, gsize len)
+{
+    const gchar *charset;
+    gsize bom_len;
+    gsize controls = 0;
+    gsize i;
+
+    if (len == 0)
+        return FALSE;
+
+    charset = flow_encoding_detect (data, len, &bom_len);
+    if (flow_encoding_is_utf16 (charset))
+        return FALSE;
+
+    for (i = 0; i < len; i++) {
+        guchar c = (guchar) data[i];
+
+        if (c == 0)
+            return TRUE;
+        if (c < 0x20 && c != '\t' && c != '\n' && c != '\r' && c != '\f' && c != '\v' &&
+            c != '\b' && c != 0x1B)
+            controls++;
+    }
+
+    return controls * 10 > len;
+}
+
+gboolean
+flow_encoding_is_utf8 (const gchar *charset)
+{
+    return !charset || g_ascii_strcasecmp (charset, FLOW_ENCODING_UTF8) == 0;
+}
+
+gboolean
+flow_encoding_is_utf16 (const gchar *charset)
+{
+    return charset && g_ascii_strncasecmp (charset, "UTF-16", 6) == 0;
+}
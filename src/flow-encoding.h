@@ -0,0 +1,45 @@
+/* flow-encoding.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define FLOW_ENCODING_UTF8     "UTF-8"
+#define FLOW_ENCODING_UTF16LE  "UTF-16LE"
+#define FLOW_ENCODING_UTF16BE  "UTF-16BE"
+#define FLOW_ENCODING_LEGACY   "WINDOWS-1252"
+#define FLOW_ENCODING_LATIN1   "ISO-8859-1"
+
+gboolean     flow_encoding_is_ascii      (const gchar *data,
+                                          gsize        len);
+const gchar *flow_encoding_detect        (const gchar *data,
+                                          gsize        len,
+                                          gsize       *bom_len);
+const gchar *flow_encoding_detect_legacy (const gchar *data,
+                                          gsize        len);
+gboolean     flow_encoding_looks_binary  (const gchar *data,
+                                          gsize        len);
+gboolean     flow_encoding_is_utf8       (const gchar *charset);
+gboolean     flow_encoding_is_utf16      (const gchar *charset);
+
+G_END_DECLS
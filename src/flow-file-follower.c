@@ -0,0 +1,339 @@
+/* flow-file-follower.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "flow-encoding.h"
+#include "flow-file-follower.h"
+
+/* Most text handed over per read; a larger backlog takes several. */
+#define FOLLOW_BATCH_SIZE     (256 * 1024)
+/* Bursts of writes closer together than this are read as one batch. */
+#define FOLLOW_RATE_LIMIT_MS  250
+
+struct _FlowFileFollower
+{
+    gint ref_count;
+
+    GFile *file;
+    gchar *charset;         /* NULL for UTF-8 */
+    GFileMonitor *monitor;
+    GCancellable *cancellable;
+    guint64 offset;         /* next byte to read */
+    gboolean reading;
+    gboolean read_again;
+
+    FlowFileFollowerFunc func;
+    gpointer user_data;
+};
+
+typedef struct {
+    GFile *file;
+    gchar *charset;
+    guint64 offset;
+    gboolean truncated;
+    gboolean more;
+} FollowRead;
+
+static void follower_read (FlowFileFollower *follower);
+
+static void
+follow_read_free (FollowRead *read)
+{
+    g_object_unref (read->file);
+    g_free (read->charset);
+    g_free (read);
+}
+
+/*
+ * Follows @file from byte @offset, or from its current end with
+ * %FLOW_FILE_FOLLOWER_OFFSET_END.  Text in @charset (%NULL for UTF-8;
+ * only single-byte encodings otherwise) is converted to UTF-8 before it
+ * reaches @func.
+ */
+FlowFileFollower *
+flow_file_follower_new (GFile                *file,
+                        guint64               offset,
+                        const gchar          *charset,
+                        FlowFileFollowerFunc  func,
+                        gpointer              user_data)
+{
+    FlowFileFollower *follower;
+
+    g_return_val_if_fail (G_IS_FILE (file), NULL);
+    g_return_val_if_fail (func != NULL, NULL);
+    g_return_val_if_fail (!flow_encoding_is_utf16 (charset), NULL);
+
+    follower = g_new0 (FlowFileFollower, 1);
+    follower->ref_count = 1;
+    follower->file = g_object_ref (file);
+    follower->charset = flow_encoding_is_utf8 (charset) ? NULL : g_strdup (charset);
+    follower->cancellable = g_cancellable_new ();
+    follower->offset = offset;
+    follower->func = func;
+    follower->user_data = user_data;
+
+    return follower;
+}
+
+FlowFileFollower *
+flow_file_follower_ref (FlowFileFollower *follower)
+{
+    g_return_val_if_fail (follower != NULL, NULL);
+
+    g_atomic_int_inc (&follower->ref_count);
+    return follower;
+}
+
+void
+flow_file_follower_unref (FlowFileFollower *follower)
+{
+    if (!follower || !g_atomic_int_dec_and_test (&follower->ref_count))
+        return;
+
+    g_clear_object (&follower->monitor);
+    g_object_unref (follower->cancellable);
+    g_object_unref (follower->file);
+    g_free (follower->charset);
+    g_free (follower);
+}
+
+/* Length of @data without a multi-byte sequence cut off at its end. */
+static gsize
+utf8_complete_length (const gchar *data, gsize len)
+{
+    gsize i;
+
+    for (i = 1; i <= 3 && i <= len; i++) {
+        guchar c = (guchar) data[len - i];
+
+        if ((c & 0xC0) == 0x80)
+            continue;
+        if (c >= 0xC0 && (gsize) g_utf8_skip[c] > i)
+            return len - i;
+        break;
+    }
+
+    return len;
+}
+
+/* Turns @len bytes at @data, which it takes, into UTF-8 text. */
+static GBytes *
+follow_decode_take (gchar *data, gsize len, const gchar *charset)
+{
+    gchar *text = NULL;
+    gsize text_len = 0;
+
+    if (!charset && g_utf8_validate_len (data, len, NULL))
+        return g_bytes_new_take (data, len);
+
+    if (charset)
+        text = g_convert (data, (gssize) len, FLOW_ENCODING_UTF8, charset, NULL, &text_len, NULL);
+    if (!text) {
+        text = g_utf8_make_valid (data, (gssize) len);
+        text_len = strlen (text);
+    }
+
+    g_free (data);
+    return g_bytes_new_take (text, text_len);
+}
+
+static void
+follower_read_worker (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    FollowRead *read = task_data;
+    GFileInputStream *stream;
+    GFileInfo *info;
+    GError *error = NULL;
+    guint64 size;
+    gchar *buffer;
+    gsize want;
+    gsize got = 0;
+    gsize complete;
+
+    (void)source_object;
+
+    stream = g_file_read (read->file, cancellable, &error);
+    if (!stream) {
+        g_task_return_error (task, error);
+        return;
+    }
+
+    info = g_file_input_stream_query_info (stream, G_FILE_ATTRIBUTE_STANDARD_SIZE, cancellable, &error);
+    if (!info)
+        goto fail;
+    size = (guint64) g_file_info_get_size (info);
+    g_object_unref (info);
+
+    if (read->offset == FLOW_FILE_FOLLOWER_OFFSET_END) {
+        read->offset = size;
+    } else if (size < read->offset) {
+        read->truncated = TRUE;
+        read->offset = 0;
+    }
+
+    want = (gsize) MIN (size - read->offset, (guint64) FOLLOW_BATCH_SIZE);
+    buffer = g_malloc (want);
+    if (want > 0 &&
+        (!g_seekable_seek (G_SEEKABLE (stream), (goffset) read->offset, G_SEEK_SET, cancellable, &error) ||
+         !g_input_stream_read_all (G_INPUT_STREAM (stream), buffer, want, &got, cancellable, &error))) {
+        g_free (buffer);
+        goto fail;
+    }
+
+    g_input_stream_close (G_INPUT_STREAM (stream), NULL, NULL);
+    g_object_unref (stream);
+
+    /* A character split by the batch limit or a writer mid-way is picked
+     * up whole by the next read. */
+    complete = read->charset ? got : utf8_complete_length (buffer, got);
+    read->more = got == want && size - read->offset > want;
+    read->offset += complete;
+
+    g_task_return_pointer (task, follow_decode_take (buffer, complete, read->charset),
+                           (GDestroyNotify) g_bytes_unref);
+    return;
+
+fail:
+    g_object_unref (stream);
+    g_task_return_error (task, error);
+}
+
+static void
+follower_read_ready (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    FlowFileFollower *follower = user_data;
+    FollowRead *read = g_task_get_task_data (G_TASK (res));
+    GError *error = NULL;
+    GBytes *text;
+
+    (void)source_object;
+
+    follower->reading = FALSE;
+    text = g_task_propagate_pointer (G_TASK (res), &error);
+
+    if (g_cancellable_is_cancelled (follower->cancellable)) {
+        g_clear_pointer (&text, g_bytes_unref);
+        g_clear_error (&error);
+        flow_file_follower_unref (follower);
+        return;
+    }
+
+    if (!text) {
+        /* A rotated log may be missing for a moment; the next change
+         * event tries again. */
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+            g_warning ("Failed to read appended text: %s", error->message);
+        g_error_free (error);
+    } else {
+        follower->offset = read->offset;
+        if (read->more)
+            follower->read_again = TRUE;
+        if (g_bytes_get_size (text) > 0 || read->truncated)
+            follower->func (follower, text, read->truncated, follower->user_data);
+        g_bytes_unref (text);
+    }
+
+    if (follower->read_again)
+        follower_read (follower);
+    flow_file_follower_unref (follower);
+}
+
+/* Reads whatever was appended since the last read; a request made while
+ * one is running is folded into a single follow-up read. */
+static void
+follower_read (FlowFileFollower *follower)
+{
+    FollowRead *read;
+    GTask *task;
+
+    if (g_cancellable_is_cancelled (follower->cancellable))
+        return;
+
+    if (follower->reading) {
+        follower->read_again = TRUE;
+        return;
+    }
+
+    follower->reading = TRUE;
+    follower->read_again = FALSE;
+
+    read = g_new0 (FollowRead, 1);
+    read->file = g_object_ref (follower->file);
+    read->charset = g_strdup (follower->charset);
+    read->offset = follower->offset;
+
+    task = g_task_new (NULL, follower->cancellable, follower_read_ready, flow_file_follower_ref (follower));
+    g_task_set_task_data (task, read, (GDestroyNotify) follow_read_free);
+    g_task_run_in_thread (task, follower_read_worker);
+    g_object_unref (task);
+}
+
+static void
+on_monitor_changed (GFileMonitor      *monitor,
+                    GFile             *file,
+                    GFile             *other_file,
+                    GFileMonitorEvent  event,
+                    FlowFileFollower  *follower)
+{
+    switch (event) {
+        case G_FILE_MONITOR_EVENT_CHANGED:
+        case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+        case G_FILE_MONITOR_EVENT_CREATED:
+            follower_read (follower);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Starts watching the file, and catches up on anything appended since
+ * the starting offset right away. */
+gboolean
+flow_file_follower_start (FlowFileFollower *follower, GError **error)
+{
+    g_return_val_if_fail (follower != NULL, FALSE);
+    g_return_val_if_fail (follower->monitor == NULL, FALSE);
+
+    follower->monitor = g_file_monitor_file (follower->file, G_FILE_MONITOR_NONE, follower->cancellable, error);
+    if (!follower->monitor)
+        return FALSE;
+
+    g_file_monitor_set_rate_limit (follower->monitor, FOLLOW_RATE_LIMIT_MS);
+    g_signal_connect (follower->monitor, "changed", G_CALLBACK (on_monitor_changed), follower);
+
+    follower_read (follower);
+    return TRUE;
+}
+
+/* Stops following; @func is not called again. */
+void
+flow_file_follower_cancel (FlowFileFollower *follower)
+{
+    g_return_if_fail (follower != NULL);
+
+    g_cancellable_cancel (follower->cancellable);
+    if (follower->monitor) {
+        g_signal_handlers_disconnect_by_data (follower->monitor, follower);
+        g_file_monitor_cancel (follower->monitor);
+    }
+}
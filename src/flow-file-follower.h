@@ -0,0 +1,59 @@
+/* flow-file-follower.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * FlowFileFollower watches a growing file, such as a log, and hands the
+ * text appended to it to the main thread in bounded batches.  Only the
+ * new byte range is read, on a worker thread, starting from a known
+ * offset; a file that shrinks (truncated or rotated) is followed again
+ * from its start.
+ */
+typedef struct _FlowFileFollower FlowFileFollower;
+
+/* Pass as the offset to start from whatever the end of the file is. */
+#define FLOW_FILE_FOLLOWER_OFFSET_END G_MAXUINT64
+
+/* @text is UTF-8; @truncated means it replaces everything seen before. */
+typedef void (*FlowFileFollowerFunc) (FlowFileFollower *follower,
+                                      GBytes           *text,
+                                      gboolean          truncated,
+                                      gpointer          user_data);
+
+FlowFileFollower *flow_file_follower_new    (GFile                *file,
+                                             guint64               offset,
+                                             const gchar          *charset,
+                                             FlowFileFollowerFunc  func,
+                                             gpointer              user_data);
+FlowFileFollower *flow_file_follower_ref    (FlowFileFollower     *follower);
+void              flow_file_follower_unref  (FlowFileFollower     *follower);
+
+gboolean          flow_file_follower_start  (FlowFileFollower     *follower,
+                                             GError              **error);
+void              flow_file_follower_cancel (FlowFileFollower     *follower);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FlowFileFollower, flow_file_follower_unref)
+
+G_END_DECLS
@@ -0,0 +1,195 @@
+/* flow-file-item.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include "flow-file-item.h"
+
+struct _FlowFileItem
+{
+    GObject parent_instance;
+
+    GFile *file;
+    gchar *name;
+    gchar *collate_key;     /* for sorting, made on first use */
+    gboolean is_directory;
+};
+
+G_DEFINE_FINAL_TYPE (FlowFileItem, flow_file_item, G_TYPE_OBJECT)
+
+enum {
+    PROP_0,
+    PROP_FILE,
+    PROP_NAME,
+    PROP_IS_DIRECTORY,
+    N_PROPS
+};
+
+static GParamSpec *properties[N_PROPS];
+
+FlowFileItem *
+flow_file_item_new (GFile *file, const gchar *name, gboolean is_directory)
+{
+    g_return_val_if_fail (G_IS_FILE (file), NULL);
+    g_return_val_if_fail (name != NULL, NULL);
+
+    return g_object_new (FLOW_TYPE_FILE_ITEM,
+                         "file", file,
+                         "name", name,
+                         "is-directory", is_directory,
+                         NULL);
+}
+
+/* Item for the child of @parent that @info describes; @info needs at
+ * least the standard name and type. */
+FlowFileItem *
+flow_file_item_new_for_info (GFile *parent, GFileInfo *info)
+{
+    const gchar *name = g_file_info_get_name (info);
+    GFile *file = g_file_get_child (parent, name);
+    FlowFileItem *self;
+
+    self = flow_file_item_new (file, name, g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY);
+    g_object_unref (file);
+    return self;
+}
+
+GFile *
+flow_file_item_get_file (FlowFileItem *self)
+{
+    g_return_val_if_fail (FLOW_IS_FILE_ITEM (self), NULL);
+
+    return self->file;
+}
+
+const gchar *
+flow_file_item_get_name (FlowFileItem *self)
+{
+    g_return_val_if_fail (FLOW_IS_FILE_ITEM (self), NULL);
+
+    return self->name;
+}
+
+gboolean
+flow_file_item_get_is_directory (FlowFileItem *self)
+{
+    g_return_val_if_fail (FLOW_IS_FILE_ITEM (self), FALSE);
+
+    return self->is_directory;
+}
+
+static const gchar *
+flow_file_item_get_collate_key (FlowFileItem *self)
+{
+    if (!self->collate_key)
+        self->collate_key = g_utf8_collate_key_for_filename (self->name, -1);
+    return self->collate_key;
+}
+
+/* Directories first, then by name the way file managers order them. */
+gint
+flow_file_item_compare (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    FlowFileItem *item_a = FLOW_FILE_ITEM ((gpointer) a);
+    FlowFileItem *item_b = FLOW_FILE_ITEM ((gpointer) b);
+
+    if (item_a->is_directory != item_b->is_directory)
+        return item_a->is_directory ? -1 : 1;
+
+    return g_strcmp0 (flow_file_item_get_collate_key (item_a), flow_file_item_get_collate_key (item_b));
+}
+
+static void
+flow_file_item_finalize (GObject *object)
+{
+    FlowFileItem *self = FLOW_FILE_ITEM (object);
+
+    g_clear_object (&self->file);
+    g_free (self->name);
+    g_free (self->collate_key);
+
+    G_OBJECT_CLASS (flow_file_item_parent_class)->finalize (object);
+}
+
+static void
+flow_file_item_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+    FlowFileItem *self = FLOW_FILE_ITEM (object);
+
+    switch (prop_id) {
+        case PROP_FILE:
+            g_value_set_object (value, self->file);
+            break;
+        case PROP_NAME:
+            g_value_set_string (value, self->name);
+            break;
+        case PROP_IS_DIRECTORY:
+            g_value_set_boolean (value, self->is_directory);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+flow_file_item_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+    FlowFileItem *self = FLOW_FILE_ITEM (object);
+
+    switch (prop_id) {
+        case PROP_FILE:
+            self->file = g_value_dup_object (value);
+            break;
+        case PROP_NAME:
+            self->name = g_value_dup_string (value);
+            break;
+        case PROP_IS_DIRECTORY:
+            self->is_directory = g_value_get_boolean (value);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+flow_file_item_class_init (FlowFileItemClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->finalize = flow_file_item_finalize;
+    object_class->get_property = flow_file_item_get_property;
+    object_class->set_property = flow_file_item_set_property;
+
+    properties[PROP_FILE] =
+        g_param_spec_object ("file", NULL, NULL, G_TYPE_FILE,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+    properties[PROP_NAME] =
+        g_param_spec_string ("name", NULL, NULL, NULL,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+    properties[PROP_IS_DIRECTORY] =
+        g_param_spec_boolean ("is-directory", NULL, NULL, FALSE,
+                              G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+    g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+flow_file_item_init (FlowFileItem *self)
+{
+}
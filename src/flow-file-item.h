@@ -0,0 +1,48 @@
+/* flow-file-item.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * One entry of the file explorer: a file or directory and what the row
+ * showing it needs.  Items are immutable; the explorer models hold them
+ * and the list view binds recycled rows to whichever are visible.
+ */
+#define FLOW_TYPE_FILE_ITEM (flow_file_item_get_type())
+
+G_DECLARE_FINAL_TYPE (FlowFileItem, flow_file_item, FLOW, FILE_ITEM, GObject)
+
+FlowFileItem *flow_file_item_new              (GFile        *file,
+                                               const gchar  *name,
+                                               gboolean      is_directory);
+FlowFileItem *flow_file_item_new_for_info     (GFile        *parent,
+                                               GFileInfo    *info);
+GFile        *flow_file_item_get_file         (FlowFileItem *self);
+const gchar  *flow_file_item_get_name         (FlowFileItem *self);
+gboolean      flow_file_item_get_is_directory (FlowFileItem *self);
+gint          flow_file_item_compare          (gconstpointer a,
+                                               gconstpointer b,
+                                               gpointer      user_data);
+
+G_END_DECLS
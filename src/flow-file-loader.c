@@ -0,0 +1,656 @@
+/* flow-file-loader.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "flow-compression.h"
+#include "flow-encoding.h"
+#include "flow-file-loader.h"
+
+/* Size of a single read from disk. */
+#define FLOW_FILE_LOADER_READ_SIZE   (256 * 1024)
+/* How far the worker may run ahead of the main thread. */
+#define FLOW_FILE_LOADER_MAX_QUEUED  (8 * 1024 * 1024)
+
+struct _FlowFileLoader
+{
+    gint ref_count;
+
+    GFile *file;
+    GBytes *bytes;
+    GCancellable *cancellable;
+
+    GMutex mutex;
+    GCond cond;
+    GQueue chunks;
+    gsize queued_bytes;
+    guint64 total_size;
+    guint64 bytes_read;
+    gboolean eof;
+    GError *error;
+    gboolean started;
+
+    const gchar *charset;
+    gboolean has_bom;
+    FlowCompression compression;
+};
+
+FlowFileLoader *
+flow_file_loader_new (GFile *file)
+{
+    FlowFileLoader *loader;
+
+    g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+    loader = g_new0 (FlowFileLoader, 1);
+    loader->ref_count = 1;
+    loader->file = g_object_ref (file);
+    loader->cancellable = g_cancellable_new ();
+    g_mutex_init (&loader->mutex);
+    g_cond_init (&loader->cond);
+    g_queue_init (&loader->chunks);
+    loader->charset = FLOW_ENCODING_UTF8;
+
+    return loader;
+}
+
+/*
+ * Loads text kept in memory, such as a hibernated tab, the same way a
+ * file is: in bounded chunks, decompressing it first if need be.
+ */
+FlowFileLoader *
+flow_file_loader_new_for_bytes (GBytes *bytes)
+{
+    FlowFileLoader *loader;
+
+    g_return_val_if_fail (bytes != NULL, NULL);
+
+    loader = g_new0 (FlowFileLoader, 1);
+    loader->ref_count = 1;
+    loader->bytes = g_bytes_ref (bytes);
+    loader->cancellable = g_cancellable_new ();
+    g_mutex_init (&loader->mutex);
+    g_cond_init (&loader->cond);
+    g_queue_init (&loader->chunks);
+    loader->charset = FLOW_ENCODING_UTF8;
+
+    return loader;
+}
+
+FlowFileLoader *
+flow_file_loader_ref (FlowFileLoader *loader)
+{
+    g_return_val_if_fail (loader != NULL, NULL);
+
+    g_atomic_int_inc (&loader->ref_count);
+    return loader;
+}
+
+void
+flow_file_loader_unref (FlowFileLoader *loader)
+{
+    if (!loader)
+        return;
+
+    if (!g_atomic_int_dec_and_test (&loader->ref_count))
+        return;
+
+    g_queue_clear_full (&loader->chunks, (GDestroyNotify) g_bytes_unref);
+    g_clear_error (&loader->error);
+    g_mutex_clear (&loader->mutex);
+    g_cond_clear (&loader->cond);
+    g_object_unref (loader->cancellable);
+    g_clear_object (&loader->file);
+    g_clear_pointer (&loader->bytes, g_bytes_unref);
+    g_free (loader);
+}
+
+/* Number of bytes at the end of @data that start a multi-byte sequence
+ * which only completes in the next read. */
+static gsize
+utf8_incomplete_tail (const gchar *data, gsize len)
+{
+    gsize i;
+
+    for (i = 1; i <= 3 && i <= len; i++) {
+        guchar c = (guchar) data[len - i];
+        gsize needed;
+
+        if ((c & 0xC0) == 0x80)
+            continue;
+        if (c < 0xC0)
+            return 0;
+
+        needed = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+        return needed > i ? i : 0;
+    }
+
+    return 0;
+}
+
+static GBytes *
+utf8_chunk_new_take (gchar *data, gsize len)
+{
+    gchar *valid;
+
+    if (g_utf8_validate_len (data, len, NULL))
+        return g_bytes_new_take (data, len);
+
+    valid = g_utf8_make_valid (data, (gssize) len);
+    g_free (data);
+    return g_bytes_new_take (valid, strlen (valid));
+}
+
+/* Converts a chunk of a single-byte encoding; every byte is a whole
+ * character, so chunks convert independently. */
+static GBytes *
+legacy_chunk_new_take (gchar *data, gsize len, const gchar *charset)
+{
+    gchar *converted;
+    gsize converted_len = 0;
+
+    converted = g_convert (data, (gssize) len, FLOW_ENCODING_UTF8, charset, NULL, &converted_len, NULL);
+    if (!converted)
+        return utf8_chunk_new_take (data, len);
+
+    g_free (data);
+    return g_bytes_new_take (converted, converted_len);
+}
+
+/* Whether @data has a byte that Windows-1252 and ISO-8859-1 decode
+ * differently. */
+static gboolean
+legacy_has_c1 (const gchar *data, gsize len)
+{
+    gsize i;
+
+    for (i = 0; i < len; i++) {
+        guchar c = (guchar) data[i];
+
+        if (c >= 0x80 && c <= 0x9F)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+flow_file_loader_set_charset (FlowFileLoader *loader, const gchar *charset, gboolean has_bom)
+{
+    g_mutex_lock (&loader->mutex);
+    loader->charset = charset;
+    loader->has_bom = has_bom;
+    g_mutex_unlock (&loader->mutex);
+}
+
+/* Wraps @base in a read buffer and fills it, so the start of the stream
+ * can be inspected without consuming it. */
+static GInputStream *
+flow_file_loader_buffer (GInputStream *base, GCancellable *cancellable, GError **error)
+{
+    GInputStream *buffered;
+
+    buffered = g_buffered_input_stream_new_sized (base, FLOW_FILE_LOADER_READ_SIZE);
+    if (g_buffered_input_stream_fill (G_BUFFERED_INPUT_STREAM (buffered), FLOW_FILE_LOADER_READ_SIZE,
+                                      cancellable, error) < 0) {
+        g_object_unref (buffered);
+        return NULL;
+    }
+
+    return buffered;
+}
+
+/*
+ * Puts a streaming decompressor in front of @buffered if the file starts
+ * with a known compression header.  The returned stream is buffered and
+ * filled with decompressed data, ready for encoding detection.
+ */
+static GInputStream *
+flow_file_loader_decompress (FlowFileLoader *loader, GInputStream *buffered,
+                             GCancellable *cancellable, GError **error)
+{
+    GConverter *decompressor;
+    GInputStream *decompressed;
+    FlowCompression compression;
+    const gchar *sample;
+    gsize sample_len = 0;
+
+    sample = g_buffered_input_stream_peek_buffer (G_BUFFERED_INPUT_STREAM (buffered), &sample_len);
+    compression = flow_compression_detect (sample, sample_len);
+    if (compression == FLOW_COMPRESSION_NONE)
+        return buffered;
+
+    decompressor = flow_compression_new_decompressor (compression, error);
+    if (!decompressor) {
+        g_object_unref (buffered);
+        return NULL;
+    }
+
+    g_mutex_lock (&loader->mutex);
+    loader->compression = compression;
+    g_mutex_unlock (&loader->mutex);
+
+    decompressed = g_converter_input_stream_new (buffered, decompressor);
+    g_object_unref (decompressor);
+    g_object_unref (buffered);
+
+    buffered = flow_file_loader_buffer (decompressed, cancellable, error);
+    g_object_unref (decompressed);
+
+    return buffered;
+}
+
+/*
+ * Looks at the first block of the file to pick its encoding, and returns
+ * the stream to read UTF-8 (or, for single-byte encodings, raw bytes)
+ * from.  UTF-16 is decoded by a streaming converter, so its two-byte
+ * units may split anywhere across reads.  Compressed files are
+ * decompressed first and detected by their contents.
+ */
+static GInputStream *
+flow_file_loader_sniff (FlowFileLoader *loader, GInputStream *base, GCancellable *cancellable, GError **error)
+{
+    GInputStream *buffered;
+    GCharsetConverter *converter;
+    GInputStream *converted;
+    const gchar *sample;
+    const gchar *charset;
+    gsize sample_len = 0;
+    gsize bom_len;
+
+    buffered = flow_file_loader_buffer (base, cancellable, error);
+    if (buffered)
+        buffered = flow_file_loader_decompress (loader, buffered, cancellable, error);
+    if (!buffered)
+        return NULL;
+
+    sample = g_buffered_input_stream_peek_buffer (G_BUFFERED_INPUT_STREAM (buffered), &sample_len);
+    charset = flow_encoding_detect (sample, sample_len, &bom_len);
+    flow_file_loader_set_charset (loader, charset, bom_len > 0);
+
+    if (bom_len > 0 && g_input_stream_skip (buffered, bom_len, cancellable, error) < 0) {
+        g_object_unref (buffered);
+        return NULL;
+    }
+
+    if (!flow_encoding_is_utf16 (charset))
+        return buffered;
+
+    converter = g_charset_converter_new (FLOW_ENCODING_UTF8, charset, error);
+    if (!converter) {
+        g_object_unref (buffered);
+        return NULL;
+    }
+
+    /* Stray surrogates become replacement characters instead of errors. */
+    g_charset_converter_set_use_fallback (converter, TRUE);
+    converted = g_converter_input_stream_new (buffered, G_CONVERTER (converter));
+    g_object_unref (converter);
+    g_object_unref (buffered);
+
+    return converted;
+}
+
+static void
+flow_file_loader_push (FlowFileLoader *loader, GBytes *bytes, guint64 bytes_read)
+{
+    g_mutex_lock (&loader->mutex);
+    if (bytes) {
+        loader->queued_bytes += g_bytes_get_size (bytes);
+        g_queue_push_tail (&loader->chunks, bytes);
+    }
+    loader->bytes_read = bytes_read;
+    g_mutex_unlock (&loader->mutex);
+}
+
+/* Decodes the chunks held back while the encoding was unsettled. */
+static void
+flow_file_loader_release_held (FlowFileLoader *loader, GQueue *held, const gchar *charset, guint64 bytes_read)
+{
+    GBytes *raw;
+
+    while ((raw = g_queue_pop_head (held))) {
+        gsize len = 0;
+        gchar *data = g_bytes_unref_to_data (raw, &len);
+
+        flow_file_loader_push (loader, legacy_chunk_new_take (data, len, charset), bytes_read);
+    }
+}
+
+/*
+ * Passes on a chunk of single-byte text.  Windows-1252 and ISO-8859-1
+ * differ only in C1 bytes, 0x80 to 0x9F, and one that Windows-1252 leaves
+ * undefined means the file is ISO-8859-1.  Text before the first C1 byte
+ * reads the same either way and goes out at once.  From there, while the
+ * encoding is still Windows-1252, chunks wait raw in @held: the end of
+ * the file settles it and they are decoded as Windows-1252, or an
+ * undefined byte does and they are decoded as ISO-8859-1.  Either way
+ * the file is read once.
+ */
+static void
+flow_file_loader_push_legacy (FlowFileLoader *loader, const gchar **charset, gboolean has_bom, GQueue *held,
+                              gchar *data, gsize len, guint64 bytes_read)
+{
+    if (g_strcmp0 (*charset, FLOW_ENCODING_LEGACY) == 0) {
+        if (g_strcmp0 (flow_encoding_detect_legacy (data, len), FLOW_ENCODING_LATIN1) == 0) {
+            *charset = FLOW_ENCODING_LATIN1;
+            flow_file_loader_set_charset (loader, *charset, has_bom);
+        } else if (!g_queue_is_empty (held) || legacy_has_c1 (data, len)) {
+            g_queue_push_tail (held, g_bytes_new_take (data, len));
+            flow_file_loader_push (loader, NULL, bytes_read);
+            return;
+        }
+    }
+
+    flow_file_loader_release_held (loader, held, *charset, bytes_read);
+    flow_file_loader_push (loader, legacy_chunk_new_take (data, len, *charset), bytes_read);
+}
+
+static void
+flow_file_loader_finish (FlowFileLoader *loader, GError *error)
+{
+    g_mutex_lock (&loader->mutex);
+    loader->eof = TRUE;
+    loader->error = error;
+    g_mutex_unlock (&loader->mutex);
+}
+
+static gboolean
+flow_file_loader_wait_for_room (FlowFileLoader *loader, GCancellable *cancellable)
+{
+    g_mutex_lock (&loader->mutex);
+    while (loader->queued_bytes >= FLOW_FILE_LOADER_MAX_QUEUED &&
+           !g_cancellable_is_cancelled (cancellable))
+        g_cond_wait_until (&loader->cond, &loader->mutex,
+                           g_get_monotonic_time () + 50 * G_TIME_SPAN_MILLISECOND);
+    g_mutex_unlock (&loader->mutex);
+
+    return !g_cancellable_is_cancelled (cancellable);
+}
+
+static void
+flow_file_loader_worker (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    FlowFileLoader *loader = task_data;
+    GFileInputStream *file_stream;
+    GInputStream *base;
+    GInputStream *stream = NULL;
+    GFileInfo *info;
+    GError *error = NULL;
+    const gchar *legacy_charset = NULL;
+    gboolean has_bom = FALSE;
+    gboolean seen_non_ascii = FALSE;
+    GQueue held = G_QUEUE_INIT;
+    gchar carry[4];
+    gsize carry_len = 0;
+
+    (void)source_object;
+
+    if (loader->bytes) {
+        base = g_memory_input_stream_new_from_bytes (loader->bytes);
+        g_mutex_lock (&loader->mutex);
+        loader->total_size = g_bytes_get_size (loader->bytes);
+        g_mutex_unlock (&loader->mutex);
+    } else {
+        file_stream = g_file_read (loader->file, cancellable, &error);
+        if (!file_stream) {
+            flow_file_loader_finish (loader, error);
+            g_task_return_boolean (task, FALSE);
+            return;
+        }
+
+        info = g_file_input_stream_query_info (file_stream, G_FILE_ATTRIBUTE_STANDARD_SIZE, cancellable, NULL);
+        if (info) {
+            g_mutex_lock (&loader->mutex);
+            loader->total_size = (guint64) g_file_info_get_size (info);
+            g_mutex_unlock (&loader->mutex);
+            g_object_unref (info);
+        }
+        base = G_INPUT_STREAM (file_stream);
+    }
+
+    stream = flow_file_loader_sniff (loader, base, cancellable, &error);
+    if (!stream)
+        goto out;
+
+    g_mutex_lock (&loader->mutex);
+    if (!flow_encoding_is_utf8 (loader->charset) && !flow_encoding_is_utf16 (loader->charset))
+        legacy_charset = loader->charset;
+    has_bom = loader->has_bom;
+    g_mutex_unlock (&loader->mutex);
+
+    for (;;) {
+        gchar *buffer;
+        gssize nread;
+        gsize len;
+        gsize tail;
+
+        if (!flow_file_loader_wait_for_room (loader, cancellable)) {
+            g_set_error_literal (&error, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Loading cancelled");
+            break;
+        }
+
+        buffer = g_malloc (carry_len + FLOW_FILE_LOADER_READ_SIZE);
+        memcpy (buffer, carry, carry_len);
+
+        nread = g_input_stream_read (stream, buffer + carry_len,
+                                     FLOW_FILE_LOADER_READ_SIZE, cancellable, &error);
+        if (nread < 0) {
+            g_free (buffer);
+            break;
+        }
+
+        if (nread == 0) {
+            /* The whole file had no byte Windows-1252 leaves undefined. */
+            flow_file_loader_release_held (loader, &held, legacy_charset,
+                                           (guint64) g_seekable_tell (G_SEEKABLE (base)));
+            /* A truncated multi-byte sequence at end of file. */
+            if (carry_len > 0)
+                flow_file_loader_push (loader, utf8_chunk_new_take (buffer, carry_len),
+                                       (guint64) g_seekable_tell (G_SEEKABLE (base)));
+            else
+                g_free (buffer);
+            break;
+        }
+
+        len = carry_len + (gsize) nread;
+        carry_len = 0;
+
+        if (legacy_charset) {
+            flow_file_loader_push_legacy (loader, &legacy_charset, has_bom, &held, buffer, len,
+                                          (guint64) g_seekable_tell (G_SEEKABLE (base)));
+            continue;
+        }
+
+        if (flow_encoding_is_ascii (buffer, len)) {
+            flow_file_loader_push (loader, g_bytes_new_take (buffer, len),
+                                   (guint64) g_seekable_tell (G_SEEKABLE (base)));
+            continue;
+        }
+
+        tail = utf8_incomplete_tail (buffer, len);
+
+        /* Everything so far was ASCII, so the sniffed block could not tell
+         * UTF-8 from a legacy encoding; the first invalid byte settles it.
+         * ASCII reads the same in both, so nothing already loaded changes. */
+        if (!seen_non_ascii && !has_bom && !g_utf8_validate_len (buffer, len - tail, NULL)) {
+            legacy_charset = flow_encoding_detect_legacy (buffer, len);
+            flow_file_loader_set_charset (loader, legacy_charset, FALSE);
+            flow_file_loader_push_legacy (loader, &legacy_charset, FALSE, &held, buffer, len,
+                                          (guint64) g_seekable_tell (G_SEEKABLE (base)));
+            continue;
+        }
+        seen_non_ascii = TRUE;
+
+        memcpy (carry, buffer + len - tail, tail);
+        carry_len = tail;
+
+        if (len > tail)
+            flow_file_loader_push (loader, utf8_chunk_new_take (buffer, len - tail),
+                                   (guint64) g_seekable_tell (G_SEEKABLE (base)));
+        else
+            g_free (buffer);
+    }
+
+out:
+    g_queue_clear_full (&held, (GDestroyNotify) g_bytes_unref);
+    if (stream) {
+        g_input_stream_close (stream, NULL, NULL);
+        g_object_unref (stream);
+    } else {
+        g_input_stream_close (base, NULL, NULL);
+    }
+    g_object_unref (base);
+
+    flow_file_loader_finish (loader, error);
+    g_task_return_boolean (task, error == NULL);
+}
+
+void
+flow_file_loader_start (FlowFileLoader *loader)
+{
+    GTask *task;
+
+    g_return_if_fail (loader != NULL);
+    g_return_if_fail (!loader->started);
+
+    loader->started = TRUE;
+
+    task = g_task_new (NULL, loader->cancellable, NULL, NULL);
+    g_task_set_task_data (task, flow_file_loader_ref (loader), (GDestroyNotify) flow_file_loader_unref);
+    g_task_run_in_thread (task, flow_file_loader_worker);
+    g_object_unref (task);
+}
+
+void
+flow_file_loader_cancel (FlowFileLoader *loader)
+{
+    g_return_if_fail (loader != NULL);
+
+    g_cancellable_cancel (loader->cancellable);
+
+    g_mutex_lock (&loader->mutex);
+    g_cond_broadcast (&loader->cond);
+    g_mutex_unlock (&loader->mutex);
+}
+
+/*
+ * Takes the next chunk produced by the worker.  Returns %NULL when nothing
+ * is queued right now; @finished is set once the worker has stopped and
+ * every chunk has been handed out, with @error describing why it stopped.
+ */
+GBytes *
+flow_file_loader_pop_chunk (FlowFileLoader *loader, gboolean *finished, GError **error)
+{
+    GBytes *bytes;
+
+    g_return_val_if_fail (loader != NULL, NULL);
+
+    *finished = FALSE;
+
+    g_mutex_lock (&loader->mutex);
+    bytes = g_queue_pop_head (&loader->chunks);
+    if (bytes) {
+        loader->queued_bytes -= g_bytes_get_size (bytes);
+        g_cond_signal (&loader->cond);
+    } else if (loader->eof) {
+        *finished = TRUE;
+        if (loader->error)
+            g_propagate_error (error, g_steal_pointer (&loader->error));
+    }
+    g_mutex_unlock (&loader->mutex);
+
+    return bytes;
+}
+
+gdouble
+flow_file_loader_get_fraction (FlowFileLoader *loader)
+{
+    gdouble fraction = 0.0;
+
+    g_return_val_if_fail (loader != NULL, 0.0);
+
+    g_mutex_lock (&loader->mutex);
+    if (loader->total_size > 0)
+        fraction = (gdouble) loader->bytes_read / (gdouble) loader->total_size;
+    g_mutex_unlock (&loader->mutex);
+
+    return CLAMP (fraction, 0.0, 1.0);
+}
+
+guint64
+flow_file_loader_get_bytes_read (FlowFileLoader *loader)
+{
+    guint64 bytes_read;
+
+    g_return_val_if_fail (loader != NULL, 0);
+
+    g_mutex_lock (&loader->mutex);
+    bytes_read = loader->bytes_read;
+    g_mutex_unlock (&loader->mutex);
+
+    return bytes_read;
+}
+
+/* Encoding the file was decoded from; final once loading has finished. */
+const gchar *
+flow_file_loader_get_charset (FlowFileLoader *loader)
+{
+    const gchar *charset;
+
+    g_return_val_if_fail (loader != NULL, NULL);
+
+    g_mutex_lock (&loader->mutex);
+    charset = loader->charset;
+    g_mutex_unlock (&loader->mutex);
+
+    return charset;
+}
+
+gboolean
+flow_file_loader_get_has_bom (FlowFileLoader *loader)
+{
+    gboolean has_bom;
+
+    g_return_val_if_fail (loader != NULL, FALSE);
+
+    g_mutex_lock (&loader->mutex);
+    has_bom = loader->has_bom;
+    g_mutex_unlock (&loader->mutex);
+
+    return has_bom;
+}
+
+/* Compression the file was stored with, known once loading has begun. */
+FlowCompression
+flow_file_loader_get_compression (FlowFileLoader *loader)
+{
+    FlowCompression compression;
+
+    g_return_val_if_fail (loader != NULL, FLOW_COMPRESSION_NONE);
+
+    g_mutex_lock (&loader->mutex);
+    compression = loader->compression;
+    g_mutex_unlock (&loader->mutex);
+
+    return compression;
+}
@@ -0,0 +1,58 @@
+/* flow-file-loader.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "flow-compression.h"
+
+G_BEGIN_DECLS
+
+/*
+ * FlowFileLoader reads a file on a worker thread and hands it to the
+ * main thread as a sequence of valid UTF-8 chunks, decompressing gzip,
+ * zstd and xz files and decoding UTF-16 and legacy single-byte encodings
+ * on the way.  The worker never runs more than a bounded number of bytes
+ * ahead of the consumer, so loading a huge file does not balloon memory
+ * while the UI inserts it.
+ */
+typedef struct _FlowFileLoader FlowFileLoader;
+
+FlowFileLoader *flow_file_loader_new             (GFile          *file);
+FlowFileLoader *flow_file_loader_new_for_bytes   (GBytes         *bytes);
+FlowFileLoader *flow_file_loader_ref             (FlowFileLoader *loader);
+void            flow_file_loader_unref           (FlowFileLoader *loader);
+
+void            flow_file_loader_start           (FlowFileLoader *loader);
+void            flow_file_loader_cancel          (FlowFileLoader *loader);
+
+GBytes         *flow_file_loader_pop_chunk       (FlowFileLoader *loader,
+                                                  gboolean       *finished,
+                                                  GError        **error);
+gdouble         flow_file_loader_get_fraction    (FlowFileLoader *loader);
+guint64         flow_file_loader_get_bytes_read  (FlowFileLoader *loader);
+const gchar    *flow_file_loader_get_charset     (FlowFileLoader *loader);
+gboolean        flow_file_loader_get_has_bom     (FlowFileLoader *loader);
+FlowCompression flow_file_loader_get_compression (FlowFileLoader *loader);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FlowFileLoader, flow_file_loader_unref)
+
+G_END_DECLS
@@ -0,0 +1,656 @@
+/* flow-file-saver.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Saving streams a piece-table snapshot through g_file_replace_async():
+ * small pieces are gathered into a staging buffer, large ones are written
+ * as they are, and every write runs on GIO's worker threads.  The replaced
+ * file only becomes visible when the stream is closed, so a failed save
+ * leaves the original in place.  Files that were not UTF-8 on disk are
+ * converted back on the fly by a converter stream around the file, and
+ * compressed files are recompressed by another one beneath it; GIO runs
+ * writes through such filters on its worker threads as well.
+ *
+ * GIO fsyncs the temporary file it replaces an existing local file
+ * through, with no flag to turn that off.  Under the "none" durability
+ * such files are written to a temporary file of our own instead, which
+ * takes over the original's mode and owner and is renamed over it once
+ * closed.  Links, and files whose owner cannot be kept, are still left
+ * to g_file_replace_async().
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+#include <gio/gfiledescriptorbased.h>
+#include <gio/gunixoutputstream.h>
+
+#include "flow-compression.h"
+#include "flow-encoding.h"
+#include "flow-file-saver.h"
+
+#define SAVE_STAGING_SIZE (256 * 1024)
+
+typedef struct {
+    GFile *file;
+    gchar *temp_path;
+    FlowPieceTableIter *iter;
+    FlowSaveDurability durability;
+    gchar *charset;
+    gboolean write_bom;
+    FlowCompression compression;
+    GOutputStream *file_stream;
+    GOutputStream *stream;
+    GByteArray *staging;
+    const gchar *pending;
+    gsize pending_len;
+    guint64 written;
+    guint64 total;
+    FlowFileSaveProgress progress;
+    gpointer progress_data;
+} SaveState;
+
+static void save_write_next (GTask *task);
+
+static void
+save_state_free (SaveState *state)
+{
+    g_clear_object (&state->stream);
+    g_clear_object (&state->file_stream);
+    /* Still set only if the save failed before the rename. */
+    if (state->temp_path) {
+        g_unlink (state->temp_path);
+        g_free (state->temp_path);
+    }
+    g_clear_pointer (&state->iter, flow_piece_table_iter_free);
+    g_free (state->charset);
+    g_byte_array_unref (state->staging);
+    g_object_unref (state->file);
+    g_free (state);
+}
+
+FlowSaveDurability
+flow_save_durability_from_string (const gchar *name)
+{
+    if (g_strcmp0 (name, "none") == 0)
+        return FLOW_SAVE_DURABILITY_NONE;
+    if (g_strcmp0 (name, "fsync-directory") == 0)
+        return FLOW_SAVE_DURABILITY_FSYNC_DIRECTORY;
+    return FLOW_SAVE_DURABILITY_FSYNC;
+}
+
+const gchar *
+flow_save_durability_to_string (FlowSaveDurability durability)
+{
+    switch (durability) {
+        case FLOW_SAVE_DURABILITY_NONE:
+            return "none";
+        case FLOW_SAVE_DURABILITY_FSYNC_DIRECTORY:
+            return "fsync-directory";
+        case FLOW_SAVE_DURABILITY_FSYNC:
+        default:
+            return "fsync";
+    }
+}
+
+/* Reports @error, making sure the half-written replacement is discarded. */
+static void
+save_abort (GTask *task, GError *error)
+{
+    SaveState *state = g_task_get_task_data (task);
+
+    if (state->file_stream && !g_output_stream_is_closed (state->file_stream)) {
+        GCancellable *discard = g_cancellable_new ();
+
+        /* Closing a replace stream with a cancelled cancellable keeps the
+         * original file.  Our own temporary file goes with the state. */
+        g_cancellable_cancel (discard);
+        g_output_stream_close (state->file_stream, discard, NULL);
+        g_object_unref (discard);
+    }
+
+    g_task_return_error (task, error);
+    g_object_unref (task);
+}
+
+static void
+save_sync_worker (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    gint fd = GPOINTER_TO_INT (task_data);
+    gint saved_errno;
+
+    (void)source_object;
+    (void)cancellable;
+
+    if (fsync (fd) == 0) {
+        g_task_return_boolean (task, TRUE);
+        return;
+    }
+
+    saved_errno = errno;
+    g_task_return_new_error (task, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                             "Failed to flush file: %s", g_strerror (saved_errno));
+}
+
+static void
+save_sync_directory_worker (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    const gchar *path = task_data;
+    gint fd;
+    gint saved_errno;
+
+    (void)source_object;
+    (void)cancellable;
+
+    fd = g_open (path, O_RDONLY | O_DIRECTORY, 0);
+    if (fd >= 0 && fsync (fd) == 0) {
+        g_close (fd, NULL);
+        g_task_return_boolean (task, TRUE);
+        return;
+    }
+
+    saved_errno = errno;
+    if (fd >= 0)
+        g_close (fd, NULL);
+    g_task_return_new_error (task, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                             "Failed to flush folder: %s", g_strerror (saved_errno));
+}
+
+static void
+save_directory_synced (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    GTask *task = G_TASK (user_data);
+    GError *error = NULL;
+
+    (void)source_object;
+
+    if (!g_task_propagate_boolean (G_TASK (res), &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+}
+
+static void
+save_rename_worker (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    SaveState *state = task_data;
+    gchar *path = g_file_get_path (state->file);
+    gint saved_errno;
+
+    (void)source_object;
+    (void)cancellable;
+
+    if (g_rename (state->temp_path, path) == 0) {
+        g_free (path);
+        g_task_return_boolean (task, TRUE);
+        return;
+    }
+
+    saved_errno = errno;
+    g_free (path);
+    g_task_return_new_error (task, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                             "Failed to replace file: %s", g_strerror (saved_errno));
+}
+
+static void
+save_renamed (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    GTask *task = G_TASK (user_data);
+    SaveState *state = g_task_get_task_data (task);
+    GError *error = NULL;
+
+    (void)source_object;
+
+    if (!g_task_propagate_boolean (G_TASK (res), &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    g_clear_pointer (&state->temp_path, g_free);
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+}
+
+static void
+save_closed (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    GTask *task = G_TASK (user_data);
+    SaveState *state = g_task_get_task_data (task);
+    GError *error = NULL;
+    GFile *parent;
+    gchar *path = NULL;
+
+    if (!g_output_stream_close_finish (G_OUTPUT_STREAM (source_object), res, &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    /* Our own temporary file is only renamed into place once complete.
+     * Not cancellable: the rename either happened or it did not. */
+    if (state->temp_path) {
+        GTask *rename = g_task_new (NULL, NULL, save_renamed, task);
+        g_task_set_task_data (rename, state, NULL);
+        g_task_run_in_thread (rename, save_rename_worker);
+        g_object_unref (rename);
+        return;
+    }
+
+    /* The new contents are renamed into place on close; flushing the
+     * folder makes that rename survive a power loss too. */
+    parent = g_file_get_parent (state->file);
+    if (parent)
+        path = g_file_get_path (parent);
+    g_clear_object (&parent);
+
+    if (state->durability == FLOW_SAVE_DURABILITY_FSYNC_DIRECTORY && path) {
+        GTask *sync = g_task_new (NULL, g_task_get_cancellable (task), save_directory_synced, task);
+        g_task_set_task_data (sync, path, g_free);
+        g_task_run_in_thread (sync, save_sync_directory_worker);
+        g_object_unref (sync);
+        return;
+    }
+
+    g_free (path);
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+}
+
+static void
+save_close (GTask *task)
+{
+    SaveState *state = g_task_get_task_data (task);
+
+    g_output_stream_close_async (state->file_stream, G_PRIORITY_DEFAULT, g_task_get_cancellable (task),
+                                 save_closed, task);
+}
+
+static void
+save_file_synced (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    GTask *task = G_TASK (user_data);
+    GError *error = NULL;
+
+    (void)source_object;
+
+    if (!g_task_propagate_boolean (G_TASK (res), &error)) {
+        save_abort (task, error);
+        return;
+    }
+
+    save_close (task);
+}
+
+static void
+save_sync (GTask *task)
+{
+    SaveState *state = g_task_get_task_data (task);
+    GTask *sync;
+
+    if (state->durability == FLOW_SAVE_DURABILITY_NONE ||
+        !G_IS_FILE_DESCRIPTOR_BASED (state->file_stream)) {
+        save_close (task);
+        return;
+    }
+
+    /* Flush the data before the replacement is renamed over the original. */
+    sync = g_task_new (NULL, g_task_get_cancellable (task), save_file_synced, task);
+    g_task_set_task_data (sync,
+                          GINT_TO_POINTER (g_file_descriptor_based_get_fd (G_FILE_DESCRIPTOR_BASED (state->file_stream))),
+                          NULL);
+    g_task_run_in_thread (sync, save_sync_worker);
+    g_object_unref (sync);
+}
+
+static void
+save_filters_closed (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    GTask *task = G_TASK (user_data);
+    GError *error = NULL;
+
+    if (!g_output_stream_close_finish (G_OUTPUT_STREAM (source_object), res, &error)) {
+        save_abort (task, error);
+        return;
+    }
+
+    save_sync (task);
+}
+
+static void
+save_flush (GTask *task)
+{
+    SaveState *state = g_task_get_task_data (task);
+
+    /* Converters may still hold the end of the text, and a compressor only
+     * writes its trailer when closed.  The filters stop short of closing
+     * the file itself, which must be synced first. */
+    if (state->stream != state->file_stream) {
+        g_output_stream_close_async (state->stream, G_PRIORITY_DEFAULT, g_task_get_cancellable (task),
+                                     save_filters_closed, task);
+        return;
+    }
+
+    save_sync (task);
+}
+
+static void
+save_written (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    GTask *task = G_TASK (user_data);
+    SaveState *state = g_task_get_task_data (task);
+    GError *error = NULL;
+    gsize written = 0;
+
+    if (!g_output_stream_write_all_finish (G_OUTPUT_STREAM (source_object), res, &written, &error)) {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA)) {
+            GError *encoding_error = g_error_new (G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                                  "The text contains characters that cannot be saved as %s",
+                                                  state->charset);
+            g_error_free (error);
+            error = encoding_error;
+        }
+        save_abort (task, error);
+        return;
+    }
+
+    g_byte_array_set_size (state->staging, 0);
+    state->written += written;
+    if (state->progress)
+        state->progress (state->written, state->total, state->progress_data);
+
+    save_write_next (task);
+}
+
+static void
+save_write (GTask *task, const gchar *data, gsize len)
+{
+    SaveState *state = g_task_get_task_data (task);
+
+    g_output_stream_write_all_async (state->stream, data, len, G_PRIORITY_DEFAULT,
+                                     g_task_get_cancellable (task), save_written, task);
+}
+
+static void
+save_write_next (GTask *task)
+{
+    SaveState *state = g_task_get_task_data (task);
+    const gchar *data;
+    gsize len;
+
+    for (;;) {
+        if (state->pending) {
+            data = state->pending;
+            len = state->pending_len;
+            state->pending = NULL;
+        } else if (!flow_piece_table_iter_next (state->iter, &data, &len)) {
+            break;
+        }
+
+        if (len >= SAVE_STAGING_SIZE) {
+            /* Large pieces go out directly, after anything staged. */
+            if (state->staging->len > 0) {
+                state->pending = data;
+                state->pending_len = len;
+                save_write (task, (const gchar *) state->staging->data, state->staging->len);
+            } else {
+                save_write (task, data, len);
+            }
+            return;
+        }
+
+        g_byte_array_append (state->staging, (const guint8 *) data, (guint) len);
+        if (state->staging->len >= SAVE_STAGING_SIZE) {
+            save_write (task, (const gchar *) state->staging->data, state->staging->len);
+            return;
+        }
+    }
+
+    if (state->staging->len > 0) {
+        save_write (task, (const gchar *) state->staging->data, state->staging->len);
+        return;
+    }
+
+    save_flush (task);
+}
+
+/* Stacks @converter on top of the streams written to so far. */
+static void
+save_push_filter (SaveState *state, GConverter *converter)
+{
+    GOutputStream *filter = g_converter_output_stream_new (state->stream, converter);
+
+    if (state->stream == state->file_stream)
+        g_filter_output_stream_set_close_base_stream (G_FILTER_OUTPUT_STREAM (filter), FALSE);
+
+    g_object_unref (state->stream);
+    state->stream = filter;
+}
+
+/* Stacks the filters on @state->file_stream and starts writing. */
+static void
+save_begin (GTask *task)
+{
+    SaveState *state = g_task_get_task_data (task);
+    GCharsetConverter *converter;
+    GConverter *compressor;
+    GError *error = NULL;
+
+    state->stream = g_object_ref (state->file_stream);
+
+    if (state->compression != FLOW_COMPRESSION_NONE) {
+        compressor = flow_compression_new_compressor (state->compression, &error);
+        if (!compressor) {
+            save_abort (task, error);
+            return;
+        }
+        save_push_filter (state, compressor);
+        g_object_unref (compressor);
+    }
+
+    if (!flow_encoding_is_utf8 (state->charset)) {
+        converter = g_charset_converter_new (state->charset, FLOW_ENCODING_UTF8, &error);
+        if (!converter) {
+            save_abort (task, error);
+            return;
+        }
+        save_push_filter (state, G_CONVERTER (converter));
+        g_object_unref (converter);
+    }
+
+    /* Written as UTF-8 and converted with the rest, so it comes out as the
+     * right byte order mark for the target encoding. */
+    if (state->write_bom)
+        g_byte_array_append (state->staging, (const guint8 *) "\xEF\xBB\xBF", 3);
+
+    save_write_next (task);
+}
+
+static void
+save_replace_ready (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    GTask *task = G_TASK (user_data);
+    SaveState *state = g_task_get_task_data (task);
+    GFileOutputStream *stream;
+    GError *error = NULL;
+
+    stream = g_file_replace_finish (G_FILE (source_object), res, &error);
+    if (!stream) {
+        save_abort (task, error);
+        return;
+    }
+
+    state->file_stream = G_OUTPUT_STREAM (stream);
+    save_begin (task);
+}
+
+static void
+save_replace (GTask *task)
+{
+    SaveState *state = g_task_get_task_data (task);
+
+    g_file_replace_async (state->file, NULL, FALSE, G_FILE_CREATE_NONE, G_PRIORITY_DEFAULT,
+                          g_task_get_cancellable (task), save_replace_ready, task);
+}
+
+/*
+ * Creates a temporary file next to @state->file with its mode and owner,
+ * or returns -1 to leave the file to GIO: it is not a plain local file
+ * with a single name, it does not exist yet (GIO does not flush new
+ * files), or the temporary file could not be made to match it.
+ */
+static void
+save_open_temp_worker (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    SaveState *state = task_data;
+    gchar *path = g_file_get_path (state->file);
+    gchar *dirname;
+    gchar *basename;
+    gchar *template;
+    GStatBuf original;
+    struct stat temp;
+    gint fd;
+
+    (void)source_object;
+    (void)cancellable;
+
+    if (!path || g_lstat (path, &original) != 0 || !S_ISREG (original.st_mode) || original.st_nlink > 1) {
+        g_free (path);
+        g_task_return_int (task, -1);
+        return;
+    }
+
+    dirname = g_path_get_dirname (path);
+    basename = g_path_get_basename (path);
+    template = g_strdup_printf ("%s" G_DIR_SEPARATOR_S ".%s.flow-XXXXXX", dirname, basename);
+    g_free (dirname);
+    g_free (basename);
+    g_free (path);
+
+    fd = g_mkstemp_full (template, O_WRONLY | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        g_free (template);
+        g_task_return_int (task, -1);
+        return;
+    }
+
+    /* The owner first: changing it may clear set-id bits of the mode. */
+    if (fstat (fd, &temp) != 0 ||
+        ((temp.st_uid != original.st_uid || temp.st_gid != original.st_gid) &&
+         fchown (fd, original.st_uid, original.st_gid) != 0) ||
+        fchmod (fd, original.st_mode & 07777) != 0) {
+        g_close (fd, NULL);
+        g_unlink (template);
+        g_free (template);
+        g_task_return_int (task, -1);
+        return;
+    }
+
+    state->temp_path = template;
+    g_task_return_int (task, fd);
+}
+
+static void
+save_open_temp_ready (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    GTask *task = G_TASK (user_data);
+    SaveState *state = g_task_get_task_data (task);
+    gssize fd;
+
+    (void)source_object;
+
+    fd = g_task_propagate_int (G_TASK (res), NULL);
+    if (fd < 0) {
+        save_replace (task);
+        return;
+    }
+
+    state->file_stream = g_unix_output_stream_new ((gint) fd, TRUE);
+    save_begin (task);
+}
+
+/*
+ * Writes @snapshot to @file without blocking the main thread, encoded
+ * as @charset (%NULL for UTF-8) and optionally with a byte order mark,
+ * then compressed with @compression.  @progress, if given, is called on the main thread after each write.
+ */
+void
+flow_file_save_async (GFile                  *file,
+                      FlowPieceTableSnapshot *snapshot,
+                      const gchar            *charset,
+                      gboolean                write_bom,
+                      FlowCompression         compression,
+                      FlowSaveDurability      durability,
+                      GCancellable           *cancellable,
+                      FlowFileSaveProgress    progress,
+                      GAsyncReadyCallback     callback,
+                      gpointer                user_data)
+{
+    SaveState *state;
+    GTask *task;
+
+    g_return_if_fail (G_IS_FILE (file));
+    g_return_if_fail (snapshot != NULL);
+
+    state = g_new0 (SaveState, 1);
+    state->file = g_object_ref (file);
+    state->iter = flow_piece_table_iter_new (snapshot);
+    state->durability = durability;
+    state->charset = g_strdup (charset ? charset : FLOW_ENCODING_UTF8);
+    state->write_bom = write_bom;
+    state->compression = compression;
+    state->staging = g_byte_array_sized_new (SAVE_STAGING_SIZE);
+    state->total = flow_piece_table_snapshot_get_length (snapshot);
+    state->progress = progress;
+    state->progress_data = user_data;
+
+    task = g_task_new (NULL, cancellable, callback, user_data);
+    g_task_set_source_tag (task, flow_file_save_async);
+    g_task_set_task_data (task, state, (GDestroyNotify) save_state_free);
+
+    /* Not cancellable, so a temporary file made is never lost track of;
+     * a cancelled save then fails at its first write. */
+    if (durability == FLOW_SAVE_DURABILITY_NONE) {
+        GTask *open = g_task_new (NULL, NULL, save_open_temp_ready, task);
+
+        g_task_set_task_data (open, state, NULL);
+        g_task_run_in_thread (open, save_open_temp_worker);
+        g_object_unref (open);
+        return;
+    }
+
+    save_replace (task);
+}
+
+gboolean
+flow_file_save_finish (GAsyncResult *result, GError **error)
+{
+    g_return_val_if_fail (g_task_is_valid (result, NULL), FALSE);
+
+    return g_task_propagate_boolean (G_TASK (result), error);
+}
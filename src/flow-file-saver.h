@@ -0,0 +1,56 @@
+/* flow-file-saver.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "flow-compression.h"
+#include "flow-piece-table.h"
+
+G_BEGIN_DECLS
+
+typedef enum {
+    FLOW_SAVE_DURABILITY_NONE,
+    FLOW_SAVE_DURABILITY_FSYNC,
+    FLOW_SAVE_DURABILITY_FSYNC_DIRECTORY,
+} FlowSaveDurability;
+
+typedef void (*FlowFileSaveProgress) (guint64  written,
+                                      guint64  total,
+                                      gpointer user_data);
+
+FlowSaveDurability flow_save_durability_from_string (const gchar            *name);
+const gchar       *flow_save_durability_to_string   (FlowSaveDurability      durability);
+
+void               flow_file_save_async             (GFile                  *file,
+                                                     FlowPieceTableSnapshot *snapshot,
+                                                     const gchar            *charset,
+                                                     gboolean                write_bom,
+                                                     FlowCompression         compression,
+                                                     FlowSaveDurability      durability,
+                                                     GCancellable           *cancellable,
+                                                     FlowFileSaveProgress    progress,
+                                                     GAsyncReadyCallback     callback,
+                                                     gpointer                user_data);
+gboolean           flow_file_save_finish            (GAsyncResult           *result,
+                                                     GError                **error);
+
+G_END_DECLS
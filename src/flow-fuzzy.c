@@ -0,0 +1,284 @@
+/* flow-fuzzy.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * The scores follow fzf's first algorithm.  A forward scan finds where
+ * the earliest match ends, and a backward scan from there finds the
+ * shortest match ending at that point.  Only that stretch is scored.  A
+ * path is first tried on its last component, so "win" prefers
+ * src/flow-window.c over src/w/i/n.c.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "flow-fuzzy.h"
+
+#define SCORE_MATCH 16
+#define SCORE_GAP_START (-3)
+#define SCORE_GAP_EXTENSION (-1)
+#define BONUS_BOUNDARY (SCORE_MATCH / 2)
+#define BONUS_BOUNDARY_DELIMITER (BONUS_BOUNDARY + 1)
+#define BONUS_BOUNDARY_WHITE (BONUS_BOUNDARY + 2)
+#define BONUS_NON_WORD (SCORE_MATCH / 2)
+#define BONUS_CAMEL_123 (BONUS_BOUNDARY + SCORE_GAP_EXTENSION)
+#define BONUS_CONSECUTIVE (-(SCORE_GAP_START + SCORE_GAP_EXTENSION))
+#define BONUS_FIRST_CHAR_MULTIPLIER 2
+
+struct _FlowFuzzyPattern {
+    gchar *text;        /* folded unless case_sensitive, without spaces */
+    gsize len;
+    gboolean case_sensitive;
+    guint64 mask;
+};
+
+/* Ordered so that every class past CHAR_NON_WORD is part of a word. */
+typedef enum {
+    CHAR_WHITE,
+    CHAR_NON_WORD,
+    CHAR_DELIMITER,
+    CHAR_LOWER,
+    CHAR_UPPER,
+    CHAR_NUMBER,
+} CharClass;
+
+static CharClass
+char_class (guchar c)
+{
+    if (g_ascii_islower (c))
+        return CHAR_LOWER;
+    if (g_ascii_isupper (c))
+        return CHAR_UPPER;
+    if (g_ascii_isdigit (c))
+        return CHAR_NUMBER;
+    if (c == '/' || c == '\\' || c == ',' || c == ':' || c == ';' || c == '|')
+        return CHAR_DELIMITER;
+    if (c == ' ' || c == '\t')
+        return CHAR_WHITE;
+    /* Bytes of multi-byte characters count as letters. */
+    if (c >= 0x80)
+        return CHAR_LOWER;
+    return CHAR_NON_WORD;
+}
+
+static gint
+char_bonus (CharClass previous, CharClass current)
+{
+    if (current > CHAR_DELIMITER) {
+        switch (previous) {
+            case CHAR_WHITE:
+                return BONUS_BOUNDARY_WHITE;
+            case CHAR_DELIMITER:
+                return BONUS_BOUNDARY_DELIMITER;
+            case CHAR_NON_WORD:
+                return BONUS_BOUNDARY;
+            default:
+                break;
+        }
+    }
+
+    if ((previous == CHAR_LOWER && current == CHAR_UPPER) ||
+        (previous != CHAR_NUMBER && current == CHAR_NUMBER))
+        return BONUS_CAMEL_123;
+
+    switch (current) {
+        case CHAR_NON_WORD:
+        case CHAR_DELIMITER:
+            return BONUS_NON_WORD;
+        case CHAR_WHITE:
+            return BONUS_BOUNDARY_WHITE;
+        default:
+            return 0;
+    }
+}
+
+static guint
+char_mask_bit (guchar c)
+{
+    c = g_ascii_tolower (c);
+    if (c >= 'a' && c <= 'z')
+        return c - 'a';
+    if (c >= '0' && c <= '9')
+        return 26 + (c - '0');
+    return 36 + c % 28;
+}
+
+/* Mask of the bytes in @text, ignoring case. */
+guint64
+flow_fuzzy_char_mask (const gchar *text, gsize len)
+{
+    guint64 mask = 0;
+    gsize i;
+
+    for (i = 0; i < len; i++)
+        mask |= G_GUINT64_CONSTANT (1) << char_mask_bit (text[i]);
+
+    return mask;
+}
+
+FlowFuzzyPattern *
+flow_fuzzy_pattern_new (const gchar *query)
+{
+    FlowFuzzyPattern *pattern = g_new0 (FlowFuzzyPattern, 1);
+    GString *text = g_string_new (NULL);
+    const gchar *p;
+
+    for (p = query ? query : ""; *p; p++) {
+        if (*p == ' ' || *p == '\t')
+            continue;
+        if (g_ascii_isupper (*p))
+            pattern->case_sensitive = TRUE;
+        g_string_append_c (text, *p);
+    }
+
+    pattern->len = text->len;
+    pattern->text = g_string_free (text, FALSE);
+    if (!pattern->case_sensitive) {
+        gsize i;
+
+        for (i = 0; i < pattern->len; i++)
+            pattern->text[i] = g_ascii_tolower (pattern->text[i]);
+    }
+    pattern->mask = flow_fuzzy_char_mask (pattern->text, pattern->len);
+
+    return pattern;
+}
+
+void
+flow_fuzzy_pattern_free (FlowFuzzyPattern *pattern)
+{
+    if (!pattern)
+        return;
+
+    g_free (pattern->text);
+    g_free (pattern);
+}
+
+gboolean
+flow_fuzzy_pattern_is_empty (const FlowFuzzyPattern *pattern)
+{
+    return pattern->len == 0;
+}
+
+guint64
+flow_fuzzy_pattern_get_mask (const FlowFuzzyPattern *pattern)
+{
+    return pattern->mask;
+}
+
+static inline gchar
+pattern_fold (const FlowFuzzyPattern *pattern, gchar c)
+{
+    return pattern->case_sensitive ? c : g_ascii_tolower (c);
+}
+
+/* Score of the match of @pattern in text[start, end). */
+static gint
+match_score (const FlowFuzzyPattern *pattern, const gchar *text, gsize start, gsize end)
+{
+    CharClass previous = start > 0 ? char_class (text[start - 1]) : CHAR_WHITE;
+    gboolean in_gap = FALSE;
+    gint consecutive = 0;
+    gint first_bonus = 0;
+    gint score = 0;
+    gsize pidx = 0;
+    gsize i;
+
+    for (i = start; i < end; i++) {
+        CharClass current = char_class (text[i]);
+
+        if (pidx < pattern->len && pattern_fold (pattern, text[i]) == pattern->text[pidx]) {
+            gint bonus = char_bonus (previous, current);
+
+            score += SCORE_MATCH;
+            if (consecutive == 0) {
+                first_bonus = bonus;
+            } else {
+                /* A run keeps the bonus of its start, or a later boundary. */
+                if (bonus >= BONUS_BOUNDARY && bonus > first_bonus)
+                    first_bonus = bonus;
+                bonus = MAX (MAX (bonus, first_bonus), BONUS_CONSECUTIVE);
+            }
+
+            score += pidx == 0 ? bonus * BONUS_FIRST_CHAR_MULTIPLIER : bonus;
+            in_gap = FALSE;
+            consecutive++;
+            pidx++;
+        } else {
+            score += in_gap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+            in_gap = TRUE;
+            consecutive = 0;
+            first_bonus = 0;
+        }
+
+        previous = current;
+    }
+
+    return score;
+}
+
+/* Matches @pattern against text[from, len), scoring the tightest match. */
+static gboolean
+match_from (const FlowFuzzyPattern *pattern, const gchar *text, gsize from, gsize len, gint *score)
+{
+    gsize pidx = 0;
+    gsize start;
+    gsize end;
+    gsize i;
+
+    for (i = from; i < len; i++) {
+        if (pattern_fold (pattern, text[i]) == pattern->text[pidx] && ++pidx == pattern->len)
+            break;
+    }
+    if (pidx < pattern->len)
+        return FALSE;
+    end = i + 1;
+
+    for (i = end; i > from; i--) {
+        if (pattern_fold (pattern, text[i - 1]) == pattern->text[pidx - 1] && --pidx == 0)
+            break;
+    }
+    start = i - 1;
+
+    *score = match_score (pattern, text, start, end);
+    return TRUE;
+}
+
+/*
+ * Whether @text, of @len bytes, matches @pattern; if so, @score is set.
+ * An empty pattern matches everything with a score of zero.
+ */
+gboolean
+flow_fuzzy_match (const FlowFuzzyPattern *pattern, const gchar *text, gsize len, gint *score)
+{
+    const gchar *slash;
+
+    if (pattern->len == 0) {
+        *score = 0;
+        return TRUE;
+    }
+
+    slash = g_strrstr_len (text, len, G_DIR_SEPARATOR_S);
+    if (slash && match_from (pattern, text, slash + 1 - text, len, score))
+        return TRUE;
+
+    return match_from (pattern, text, 0, len, score);
+}
@@ -0,0 +1,52 @@
+/* flow-fuzzy.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Fuzzy matching of file paths in the manner of fzf: every character of
+ * the pattern must appear in order, and a match scores higher the more of
+ * it falls on word starts or runs together.  Matching ignores case unless
+ * the pattern has an upper-case letter.
+ *
+ * The character mask of a text has a bit for each kind of byte it
+ * contains.  A text whose mask lacks a bit of the pattern's mask cannot
+ * match, which rejects most texts without looking at them.
+ */
+typedef struct _FlowFuzzyPattern FlowFuzzyPattern;
+
+guint64           flow_fuzzy_char_mask        (const gchar            *text,
+                                               gsize                   len);
+
+FlowFuzzyPattern *flow_fuzzy_pattern_new      (const gchar            *query);
+void              flow_fuzzy_pattern_free     (FlowFuzzyPattern       *pattern);
+gboolean          flow_fuzzy_pattern_is_empty (const FlowFuzzyPattern *pattern);
+guint64           flow_fuzzy_pattern_get_mask (const FlowFuzzyPattern *pattern);
+
+gboolean          flow_fuzzy_match            (const FlowFuzzyPattern *pattern,
+                                               const gchar            *text,
+                                               gsize                   len,
+                                               gint                   *score);
+
+G_END_DECLS
@@ -0,0 +1,585 @@
+/* flow-ignore.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Each pattern is compiled once into the cheapest test that decides it:
+ * a plain name is compared whole, "*.ext" and the like by their suffix,
+ * and only the rest go through the glob matcher.  A pattern without a
+ * slash is tested against the last component of a path; one with a
+ * slash is tied to the directory of its file and tested against the
+ * path from there.
+ *
+ * Rules are kept per directory.  A lookup goes from the path's own
+ * directory up to the folder, then to the global patterns, and within
+ * each takes the last rule that matches, so the first match found
+ * decides.
+ *
+ * The digest sums a hash of every ignore file read and of the global
+ * patterns.  Two walks that saw the same rules end with the same digest,
+ * whatever order they loaded directories in.
+ *
+ * Files are read outside the lock; only adding what was read takes it
+ * for writing.  Rules are never changed once added.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "flow-ignore.h"
+
+typedef enum {
+    RULE_LITERAL,
+    RULE_SUFFIX,
+    RULE_GLOB
+} RuleKind;
+
+typedef struct {
+    gchar *pattern;         /* for RULE_SUFFIX, only what follows the '*' */
+    gsize len;
+    RuleKind kind;
+    gboolean negated;
+    gboolean directory_only;
+    gboolean anchored;
+} IgnoreRule;
+
+/* Rules read from one directory, on whichever thread read them. */
+typedef struct {
+    gchar *relative;
+    GArray *rules;          /* IgnoreRule, or NULL for none */
+    guint64 digest;
+} DirRules;
+
+struct _FlowIgnore
+{
+    gint ref_count;
+    GFile *root;
+    GArray *global;         /* IgnoreRule */
+    GRWLock lock;
+    GHashTable *dirs;       /* relative path -> GArray of IgnoreRule, or NULL */
+    guint64 digest;
+};
+
+/* Files read in each directory, the later taking precedence. */
+static const gchar * const ignore_files[] = { ".gitignore", ".ignore" };
+
+static guint64
+hash_bytes (guint64 hash, const gchar *data, gsize len)
+{
+    gsize i;
+
+    /* FNV-1a */
+    if (hash == 0)
+        hash = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+    for (i = 0; i < len; i++) {
+        hash ^= (guint8) data[i];
+        hash *= G_GUINT64_CONSTANT (0x100000001b3);
+    }
+    return hash;
+}
+
+static void
+ignore_rule_clear (gpointer data)
+{
+    g_free (((IgnoreRule *) data)->pattern);
+}
+
+static void
+rules_unref (gpointer rules)
+{
+    if (rules)
+        g_array_unref (rules);
+}
+
+static GArray *
+rules_new (void)
+{
+    GArray *rules = g_array_new (FALSE, FALSE, sizeof (IgnoreRule));
+
+    g_array_set_clear_func (rules, ignore_rule_clear);
+    return rules;
+}
+
+static void
+rules_add_line (GArray *rules, const gchar *line, gsize len)
+{
+    IgnoreRule rule = { 0 };
+
+    if (len > 0 && line[len - 1] == '\r')
+        len--;
+    /* Trailing spaces are dropped unless escaped. */
+    while (len > 0 && line[len - 1] == ' ' && !(len > 1 && line[len - 2] == '\\'))
+        len--;
+    if (len == 0 || line[0] == '#')
+        return;
+
+    if (line[0] == '!') {
+        rule.negated = TRUE;
+        line++;
+        len--;
+    } else if (line[0] == '\\' && len > 1 && (line[1] == '!' || line[1] == '#')) {
+        line++;
+        len--;
+    }
+
+    if (len > 0 && line[len - 1] == '/') {
+        rule.directory_only = TRUE;
+        len--;
+    }
+
+    /* A slash before the end ties the pattern to its directory. */
+    if (len > 0 && memchr (line, '/', len)) {
+        rule.anchored = TRUE;
+        if (line[0] == '/') {
+            line++;
+            len--;
+        }
+    }
+    if (len == 0)
+        return;
+
+    rule.pattern = g_strndup (line, len);
+    rule.len = len;
+    rule.kind = RULE_GLOB;
+    if (!strpbrk (rule.pattern, "*?[\\")) {
+        rule.kind = RULE_LITERAL;
+    } else if (!rule.anchored && rule.pattern[0] == '*' && !strpbrk (rule.pattern + 1, "*?[\\")) {
+        gchar *suffix = g_strdup (rule.pattern + 1);
+
+        g_free (rule.pattern);
+        rule.pattern = suffix;
+        rule.len = len - 1;
+        rule.kind = RULE_SUFFIX;
+    }
+
+    g_array_append_val (rules, rule);
+}
+
+static void
+rules_add_text (GArray *rules, const gchar *text, gsize len)
+{
+    const gchar *end = text + len;
+
+    while (text < end) {
+        const gchar *eol = memchr (text, '\n', end - text);
+
+        if (!eol)
+            eol = end;
+        rules_add_line (rules, text, eol - text);
+        text = eol + 1;
+    }
+}
+
+/*
+ * Matches the class at @p, which starts with '[', against @c.  Returns
+ * the end of the class, or NULL if it is never closed.
+ */
+static const gchar *
+match_class (const gchar *p, guchar c, gboolean *matched)
+{
+    gboolean negated = FALSE;
+
+    *matched = FALSE;
+    p++;
+    if (*p == '!' || *p == '^') {
+        negated = TRUE;
+        p++;
+    }
+
+    /* A ']' first in the class is part of it. */
+    do {
+        guchar low = (guchar) *p;
+        guchar high;
+
+        if (low == '\0')
+            return NULL;
+        if (low == '\\' && p[1])
+            low = (guchar) *++p;
+        high = low;
+        if (p[1] == '-' && p[2] && p[2] != ']') {
+            p += 2;
+            if (*p == '\\' && p[1])
+                p++;
+            high = (guchar) *p;
+        }
+        if (c >= low && c <= high)
+            *matched = TRUE;
+        p++;
+    } while (*p != ']');
+
+    if (negated)
+        *matched = !*matched;
+    return p + 1;
+}
+
+/*
+ * Glob match of all of @text.  '*', '?' and classes stay within one
+ * path component; "**" spans any number, and "**" followed by a slash
+ * may also match none.
+ */
+static gboolean
+glob_match (const gchar *p, const gchar *text)
+{
+    while (*p) {
+        const gchar *after;
+        gboolean matched;
+
+        switch (*p) {
+            case '*':
+                if (p[1] == '*') {
+                    p += 2;
+                    if (*p == '/' && glob_match (p + 1, text))
+                        return TRUE;
+                    for (;; text++) {
+                        if (glob_match (p, text))
+                            return TRUE;
+                        if (!*text)
+                            return FALSE;
+                    }
+                }
+                p++;
+                for (;; text++) {
+                    if (glob_match (p, text))
+                        return TRUE;
+                    if (!*text || *text == '/')
+                        return FALSE;
+                }
+            case '?':
+                if (!*text || *text == '/')
+                    return FALSE;
+                p++;
+                text++;
+                break;
+            case '[':
+                after = match_class (p, (guchar) *text, &matched);
+                if (after) {
+                    if (!*text || *text == '/' || !matched)
+                        return FALSE;
+                    p = after;
+                    text++;
+                    break;
+                }
+                /* Never closed, so a plain '['. */
+                if (*text != '[')
+                    return FALSE;
+                p++;
+                text++;
+                break;
+            default:
+                if (*p == '\\' && p[1])
+                    p++;
+                if (*p != *text)
+                    return FALSE;
+                p++;
+                text++;
+                break;
+        }
+    }
+
+    return *text == '\0';
+}
+
+static gboolean
+rule_matches (const IgnoreRule *rule, const gchar *path, const gchar *basename, gboolean is_directory)
+{
+    const gchar *subject = rule->anchored ? path : basename;
+    gsize len;
+
+    if (rule->directory_only && !is_directory)
+        return FALSE;
+
+    switch (rule->kind) {
+        case RULE_LITERAL:
+            return strcmp (subject, rule->pattern) == 0;
+        case RULE_SUFFIX:
+            len = strlen (subject);
+            return len >= rule->len && memcmp (subject + len - rule->len, rule->pattern, rule->len) == 0;
+        default:
+            return glob_match (rule->pattern, subject);
+    }
+}
+
+/* Whether @rules decide @path; if so, @ignored says which way. */
+static gboolean
+rules_decide (GArray       *rules,
+              const gchar  *path,
+              const gchar  *basename,
+              gboolean      is_directory,
+              gboolean     *ignored)
+{
+    guint i;
+
+    for (i = rules ? rules->len : 0; i > 0; i--) {
+        const IgnoreRule *rule = &g_array_index (rules, IgnoreRule, i - 1);
+
+        if (rule_matches (rule, path, basename, is_directory)) {
+            *ignored = !rule->negated;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+dir_rules_free (DirRules *dir)
+{
+    g_free (dir->relative);
+    if (dir->rules)
+        g_array_unref (dir->rules);
+    g_free (dir);
+}
+
+/* Reads the ignore files of directory @relative; safe on any thread. */
+static DirRules *
+dir_rules_read (GFile *root, const gchar *relative, GCancellable *cancellable)
+{
+    DirRules *result = g_new0 (DirRules, 1);
+    GFile *dir = *relative ? g_file_resolve_relative_path (root, relative) : g_object_ref (root);
+    GPtrArray *names = g_ptr_array_new ();
+    guint i;
+
+    result->relative = g_strdup (relative);
+
+    if (!*relative)
+        g_ptr_array_add (names, (gpointer) ".git/info/exclude");
+    for (i = 0; i < G_N_ELEMENTS (ignore_files); i++)
+        g_ptr_array_add (names, (gpointer) ignore_files[i]);
+
+    for (i = 0; i < names->len; i++) {
+        GFile *file = g_file_resolve_relative_path (dir, names->pdata[i]);
+        gchar *contents;
+        gsize len;
+
+        if (g_file_load_contents (file, cancellable, &contents, &len, NULL, NULL)) {
+            if (!result->rules)
+                result->rules = rules_new ();
+            rules_add_text (result->rules, contents, len);
+            result->digest = hash_bytes (result->digest, relative, strlen (relative) + 1);
+            result->digest = hash_bytes (result->digest, names->pdata[i], strlen (names->pdata[i]) + 1);
+            result->digest = hash_bytes (result->digest, contents, len);
+            g_free (contents);
+        }
+        g_object_unref (file);
+    }
+
+    if (result->rules && result->rules->len == 0)
+        g_clear_pointer (&result->rules, g_array_unref);
+
+    g_ptr_array_unref (names);
+    g_object_unref (dir);
+    return result;
+}
+
+/* Keeps @dir's rules, unless the directory was loaded meanwhile. */
+static void
+ignore_add_dir (FlowIgnore *ignore, DirRules *dir)
+{
+    g_rw_lock_writer_lock (&ignore->lock);
+    if (!g_hash_table_contains (ignore->dirs, dir->relative)) {
+        g_hash_table_insert (ignore->dirs, g_strdup (dir->relative),
+                             dir->rules ? g_array_ref (dir->rules) : NULL);
+        ignore->digest += dir->digest;
+    }
+    g_rw_lock_writer_unlock (&ignore->lock);
+    dir_rules_free (dir);
+}
+
+static gboolean
+ignore_has_dir (FlowIgnore *ignore, const gchar *relative)
+{
+    gboolean loaded;
+
+    g_rw_lock_reader_lock (&ignore->lock);
+    loaded = g_hash_table_contains (ignore->dirs, relative);
+    g_rw_lock_reader_unlock (&ignore->lock);
+    return loaded;
+}
+
+/*
+ * Creates a matcher for the folder @root with @patterns, in gitignore
+ * syntax, applying everywhere below it.  No directory is loaded yet.
+ */
+FlowIgnore *
+flow_ignore_new (GFile *root, const gchar * const *patterns)
+{
+    FlowIgnore *ignore;
+    guint i;
+
+    g_return_val_if_fail (G_IS_FILE (root), NULL);
+
+    ignore = g_new0 (FlowIgnore, 1);
+    ignore->ref_count = 1;
+    ignore->root = g_object_ref (root);
+    ignore->global = rules_new ();
+    g_rw_lock_init (&ignore->lock);
+    ignore->dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, rules_unref);
+
+    for (i = 0; patterns && patterns[i]; i++) {
+        rules_add_line (ignore->global, patterns[i], strlen (patterns[i]));
+        ignore->digest = hash_bytes (ignore->digest, patterns[i], strlen (patterns[i]) + 1);
+    }
+
+    return ignore;
+}
+
+FlowIgnore *
+flow_ignore_ref (FlowIgnore *ignore)
+{
+    g_return_val_if_fail (ignore != NULL, NULL);
+
+    g_atomic_int_inc (&ignore->ref_count);
+    return ignore;
+}
+
+void
+flow_ignore_unref (FlowIgnore *ignore)
+{
+    if (!ignore || !g_atomic_int_dec_and_test (&ignore->ref_count))
+        return;
+
+    g_object_unref (ignore->root);
+    g_array_unref (ignore->global);
+    g_rw_lock_clear (&ignore->lock);
+    g_hash_table_unref (ignore->dirs);
+    g_free (ignore);
+}
+
+/* Reads the rules of directory @relative, if that was not done before. */
+void
+flow_ignore_load_dir (FlowIgnore *ignore, const gchar *relative, GCancellable *cancellable)
+{
+    g_return_if_fail (ignore != NULL);
+    g_return_if_fail (relative != NULL);
+
+    if (!ignore_has_dir (ignore, relative))
+        ignore_add_dir (ignore, dir_rules_read (ignore->root, relative, cancellable));
+}
+
+static void
+load_dir_worker (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    FlowIgnore *ignore = task_data;
+    const gchar *relative = g_object_get_data (G_OBJECT (task), "relative");
+
+    g_task_return_pointer (task, dir_rules_read (ignore->root, relative, cancellable),
+                           (GDestroyNotify) dir_rules_free);
+}
+
+/*
+ * Reads the rules of directory @relative on a worker thread.  They are
+ * kept by flow_ignore_load_dir_finish().
+ */
+void
+flow_ignore_load_dir_async (FlowIgnore          *ignore,
+                            const gchar         *relative,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
+{
+    GTask *task;
+
+    g_return_if_fail (ignore != NULL);
+    g_return_if_fail (relative != NULL);
+
+    task = g_task_new (NULL, cancellable, callback, user_data);
+    g_task_set_source_tag (task, flow_ignore_load_dir_async);
+    g_task_set_task_data (task, flow_ignore_ref (ignore), (GDestroyNotify) flow_ignore_unref);
+
+    if (ignore_has_dir (ignore, relative)) {
+        g_task_return_pointer (task, NULL, NULL);
+    } else {
+        g_object_set_data_full (G_OBJECT (task), "relative", g_strdup (relative), g_free);
+        g_task_run_in_thread (task, load_dir_worker);
+    }
+    g_object_unref (task);
+}
+
+gboolean
+flow_ignore_load_dir_finish (FlowIgnore *ignore, GAsyncResult *result, GError **error)
+{
+    DirRules *dir;
+
+    g_return_val_if_fail (g_task_is_valid (result, NULL), FALSE);
+
+    dir = g_task_propagate_pointer (G_TASK (result), error);
+    if (dir)
+        ignore_add_dir (ignore, dir);
+    return !g_task_had_error (G_TASK (result));
+}
+
+/*
+ * Whether @relative, a file or a directory, is ignored by the rules of
+ * the directories loaded so far.
+ */
+gboolean
+flow_ignore_is_ignored (FlowIgnore *ignore, const gchar *relative, gboolean is_directory)
+{
+    const gchar *basename;
+    gsize dir_len;
+    gchar *dir;
+    gboolean ignored = FALSE;
+    gboolean decided = FALSE;
+
+    g_return_val_if_fail (ignore != NULL, FALSE);
+    g_return_val_if_fail (relative != NULL, FALSE);
+
+    basename = strrchr (relative, '/');
+    basename = basename ? basename + 1 : relative;
+    dir_len = basename > relative ? (gsize) (basename - relative) - 1 : 0;
+    dir = g_strndup (relative, dir_len);
+
+    g_rw_lock_reader_lock (&ignore->lock);
+    /* From the path's own directory up to the folder. */
+    while (!decided) {
+        GArray *rules = g_hash_table_lookup (ignore->dirs, dir);
+
+        decided = rules_decide (rules, dir_len ? relative + dir_len + 1 : relative, basename,
+                                is_directory, &ignored);
+        if (dir_len == 0)
+            break;
+
+        while (dir_len > 0 && relative[dir_len - 1] != '/')
+            dir_len--;
+        if (dir_len > 0)
+            dir_len--;
+        dir[dir_len] = '\0';
+    }
+    g_rw_lock_reader_unlock (&ignore->lock);
+    g_free (dir);
+
+    if (!decided)
+        rules_decide (ignore->global, relative, basename, is_directory, &ignored);
+    return ignored;
+}
+
+/* A digest of the patterns and every ignore file loaded so far. */
+guint64
+flow_ignore_get_digest (FlowIgnore *ignore)
+{
+    guint64 digest;
+
+    g_return_val_if_fail (ignore != NULL, 0);
+
+    g_rw_lock_reader_lock (&ignore->lock);
+    digest = ignore->digest;
+    g_rw_lock_reader_unlock (&ignore->lock);
+    return digest;
+}
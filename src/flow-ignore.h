@@ -0,0 +1,64 @@
+/* flow-ignore.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * FlowIgnore tells which paths under a folder are ignored, following
+ * gitignore syntax and precedence.  Rules come from a list of global
+ * patterns, from .git/info/exclude at the top, and from the .gitignore
+ * and .ignore files of each directory.  Paths are relative to the
+ * folder.  A directory's files are read when it is loaded, which walks
+ * do on their way down before asking about its entries; a path inside
+ * an ignored directory is not itself reported, as walks never reach it.
+ *
+ * One matcher can be shared by threads walking different directories.
+ */
+typedef struct _FlowIgnore FlowIgnore;
+
+FlowIgnore *flow_ignore_new             (GFile               *root,
+                                         const gchar * const *patterns);
+FlowIgnore *flow_ignore_ref             (FlowIgnore          *ignore);
+void        flow_ignore_unref           (FlowIgnore          *ignore);
+
+void        flow_ignore_load_dir        (FlowIgnore          *ignore,
+                                         const gchar         *relative,
+                                         GCancellable        *cancellable);
+void        flow_ignore_load_dir_async  (FlowIgnore          *ignore,
+                                         const gchar         *relative,
+                                         GCancellable        *cancellable,
+                                         GAsyncReadyCallback  callback,
+                                         gpointer             user_data);
+gboolean    flow_ignore_load_dir_finish (FlowIgnore          *ignore,
+                                         GAsyncResult        *result,
+                                         GError             **error);
+
+gboolean    flow_ignore_is_ignored      (FlowIgnore          *ignore,
+                                         const gchar         *relative,
+                                         gboolean             is_directory);
+guint64     flow_ignore_get_digest      (FlowIgnore          *ignore);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FlowIgnore, flow_ignore_unref)
+
+G_END_DECLS
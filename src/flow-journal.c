@@ -0,0 +1,792 @@
+/* flow-journal.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * A journal file is the magic followed by records, each a type byte, a
+ * little-endian 32-bit payload length and a checksum of the payload:
+ *
+ *   'H'  has_bom (u8), compression (u8), charset length (u16), charset,
+ *        then the document URI, empty for an untitled one
+ *   'T'  the text the edits apply to
+ *   'I'  character offset (u64), then the inserted text
+ *   'D'  character offset (u64), character count (u64)
+ *
+ * A crash can leave a torn record at the end; replay stops there.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "flow-encoding.h"
+#include "flow-journal.h"
+
+#define JOURNAL_MAGIC              "FLOWJRN1"
+#define JOURNAL_MAGIC_SIZE         8
+#define JOURNAL_RECORD_HEADER_SIZE 9
+#define JOURNAL_SUFFIX             ".journal"
+#define JOURNAL_TMP_SUFFIX         ".journal.tmp"
+#define JOURNAL_CHECKSUM_SEED      2166136261u
+/* Edits closer together than this are written and flushed as one. */
+#define JOURNAL_COMMIT_INTERVAL_MS 200
+/* Edits may outgrow the text they apply to up to this before compaction. */
+#define JOURNAL_COMPACT_MIN_SIZE   (1024 * 1024)
+
+enum {
+    RECORD_HEADER = 'H',
+    RECORD_TEXT = 'T',
+    RECORD_INSERT = 'I',
+    RECORD_DELETE = 'D',
+};
+
+struct _FlowJournal
+{
+    gint ref_count;
+
+    gchar *path;
+    GBytes *header;         /* encoded 'H' record, rewritten on compaction */
+
+    GMutex mutex;
+    GByteArray *pending;    /* records not written yet */
+    FlowPieceTableSnapshot *base;   /* text to start the file over from */
+    gboolean writing;
+    gboolean discarded;
+    gboolean failed;
+
+    gint fd;                /* only touched by the writer, or with none running */
+
+    /* Main thread only. */
+    guint commit_source_id;
+    guint64 base_size;
+    guint64 edit_size;
+};
+
+static gchar *
+journal_get_directory (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "flow", "journal", NULL);
+}
+
+/* FNV-1a; enough to tell a torn or garbled record from a whole one. */
+static guint32
+journal_checksum (guint32 hash, const guchar *data, gsize len)
+{
+    gsize i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static void
+journal_append_record (GByteArray   *out,
+                       guint8        type,
+                       const guchar *prefix,
+                       gsize         prefix_len,
+                       const guchar *data,
+                       gsize         len)
+{
+    guint32 length = GUINT32_TO_LE ((guint32) (prefix_len + len));
+    guint32 checksum;
+
+    checksum = journal_checksum (journal_checksum (JOURNAL_CHECKSUM_SEED, prefix, prefix_len), data, len);
+    checksum = GUINT32_TO_LE (checksum);
+
+    g_byte_array_append (out, &type, 1);
+    g_byte_array_append (out, (const guint8 *) &length, sizeof length);
+    g_byte_array_append (out, (const guint8 *) &checksum, sizeof checksum);
+    if (prefix_len > 0)
+        g_byte_array_append (out, prefix, (guint) prefix_len);
+    if (len > 0)
+        g_byte_array_append (out, data, (guint) len);
+}
+
+static GBytes *
+journal_encode_header (const gchar *uri, const gchar *charset, gboolean has_bom, FlowCompression compression)
+{
+    GByteArray *prefix = g_byte_array_new ();
+    GByteArray *record = g_byte_array_new ();
+    guint8 flags[2];
+    guint16 charset_len;
+
+    if (!charset)
+        charset = FLOW_ENCODING_UTF8;
+    if (!uri)
+        uri = "";
+
+    flags[0] = has_bom ? 1 : 0;
+    flags[1] = (guint8) compression;
+    charset_len = GUINT16_TO_LE ((guint16) strlen (charset));
+    g_byte_array_append (prefix, flags, sizeof flags);
+    g_byte_array_append (prefix, (const guint8 *) &charset_len, sizeof charset_len);
+    g_byte_array_append (prefix, (const guint8 *) charset, (guint) strlen (charset));
+
+    journal_append_record (record, RECORD_HEADER, prefix->data, prefix->len, (const guchar *) uri, strlen (uri));
+    g_byte_array_unref (prefix);
+
+    return g_byte_array_free_to_bytes (record);
+}
+
+/*
+ * Starts a journal for a document whose text is @base, which is written
+ * out before any edit.  The journal goes to @path, replacing what is
+ * there, or to a new file in the cache directory when @path is %NULL.
+ * Nothing is written on the calling thread.
+ */
+FlowJournal *
+flow_journal_new (const gchar            *path,
+                  const gchar            *uri,
+                  const gchar            *charset,
+                  gboolean                has_bom,
+                  FlowCompression         compression,
+                  FlowPieceTableSnapshot *base)
+{
+    FlowJournal *journal;
+
+    g_return_val_if_fail (base != NULL, NULL);
+
+    journal = g_new0 (FlowJournal, 1);
+    journal->ref_count = 1;
+    journal->fd = -1;
+
+    if (path) {
+        journal->path = g_strdup (path);
+    } else {
+        gchar *directory = journal_get_directory ();
+        gchar *uuid = g_uuid_string_random ();
+        gchar *name = g_strconcat (uuid, JOURNAL_SUFFIX, NULL);
+
+        journal->path = g_build_filename (directory, name, NULL);
+        g_free (name);
+        g_free (uuid);
+        g_free (directory);
+    }
+
+    journal->header = journal_encode_header (uri, charset, has_bom, compression);
+    g_mutex_init (&journal->mutex);
+    journal->pending = g_byte_array_new ();
+
+    flow_journal_compact (journal, base);
+
+    return journal;
+}
+
+FlowJournal *
+flow_journal_ref (FlowJournal *journal)
+{
+    g_return_val_if_fail (journal != NULL, NULL);
+
+    g_atomic_int_inc (&journal->ref_count);
+    return journal;
+}
+
+void
+flow_journal_unref (FlowJournal *journal)
+{
+    if (!journal || !g_atomic_int_dec_and_test (&journal->ref_count))
+        return;
+
+    if (journal->fd >= 0)
+        g_close (journal->fd, NULL);
+    g_clear_pointer (&journal->base, flow_piece_table_snapshot_unref);
+    g_byte_array_unref (journal->pending);
+    g_mutex_clear (&journal->mutex);
+    g_bytes_unref (journal->header);
+    g_free (journal->path);
+    g_free (journal);
+}
+
+static gboolean
+journal_set_errno_error (GError **error, const gchar *what)
+{
+    gint saved_errno = errno;
+
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                 "Failed to %s: %s", what, g_strerror (saved_errno));
+    return FALSE;
+}
+
+static gboolean
+journal_write_all (gint fd, const guint8 *data, gsize len, GError **error)
+{
+    while (len > 0) {
+        gssize written = write (fd, data, len);
+
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return journal_set_errno_error (error, "write journal");
+        }
+
+        data += written;
+        len -= (gsize) written;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+journal_write_text (gint fd, FlowPieceTableSnapshot *text, GError **error)
+{
+    FlowPieceTableIter *iter;
+    const gchar *chunk;
+    gsize chunk_len;
+    gsize len = flow_piece_table_snapshot_get_length (text);
+    guint32 checksum = JOURNAL_CHECKSUM_SEED;
+    guint32 length;
+    guint8 type = RECORD_TEXT;
+    gboolean ok = TRUE;
+
+    if (len > G_MAXUINT32) {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE, "Document too large to journal");
+        return FALSE;
+    }
+
+    iter = flow_piece_table_iter_new (text);
+    while (flow_piece_table_iter_next (iter, &chunk, &chunk_len))
+        checksum = journal_checksum (checksum, (const guchar *) chunk, chunk_len);
+    flow_piece_table_iter_free (iter);
+
+    length = GUINT32_TO_LE ((guint32) len);
+    checksum = GUINT32_TO_LE (checksum);
+    if (!journal_write_all (fd, &type, 1, error) ||
+        !journal_write_all (fd, (const guint8 *) &length, sizeof length, error) ||
+        !journal_write_all (fd, (const guint8 *) &checksum, sizeof checksum, error))
+        return FALSE;
+
+    iter = flow_piece_table_iter_new (text);
+    while (ok && flow_piece_table_iter_next (iter, &chunk, &chunk_len))
+        ok = journal_write_all (fd, (const guint8 *) chunk, chunk_len, error);
+    flow_piece_table_iter_free (iter);
+
+    return ok;
+}
+
+static gboolean
+journal_sync (gint fd, GError **error)
+{
+    if (fsync (fd) < 0)
+        return journal_set_errno_error (error, "flush journal");
+    return TRUE;
+}
+
+/* Makes a rename into @directory stick; a failure only weakens that. */
+static void
+journal_sync_directory (const gchar *directory)
+{
+    gint fd = g_open (directory, O_RDONLY | O_DIRECTORY, 0);
+
+    if (fd < 0)
+        return;
+    fsync (fd);
+    g_close (fd, NULL);
+}
+
+/*
+ * Writes a new journal holding @base and then @batch next to the old one
+ * and renames it into place, so a crash at any point leaves one of the
+ * two whole.
+ */
+static gboolean
+journal_rewrite (FlowJournal *journal, FlowPieceTableSnapshot *base, GByteArray *batch, GError **error)
+{
+    gchar *directory = g_path_get_dirname (journal->path);
+    gchar *tmp_path = g_strconcat (journal->path, ".tmp", NULL);
+    gconstpointer header;
+    gsize header_len;
+    gboolean ok = FALSE;
+    gint fd = -1;
+
+    if (g_mkdir_with_parents (directory, 0700) < 0) {
+        journal_set_errno_error (error, "create journal folder");
+        goto out;
+    }
+
+    fd = g_open (tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        journal_set_errno_error (error, "create journal");
+        goto out;
+    }
+
+    /* Held while the journal is in use, so recovery leaves it alone. */
+    if (flock (fd, LOCK_EX) < 0) {
+        journal_set_errno_error (error, "lock journal");
+        goto out;
+    }
+
+    header = g_bytes_get_data (journal->header, &header_len);
+    if (!journal_write_all (fd, (const guint8 *) JOURNAL_MAGIC, JOURNAL_MAGIC_SIZE, error) ||
+        !journal_write_all (fd, header, header_len, error) ||
+        !journal_write_text (fd, base, error) ||
+        !journal_write_all (fd, batch->data, batch->len, error) ||
+        !journal_sync (fd, error))
+        goto out;
+
+    if (g_rename (tmp_path, journal->path) < 0) {
+        journal_set_errno_error (error, "replace journal");
+        goto out;
+    }
+    journal_sync_directory (directory);
+
+    if (journal->fd >= 0)
+        g_close (journal->fd, NULL);
+    journal->fd = fd;
+    fd = -1;
+    ok = TRUE;
+
+out:
+    if (fd >= 0) {
+        g_close (fd, NULL);
+        g_unlink (tmp_path);
+    }
+    g_free (tmp_path);
+    g_free (directory);
+    return ok;
+}
+
+static void
+journal_remove (FlowJournal *journal)
+{
+    gchar *tmp_path = g_strconcat (journal->path, ".tmp", NULL);
+
+    if (journal->fd >= 0) {
+        g_close (journal->fd, NULL);
+        journal->fd = -1;
+    }
+    g_unlink (journal->path);
+    g_unlink (tmp_path);
+    g_free (tmp_path);
+}
+
+/*
+ * Writes whatever has been recorded, then looks again: edits made while
+ * one batch was being flushed go out together in the next.
+ */
+static void
+journal_writer (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    FlowJournal *journal = task_data;
+
+    (void)source_object;
+    (void)cancellable;
+
+    for (;;) {
+        FlowPieceTableSnapshot *base;
+        GByteArray *batch;
+        GError *error = NULL;
+        gboolean discarded;
+        gboolean ok;
+
+        g_mutex_lock (&journal->mutex);
+        discarded = journal->discarded;
+        base = g_steal_pointer (&journal->base);
+        batch = journal->pending;
+        if (discarded || journal->failed || (!base && batch->len == 0)) {
+            journal->writing = FALSE;
+            g_mutex_unlock (&journal->mutex);
+            g_clear_pointer (&base, flow_piece_table_snapshot_unref);
+            if (discarded)
+                journal_remove (journal);
+            break;
+        }
+        journal->pending = g_byte_array_new ();
+        g_mutex_unlock (&journal->mutex);
+
+        if (base)
+            ok = journal_rewrite (journal, base, batch, &error);
+        else
+            ok = journal_write_all (journal->fd, batch->data, batch->len, &error) &&
+                 journal_sync (journal->fd, &error);
+
+        if (!ok) {
+            g_warning ("Failed to write edit journal: %s", error->message);
+            g_error_free (error);
+            g_mutex_lock (&journal->mutex);
+            journal->failed = TRUE;
+            g_mutex_unlock (&journal->mutex);
+        }
+
+        g_clear_pointer (&base, flow_piece_table_snapshot_unref);
+        g_byte_array_unref (batch);
+    }
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static gboolean
+journal_commit_cb (gpointer user_data)
+{
+    FlowJournal *journal = user_data;
+    GTask *task;
+
+    journal->commit_source_id = 0;
+
+    /* A writer still running picks up the new records itself. */
+    g_mutex_lock (&journal->mutex);
+    if (journal->writing || journal->discarded) {
+        g_mutex_unlock (&journal->mutex);
+        return G_SOURCE_REMOVE;
+    }
+    journal->writing = TRUE;
+    g_mutex_unlock (&journal->mutex);
+
+    task = g_task_new (NULL, NULL, NULL, NULL);
+    g_task_set_task_data (task, flow_journal_ref (journal), (GDestroyNotify) flow_journal_unref);
+    g_task_run_in_thread (task, journal_writer);
+    g_object_unref (task);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+journal_schedule (FlowJournal *journal)
+{
+    if (journal->commit_source_id)
+        return;
+
+    journal->commit_source_id = g_timeout_add_full (G_PRIORITY_DEFAULT, JOURNAL_COMMIT_INTERVAL_MS,
+                                                    journal_commit_cb, flow_journal_ref (journal),
+                                                    (GDestroyNotify) flow_journal_unref);
+}
+
+static void
+journal_record (FlowJournal  *journal,
+                guint8        type,
+                const guchar *prefix,
+                gsize         prefix_len,
+                const guchar *data,
+                gsize         len)
+{
+    gboolean accepted;
+
+    g_mutex_lock (&journal->mutex);
+    accepted = !journal->discarded && !journal->failed;
+    if (accepted)
+        journal_append_record (journal->pending, type, prefix, prefix_len, data, len);
+    g_mutex_unlock (&journal->mutex);
+
+    if (!accepted)
+        return;
+
+    journal->edit_size += JOURNAL_RECORD_HEADER_SIZE + prefix_len + len;
+    journal_schedule (journal);
+}
+
+/* Records @len bytes of @text inserted at character @char_offset. */
+void
+flow_journal_insert (FlowJournal *journal, gsize char_offset, const gchar *text, gsize len)
+{
+    guint64 offset = GUINT64_TO_LE ((guint64) char_offset);
+
+    g_return_if_fail (journal != NULL);
+
+    journal_record (journal, RECORD_INSERT, (const guchar *) &offset, sizeof offset, (const guchar *) text, len);
+}
+
+void
+flow_journal_delete (FlowJournal *journal, gsize char_offset, gsize n_chars)
+{
+    guint64 payload[2];
+
+    g_return_if_fail (journal != NULL);
+
+    payload[0] = GUINT64_TO_LE ((guint64) char_offset);
+    payload[1] = GUINT64_TO_LE ((guint64) n_chars);
+    journal_record (journal, RECORD_DELETE, (const guchar *) payload, sizeof payload, NULL, 0);
+}
+
+/* Whether the edits recorded have outgrown the text they apply to. */
+gboolean
+flow_journal_wants_compaction (FlowJournal *journal)
+{
+    g_return_val_if_fail (journal != NULL, FALSE);
+
+    return journal->edit_size > MAX ((guint64) JOURNAL_COMPACT_MIN_SIZE, journal->base_size);
+}
+
+/*
+ * Starts the journal over from @snapshot, which must hold every edit
+ * recorded so far.  The old file stays in place until the new one is
+ * complete.
+ */
+void
+flow_journal_compact (FlowJournal *journal, FlowPieceTableSnapshot *snapshot)
+{
+    g_return_if_fail (journal != NULL);
+    g_return_if_fail (snapshot != NULL);
+
+    g_mutex_lock (&journal->mutex);
+    if (!journal->discarded && !journal->failed) {
+        g_clear_pointer (&journal->base, flow_piece_table_snapshot_unref);
+        journal->base = flow_piece_table_snapshot_ref (snapshot);
+        g_byte_array_set_size (journal->pending, 0);
+    }
+    g_mutex_unlock (&journal->mutex);
+
+    journal->base_size = flow_piece_table_snapshot_get_length (snapshot);
+    journal->edit_size = 0;
+    journal_schedule (journal);
+}
+
+/* Deletes the journal once its edits no longer need recovering, such as
+ * after a save.  Later edits are ignored. */
+void
+flow_journal_discard (FlowJournal *journal)
+{
+    gboolean writing;
+
+    g_return_if_fail (journal != NULL);
+
+    g_mutex_lock (&journal->mutex);
+    journal->discarded = TRUE;
+    writing = journal->writing;
+    g_clear_pointer (&journal->base, flow_piece_table_snapshot_unref);
+    g_byte_array_set_size (journal->pending, 0);
+    g_mutex_unlock (&journal->mutex);
+
+    /* Otherwise the writer removes it on its way out. */
+    if (!writing)
+        journal_remove (journal);
+}
+
+void
+flow_journal_recovery_free (FlowJournalRecovery *recovery)
+{
+    if (!recovery)
+        return;
+
+    g_free (recovery->path);
+    g_free (recovery->uri);
+    g_clear_pointer (&recovery->text, g_bytes_unref);
+    g_free (recovery);
+}
+
+static FlowJournalRecovery *
+journal_parse_header (const guchar *payload, gsize len)
+{
+    FlowJournalRecovery *recovery;
+    guint16 charset_len;
+    gchar *charset;
+
+    if (len < 4 || payload[1] > FLOW_COMPRESSION_XZ)
+        return NULL;
+
+    memcpy (&charset_len, payload + 2, sizeof charset_len);
+    charset_len = GUINT16_FROM_LE (charset_len);
+    if (charset_len == 0 || charset_len > len - 4)
+        return NULL;
+
+    recovery = g_new0 (FlowJournalRecovery, 1);
+    recovery->has_bom = payload[0] != 0;
+    recovery->compression = (FlowCompression) payload[1];
+    charset = g_strndup ((const gchar *) payload + 4, charset_len);
+    recovery->charset = g_intern_string (charset);
+    g_free (charset);
+    if (len > 4u + charset_len)
+        recovery->uri = g_strndup ((const gchar *) payload + 4 + charset_len, len - 4 - charset_len);
+
+    return recovery;
+}
+
+static GBytes *
+journal_table_to_bytes (FlowPieceTable *table)
+{
+    FlowPieceTableSnapshot *snapshot = flow_piece_table_snapshot (table);
+    FlowPieceTableIter *iter = flow_piece_table_iter_new (snapshot);
+    GString *text = g_string_sized_new (flow_piece_table_snapshot_get_length (snapshot));
+    const gchar *chunk;
+    gsize len;
+
+    while (flow_piece_table_iter_next (iter, &chunk, &len))
+        g_string_append_len (text, chunk, (gssize) len);
+    flow_piece_table_iter_free (iter);
+    flow_piece_table_snapshot_unref (snapshot);
+
+    return g_string_free_to_bytes (text);
+}
+
+/* Rebuilds the text a journal ends with, or %NULL if it holds no edits. */
+static FlowJournalRecovery *
+journal_replay (const gchar *contents, gsize len)
+{
+    FlowJournalRecovery *recovery = NULL;
+    FlowPieceTable *table = NULL;
+    gsize pos = JOURNAL_MAGIC_SIZE;
+    guint n_edits = 0;
+
+    if (len < JOURNAL_MAGIC_SIZE || memcmp (contents, JOURNAL_MAGIC, JOURNAL_MAGIC_SIZE) != 0)
+        return NULL;
+
+    while (len - pos >= JOURNAL_RECORD_HEADER_SIZE) {
+        const guchar *payload;
+        guint8 type = (guint8) contents[pos];
+        guint32 length;
+        guint32 checksum;
+        guint64 offset;
+        guint64 n_chars;
+        gsize n_total;
+
+        memcpy (&length, contents + pos + 1, sizeof length);
+        memcpy (&checksum, contents + pos + 5, sizeof checksum);
+        length = GUINT32_FROM_LE (length);
+        checksum = GUINT32_FROM_LE (checksum);
+        if (length > len - pos - JOURNAL_RECORD_HEADER_SIZE)
+            break;
+
+        payload = (const guchar *) contents + pos + JOURNAL_RECORD_HEADER_SIZE;
+        if (journal_checksum (JOURNAL_CHECKSUM_SEED, payload, length) != checksum)
+            break;
+        pos += JOURNAL_RECORD_HEADER_SIZE + length;
+
+        if (type == RECORD_HEADER && !recovery) {
+            recovery = journal_parse_header (payload, length);
+            if (!recovery)
+                break;
+        } else if (type == RECORD_TEXT && recovery && !table) {
+            GBytes *text;
+
+            if (!g_utf8_validate_len ((const gchar *) payload, length, NULL))
+                break;
+            table = flow_piece_table_new ();
+            text = g_bytes_new (payload, length);
+            flow_piece_table_append_bytes (table, text);
+            g_bytes_unref (text);
+        } else if (type == RECORD_INSERT && table && length >= sizeof offset) {
+            memcpy (&offset, payload, sizeof offset);
+            offset = GUINT64_FROM_LE (offset);
+            if (offset > flow_piece_table_get_char_count (table) ||
+                !g_utf8_validate_len ((const gchar *) payload + sizeof offset, length - sizeof offset, NULL))
+                break;
+            flow_piece_table_insert (table, (gsize) offset, (const gchar *) payload + sizeof offset,
+                                     length - sizeof offset);
+            n_edits++;
+        } else if (type == RECORD_DELETE && table && length == sizeof offset + sizeof n_chars) {
+            memcpy (&offset, payload, sizeof offset);
+            memcpy (&n_chars, payload + sizeof offset, sizeof n_chars);
+            offset = GUINT64_FROM_LE (offset);
+            n_chars = GUINT64_FROM_LE (n_chars);
+            n_total = flow_piece_table_get_char_count (table);
+            if (offset > n_total || n_chars > n_total - offset)
+                break;
+            flow_piece_table_delete (table, (gsize) offset, (gsize) n_chars);
+            n_edits++;
+        } else {
+            break;
+        }
+    }
+
+    if (!table || n_edits == 0) {
+        flow_piece_table_free (table);
+        flow_journal_recovery_free (recovery);
+        return NULL;
+    }
+
+    recovery->text = journal_table_to_bytes (table);
+    flow_piece_table_free (table);
+    return recovery;
+}
+
+static FlowJournalRecovery *
+journal_recover_file (const gchar *path)
+{
+    FlowJournalRecovery *recovery = NULL;
+    gchar *contents;
+    gsize len;
+    gint fd;
+
+    fd = g_open (path, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+        return NULL;
+
+    /* Journals of documents open right now are locked by their writer. */
+    if (flock (fd, LOCK_EX | LOCK_NB) < 0) {
+        g_close (fd, NULL);
+        return NULL;
+    }
+
+    if (g_file_get_contents (path, &contents, &len, NULL)) {
+        recovery = journal_replay (contents, len);
+        g_free (contents);
+    }
+
+    if (recovery)
+        recovery->path = g_strdup (path);
+    else
+        g_unlink (path);
+
+    g_close (fd, NULL);
+    return recovery;
+}
+
+/*
+ * Replays the journals left behind by documents that were never saved or
+ * closed, and returns a #FlowJournalRecovery for each that holds edits.
+ * Journals with nothing to recover are deleted; the others are kept until
+ * a new journal takes over their path.  Blocks; call from a worker.
+ */
+GPtrArray *
+flow_journal_recover (GCancellable *cancellable)
+{
+    GPtrArray *recoveries;
+    gchar *directory;
+    const gchar *name;
+    GDir *dir;
+
+    recoveries = g_ptr_array_new_with_free_func ((GDestroyNotify) flow_journal_recovery_free);
+    directory = journal_get_directory ();
+    dir = g_dir_open (directory, 0, NULL);
+    if (!dir) {
+        g_free (directory);
+        return recoveries;
+    }
+
+    while ((name = g_dir_read_name (dir)) && !g_cancellable_is_cancelled (cancellable)) {
+        gchar *path = g_build_filename (directory, name, NULL);
+
+        if (g_str_has_suffix (name, JOURNAL_TMP_SUFFIX)) {
+            gint fd = g_open (path, O_RDONLY | O_CLOEXEC, 0);
+
+            /* Left over from a compaction that never finished. */
+            if (fd >= 0 && flock (fd, LOCK_EX | LOCK_NB) == 0)
+                g_unlink (path);
+            if (fd >= 0)
+                g_close (fd, NULL);
+        } else if (g_str_has_suffix (name, JOURNAL_SUFFIX)) {
+            FlowJournalRecovery *recovery = journal_recover_file (path);
+
+            if (recovery)
+                g_ptr_array_add (recoveries, recovery);
+        }
+
+        g_free (path);
+    }
+
+    g_dir_close (dir);
+    g_free (directory);
+    return recoveries;
+}
@@ -0,0 +1,80 @@
+/* flow-journal.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "flow-compression.h"
+#include "flow-piece-table.h"
+
+G_BEGIN_DECLS
+
+/*
+ * FlowJournal keeps an append-only record of the unsaved edits to one
+ * document under the user cache directory, so they survive a crash.  The
+ * file starts with a copy of the text the edits apply to, followed by
+ * insert and delete records.  Recording an edit only appends to a memory
+ * buffer; a worker thread writes and fsyncs whatever has accumulated, so
+ * a burst of typing costs one flush.  Compaction replaces the file with
+ * a fresh copy of the text once the edits outgrow it.
+ */
+typedef struct _FlowJournal FlowJournal;
+
+/* Documents larger than this are not journaled: the copy of the text
+ * each journal starts with would cost too much. */
+#define FLOW_JOURNAL_MAX_BASE_SIZE (64 * 1024 * 1024)
+
+typedef struct {
+    gchar *path;
+    gchar *uri;             /* NULL for an untitled document */
+    const gchar *charset;   /* interned */
+    gboolean has_bom;
+    FlowCompression compression;
+    GBytes *text;
+} FlowJournalRecovery;
+
+FlowJournal *flow_journal_new              (const gchar            *path,
+                                            const gchar            *uri,
+                                            const gchar            *charset,
+                                            gboolean                has_bom,
+                                            FlowCompression         compression,
+                                            FlowPieceTableSnapshot *base);
+FlowJournal *flow_journal_ref              (FlowJournal            *journal);
+void         flow_journal_unref            (FlowJournal            *journal);
+
+void         flow_journal_insert           (FlowJournal            *journal,
+                                            gsize                   char_offset,
+                                            const gchar            *text,
+                                            gsize                   len);
+void         flow_journal_delete           (FlowJournal            *journal,
+                                            gsize                   char_offset,
+                                            gsize                   n_chars);
+gboolean     flow_journal_wants_compaction (FlowJournal            *journal);
+void         flow_journal_compact          (FlowJournal            *journal,
+                                            FlowPieceTableSnapshot *snapshot);
+void         flow_journal_discard          (FlowJournal            *journal);
+
+GPtrArray   *flow_journal_recover          (GCancellable           *cancellable);
+void         flow_journal_recovery_free    (FlowJournalRecovery    *recovery);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FlowJournal, flow_journal_unref)
+
+G_END_DECLS
@@ -0,0 +1,239 @@
+/* flow-languages.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Globs come in three kinds.  An exact name ("Makefile") goes into
+ * by_name and a plain extension ("*.c") into by_extension.  Anything else
+ * ("*.[ch]pp", "Makefile.*") is kept as a compiled pattern.  A name that
+ * matches none of those patterns is looked up in the two tables alone.
+ * Otherwise, or when two languages claim one extension, the language
+ * manager decides, and its answer is kept in guessed by name.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "flow-languages.h"
+
+typedef struct {
+    GHashTable *by_name;        /* basename -> GtkSourceLanguage */
+    GHashTable *by_extension;   /* ".ext" -> GtkSourceLanguage, or ambiguous */
+    GPtrArray *patterns;        /* GPatternSpec */
+    GHashTable *guessed;        /* basename -> GtkSourceLanguage or none */
+} LanguageIndex;
+
+/* Markers in the tables, never dereferenced. */
+static gchar ambiguous_marker;
+static gchar none_marker;
+#define LANGUAGE_AMBIGUOUS ((gpointer) &ambiguous_marker)
+#define LANGUAGE_NONE      ((gpointer) &none_marker)
+
+static LanguageIndex *language_index;
+static GHashTable *style_schemes;   /* id -> GtkSourceStyleScheme */
+static gboolean warm_up_started;
+
+static void
+language_index_add_glob (LanguageIndex *index, const gchar *glob, GtkSourceLanguage *language)
+{
+    GHashTable *table = index->by_name;
+    const gchar *key = glob;
+    gpointer existing;
+
+    if (glob[0] == '*' && glob[1] == '.' && !strpbrk (glob + 2, "*?[.")) {
+        table = index->by_extension;
+        key = glob + 1;
+    } else if (strpbrk (glob, "*?[")) {
+        g_ptr_array_add (index->patterns, g_pattern_spec_new (glob));
+        return;
+    }
+
+    existing = g_hash_table_lookup (table, key);
+    if (existing && existing != language)
+        g_hash_table_insert (table, g_strdup (key), LANGUAGE_AMBIGUOUS);
+    else
+        g_hash_table_insert (table, g_strdup (key), language);
+}
+
+static LanguageIndex *
+language_index_get (void)
+{
+    GtkSourceLanguageManager *manager;
+    const gchar * const *ids;
+    guint i, j;
+
+    if (language_index)
+        return language_index;
+
+    language_index = g_new0 (LanguageIndex, 1);
+    language_index->by_name = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    language_index->by_extension = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    language_index->patterns = g_ptr_array_new_with_free_func ((GDestroyNotify) g_pattern_spec_free);
+    language_index->guessed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    manager = gtk_source_language_manager_get_default ();
+    ids = gtk_source_language_manager_get_language_ids (manager);
+    for (i = 0; ids && ids[i]; i++) {
+        GtkSourceLanguage *language = gtk_source_language_manager_get_language (manager, ids[i]);
+        gchar **globs = language ? gtk_source_language_get_globs (language) : NULL;
+
+        for (j = 0; globs && globs[j]; j++)
+            language_index_add_glob (language_index, globs[j], language);
+        g_strfreev (globs);
+    }
+
+    return language_index;
+}
+
+/*
+ * Language for a file called @basename, or NULL for none.  Only the
+ * first name of each kind costs a language manager lookup.
+ */
+GtkSourceLanguage *
+flow_languages_guess (const gchar *basename)
+{
+    LanguageIndex *index = language_index_get ();
+    GtkSourceLanguage *language;
+    const gchar *extension;
+    gpointer found;
+    guint i;
+
+    g_return_val_if_fail (basename != NULL, NULL);
+
+    found = g_hash_table_lookup (index->guessed, basename);
+    if (found)
+        return found == LANGUAGE_NONE ? NULL : found;
+
+    found = g_hash_table_lookup (index->by_name, basename);
+    if (found && found != LANGUAGE_AMBIGUOUS)
+        return found;
+
+    if (!found) {
+        for (i = 0; i < index->patterns->len; i++) {
+            if (g_pattern_spec_match_string (g_ptr_array_index (index->patterns, i), basename)) {
+                found = LANGUAGE_AMBIGUOUS;
+                break;
+            }
+        }
+    }
+
+    if (!found) {
+        extension = strrchr (basename, '.');
+        found = extension ? g_hash_table_lookup (index->by_extension, extension) : NULL;
+        if (found != LANGUAGE_AMBIGUOUS)
+            return found;
+    }
+
+    language = gtk_source_language_manager_guess_language (gtk_source_language_manager_get_default (),
+                                                           basename, NULL);
+    g_hash_table_insert (index->guessed, g_strdup (basename), language ? (gpointer) language : LANGUAGE_NONE);
+    return language;
+}
+
+/* Style scheme @id, or NULL if none is installed by that name. */
+GtkSourceStyleScheme *
+flow_languages_get_style_scheme (const gchar *id)
+{
+    GtkSourceStyleScheme *scheme;
+
+    if (!style_schemes)
+        style_schemes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    scheme = g_hash_table_lookup (style_schemes, id);
+    if (!scheme) {
+        scheme = gtk_source_style_scheme_manager_get_scheme (gtk_source_style_scheme_manager_get_default (), id);
+        if (scheme)
+            g_hash_table_insert (style_schemes, g_strdup (id), scheme);
+    }
+
+    return scheme;
+}
+
+/* Reads every file in @directories so the managers find them cached. */
+static void
+warm_up_worker (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    gchar **directories = task_data;
+    guint i;
+
+    for (i = 0; directories[i]; i++) {
+        GDir *dir = g_dir_open (directories[i], 0, NULL);
+        const gchar *name;
+
+        if (!dir)
+            continue;
+
+        while ((name = g_dir_read_name (dir))) {
+            gchar *path;
+            gchar *contents;
+
+            if (!g_str_has_suffix (name, ".lang") && !g_str_has_suffix (name, ".xml") &&
+                !g_str_has_suffix (name, ".rng"))
+                continue;
+
+            path = g_build_filename (directories[i], name, NULL);
+            if (g_file_get_contents (path, &contents, NULL, NULL))
+                g_free (contents);
+            g_free (path);
+        }
+
+        g_dir_close (dir);
+    }
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static void
+on_warm_up_ready (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    /* The files are in memory now; parsing their headers is quick. */
+    language_index_get ();
+    flow_languages_get_style_scheme ("Adwaita");
+    flow_languages_get_style_scheme ("Adwaita-dark");
+}
+
+/*
+ * Reads the language and style scheme files on a worker thread, then
+ * builds the index, so the first file opened does not wait on either.
+ * Later calls do nothing.
+ */
+void
+flow_languages_warm_up (void)
+{
+    GStrvBuilder *builder;
+    GTask *task;
+
+    if (warm_up_started || language_index)
+        return;
+    warm_up_started = TRUE;
+
+    builder = g_strv_builder_new ();
+    g_strv_builder_addv (builder, (const gchar **) gtk_source_language_manager_get_search_path (
+        gtk_source_language_manager_get_default ()));
+    g_strv_builder_addv (builder, (const gchar **) gtk_source_style_scheme_manager_get_search_path (
+        gtk_source_style_scheme_manager_get_default ()));
+
+    task = g_task_new (NULL, NULL, on_warm_up_ready, NULL);
+    g_task_set_task_data (task, g_strv_builder_end (builder), (GDestroyNotify) g_strfreev);
+    g_task_set_priority (task, G_PRIORITY_LOW);
+    g_task_run_in_thread (task, warm_up_worker);
+    g_object_unref (task);
+    g_strv_builder_unref (builder);
+}
@@ -0,0 +1,39 @@
+/* flow-languages.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtksourceview/gtksource.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Cached lookups of GtkSourceView languages and style schemes, shared by
+ * every window.  The language manager matches a file name against the
+ * globs of each language in turn; these lookups instead go through an
+ * index of those globs by exact name and by extension, built once.  Main
+ * thread only, like the managers themselves.
+ */
+
+void                  flow_languages_warm_up          (void);
+GtkSourceLanguage    *flow_languages_guess            (const gchar *basename);
+GtkSourceStyleScheme *flow_languages_get_style_scheme (const gchar *id);
+
+G_END_DECLS
@@ -0,0 +1,338 @@
+/* flow-line-index.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Line starts are stored in fixed-size blocks: a 64-bit base offset per
+ * block and a 32-bit offset relative to it per line, which halves the
+ * memory of a flat guint64 array while keeping lookups a shift and a
+ * mask.  A block whose lines span more than 4 GiB keeps the odd large
+ * offsets in a side table.
+ *
+ * Scanning relies on memchr(), which the C library vectorizes; appends
+ * larger than PARALLEL_MIN_BYTES are cut into segments that are scanned
+ * concurrently and merged back in order.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "flow-line-index.h"
+
+#define LINE_BLOCK_SHIFT 12
+#define LINE_BLOCK_SIZE (1 << LINE_BLOCK_SHIFT)
+#define LINE_BLOCK_MASK (LINE_BLOCK_SIZE - 1)
+#define LINE_REL_OVERFLOW G_MAXUINT32
+
+#define SEGMENT_SIZE (32 * 1024 * 1024)
+#define PARALLEL_MIN_BYTES (2 * SEGMENT_SIZE)
+
+typedef struct {
+    guint64 base;
+    guint32 rel[LINE_BLOCK_SIZE];
+} LineBlock;
+
+struct _FlowLineIndex
+{
+    gint ref_count;
+    GRWLock lock;
+    GPtrArray *blocks;
+    GHashTable *overflow;   /* line -> offset, for LINE_REL_OVERFLOW entries */
+    guint64 n_lines;
+    guint64 length;
+};
+
+typedef struct {
+    const gchar *data;
+    gsize len;
+    GArray *starts;         /* guint32 line starts, relative to data */
+    gboolean done;
+} ScanSegment;
+
+typedef struct {
+    GMutex mutex;
+    GCond cond;
+    GCancellable *cancellable;
+} ScanJob;
+
+static void
+line_index_push_locked (FlowLineIndex *index, guint64 offset)
+{
+    guint64 line = index->n_lines;
+    LineBlock *block;
+    guint64 rel;
+
+    if ((line & LINE_BLOCK_MASK) == 0) {
+        block = g_new (LineBlock, 1);
+        block->base = offset;
+        g_ptr_array_add (index->blocks, block);
+    } else {
+        block = g_ptr_array_index (index->blocks, index->blocks->len - 1);
+    }
+
+    rel = offset - block->base;
+    if (rel >= LINE_REL_OVERFLOW) {
+        block->rel[line & LINE_BLOCK_MASK] = LINE_REL_OVERFLOW;
+        g_hash_table_insert (index->overflow, g_memdup2 (&line, sizeof line), g_memdup2 (&offset, sizeof offset));
+    } else {
+        block->rel[line & LINE_BLOCK_MASK] = (guint32) rel;
+    }
+
+    index->n_lines++;
+}
+
+static guint64
+line_index_get_locked (FlowLineIndex *index, guint64 line)
+{
+    LineBlock *block = g_ptr_array_index (index->blocks, (guint) (line >> LINE_BLOCK_SHIFT));
+    guint32 rel = block->rel[line & LINE_BLOCK_MASK];
+
+    if (G_UNLIKELY (rel == LINE_REL_OVERFLOW))
+        return *(guint64 *) g_hash_table_lookup (index->overflow, &line);
+
+    return block->base + rel;
+}
+
+FlowLineIndex *
+flow_line_index_new (void)
+{
+    FlowLineIndex *index = g_new0 (FlowLineIndex, 1);
+
+    index->ref_count = 1;
+    g_rw_lock_init (&index->lock);
+    index->blocks = g_ptr_array_new_with_free_func (g_free);
+    index->overflow = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, g_free);
+
+    /* The first line starts at the beginning, even of an empty text. */
+    line_index_push_locked (index, 0);
+
+    return index;
+}
+
+FlowLineIndex *
+flow_line_index_ref (FlowLineIndex *index)
+{
+    g_return_val_if_fail (index != NULL, NULL);
+
+    g_atomic_int_inc (&index->ref_count);
+    return index;
+}
+
+void
+flow_line_index_unref (FlowLineIndex *index)
+{
+    if (!index || !g_atomic_int_dec_and_test (&index->ref_count))
+        return;
+
+    g_ptr_array_unref (index->blocks);
+    g_hash_table_unref (index->overflow);
+    g_rw_lock_clear (&index->lock);
+    g_free (index);
+}
+
+static void
+scan_segment (ScanSegment *segment)
+{
+    const gchar *p = segment->data;
+    const gchar *end = segment->data + segment->len;
+
+    while (p < end) {
+        const gchar *nl = memchr (p, '\n', (gsize) (end - p));
+        guint32 start;
+
+        if (!nl)
+            break;
+
+        start = (guint32) (nl + 1 - segment->data);
+        g_array_append_val (segment->starts, start);
+        p = nl + 1;
+    }
+}
+
+static void
+scan_segment_worker (gpointer data, gpointer user_data)
+{
+    ScanSegment *segment = data;
+    ScanJob *job = user_data;
+
+    if (!g_cancellable_is_cancelled (job->cancellable))
+        scan_segment (segment);
+
+    g_mutex_lock (&job->mutex);
+    segment->done = TRUE;
+    g_cond_broadcast (&job->cond);
+    g_mutex_unlock (&job->mutex);
+}
+
+static void
+line_index_publish (FlowLineIndex *index, ScanSegment *segment)
+{
+    guint64 base;
+    guint i;
+
+    g_rw_lock_writer_lock (&index->lock);
+    base = index->length;
+    for (i = 0; i < segment->starts->len; i++)
+        line_index_push_locked (index, base + g_array_index (segment->starts, guint32, i));
+    index->length = base + segment->len;
+    g_rw_lock_writer_unlock (&index->lock);
+}
+
+/*
+ * Indexes @len more bytes of text, continuing where the previous append
+ * ended.  Blocks until done or @cancellable is triggered, so call it from
+ * a worker thread for large inputs; lookups from other threads see each
+ * segment as soon as it and everything before it has been scanned.
+ */
+void
+flow_line_index_append (FlowLineIndex *index,
+                        const gchar   *data,
+                        gsize          len,
+                        GCancellable  *cancellable)
+{
+    ScanSegment *segments;
+    GThreadPool *pool;
+    ScanJob job;
+    guint n_segments;
+    guint i;
+    gboolean cancelled = FALSE;
+
+    g_return_if_fail (index != NULL);
+    g_return_if_fail (data != NULL || len == 0);
+
+    if (len < PARALLEL_MIN_BYTES) {
+        ScanSegment segment = { data, len, g_array_new (FALSE, FALSE, sizeof (guint32)), FALSE };
+
+        scan_segment (&segment);
+        line_index_publish (index, &segment);
+        g_array_unref (segment.starts);
+        return;
+    }
+
+    n_segments = (guint) ((len + SEGMENT_SIZE - 1) / SEGMENT_SIZE);
+    segments = g_new0 (ScanSegment, n_segments);
+
+    g_mutex_init (&job.mutex);
+    g_cond_init (&job.cond);
+    job.cancellable = cancellable;
+
+    pool = g_thread_pool_new (scan_segment_worker, &job, (gint) g_get_num_processors (), FALSE, NULL);
+    for (i = 0; i < n_segments; i++) {
+        segments[i].data = data + (gsize) i * SEGMENT_SIZE;
+        segments[i].len = MIN ((gsize) SEGMENT_SIZE, len - (gsize) i * SEGMENT_SIZE);
+        segments[i].starts = g_array_new (FALSE, FALSE, sizeof (guint32));
+        g_thread_pool_push (pool, &segments[i], NULL);
+    }
+
+    for (i = 0; i < n_segments && !cancelled; i++) {
+        g_mutex_lock (&job.mutex);
+        while (!segments[i].done)
+            g_cond_wait (&job.cond, &job.mutex);
+        g_mutex_unlock (&job.mutex);
+
+        cancelled = g_cancellable_is_cancelled (cancellable);
+        if (!cancelled)
+            line_index_publish (index, &segments[i]);
+
+        /* Merged segments are no longer needed; free them early. */
+        g_array_set_size (segments[i].starts, 0);
+    }
+
+    /* Drops queued segments after a cancel, and waits for running ones. */
+    g_thread_pool_free (pool, cancelled, TRUE);
+
+    for (i = 0; i < n_segments; i++)
+        g_array_unref (segments[i].starts);
+    g_free (segments);
+    g_cond_clear (&job.cond);
+    g_mutex_clear (&job.mutex);
+}
+
+/* Number of lines seen so far; a text ending in a newline has an empty
+ * last line. */
+guint64
+flow_line_index_get_n_lines (FlowLineIndex *index)
+{
+    guint64 n_lines;
+
+    g_return_val_if_fail (index != NULL, 0);
+
+    g_rw_lock_reader_lock (&index->lock);
+    n_lines = index->n_lines;
+    g_rw_lock_reader_unlock (&index->lock);
+
+    return n_lines;
+}
+
+/* Number of bytes indexed so far. */
+guint64
+flow_line_index_get_length (FlowLineIndex *index)
+{
+    guint64 length;
+
+    g_return_val_if_fail (index != NULL, 0);
+
+    g_rw_lock_reader_lock (&index->lock);
+    length = index->length;
+    g_rw_lock_reader_unlock (&index->lock);
+
+    return length;
+}
+
+/* Byte offset at which @line (0-based) starts, if it has been indexed. */
+gboolean
+flow_line_index_lookup (FlowLineIndex *index, guint64 line, guint64 *offset)
+{
+    gboolean found;
+
+    g_return_val_if_fail (index != NULL, FALSE);
+
+    g_rw_lock_reader_lock (&index->lock);
+    found = line < index->n_lines;
+    if (found && offset)
+        *offset = line_index_get_locked (index, line);
+    g_rw_lock_reader_unlock (&index->lock);
+
+    return found;
+}
+
+/* Line containing byte @offset; offsets past the indexed region map to
+ * the last line seen. */
+guint64
+flow_line_index_get_line_at_offset (FlowLineIndex *index, guint64 offset)
+{
+    guint64 lo, hi;
+
+    g_return_val_if_fail (index != NULL, 0);
+
+    g_rw_lock_reader_lock (&index->lock);
+    lo = 0;
+    hi = index->n_lines;
+    while (hi - lo > 1) {
+        guint64 mid = lo + (hi - lo) / 2;
+        if (line_index_get_locked (index, mid) <= offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    g_rw_lock_reader_unlock (&index->lock);
+
+    return lo;
+}
@@ -0,0 +1,55 @@
+/* flow-line-index.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * FlowLineIndex records the byte offset at which every line of a text
+ * starts.  Text is appended in order; large appends are scanned by a pool
+ * of threads and the results published as they become contiguous, so
+ * readers on other threads see the index grow while it is being built.
+ * Looking up a line is O(1), finding the line of an offset O(log n).
+ */
+typedef struct _FlowLineIndex FlowLineIndex;
+
+FlowLineIndex *flow_line_index_new                (void);
+FlowLineIndex *flow_line_index_ref                (FlowLineIndex *index);
+void           flow_line_index_unref              (FlowLineIndex *index);
+
+void           flow_line_index_append             (FlowLineIndex *index,
+                                                   const gchar   *data,
+                                                   gsize          len,
+                                                   GCancellable  *cancellable);
+
+guint64        flow_line_index_get_n_lines        (FlowLineIndex *index);
+guint64        flow_line_index_get_length         (FlowLineIndex *index);
+gboolean       flow_line_index_lookup             (FlowLineIndex *index,
+                                                   guint64        line,
+                                                   guint64       *offset);
+guint64        flow_line_index_get_line_at_offset (FlowLineIndex *index,
+                                                   guint64        offset);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FlowLineIndex, flow_line_index_unref)
+
+G_END_DECLS
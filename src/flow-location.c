@@ -0,0 +1,112 @@
+/* flow-location.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "flow-location.h"
+
+static gboolean
+location_match (const gchar *text, GMatchInfo **match)
+{
+    GRegex *regex = g_regex_new ("^(.+?):([0-9]+)(?::([0-9]+))?:?$", 0, 0, NULL);
+    gboolean matched = g_regex_match (regex, text, 0, match);
+
+    g_regex_unref (regex);
+    return matched;
+}
+
+/*
+ * Returns the absolute path @arg names when it ends in a location that
+ * GIO would misread as a URI, or NULL when GIO reads it well already.
+ * Real URIs are left alone.
+ */
+gchar *
+flow_location_resolve_arg (const gchar *arg, const gchar *cwd)
+{
+    GMatchInfo *match = NULL;
+    GFile *file;
+    gchar *path;
+    gboolean matched;
+
+    g_return_val_if_fail (arg != NULL, NULL);
+    g_return_val_if_fail (cwd != NULL, NULL);
+
+    matched = location_match (arg, &match);
+    g_match_info_free (match);
+    if (!matched || strstr (arg, "://"))
+        return NULL;
+
+    file = g_file_new_for_commandline_arg_and_cwd (arg, cwd);
+    path = g_file_get_path (file);
+    g_object_unref (file);
+    if (path) {
+        g_free (path);
+        return NULL;
+    }
+
+    return g_canonicalize_filename (arg, cwd);
+}
+
+/*
+ * Splits a trailing ":LINE" or ":LINE:COLUMN" off @file.  A file whose
+ * name really ends that way wins.  @line and @column are 0 when absent.
+ */
+GFile *
+flow_location_split (GFile *file, gint *line, gint *column)
+{
+    GMatchInfo *match = NULL;
+    gchar *path;
+    gchar *name;
+    gchar *line_str;
+    gchar *column_str;
+    GFile *result;
+
+    g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+    *line = 0;
+    *column = 0;
+
+    path = g_file_get_path (file);
+    if (!path)
+        return g_object_ref (file);
+    if (!location_match (path, &match) || g_file_query_exists (file, NULL)) {
+        g_match_info_free (match);
+        g_free (path);
+        return g_object_ref (file);
+    }
+
+    name = g_match_info_fetch (match, 1);
+    line_str = g_match_info_fetch (match, 2);
+    column_str = g_match_info_fetch (match, 3);
+    *line = (gint) MIN (g_ascii_strtoull (line_str, NULL, 10), G_MAXINT);
+    if (column_str && *column_str)
+        *column = (gint) MIN (g_ascii_strtoull (column_str, NULL, 10), G_MAXINT);
+    result = g_file_new_for_path (name);
+
+    g_free (column_str);
+    g_free (line_str);
+    g_free (name);
+    g_match_info_free (match);
+    g_free (path);
+
+    return result;
+}
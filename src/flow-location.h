@@ -0,0 +1,41 @@
+/* flow-location.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * File arguments may end in ":LINE" or ":LINE:COLUMN", as compilers and
+ * grep print locations.  GIO reads a bare "main.c:42" as a URI with the
+ * scheme "main.c", so such an argument is first turned into a path
+ * against the directory it was given in, and the location is split off
+ * the resulting file later.
+ */
+
+gchar *flow_location_resolve_arg (const gchar *arg,
+                                  const gchar *cwd);
+GFile *flow_location_split       (GFile       *file,
+                                  gint        *line,
+                                  gint        *column);
+
+G_END_DECLS
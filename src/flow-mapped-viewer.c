@@ -0,0 +1,928 @@
+/* flow-mapped-viewer.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * A read-only viewer for files too large for a GtkTextBuffer.  The file is
+ * memory-mapped and never copied; only the lines in the visible window are
+ * turned into text for drawing.  A worker thread builds a FlowLineIndex
+ * over the mapping, so jumping to any indexed line is a single lookup.
+ *
+ * In hex mode, used for binary files, a "line" is a row of
+ * HEX_BYTES_PER_ROW bytes and no index is needed; the kernel pages in
+ * only the part of the mapping being drawn.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "flow-line-index.h"
+#include "flow-mapped-viewer.h"
+
+#define MAX_DISPLAY_LINE_BYTES 4096
+#define HEX_BYTES_PER_ROW 16
+#define INDEX_POLL_INTERVAL_MS 100
+
+typedef struct {
+    gint ref_count;
+    GMappedFile *mapped;
+    GCancellable *cancellable;
+    FlowLineIndex *lines;
+    gint done;
+} ViewerIndex;
+
+typedef struct {
+    GMappedFile *mapped;
+    gchar *needle;
+    gsize needle_len;
+    guint64 from;
+} ViewerSearchJob;
+
+struct _FlowMappedViewer
+{
+    GtkWidget parent_instance;
+
+    GtkWidget *toolbar;
+    GtkWidget *search_entry;
+    GtkWidget *line_entry;
+    GtkWidget *info_label;
+    GtkWidget *canvas;
+    GtkWidget *scrollbar;
+    GtkAdjustment *adjustment;
+
+    GMappedFile *mapped;
+    const gchar *data;
+    gsize size;
+    gboolean hex;
+
+    ViewerIndex *index;
+    guint index_poll_id;
+
+    GCancellable *search_cancellable;
+    gboolean has_match;
+    guint64 match_offset;
+    gsize match_len;
+
+    gint line_height;
+    guint visible_rows;
+};
+
+G_DEFINE_FINAL_TYPE (FlowMappedViewer, flow_mapped_viewer, GTK_TYPE_WIDGET)
+
+enum {
+    PROP_0,
+    PROP_TOP_LINE,
+    PROP_N_LINES,
+    PROP_INDEXING,
+    N_PROPS
+};
+
+static GParamSpec *properties[N_PROPS];
+
+static ViewerIndex *
+viewer_index_new (GMappedFile *mapped)
+{
+    ViewerIndex *index = g_new0 (ViewerIndex, 1);
+
+    index->ref_count = 1;
+    index->mapped = g_mapped_file_ref (mapped);
+    index->cancellable = g_cancellable_new ();
+    index->lines = flow_line_index_new ();
+
+    return index;
+}
+
+static ViewerIndex *
+viewer_index_ref (ViewerIndex *index)
+{
+    g_atomic_int_inc (&index->ref_count);
+    return index;
+}
+
+static void
+viewer_index_unref (ViewerIndex *index)
+{
+    if (!index || !g_atomic_int_dec_and_test (&index->ref_count))
+        return;
+
+    flow_line_index_unref (index->lines);
+    g_object_unref (index->cancellable);
+    g_mapped_file_unref (index->mapped);
+    g_free (index);
+}
+
+static void
+viewer_index_worker (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    ViewerIndex *index = task_data;
+
+    (void)source_object;
+
+    flow_line_index_append (index->lines,
+                            g_mapped_file_get_contents (index->mapped),
+                            g_mapped_file_get_length (index->mapped),
+                            cancellable);
+
+    g_atomic_int_set (&index->done, TRUE);
+    g_task_return_boolean (task, TRUE);
+}
+
+guint64
+flow_mapped_viewer_get_n_lines (FlowMappedViewer *self)
+{
+    guint64 n_lines;
+
+    g_return_val_if_fail (FLOW_IS_MAPPED_VIEWER (self), 0);
+
+    if (self->hex)
+        return self->mapped ? MAX ((self->size + HEX_BYTES_PER_ROW - 1) / HEX_BYTES_PER_ROW, 1) : 0;
+
+    if (!self->index)
+        return 0;
+
+    n_lines = flow_line_index_get_n_lines (self->index->lines);
+
+    /* A trailing newline does not start another line. */
+    if (g_atomic_int_get (&self->index->done) && n_lines > 1 &&
+        self->size > 0 && self->data[self->size - 1] == '\n')
+        n_lines--;
+
+    return n_lines;
+}
+
+gboolean
+flow_mapped_viewer_get_indexing (FlowMappedViewer *self)
+{
+    g_return_val_if_fail (FLOW_IS_MAPPED_VIEWER (self), FALSE);
+
+    if (!self->index)
+        return FALSE;
+
+    return !g_atomic_int_get (&self->index->done);
+}
+
+guint64
+flow_mapped_viewer_get_top_line (FlowMappedViewer *self)
+{
+    g_return_val_if_fail (FLOW_IS_MAPPED_VIEWER (self), 0);
+
+    return (guint64) gtk_adjustment_get_value (self->adjustment);
+}
+
+/* Whether a file has been loaded and lines can be addressed. */
+static gboolean
+viewer_is_ready (FlowMappedViewer *self)
+{
+    return self->hex ? self->mapped != NULL : self->index != NULL;
+}
+
+/* Byte offset where @line starts, or the end of the file if it is past
+ * the indexed region. */
+static gsize
+viewer_line_start (FlowMappedViewer *self, guint64 line)
+{
+    guint64 offset;
+
+    if (self->hex)
+        return (gsize) MIN (line * HEX_BYTES_PER_ROW, (guint64) self->size);
+
+    if (!flow_line_index_lookup (self->index->lines, line, &offset))
+        return self->size;
+
+    return (gsize) MIN (offset, (guint64) self->size);
+}
+
+/* Byte offset of the first visible line. */
+guint64
+flow_mapped_viewer_get_top_offset (FlowMappedViewer *self)
+{
+    g_return_val_if_fail (FLOW_IS_MAPPED_VIEWER (self), 0);
+
+    if (!viewer_is_ready (self))
+        return 0;
+
+    return viewer_line_start (self, flow_mapped_viewer_get_top_line (self));
+}
+
+static guint64
+viewer_offset_to_line (FlowMappedViewer *self, gsize offset)
+{
+    if (self->hex)
+        return offset / HEX_BYTES_PER_ROW;
+
+    return flow_line_index_get_line_at_offset (self->index->lines, offset);
+}
+
+static void
+viewer_update_info (FlowMappedViewer *self)
+{
+    gchar *text;
+    guint64 n_lines = flow_mapped_viewer_get_n_lines (self);
+
+    if (self->hex) {
+        gchar *size = g_format_size (self->size);
+        text = g_strdup_printf ("%s, read-only", size);
+        gtk_label_set_text (GTK_LABEL (self->info_label), text);
+        g_free (text);
+        g_free (size);
+        return;
+    }
+
+    if (flow_mapped_viewer_get_indexing (self))
+        text = g_strdup_printf ("Indexing… %" G_GUINT64_FORMAT " lines", n_lines);
+    else
+        text = g_strdup_printf ("%" G_GUINT64_FORMAT " lines, read-only", n_lines);
+    gtk_label_set_text (GTK_LABEL (self->info_label), text);
+    g_free (text);
+}
+
+static void
+viewer_sync_adjustment (FlowMappedViewer *self)
+{
+    gdouble n_lines = (gdouble) flow_mapped_viewer_get_n_lines (self);
+
+    gtk_adjustment_configure (self->adjustment,
+                              gtk_adjustment_get_value (self->adjustment),
+                              0,
+                              n_lines + MAX (self->visible_rows, 1) - 1,
+                              1,
+                              MAX (self->visible_rows, 1),
+                              MAX (self->visible_rows, 1));
+}
+
+static gboolean
+viewer_index_poll (gpointer user_data)
+{
+    FlowMappedViewer *self = FLOW_MAPPED_VIEWER (user_data);
+    gboolean indexing = flow_mapped_viewer_get_indexing (self);
+
+    viewer_sync_adjustment (self);
+    viewer_update_info (self);
+    gtk_widget_queue_draw (self->canvas);
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_LINES]);
+
+    if (indexing)
+        return G_SOURCE_CONTINUE;
+
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_INDEXING]);
+    self->index_poll_id = 0;
+    return G_SOURCE_REMOVE;
+}
+
+static void
+viewer_set_top_line (FlowMappedViewer *self, gdouble line)
+{
+    gdouble max = (gdouble) flow_mapped_viewer_get_n_lines (self) - 1;
+
+    gtk_adjustment_set_value (self->adjustment, CLAMP (line, 0, MAX (max, 0)));
+}
+
+void
+flow_mapped_viewer_goto_line (FlowMappedViewer *self, guint64 line)
+{
+    g_return_if_fail (FLOW_IS_MAPPED_VIEWER (self));
+
+    if (!viewer_is_ready (self))
+        return;
+
+    /* Leave a little context above the target line. */
+    viewer_set_top_line (self, (gdouble) line - MIN (line, self->visible_rows / 3));
+}
+
+static gint
+viewer_measure_line_height (FlowMappedViewer *self)
+{
+    PangoLayout *layout;
+    gint height;
+
+    layout = gtk_widget_create_pango_layout (self->canvas, "Xg");
+    pango_layout_get_pixel_size (layout, NULL, &height);
+    g_object_unref (layout);
+
+    return MAX (height, 1);
+}
+
+static void
+viewer_append_line (GString *text, const gchar *line, gsize len)
+{
+    const gchar *end;
+
+    if (len > 0 && line[len - 1] == '\r')
+        len--;
+
+    if (g_utf8_validate_len (line, len, &end)) {
+        g_string_append_len (text, line, (gssize) len);
+    } else {
+        gchar *valid = g_utf8_make_valid (line, (gssize) len);
+        g_string_append (text, valid);
+        g_free (valid);
+    }
+}
+
+static void
+viewer_highlight (PangoAttrList *attrs, guint start, guint end)
+{
+    PangoAttribute *attr;
+
+    attr = pango_attr_background_new (0xffff, 0xd700, 0x0000);
+    attr->start_index = start;
+    attr->end_index = end;
+    pango_attr_list_insert (attrs, attr);
+    attr = pango_attr_foreground_new (0x0000, 0x0000, 0x0000);
+    attr->start_index = start;
+    attr->end_index = end;
+    pango_attr_list_insert (attrs, attr);
+}
+
+/* Column of byte @i of a row in the hex pane; the two halves of a row are
+ * separated by an extra space. */
+static guint
+hex_column (guint i)
+{
+    return i * 3 + (i >= HEX_BYTES_PER_ROW / 2 ? 1 : 0);
+}
+
+/* Rows of "offset  hex bytes  |ascii|"; only the visible rows are read. */
+static void
+viewer_draw_hex (FlowMappedViewer *self, GString *text, PangoAttrList **attrs)
+{
+    static const gchar hex_digits[] = "0123456789abcdef";
+    guint64 top = flow_mapped_viewer_get_top_line (self);
+    guint64 n_rows = flow_mapped_viewer_get_n_lines (self);
+    gint digits = MAX (8, g_snprintf (NULL, 0, "%" G_GINT64_MODIFIER "x", (guint64) self->size));
+    guint64 row;
+
+    for (row = top; row < n_rows && row <= top + self->visible_rows; row++) {
+        guint64 offset = row * HEX_BYTES_PER_ROW;
+        const guchar *bytes = (const guchar *) self->data + offset;
+        guint count = (guint) MIN ((guint64) HEX_BYTES_PER_ROW, (guint64) self->size - offset);
+        gsize hex_start;
+        gsize ascii_start;
+        guint i;
+
+        g_string_append_printf (text, "%0*" G_GINT64_MODIFIER "x  ", digits, offset);
+        hex_start = text->len;
+        for (i = 0; i < HEX_BYTES_PER_ROW; i++) {
+            if (i == HEX_BYTES_PER_ROW / 2)
+                g_string_append_c (text, ' ');
+            if (i < count) {
+                g_string_append_c (text, hex_digits[bytes[i] >> 4]);
+                g_string_append_c (text, hex_digits[bytes[i] & 0xF]);
+                g_string_append_c (text, ' ');
+            } else {
+                g_string_append (text, "   ");
+            }
+        }
+
+        g_string_append (text, " |");
+        ascii_start = text->len;
+        for (i = 0; i < count; i++)
+            g_string_append_c (text, bytes[i] >= 0x20 && bytes[i] < 0x7F ? (gchar) bytes[i] : '.');
+        g_string_append (text, "|\n");
+
+        if (self->has_match &&
+            self->match_offset < offset + count &&
+            self->match_offset + self->match_len > offset) {
+            guint first = (guint) (MAX (self->match_offset, offset) - offset);
+            guint last = (guint) (MIN (self->match_offset + self->match_len, offset + count) - offset);
+
+            if (!*attrs)
+                *attrs = pango_attr_list_new ();
+            viewer_highlight (*attrs, (guint) hex_start + hex_column (first),
+                              (guint) hex_start + hex_column (last - 1) + 2);
+            viewer_highlight (*attrs, (guint) ascii_start + first, (guint) ascii_start + last);
+        }
+    }
+}
+
+static void
+viewer_draw (GtkDrawingArea *area, cairo_t *cr, int width, int height, gpointer user_data)
+{
+    FlowMappedViewer *self = FLOW_MAPPED_VIEWER (user_data);
+    const gchar *end;
+    const gchar *p;
+    GString *text;
+    PangoLayout *layout;
+    PangoAttrList *attrs = NULL;
+    GdkRGBA color;
+    guint64 top, n_lines, line;
+    gint digits;
+    guint row;
+
+    (void)width;
+    (void)height;
+
+    if (!viewer_is_ready (self))
+        return;
+
+    text = g_string_new (NULL);
+    if (self->hex) {
+        viewer_draw_hex (self, text, &attrs);
+        goto show;
+    }
+
+    top = flow_mapped_viewer_get_top_line (self);
+    n_lines = flow_mapped_viewer_get_n_lines (self);
+    digits = MAX (4, g_snprintf (NULL, 0, "%" G_GUINT64_FORMAT, n_lines));
+    end = self->data + self->size;
+    p = self->data + viewer_line_start (self, top);
+
+    for (row = 0, line = top; row <= self->visible_rows && line < n_lines; row++, line++) {
+        const gchar *nl = memchr (p, '\n', (gsize) (end - p));
+        const gchar *line_end = nl ? nl : end;
+        gsize shown = MIN ((gsize) (line_end - p), MAX_DISPLAY_LINE_BYTES);
+        gsize text_start;
+
+        g_string_append_printf (text, "%*" G_GUINT64_FORMAT "  ", digits, line + 1);
+        text_start = text->len;
+        viewer_append_line (text, p, shown);
+
+        if (self->has_match &&
+            self->match_offset >= (guint64) (p - self->data) &&
+            self->match_offset + self->match_len <= (guint64) (p - self->data) + shown) {
+            guint start_index = (guint) (text_start + (self->match_offset - (guint64) (p - self->data)));
+
+            attrs = pango_attr_list_new ();
+            viewer_highlight (attrs, start_index, start_index + (guint) self->match_len);
+        }
+
+        g_string_append_c (text, '\n');
+        if (!nl)
+            break;
+        p = nl + 1;
+    }
+
+show:
+    layout = gtk_widget_create_pango_layout (GTK_WIDGET (area), text->str);
+    if (attrs) {
+        pango_layout_set_attributes (layout, attrs);
+        pango_attr_list_unref (attrs);
+    }
+
+    gtk_widget_get_color (GTK_WIDGET (area), &color);
+    gdk_cairo_set_source_rgba (cr, &color);
+    cairo_move_to (cr, 12, 0);
+    pango_cairo_show_layout (cr, layout);
+
+    g_object_unref (layout);
+    g_string_free (text, TRUE);
+}
+
+static void
+viewer_canvas_resize (GtkDrawingArea *area, int width, int height, gpointer user_data)
+{
+    FlowMappedViewer *self = FLOW_MAPPED_VIEWER (user_data);
+
+    (void)area;
+    (void)width;
+
+    self->line_height = viewer_measure_line_height (self);
+    self->visible_rows = (guint) MAX (height / self->line_height, 1);
+    if (viewer_is_ready (self))
+        viewer_sync_adjustment (self);
+}
+
+static void
+viewer_adjustment_value_changed (GtkAdjustment *adjustment, FlowMappedViewer *self)
+{
+    (void)adjustment;
+
+    gtk_widget_queue_draw (self->canvas);
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_TOP_LINE]);
+}
+
+static gboolean
+viewer_scroll (GtkEventControllerScroll *controller, gdouble dx, gdouble dy, FlowMappedViewer *self)
+{
+    (void)controller;
+    (void)dx;
+
+    viewer_set_top_line (self, gtk_adjustment_get_value (self->adjustment) + dy * 3);
+    return TRUE;
+}
+
+static gboolean
+viewer_key_pressed (GtkEventControllerKey *controller, guint keyval, guint keycode,
+                    GdkModifierType state, FlowMappedViewer *self)
+{
+    gdouble value = gtk_adjustment_get_value (self->adjustment);
+    gdouble page = MAX (self->visible_rows, 2) - 1;
+
+    (void)controller;
+    (void)keycode;
+    (void)state;
+
+    switch (keyval) {
+        case GDK_KEY_Up:
+            viewer_set_top_line (self, value - 1);
+            return TRUE;
+        case GDK_KEY_Down:
+            viewer_set_top_line (self, value + 1);
+            return TRUE;
+        case GDK_KEY_Page_Up:
+            viewer_set_top_line (self, value - page);
+            return TRUE;
+        case GDK_KEY_Page_Down:
+            viewer_set_top_line (self, value + page);
+            return TRUE;
+        case GDK_KEY_Home:
+            viewer_set_top_line (self, 0);
+            return TRUE;
+        case GDK_KEY_End:
+            viewer_set_top_line (self, (gdouble) flow_mapped_viewer_get_n_lines (self));
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+static void
+viewer_search_job_free (ViewerSearchJob *job)
+{
+    g_mapped_file_unref (job->mapped);
+    g_free (job->needle);
+    g_free (job);
+}
+
+static const gchar *
+find_bytes (const gchar *haystack, gsize haystack_len, const gchar *needle, gsize needle_len,
+            GCancellable *cancellable)
+{
+    const gchar *p = haystack;
+    const gchar *last;
+    guint checks = 0;
+
+    if (needle_len == 0 || haystack_len < needle_len)
+        return NULL;
+
+    last = haystack + haystack_len - needle_len;
+    while (p <= last) {
+        p = memchr (p, needle[0], (gsize) (last - p) + 1);
+        if (!p)
+            return NULL;
+        if (memcmp (p, needle, needle_len) == 0)
+            return p;
+        if (++checks % 65536 == 0 && g_cancellable_is_cancelled (cancellable))
+            return NULL;
+        p++;
+    }
+
+    return NULL;
+}
+
+static void
+viewer_search_worker (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    ViewerSearchJob *job = task_data;
+    const gchar *data = g_mapped_file_get_contents (job->mapped);
+    gsize size = g_mapped_file_get_length (job->mapped);
+    gsize from = (gsize) MIN (job->from, size);
+    const gchar *match;
+
+    (void)source_object;
+
+    match = find_bytes (data + from, size - from, job->needle, job->needle_len, cancellable);
+    if (!match && from > 0)
+        match = find_bytes (data, MIN (size, from + job->needle_len - 1),
+                            job->needle, job->needle_len, cancellable);
+
+    if (g_task_return_error_if_cancelled (task))
+        return;
+
+    g_task_return_int (task, match ? (gssize) (match - data) : -1);
+}
+
+static void
+viewer_search_completed (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    FlowMappedViewer *self = FLOW_MAPPED_VIEWER (source_object);
+    ViewerSearchJob *job = g_task_get_task_data (G_TASK (res));
+    GError *error = NULL;
+    gssize offset;
+
+    (void)user_data;
+
+    offset = g_task_propagate_int (G_TASK (res), &error);
+    if (error) {
+        g_error_free (error);
+        return;
+    }
+
+    if (!viewer_is_ready (self))
+        return;
+
+    if (offset < 0) {
+        self->has_match = FALSE;
+        gtk_label_set_text (GTK_LABEL (self->info_label), "Not found");
+        gtk_widget_queue_draw (self->canvas);
+        return;
+    }
+
+    self->has_match = TRUE;
+    self->match_offset = (guint64) offset;
+    self->match_len = job->needle_len;
+    viewer_update_info (self);
+    flow_mapped_viewer_goto_line (self, viewer_offset_to_line (self, (gsize) offset));
+    gtk_widget_queue_draw (self->canvas);
+}
+
+void
+flow_mapped_viewer_find (FlowMappedViewer *self, const gchar *needle)
+{
+    ViewerSearchJob *job;
+    GTask *task;
+
+    g_return_if_fail (FLOW_IS_MAPPED_VIEWER (self));
+
+    if (!self->mapped || !needle || !*needle)
+        return;
+
+    if (self->search_cancellable) {
+        g_cancellable_cancel (self->search_cancellable);
+        g_object_unref (self->search_cancellable);
+    }
+    self->search_cancellable = g_cancellable_new ();
+
+    job = g_new0 (ViewerSearchJob, 1);
+    job->mapped = g_mapped_file_ref (self->mapped);
+    job->needle = g_strdup (needle);
+    job->needle_len = strlen (needle);
+    if (self->has_match)
+        job->from = self->match_offset + 1;
+    else
+        job->from = viewer_line_start (self, flow_mapped_viewer_get_top_line (self));
+
+    gtk_label_set_text (GTK_LABEL (self->info_label), "Searching…");
+
+    task = g_task_new (self, self->search_cancellable, viewer_search_completed, NULL);
+    g_task_set_task_data (task, job, (GDestroyNotify) viewer_search_job_free);
+    g_task_run_in_thread (task, viewer_search_worker);
+    g_object_unref (task);
+}
+
+static void
+on_search_activate (GtkSearchEntry *entry, FlowMappedViewer *self)
+{
+    flow_mapped_viewer_find (self, gtk_editable_get_text (GTK_EDITABLE (entry)));
+}
+
+static void
+on_search_changed (GtkSearchEntry *entry, FlowMappedViewer *self)
+{
+    (void)entry;
+
+    self->has_match = FALSE;
+    gtk_widget_queue_draw (self->canvas);
+}
+
+static void
+on_line_activate (GtkEntry *entry, FlowMappedViewer *self)
+{
+    const gchar *text = gtk_editable_get_text (GTK_EDITABLE (entry));
+
+    if (self->hex) {
+        /* Byte offsets, decimal or 0x-prefixed hex. */
+        guint64 offset = g_ascii_strtoull (text, NULL, 0);
+        flow_mapped_viewer_goto_line (self, viewer_offset_to_line (self, (gsize) MIN (offset, (guint64) self->size)));
+    } else {
+        guint64 line = g_ascii_strtoull (text, NULL, 10);
+        if (line > 0)
+            flow_mapped_viewer_goto_line (self, line - 1);
+    }
+    gtk_widget_grab_focus (self->canvas);
+}
+
+gboolean
+flow_mapped_viewer_load (FlowMappedViewer *self, GFile *file, GError **error)
+{
+    gchar *path;
+    GTask *task;
+
+    g_return_val_if_fail (FLOW_IS_MAPPED_VIEWER (self), FALSE);
+    g_return_val_if_fail (self->mapped == NULL, FALSE);
+
+    path = g_file_get_path (file);
+    if (!path) {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                             "Only local files can be opened in the viewer");
+        return FALSE;
+    }
+
+    self->mapped = g_mapped_file_new (path, FALSE, error);
+    g_free (path);
+    if (!self->mapped)
+        return FALSE;
+
+    self->data = g_mapped_file_get_contents (self->mapped);
+    self->size = g_mapped_file_get_length (self->mapped);
+
+    if (self->hex) {
+        viewer_sync_adjustment (self);
+        viewer_update_info (self);
+        g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_LINES]);
+        return TRUE;
+    }
+
+    self->index = viewer_index_new (self->mapped);
+
+    task = g_task_new (NULL, self->index->cancellable, NULL, NULL);
+    g_task_set_task_data (task, viewer_index_ref (self->index), (GDestroyNotify) viewer_index_unref);
+    g_task_run_in_thread (task, viewer_index_worker);
+    g_object_unref (task);
+
+    self->index_poll_id = g_timeout_add (INDEX_POLL_INTERVAL_MS, viewer_index_poll, self);
+    viewer_sync_adjustment (self);
+    viewer_update_info (self);
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_INDEXING]);
+
+    return TRUE;
+}
+
+static void
+flow_mapped_viewer_dispose (GObject *object)
+{
+    FlowMappedViewer *self = FLOW_MAPPED_VIEWER (object);
+    GtkWidget *child;
+
+    if (self->index_poll_id) {
+        g_source_remove (self->index_poll_id);
+        self->index_poll_id = 0;
+    }
+
+    if (self->index) {
+        g_cancellable_cancel (self->index->cancellable);
+        g_clear_pointer (&self->index, viewer_index_unref);
+    }
+
+    if (self->search_cancellable) {
+        g_cancellable_cancel (self->search_cancellable);
+        g_clear_object (&self->search_cancellable);
+    }
+
+    g_clear_pointer (&self->mapped, g_mapped_file_unref);
+    self->data = NULL;
+    self->size = 0;
+
+    while ((child = gtk_widget_get_first_child (GTK_WIDGET (self))))
+        gtk_widget_unparent (child);
+
+    g_clear_object (&self->adjustment);
+
+    G_OBJECT_CLASS (flow_mapped_viewer_parent_class)->dispose (object);
+}
+
+static void
+flow_mapped_viewer_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+    FlowMappedViewer *self = FLOW_MAPPED_VIEWER (object);
+
+    switch (prop_id) {
+        case PROP_TOP_LINE:
+            g_value_set_uint64 (value, flow_mapped_viewer_get_top_line (self));
+            break;
+        case PROP_N_LINES:
+            g_value_set_uint64 (value, flow_mapped_viewer_get_n_lines (self));
+            break;
+        case PROP_INDEXING:
+            g_value_set_boolean (value, flow_mapped_viewer_get_indexing (self));
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+flow_mapped_viewer_class_init (FlowMappedViewerClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+    GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+    object_class->dispose = flow_mapped_viewer_dispose;
+    object_class->get_property = flow_mapped_viewer_get_property;
+
+    properties[PROP_TOP_LINE] =
+        g_param_spec_uint64 ("top-line", NULL, NULL, 0, G_MAXUINT64, 0,
+                             G_PARAM_READABLE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+    properties[PROP_N_LINES] =
+        g_param_spec_uint64 ("n-lines", NULL, NULL, 0, G_MAXUINT64, 0,
+                             G_PARAM_READABLE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+    properties[PROP_INDEXING] =
+        g_param_spec_boolean ("indexing", NULL, NULL, FALSE,
+                              G_PARAM_READABLE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+    g_object_class_install_properties (object_class, N_PROPS, properties);
+
+    gtk_widget_class_set_layout_manager_type (widget_class, GTK_TYPE_BOX_LAYOUT);
+}
+
+static void
+flow_mapped_viewer_init (FlowMappedViewer *self)
+{
+    GtkWidget *body;
+    GtkEventController *scroll;
+    GtkEventController *keys;
+
+    gtk_orientable_set_orientation (GTK_ORIENTABLE (gtk_widget_get_layout_manager (GTK_WIDGET (self))),
+                                    GTK_ORIENTATION_VERTICAL);
+
+    self->toolbar = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 8);
+    gtk_widget_set_margin_start (self->toolbar, 12);
+    gtk_widget_set_margin_end (self->toolbar, 12);
+    gtk_widget_set_margin_top (self->toolbar, 6);
+    gtk_widget_set_margin_bottom (self->toolbar, 6);
+
+    self->search_entry = gtk_search_entry_new ();
+    gtk_search_entry_set_placeholder_text (GTK_SEARCH_ENTRY (self->search_entry), "Find in file…");
+    gtk_widget_set_hexpand (self->search_entry, TRUE);
+    g_signal_connect (self->search_entry, "activate", G_CALLBACK (on_search_activate), self);
+    g_signal_connect (self->search_entry, "search-changed", G_CALLBACK (on_search_changed), self);
+    gtk_box_append (GTK_BOX (self->toolbar), self->search_entry);
+
+    self->line_entry = gtk_entry_new ();
+    gtk_entry_set_placeholder_text (GTK_ENTRY (self->line_entry), "Go to line");
+    gtk_entry_set_input_purpose (GTK_ENTRY (self->line_entry), GTK_INPUT_PURPOSE_DIGITS);
+    gtk_editable_set_width_chars (GTK_EDITABLE (self->line_entry), 12);
+    g_signal_connect (self->line_entry, "activate", G_CALLBACK (on_line_activate), self);
+    gtk_box_append (GTK_BOX (self->toolbar), self->line_entry);
+
+    self->info_label = gtk_label_new (NULL);
+    gtk_widget_add_css_class (self->info_label, "dim-label");
+    gtk_box_append (GTK_BOX (self->toolbar), self->info_label);
+
+    gtk_widget_set_parent (self->toolbar, GTK_WIDGET (self));
+
+    self->adjustment = g_object_ref_sink (gtk_adjustment_new (0, 0, 1, 1, 1, 1));
+    g_signal_connect (self->adjustment, "value-changed", G_CALLBACK (viewer_adjustment_value_changed), self);
+
+    self->canvas = gtk_drawing_area_new ();
+    gtk_widget_set_hexpand (self->canvas, TRUE);
+    gtk_widget_set_vexpand (self->canvas, TRUE);
+    gtk_widget_set_focusable (self->canvas, TRUE);
+    gtk_widget_set_focus_on_click (self->canvas, TRUE);
+    gtk_widget_add_css_class (self->canvas, "view");
+    gtk_widget_add_css_class (self->canvas, "monospace");
+    gtk_drawing_area_set_draw_func (GTK_DRAWING_AREA (self->canvas), viewer_draw, self, NULL);
+    g_signal_connect (self->canvas, "resize", G_CALLBACK (viewer_canvas_resize), self);
+
+    scroll = gtk_event_controller_scroll_new (GTK_EVENT_CONTROLLER_SCROLL_VERTICAL);
+    g_signal_connect (scroll, "scroll", G_CALLBACK (viewer_scroll), self);
+    gtk_widget_add_controller (self->canvas, scroll);
+
+    keys = gtk_event_controller_key_new ();
+    g_signal_connect (keys, "key-pressed", G_CALLBACK (viewer_key_pressed), self);
+    gtk_widget_add_controller (self->canvas, keys);
+
+    self->scrollbar = gtk_scrollbar_new (GTK_ORIENTATION_VERTICAL, self->adjustment);
+
+    body = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
+    gtk_widget_set_vexpand (body, TRUE);
+    gtk_box_append (GTK_BOX (body), self->canvas);
+    gtk_box_append (GTK_BOX (body), self->scrollbar);
+    gtk_widget_set_parent (body, GTK_WIDGET (self));
+
+    self->line_height = 1;
+    self->visible_rows = 1;
+}
+
+GtkWidget *
+flow_mapped_viewer_new (void)
+{
+    return g_object_new (FLOW_TYPE_MAPPED_VIEWER, NULL);
+}
+
+/* A viewer showing the file as rows of hex bytes, for binary files. */
+GtkWidget *
+flow_mapped_viewer_new_hex (void)
+{
+    FlowMappedViewer *self = g_object_new (FLOW_TYPE_MAPPED_VIEWER, NULL);
+
+    self->hex = TRUE;
+    gtk_entry_set_placeholder_text (GTK_ENTRY (self->line_entry), "Go to offset");
+    gtk_entry_set_input_purpose (GTK_ENTRY (self->line_entry), GTK_INPUT_PURPOSE_FREE_FORM);
+
+    return GTK_WIDGET (self);
+}
+
+gboolean
+flow_mapped_viewer_get_hex (FlowMappedViewer *self)
+{
+    g_return_val_if_fail (FLOW_IS_MAPPED_VIEWER (self), FALSE);
+
+    return self->hex;
+}
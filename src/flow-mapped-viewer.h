@@ -0,0 +1,46 @@
+/* flow-mapped-viewer.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define FLOW_TYPE_MAPPED_VIEWER (flow_mapped_viewer_get_type())
+
+G_DECLARE_FINAL_TYPE (FlowMappedViewer, flow_mapped_viewer, FLOW, MAPPED_VIEWER, GtkWidget)
+
+GtkWidget *flow_mapped_viewer_new           (void);
+GtkWidget *flow_mapped_viewer_new_hex       (void);
+gboolean   flow_mapped_viewer_load          (FlowMappedViewer  *self,
+                                             GFile             *file,
+                                             GError           **error);
+void       flow_mapped_viewer_goto_line     (FlowMappedViewer  *self,
+                                             guint64            line);
+void       flow_mapped_viewer_find          (FlowMappedViewer  *self,
+                                             const gchar       *needle);
+guint64    flow_mapped_viewer_get_top_line  (FlowMappedViewer  *self);
+guint64    flow_mapped_viewer_get_top_offset (FlowMappedViewer *self);
+guint64    flow_mapped_viewer_get_n_lines   (FlowMappedViewer  *self);
+gboolean   flow_mapped_viewer_get_indexing  (FlowMappedViewer  *self);
+gboolean   flow_mapped_viewer_get_hex       (FlowMappedViewer  *self);
+
+G_END_DECLS
@@ -0,0 +1,547 @@
+/* flow-piece-table.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * The piece tree is a treap ordered by document position.  Every node
+ * carries one piece plus byte, character and newline totals for its
+ * subtree, which is what makes offset and line lookups logarithmic.
+ * Updates copy the path from the root to the change and share every other
+ * subtree with the previous version (reference counted), so old roots stay
+ * valid as snapshots.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "flow-piece-table.h"
+
+/* Size of each block of the append-only buffer for typed text. */
+#define ADD_BLOCK_SIZE (64 * 1024)
+/* Loaded chunks are split into pieces of at most this many bytes, which
+ * bounds the cost of finding a character offset inside one piece. */
+#define MAX_APPEND_PIECE (64 * 1024)
+
+typedef struct _PieceNode PieceNode;
+
+struct _PieceNode
+{
+    gint ref_count;
+    guint32 priority;
+    PieceNode *left;
+    PieceNode *right;
+
+    GBytes *bytes;
+    gsize offset;
+    gsize len;
+    gsize chars;
+    gsize newlines;
+
+    gsize total_len;
+    gsize total_chars;
+    gsize total_newlines;
+};
+
+struct _FlowPieceTable
+{
+    PieceNode *root;
+
+    GBytes *add_block;
+    gchar *add_data;
+    gsize add_used;
+    gsize add_capacity;
+};
+
+struct _FlowPieceTableSnapshot
+{
+    gint ref_count;
+    PieceNode *root;
+};
+
+struct _FlowPieceTableIter
+{
+    FlowPieceTableSnapshot *snapshot;
+    GPtrArray *stack;
+};
+
+static gsize
+count_newlines (const gchar *data, gsize len)
+{
+    const gchar *p = data;
+    const gchar *end = data + len;
+    gsize count = 0;
+
+    while (p < end && (p = memchr (p, '\n', (gsize) (end - p))) != NULL) {
+        count++;
+        p++;
+    }
+
+    return count;
+}
+
+static PieceNode *
+piece_node_ref (PieceNode *node)
+{
+    if (node)
+        g_atomic_int_inc (&node->ref_count);
+    return node;
+}
+
+static void
+piece_node_unref (PieceNode *node)
+{
+    if (!node || !g_atomic_int_dec_and_test (&node->ref_count))
+        return;
+
+    piece_node_unref (node->left);
+    piece_node_unref (node->right);
+    g_bytes_unref (node->bytes);
+    g_free (node);
+}
+
+/* Takes ownership of @left and @right. */
+static PieceNode *
+piece_node_new (GBytes *bytes, gsize offset, gsize len, gsize chars, gsize newlines,
+                guint32 priority, PieceNode *left, PieceNode *right)
+{
+    PieceNode *node = g_new (PieceNode, 1);
+
+    node->ref_count = 1;
+    node->priority = priority;
+    node->left = left;
+    node->right = right;
+    node->bytes = g_bytes_ref (bytes);
+    node->offset = offset;
+    node->len = len;
+    node->chars = chars;
+    node->newlines = newlines;
+
+    node->total_len = len;
+    node->total_chars = chars;
+    node->total_newlines = newlines;
+    if (left) {
+        node->total_len += left->total_len;
+        node->total_chars += left->total_chars;
+        node->total_newlines += left->total_newlines;
+    }
+    if (right) {
+        node->total_len += right->total_len;
+        node->total_chars += right->total_chars;
+        node->total_newlines += right->total_newlines;
+    }
+
+    return node;
+}
+
+static PieceNode *
+piece_node_new_leaf (GBytes *bytes, gsize offset, gsize len, gsize chars, gsize newlines)
+{
+    return piece_node_new (bytes, offset, len, chars, newlines, g_random_int (), NULL, NULL);
+}
+
+/* A copy of @node's piece with new children; takes ownership of them. */
+static PieceNode *
+piece_node_with_children (PieceNode *node, PieceNode *left, PieceNode *right)
+{
+    return piece_node_new (node->bytes, node->offset, node->len, node->chars, node->newlines,
+                           node->priority, left, right);
+}
+
+static const gchar *
+piece_node_data (PieceNode *node)
+{
+    return (const gchar *) g_bytes_get_data (node->bytes, NULL) + node->offset;
+}
+
+/* Joins two trees where every position of @a precedes @b.  Takes ownership
+ * of both. */
+static PieceNode *
+piece_tree_merge (PieceNode *a, PieceNode *b)
+{
+    PieceNode *result;
+
+    if (!a)
+        return b;
+    if (!b)
+        return a;
+
+    if (a->priority > b->priority) {
+        result = piece_node_with_children (a, piece_node_ref (a->left),
+                                           piece_tree_merge (piece_node_ref (a->right), b));
+        piece_node_unref (a);
+    } else {
+        result = piece_node_with_children (b, piece_tree_merge (a, piece_node_ref (b->left)),
+                                           piece_node_ref (b->right));
+        piece_node_unref (b);
+    }
+
+    return result;
+}
+
+/* Splits @tree so that @left holds its first @pos characters.  @tree is
+ * borrowed; both halves are new references. */
+static void
+piece_tree_split (PieceNode *tree, gsize pos, PieceNode **left, PieceNode **right)
+{
+    PieceNode *tmp;
+    gsize left_chars;
+
+    if (!tree) {
+        *left = NULL;
+        *right = NULL;
+        return;
+    }
+
+    left_chars = tree->left ? tree->left->total_chars : 0;
+
+    if (pos <= left_chars) {
+        piece_tree_split (tree->left, pos, left, &tmp);
+        *right = piece_node_with_children (tree, tmp, piece_node_ref (tree->right));
+    } else if (pos >= left_chars + tree->chars) {
+        piece_tree_split (tree->right, pos - left_chars - tree->chars, &tmp, right);
+        *left = piece_node_with_children (tree, piece_node_ref (tree->left), tmp);
+    } else {
+        const gchar *data = piece_node_data (tree);
+        gsize k = pos - left_chars;
+        gsize k_bytes = (gsize) (g_utf8_offset_to_pointer (data, (glong) k) - data);
+        gsize k_newlines = count_newlines (data, k_bytes);
+        PieceNode *head;
+        PieceNode *tail;
+
+        head = piece_node_new_leaf (tree->bytes, tree->offset, k_bytes, k, k_newlines);
+        tail = piece_node_new_leaf (tree->bytes, tree->offset + k_bytes, tree->len - k_bytes,
+                                    tree->chars - k, tree->newlines - k_newlines);
+        *left = piece_tree_merge (piece_node_ref (tree->left), head);
+        *right = piece_tree_merge (tail, piece_node_ref (tree->right));
+    }
+}
+
+/* A copy of @tree whose last piece is @len bytes longer. */
+static PieceNode *
+piece_tree_extend_last (PieceNode *tree, gsize len, gsize chars, gsize newlines)
+{
+    if (tree->right)
+        return piece_node_with_children (tree, piece_node_ref (tree->left),
+                                         piece_tree_extend_last (tree->right, len, chars, newlines));
+
+    return piece_node_new (tree->bytes, tree->offset, tree->len + len, tree->chars + chars,
+                           tree->newlines + newlines, tree->priority,
+                           piece_node_ref (tree->left), NULL);
+}
+
+static PieceNode *
+piece_tree_last (PieceNode *tree)
+{
+    while (tree && tree->right)
+        tree = tree->right;
+    return tree;
+}
+
+FlowPieceTable *
+flow_piece_table_new (void)
+{
+    return g_new0 (FlowPieceTable, 1);
+}
+
+void
+flow_piece_table_free (FlowPieceTable *table)
+{
+    if (!table)
+        return;
+
+    piece_node_unref (table->root);
+    g_clear_pointer (&table->add_block, g_bytes_unref);
+    g_free (table);
+}
+
+void
+flow_piece_table_clear (FlowPieceTable *table)
+{
+    g_return_if_fail (table != NULL);
+
+    g_clear_pointer (&table->root, piece_node_unref);
+}
+
+/*
+ * Appends @bytes, which must be valid UTF-8, without copying it.  Used
+ * when loading, where chunks arrive in order from the file loader.
+ */
+void
+flow_piece_table_append_bytes (FlowPieceTable *table, GBytes *bytes)
+{
+    const gchar *data;
+    gsize size;
+    gsize offset = 0;
+
+    g_return_if_fail (table != NULL);
+    g_return_if_fail (bytes != NULL);
+
+    data = g_bytes_get_data (bytes, &size);
+
+    while (offset < size) {
+        gsize len = MIN (size - offset, MAX_APPEND_PIECE);
+        PieceNode *leaf;
+
+        /* Never cut a character in half. */
+        while (offset + len < size && ((guchar) data[offset + len] & 0xC0) == 0x80)
+            len--;
+
+        leaf = piece_node_new_leaf (bytes, offset, len,
+                                    (gsize) g_utf8_strlen (data + offset, (gssize) len),
+                                    count_newlines (data + offset, len));
+        table->root = piece_tree_merge (table->root, leaf);
+        offset += len;
+    }
+}
+
+void
+flow_piece_table_insert (FlowPieceTable *table, gsize char_offset, const gchar *text, gsize len)
+{
+    PieceNode *left;
+    PieceNode *right;
+    PieceNode *last;
+    gsize offset;
+    gsize chars;
+    gsize newlines;
+
+    g_return_if_fail (table != NULL);
+
+    if (len == 0)
+        return;
+
+    if (!table->add_block || table->add_used + len > table->add_capacity) {
+        g_clear_pointer (&table->add_block, g_bytes_unref);
+        table->add_capacity = MAX (ADD_BLOCK_SIZE, len);
+        table->add_data = g_malloc (table->add_capacity);
+        table->add_used = 0;
+        /* Bytes past add_used are not referenced by any piece yet, so
+         * appending to them does not change what snapshots can see. */
+        table->add_block = g_bytes_new_take (table->add_data, table->add_capacity);
+    }
+
+    offset = table->add_used;
+    memcpy (table->add_data + offset, text, len);
+    table->add_used += len;
+
+    chars = (gsize) g_utf8_strlen (text, (gssize) len);
+    newlines = count_newlines (text, len);
+
+    piece_tree_split (table->root, char_offset, &left, &right);
+
+    /* Typing usually continues right where the previous piece ends in the
+     * add buffer; grow that piece instead of adding a node per keystroke. */
+    last = piece_tree_last (left);
+    if (last && last->bytes == table->add_block && last->offset + last->len == offset) {
+        PieceNode *extended = piece_tree_extend_last (left, len, chars, newlines);
+        piece_node_unref (left);
+        left = extended;
+    } else {
+        left = piece_tree_merge (left, piece_node_new_leaf (table->add_block, offset, len, chars, newlines));
+    }
+
+    piece_node_unref (table->root);
+    table->root = piece_tree_merge (left, right);
+}
+
+void
+flow_piece_table_delete (FlowPieceTable *table, gsize char_offset, gsize n_chars)
+{
+    PieceNode *left;
+    PieceNode *rest;
+    PieceNode *middle;
+    PieceNode *right;
+
+    g_return_if_fail (table != NULL);
+
+    if (n_chars == 0)
+        return;
+
+    piece_tree_split (table->root, char_offset, &left, &rest);
+    piece_tree_split (rest, n_chars, &middle, &right);
+    piece_node_unref (rest);
+    piece_node_unref (middle);
+
+    piece_node_unref (table->root);
+    table->root = piece_tree_merge (left, right);
+}
+
+gsize
+flow_piece_table_get_length (FlowPieceTable *table)
+{
+    g_return_val_if_fail (table != NULL, 0);
+
+    return table->root ? table->root->total_len : 0;
+}
+
+gsize
+flow_piece_table_get_char_count (FlowPieceTable *table)
+{
+    g_return_val_if_fail (table != NULL, 0);
+
+    return table->root ? table->root->total_chars : 0;
+}
+
+gsize
+flow_piece_table_get_line_count (FlowPieceTable *table)
+{
+    g_return_val_if_fail (table != NULL, 0);
+
+    return (table->root ? table->root->total_newlines : 0) + 1;
+}
+
+/* Character offset at which @line (0-based) starts. */
+gsize
+flow_piece_table_get_line_offset (FlowPieceTable *table, gsize line)
+{
+    PieceNode *node;
+    gsize base = 0;
+
+    g_return_val_if_fail (table != NULL, 0);
+
+    node = table->root;
+    if (line == 0 || !node)
+        return 0;
+    if (line > node->total_newlines)
+        return node->total_chars;
+
+    while (node) {
+        gsize left_newlines = node->left ? node->left->total_newlines : 0;
+        gsize left_chars = node->left ? node->left->total_chars : 0;
+
+        if (line <= left_newlines) {
+            node = node->left;
+        } else if (line <= left_newlines + node->newlines) {
+            const gchar *data = piece_node_data (node);
+            const gchar *p = data;
+            gsize remaining = line - left_newlines;
+
+            while (remaining > 0) {
+                p = memchr (p, '\n', node->len - (gsize) (p - data));
+                p++;
+                remaining--;
+            }
+            return base + left_chars + (gsize) g_utf8_pointer_to_offset (data, p);
+        } else {
+            line -= left_newlines + node->newlines;
+            base += left_chars + node->chars;
+            node = node->right;
+        }
+    }
+
+    return base;
+}
+
+FlowPieceTableSnapshot *
+flow_piece_table_snapshot (FlowPieceTable *table)
+{
+    FlowPieceTableSnapshot *snapshot;
+
+    g_return_val_if_fail (table != NULL, NULL);
+
+    snapshot = g_new0 (FlowPieceTableSnapshot, 1);
+    snapshot->ref_count = 1;
+    snapshot->root = piece_node_ref (table->root);
+
+    return snapshot;
+}
+
+FlowPieceTableSnapshot *
+flow_piece_table_snapshot_ref (FlowPieceTableSnapshot *snapshot)
+{
+    g_return_val_if_fail (snapshot != NULL, NULL);
+
+    g_atomic_int_inc (&snapshot->ref_count);
+    return snapshot;
+}
+
+void
+flow_piece_table_snapshot_unref (FlowPieceTableSnapshot *snapshot)
+{
+    if (!snapshot || !g_atomic_int_dec_and_test (&snapshot->ref_count))
+        return;
+
+    piece_node_unref (snapshot->root);
+    g_free (snapshot);
+}
+
+gsize
+flow_piece_table_snapshot_get_length (FlowPieceTableSnapshot *snapshot)
+{
+    g_return_val_if_fail (snapshot != NULL, 0);
+
+    return snapshot->root ? snapshot->root->total_len : 0;
+}
+
+static void
+piece_table_iter_push_left (FlowPieceTableIter *iter, PieceNode *node)
+{
+    while (node) {
+        g_ptr_array_add (iter->stack, node);
+        node = node->left;
+    }
+}
+
+/* Walks the pieces of @snapshot in document order.  Safe to use from any
+ * thread. */
+FlowPieceTableIter *
+flow_piece_table_iter_new (FlowPieceTableSnapshot *snapshot)
+{
+    FlowPieceTableIter *iter;
+
+    g_return_val_if_fail (snapshot != NULL, NULL);
+
+    iter = g_new0 (FlowPieceTableIter, 1);
+    iter->snapshot = flow_piece_table_snapshot_ref (snapshot);
+    iter->stack = g_ptr_array_new ();
+    piece_table_iter_push_left (iter, snapshot->root);
+
+    return iter;
+}
+
+gboolean
+flow_piece_table_iter_next (FlowPieceTableIter *iter, const gchar **data, gsize *len)
+{
+    PieceNode *node;
+
+    g_return_val_if_fail (iter != NULL, FALSE);
+
+    do {
+        if (iter->stack->len == 0)
+            return FALSE;
+
+        node = g_ptr_array_steal_index (iter->stack, iter->stack->len - 1);
+        piece_table_iter_push_left (iter, node->right);
+    } while (node->len == 0);
+
+    *data = piece_node_data (node);
+    *len = node->len;
+    return TRUE;
+}
+
+void
+flow_piece_table_iter_free (FlowPieceTableIter *iter)
+{
+    if (!iter)
+        return;
+
+    g_ptr_array_unref (iter->stack);
+    flow_piece_table_snapshot_unref (iter->snapshot);
+    g_free (iter);
+}
@@ -0,0 +1,76 @@
+/* flow-piece-table.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * FlowPieceTable is the document model behind an editor tab.  Text lives
+ * in immutable GBytes (chunks handed over by the file loader, plus an
+ * append-only buffer for typed text); the document is an ordered tree of
+ * pieces referencing them.  Positions are character offsets, matching
+ * GtkTextIter offsets.
+ *
+ * Inserts and deletes are O(log n).  Tree nodes are never modified once
+ * built, so a snapshot is a single reference to the current root and can
+ * be read from another thread while editing continues.
+ */
+typedef struct _FlowPieceTable FlowPieceTable;
+typedef struct _FlowPieceTableSnapshot FlowPieceTableSnapshot;
+typedef struct _FlowPieceTableIter FlowPieceTableIter;
+
+FlowPieceTable         *flow_piece_table_new                 (void);
+void                    flow_piece_table_free                (FlowPieceTable         *table);
+
+void                    flow_piece_table_append_bytes        (FlowPieceTable         *table,
+                                                              GBytes                 *bytes);
+void                    flow_piece_table_insert              (FlowPieceTable         *table,
+                                                              gsize                   char_offset,
+                                                              const gchar            *text,
+                                                              gsize                   len);
+void                    flow_piece_table_delete              (FlowPieceTable         *table,
+                                                              gsize                   char_offset,
+                                                              gsize                   n_chars);
+void                    flow_piece_table_clear               (FlowPieceTable         *table);
+
+gsize                   flow_piece_table_get_length          (FlowPieceTable         *table);
+gsize                   flow_piece_table_get_char_count      (FlowPieceTable         *table);
+gsize                   flow_piece_table_get_line_count      (FlowPieceTable         *table);
+gsize                   flow_piece_table_get_line_offset     (FlowPieceTable         *table,
+                                                              gsize                   line);
+
+FlowPieceTableSnapshot *flow_piece_table_snapshot            (FlowPieceTable         *table);
+FlowPieceTableSnapshot *flow_piece_table_snapshot_ref        (FlowPieceTableSnapshot *snapshot);
+void                    flow_piece_table_snapshot_unref      (FlowPieceTableSnapshot *snapshot);
+gsize                   flow_piece_table_snapshot_get_length (FlowPieceTableSnapshot *snapshot);
+
+FlowPieceTableIter     *flow_piece_table_iter_new            (FlowPieceTableSnapshot *snapshot);
+gboolean                flow_piece_table_iter_next           (FlowPieceTableIter     *iter,
+                                                              const gchar           **data,
+                                                              gsize                  *len);
+void                    flow_piece_table_iter_free           (FlowPieceTableIter     *iter);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FlowPieceTableSnapshot, flow_piece_table_snapshot_unref)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FlowPieceTableIter, flow_piece_table_iter_free)
+
+G_END_DECLS
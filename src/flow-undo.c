@@ -0,0 +1,768 @@
+/* flow-undo.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * The undo queue holds steps oldest first.  Spilled steps always form a
+ * prefix of it, and they lie in the spill file in the same order, so the
+ * file works as a stack: undo reads back the last one and truncates the
+ * file, and forgetting the oldest one only moves spill_start forward.
+ *
+ * Each state of the document is named by the id of the step that led to
+ * it, or base_id before any step.  The document is saved while that id
+ * equals saved_id.
+ *
+ * A spilled step is compressed as a sequence of edits, each a kind byte
+ * and little-endian 64-bit offset, character count and byte length,
+ * followed by the text.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "flow-compression.h"
+#include "flow-undo.h"
+
+/* In-memory undo steps past this are spilled, oldest first. */
+#define UNDO_MEMORY_SIZE      (2 * 1024 * 1024)
+/* Spill file bytes given up before the file is rewritten without them. */
+#define UNDO_COMPACT_MIN_SIZE (4 * 1024 * 1024)
+/* Rough cost of an edit besides its text. */
+#define UNDO_EDIT_OVERHEAD    48
+#define UNDO_EDIT_HEADER_SIZE 25
+#define UNDO_COPY_CHUNK_SIZE  (256 * 1024)
+
+#ifdef HAVE_ZSTD
+#define UNDO_SPILL_COMPRESSION FLOW_COMPRESSION_ZSTD
+#else
+#define UNDO_SPILL_COMPRESSION FLOW_COMPRESSION_GZIP
+#endif
+
+typedef struct {
+    guint64 id;
+    GArray *edits;          /* FlowUndoEdit; NULL while spilled */
+    gsize size;             /* in memory, or in the spill file */
+    guint64 spill_offset;
+    gsize spill_len;
+    gboolean sealed;        /* later edits may not merge into it */
+} UndoStep;
+
+struct _FlowUndo
+{
+    GQueue undo;            /* UndoStep, oldest first */
+    GQueue redo;            /* UndoStep, next to redo first */
+    UndoStep *pending;      /* edits of the open action */
+    guint action_depth;
+
+    gsize byte_cap;
+    gsize undo_memory;      /* in-memory undo steps */
+    gsize total_size;       /* everything, spilled steps by their spilled size */
+    guint n_spilled;
+
+    gint spill_fd;
+    gboolean spill_failed;
+    guint64 spill_start;
+    guint64 spill_end;
+
+    guint64 next_id;
+    guint64 base_id;
+    guint64 saved_id;
+};
+
+static void
+undo_edit_clear (gpointer pointer)
+{
+    FlowUndoEdit *edit = pointer;
+
+    g_free (edit->text);
+}
+
+static GArray *
+undo_edits_new (void)
+{
+    GArray *edits = g_array_new (FALSE, FALSE, sizeof (FlowUndoEdit));
+
+    g_array_set_clear_func (edits, undo_edit_clear);
+    return edits;
+}
+
+static UndoStep *
+undo_step_new (FlowUndo *undo)
+{
+    UndoStep *step = g_new0 (UndoStep, 1);
+
+    step->id = undo->next_id++;
+    step->edits = undo_edits_new ();
+    return step;
+}
+
+static void
+undo_step_free (UndoStep *step)
+{
+    if (step->edits)
+        g_array_unref (step->edits);
+    g_free (step);
+}
+
+static void
+undo_step_add (UndoStep *step, FlowUndoEditKind kind, gsize offset, const gchar *text, gsize len)
+{
+    FlowUndoEdit edit;
+
+    edit.kind = kind;
+    edit.offset = offset;
+    edit.n_chars = (gsize) g_utf8_strlen (text, (gssize) len);
+    edit.text = g_strndup (text, len);
+    edit.len = len;
+    g_array_append_val (step->edits, edit);
+    step->size += len + UNDO_EDIT_OVERHEAD;
+}
+
+static guint64
+undo_current_id (FlowUndo *undo)
+{
+    UndoStep *top = g_queue_peek_tail (&undo->undo);
+
+    return top ? top->id : undo->base_id;
+}
+
+static gboolean
+undo_is_word_char (gunichar ch)
+{
+    return !g_unichar_isspace (ch);
+}
+
+/* Whether @edit extends @last the way one more keystroke would. */
+static gboolean
+undo_edit_continues (const FlowUndoEdit *last, const FlowUndoEdit *edit)
+{
+    gunichar prev, next;
+
+    if (edit->kind != last->kind || edit->n_chars != 1 || strchr (edit->text, '\n'))
+        return FALSE;
+
+    next = g_utf8_get_char (edit->text);
+
+    if (edit->kind == FLOW_UNDO_EDIT_INSERT) {
+        if (edit->offset != last->offset + last->n_chars)
+            return FALSE;
+        prev = g_utf8_get_char (g_utf8_prev_char (last->text + last->len));
+        /* Each word typed, with the spaces before it, is its own step. */
+        return undo_is_word_char (next) || !undo_is_word_char (prev);
+    }
+
+    /* Backspace or Delete, one character at a time. */
+    return edit->offset + 1 == last->offset || edit->offset == last->offset;
+}
+
+static void
+undo_edit_merge (FlowUndoEdit *last, const FlowUndoEdit *edit)
+{
+    gchar *text;
+
+    if (edit->kind == FLOW_UNDO_EDIT_DELETE && edit->offset + 1 == last->offset) {
+        text = g_strconcat (edit->text, last->text, NULL);
+        last->offset = edit->offset;
+    } else {
+        text = g_strconcat (last->text, edit->text, NULL);
+    }
+
+    g_free (last->text);
+    last->text = text;
+    last->len += edit->len;
+    last->n_chars += edit->n_chars;
+}
+
+static gboolean
+undo_step_is_keystroke (UndoStep *step)
+{
+    FlowUndoEdit *edit;
+
+    if (step->edits->len != 1)
+        return FALSE;
+
+    edit = &g_array_index (step->edits, FlowUndoEdit, 0);
+    return edit->n_chars == 1 && !strchr (edit->text, '\n');
+}
+
+/* Spill file */
+
+static gboolean
+undo_spill_open (FlowUndo *undo, GError **error)
+{
+    gchar *path = NULL;
+
+    if (undo->spill_fd >= 0)
+        return TRUE;
+
+    undo->spill_fd = g_file_open_tmp ("flow-undo-XXXXXX", &path, error);
+    if (undo->spill_fd < 0)
+        return FALSE;
+
+    /* Nobody else needs to see it, and it goes away with the descriptor. */
+    g_unlink (path);
+    g_free (path);
+    undo->spill_start = 0;
+    undo->spill_end = 0;
+    return TRUE;
+}
+
+static gboolean
+undo_convert (GConverter *converter, const guchar *data, gsize len, GByteArray *out, GError **error)
+{
+    GOutputStream *memory = g_memory_output_stream_new_resizable ();
+    GOutputStream *stream = g_converter_output_stream_new (memory, converter);
+    gboolean ok;
+
+    ok = g_output_stream_write_all (stream, data, len, NULL, NULL, error) &&
+         g_output_stream_close (stream, NULL, error);
+
+    if (ok)
+        g_byte_array_append (out,
+                             g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (memory)),
+                             (guint) g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (memory)));
+
+    g_object_unref (stream);
+    g_object_unref (memory);
+    return ok;
+}
+
+static gboolean
+undo_pwrite_all (gint fd, const guchar *data, gsize len, guint64 offset, GError **error)
+{
+    while (len > 0) {
+        gssize written = pwrite (fd, data, len, (off_t) offset);
+
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                         "Could not write undo history: %s", g_strerror (errno));
+            return FALSE;
+        }
+
+        data += written;
+        len -= (gsize) written;
+        offset += (guint64) written;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+undo_pread_all (gint fd, guchar *data, gsize len, guint64 offset, GError **error)
+{
+    while (len > 0) {
+        gssize n_read = pread (fd, data, len, (off_t) offset);
+
+        if (n_read < 0 && errno == EINTR)
+            continue;
+        if (n_read <= 0) {
+            g_set_error (error, G_IO_ERROR, n_read < 0 ? g_io_error_from_errno (errno) : G_IO_ERROR_PARTIAL_INPUT,
+                         "Could not read undo history: %s", n_read < 0 ? g_strerror (errno) : "file is truncated");
+            return FALSE;
+        }
+
+        data += n_read;
+        len -= (gsize) n_read;
+        offset += (guint64) n_read;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+undo_step_spill (FlowUndo *undo, UndoStep *step, GError **error)
+{
+    GByteArray *raw = g_byte_array_new ();
+    GByteArray *compressed = g_byte_array_new ();
+    GConverter *compressor;
+    gboolean ok = FALSE;
+    guint i;
+
+    for (i = 0; i < step->edits->len; i++) {
+        FlowUndoEdit *edit = &g_array_index (step->edits, FlowUndoEdit, i);
+        guint8 kind = (guint8) edit->kind;
+        guint64 fields[3];
+
+        fields[0] = GUINT64_TO_LE ((guint64) edit->offset);
+        fields[1] = GUINT64_TO_LE ((guint64) edit->n_chars);
+        fields[2] = GUINT64_TO_LE ((guint64) edit->len);
+        g_byte_array_append (raw, &kind, 1);
+        g_byte_array_append (raw, (const guint8 *) fields, sizeof fields);
+        g_byte_array_append (raw, (const guint8 *) edit->text, (guint) edit->len);
+    }
+
+    compressor = flow_compression_new_compressor (UNDO_SPILL_COMPRESSION, error);
+    if (compressor &&
+        undo_convert (compressor, raw->data, raw->len, compressed, error) &&
+        undo_pwrite_all (undo->spill_fd, compressed->data, compressed->len, undo->spill_end, error)) {
+        g_clear_pointer (&step->edits, g_array_unref);
+        step->spill_offset = undo->spill_end;
+        step->spill_len = compressed->len;
+        step->size = compressed->len;
+        undo->spill_end += compressed->len;
+        ok = TRUE;
+    }
+
+    g_clear_object (&compressor);
+    g_byte_array_unref (compressed);
+    g_byte_array_unref (raw);
+    return ok;
+}
+
+static gboolean
+undo_step_unspill (FlowUndo *undo, UndoStep *step, GError **error)
+{
+    guchar *compressed = g_malloc (step->spill_len);
+    GByteArray *raw = g_byte_array_new ();
+    GConverter *decompressor = NULL;
+    GArray *edits = NULL;
+    gsize pos = 0;
+    gsize size = 0;
+    gboolean ok = FALSE;
+
+    if (!undo_pread_all (undo->spill_fd, compressed, step->spill_len, step->spill_offset, error))
+        goto out;
+
+    decompressor = flow_compression_new_decompressor (UNDO_SPILL_COMPRESSION, error);
+    if (!decompressor || !undo_convert (decompressor, compressed, step->spill_len, raw, error))
+        goto out;
+
+    edits = undo_edits_new ();
+    while (pos < raw->len) {
+        FlowUndoEdit edit;
+        guint64 fields[3];
+
+        if (raw->len - pos < UNDO_EDIT_HEADER_SIZE)
+            break;
+        memcpy (fields, raw->data + pos + 1, sizeof fields);
+        edit.kind = raw->data[pos] == FLOW_UNDO_EDIT_DELETE ? FLOW_UNDO_EDIT_DELETE : FLOW_UNDO_EDIT_INSERT;
+        edit.offset = (gsize) GUINT64_FROM_LE (fields[0]);
+        edit.n_chars = (gsize) GUINT64_FROM_LE (fields[1]);
+        edit.len = (gsize) GUINT64_FROM_LE (fields[2]);
+        pos += UNDO_EDIT_HEADER_SIZE;
+        if (edit.len > raw->len - pos)
+            break;
+        edit.text = g_strndup ((const gchar *) raw->data + pos, edit.len);
+        pos += edit.len;
+        size += edit.len + UNDO_EDIT_OVERHEAD;
+        g_array_append_val (edits, edit);
+    }
+
+    if (pos != raw->len) {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Undo history is corrupt");
+        goto out;
+    }
+
+    step->edits = g_steal_pointer (&edits);
+    step->size = size;
+    ok = TRUE;
+
+out:
+    if (edits)
+        g_array_unref (edits);
+    g_clear_object (&decompressor);
+    g_byte_array_unref (raw);
+    g_free (compressed);
+    return ok;
+}
+
+/* Moves the live part of the spill file to its start once enough of the
+ * file holds forgotten steps. */
+static void
+undo_spill_compact (FlowUndo *undo)
+{
+    guchar *chunk;
+    guint64 shift = undo->spill_start;
+    guint64 pos;
+    GList *l;
+    GError *error = NULL;
+
+    if (shift < UNDO_COMPACT_MIN_SIZE || shift < undo->spill_end - shift)
+        return;
+
+    chunk = g_malloc (UNDO_COPY_CHUNK_SIZE);
+    for (pos = shift; pos < undo->spill_end; pos += UNDO_COPY_CHUNK_SIZE) {
+        gsize len = (gsize) MIN ((guint64) UNDO_COPY_CHUNK_SIZE, undo->spill_end - pos);
+
+        if (!undo_pread_all (undo->spill_fd, chunk, len, pos, &error) ||
+            !undo_pwrite_all (undo->spill_fd, chunk, len, pos - shift, &error))
+            break;
+    }
+    g_free (chunk);
+
+    if (error) {
+        /* The steps are still where they were; try again later. */
+        g_warning ("%s", error->message);
+        g_error_free (error);
+        return;
+    }
+
+    for (l = undo->undo.head; l && ((UndoStep *) l->data)->edits == NULL; l = l->next)
+        ((UndoStep *) l->data)->spill_offset -= shift;
+    undo->spill_start = 0;
+    undo->spill_end -= shift;
+    if (ftruncate (undo->spill_fd, (off_t) undo->spill_end) < 0)
+        g_warning ("Could not shrink undo history: %s", g_strerror (errno));
+}
+
+/* Forgets the oldest undo step. */
+static void
+undo_drop_oldest (FlowUndo *undo)
+{
+    UndoStep *step = g_queue_pop_head (&undo->undo);
+
+    undo->base_id = step->id;
+    undo->total_size -= step->size;
+
+    if (step->edits) {
+        undo->undo_memory -= step->size;
+    } else {
+        undo->n_spilled--;
+        undo->spill_start = step->spill_offset + step->spill_len;
+        if (undo->n_spilled == 0) {
+            undo->spill_start = 0;
+            undo->spill_end = 0;
+            if (ftruncate (undo->spill_fd, 0) < 0)
+                g_warning ("Could not shrink undo history: %s", g_strerror (errno));
+        }
+    }
+
+    undo_step_free (step);
+}
+
+/* Forgets every spilled step, for when the spill file lets us down. */
+static void
+undo_drop_spilled (FlowUndo *undo)
+{
+    while (undo->n_spilled > 0)
+        undo_drop_oldest (undo);
+}
+
+static void
+undo_clear_redo (FlowUndo *undo)
+{
+    UndoStep *step;
+
+    /* The saved state may have been one of them; it is out of reach now. */
+    if (undo->saved_id != G_MAXUINT64 && undo->saved_id > undo_current_id (undo))
+        undo->saved_id = G_MAXUINT64;
+
+    while ((step = g_queue_pop_head (&undo->redo))) {
+        undo->total_size -= step->size;
+        undo_step_free (step);
+    }
+}
+
+static void
+undo_enforce_limits (FlowUndo *undo)
+{
+    UndoStep *step;
+
+    while (undo->total_size > undo->byte_cap && !g_queue_is_empty (&undo->undo))
+        undo_drop_oldest (undo);
+
+    while (undo->total_size > undo->byte_cap && (step = g_queue_pop_tail (&undo->redo))) {
+        undo->total_size -= step->size;
+        undo_step_free (step);
+    }
+
+    undo_spill_compact (undo);
+
+    /* Spill the oldest in-memory steps, but never the newest one: it is
+     * the one most likely to be undone or merged into. */
+    while (undo->undo_memory > UNDO_MEMORY_SIZE && !undo->spill_failed &&
+           undo->n_spilled + 1 < g_queue_get_length (&undo->undo)) {
+        GError *error = NULL;
+        gsize size;
+
+        step = g_queue_peek_nth (&undo->undo, undo->n_spilled);
+        size = step->size;
+
+        if (!undo_spill_open (undo, &error) || !undo_step_spill (undo, step, &error)) {
+            /* Keep everything in memory; the byte cap still applies. */
+            g_warning ("%s", error->message);
+            g_error_free (error);
+            undo->spill_failed = TRUE;
+            break;
+        }
+
+        undo->undo_memory -= size;
+        undo->total_size = undo->total_size - size + step->size;
+        undo->n_spilled++;
+    }
+}
+
+/* Pushes the edits of a finished action, merging runs of typing. */
+static void
+undo_commit (FlowUndo *undo, UndoStep *step)
+{
+    UndoStep *top = g_queue_peek_tail (&undo->undo);
+    FlowUndoEdit *edit;
+
+    if (step->edits->len == 0) {
+        undo_step_free (step);
+        return;
+    }
+
+    undo_clear_redo (undo);
+
+    edit = &g_array_index (step->edits, FlowUndoEdit, 0);
+    if (top && top->edits && !top->sealed && step->edits->len == 1 &&
+        undo_edit_continues (&g_array_index (top->edits, FlowUndoEdit, 0), edit)) {
+        undo_edit_merge (&g_array_index (top->edits, FlowUndoEdit, 0), edit);
+        top->size += edit->len;
+        undo->undo_memory += edit->len;
+        undo->total_size += edit->len;
+        undo_step_free (step);
+    } else {
+        step->sealed = !undo_step_is_keystroke (step);
+        g_queue_push_tail (&undo->undo, step);
+        undo->undo_memory += step->size;
+        undo->total_size += step->size;
+    }
+
+    undo_enforce_limits (undo);
+}
+
+FlowUndo *
+flow_undo_new (void)
+{
+    FlowUndo *undo = g_new0 (FlowUndo, 1);
+
+    g_queue_init (&undo->undo);
+    g_queue_init (&undo->redo);
+    undo->byte_cap = FLOW_UNDO_DEFAULT_BYTE_CAP;
+    undo->spill_fd = -1;
+    undo->next_id = 1;
+    return undo;
+}
+
+void
+flow_undo_free (FlowUndo *undo)
+{
+    if (!undo)
+        return;
+
+    g_queue_clear_full (&undo->undo, (GDestroyNotify) undo_step_free);
+    g_queue_clear_full (&undo->redo, (GDestroyNotify) undo_step_free);
+    if (undo->pending)
+        undo_step_free (undo->pending);
+    if (undo->spill_fd >= 0)
+        close (undo->spill_fd);
+    g_free (undo);
+}
+
+void
+flow_undo_set_byte_cap (FlowUndo *undo, gsize byte_cap)
+{
+    undo->byte_cap = byte_cap;
+    undo_enforce_limits (undo);
+}
+
+void
+flow_undo_begin_action (FlowUndo *undo)
+{
+    if (undo->action_depth++ == 0)
+        undo->pending = undo_step_new (undo);
+}
+
+void
+flow_undo_end_action (FlowUndo *undo)
+{
+    g_return_if_fail (undo->action_depth > 0);
+
+    if (--undo->action_depth == 0)
+        undo_commit (undo, g_steal_pointer (&undo->pending));
+}
+
+static void
+undo_record (FlowUndo *undo, FlowUndoEditKind kind, gsize offset, const gchar *text, gsize len)
+{
+    if (len == 0)
+        return;
+
+    /* An edit outside any action is an action of its own. */
+    flow_undo_begin_action (undo);
+    undo_step_add (undo->pending, kind, offset, text, len);
+    flow_undo_end_action (undo);
+}
+
+void
+flow_undo_record_insert (FlowUndo *undo, gsize offset, const gchar *text, gsize len)
+{
+    undo_record (undo, FLOW_UNDO_EDIT_INSERT, offset, text, len);
+}
+
+void
+flow_undo_record_delete (FlowUndo *undo, gsize offset, const gchar *text, gsize len)
+{
+    undo_record (undo, FLOW_UNDO_EDIT_DELETE, offset, text, len);
+}
+
+/* Forgets the whole history; the current text becomes the oldest state. */
+void
+flow_undo_clear (FlowUndo *undo)
+{
+    gboolean saved = flow_undo_is_saved (undo);
+
+    g_queue_clear_full (&undo->undo, (GDestroyNotify) undo_step_free);
+    g_queue_clear_full (&undo->redo, (GDestroyNotify) undo_step_free);
+    if (undo->pending) {
+        undo_step_free (undo->pending);
+        undo->pending = undo_step_new (undo);
+    }
+
+    undo->undo_memory = 0;
+    undo->total_size = 0;
+    undo->n_spilled = 0;
+    undo->spill_start = 0;
+    undo->spill_end = 0;
+    if (undo->spill_fd >= 0 && ftruncate (undo->spill_fd, 0) < 0)
+        g_warning ("Could not shrink undo history: %s", g_strerror (errno));
+
+    undo->base_id = undo->next_id++;
+    undo->saved_id = saved ? undo->base_id : G_MAXUINT64;
+}
+
+void
+flow_undo_mark_saved (FlowUndo *undo)
+{
+    UndoStep *top = g_queue_peek_tail (&undo->undo);
+
+    /* Typing on from here must not change what the saved state names. */
+    if (top)
+        top->sealed = TRUE;
+    undo->saved_id = undo_current_id (undo);
+}
+
+void
+flow_undo_mark_unsaved (FlowUndo *undo)
+{
+    undo->saved_id = G_MAXUINT64;
+}
+
+gboolean
+flow_undo_is_saved (FlowUndo *undo)
+{
+    return undo->saved_id == undo_current_id (undo);
+}
+
+gboolean
+flow_undo_can_undo (FlowUndo *undo)
+{
+    return !g_queue_is_empty (&undo->undo);
+}
+
+gboolean
+flow_undo_can_redo (FlowUndo *undo)
+{
+    return !g_queue_is_empty (&undo->redo);
+}
+
+static GArray *
+undo_copy_edits (GArray *edits, gboolean invert)
+{
+    GArray *copy = undo_edits_new ();
+    guint i;
+
+    for (i = 0; i < edits->len; i++) {
+        FlowUndoEdit edit = g_array_index (edits, FlowUndoEdit, invert ? edits->len - 1 - i : i);
+
+        if (invert)
+            edit.kind = edit.kind == FLOW_UNDO_EDIT_INSERT ? FLOW_UNDO_EDIT_DELETE : FLOW_UNDO_EDIT_INSERT;
+        edit.text = g_strndup (edit.text, edit.len);
+        g_array_append_val (copy, edit);
+    }
+
+    return copy;
+}
+
+/*
+ * Takes back the newest step and returns the edits that do so, to be
+ * applied in order, or NULL if there is nothing to undo.  A spilled step
+ * is read back first; should that fail, every spilled step is forgotten,
+ * later steps are kept in memory, and @error says what was lost.
+ */
+GArray *
+flow_undo_undo (FlowUndo *undo, GError **error)
+{
+    UndoStep *step = g_queue_peek_tail (&undo->undo);
+    UndoStep *top;
+    GArray *edits;
+    gsize spilled_size;
+
+    if (!step || undo->action_depth > 0)
+        return NULL;
+
+    if (!step->edits) {
+        spilled_size = step->size;
+        if (!undo_step_unspill (undo, step, error)) {
+            g_prefix_error (error, "Older undo history was lost: ");
+            undo_drop_spilled (undo);
+            undo->spill_failed = TRUE;
+            return NULL;
+        }
+
+        undo->n_spilled--;
+        undo->spill_end = step->spill_offset;
+        if (ftruncate (undo->spill_fd, (off_t) undo->spill_end) < 0)
+            g_warning ("Could not shrink undo history: %s", g_strerror (errno));
+        undo->total_size = undo->total_size - spilled_size + step->size;
+    } else {
+        undo->undo_memory -= step->size;
+    }
+
+    g_queue_pop_tail (&undo->undo);
+    step->sealed = TRUE;
+    g_queue_push_head (&undo->redo, step);
+
+    top = g_queue_peek_tail (&undo->undo);
+    if (top)
+        top->sealed = TRUE;
+
+    /* Copied first: the cap may forget the step right away. */
+    edits = undo_copy_edits (step->edits, TRUE);
+    undo_enforce_limits (undo);
+    return edits;
+}
+
+/* Does again the step last undone; see flow_undo_undo(). */
+GArray *
+flow_undo_redo (FlowUndo *undo, GError **error)
+{
+    UndoStep *step;
+    GArray *edits;
+
+    if (undo->action_depth > 0 || !(step = g_queue_pop_head (&undo->redo)))
+        return NULL;
+
+    g_queue_push_tail (&undo->undo, step);
+    undo->undo_memory += step->size;
+
+    edits = undo_copy_edits (step->edits, FALSE);
+    undo_enforce_limits (undo);
+    return edits;
+}
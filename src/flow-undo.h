@@ -0,0 +1,82 @@
+/* flow-undo.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * FlowUndo is the undo history of one document, kept apart from the
+ * text buffer so its size can be bounded.  A step holds the edits of one
+ * user action; runs of typing or deleting merge into one step.  The
+ * newest steps stay in memory.  Older ones are compressed into a spill
+ * file, an unlinked temporary file that is read back only when undo
+ * reaches them.  Past the byte cap the oldest steps are forgotten.
+ */
+typedef struct _FlowUndo FlowUndo;
+
+typedef enum {
+    FLOW_UNDO_EDIT_INSERT,
+    FLOW_UNDO_EDIT_DELETE,
+} FlowUndoEditKind;
+
+/* One change to apply to the document; offsets count characters. */
+typedef struct {
+    FlowUndoEditKind kind;
+    gsize offset;
+    gsize n_chars;
+    gchar *text;
+    gsize len;
+} FlowUndoEdit;
+
+#define FLOW_UNDO_DEFAULT_BYTE_CAP (64 * 1024 * 1024)
+
+FlowUndo *flow_undo_new             (void);
+void      flow_undo_free            (FlowUndo     *undo);
+
+void      flow_undo_set_byte_cap    (FlowUndo     *undo,
+                                     gsize         byte_cap);
+
+void      flow_undo_begin_action    (FlowUndo     *undo);
+void      flow_undo_end_action      (FlowUndo     *undo);
+void      flow_undo_record_insert   (FlowUndo     *undo,
+                                     gsize         offset,
+                                     const gchar  *text,
+                                     gsize         len);
+void      flow_undo_record_delete   (FlowUndo     *undo,
+                                     gsize         offset,
+                                     const gchar  *text,
+                                     gsize         len);
+void      flow_undo_clear           (FlowUndo     *undo);
+
+void      flow_undo_mark_saved      (FlowUndo     *undo);
+void      flow_undo_mark_unsaved    (FlowUndo     *undo);
+gboolean  flow_undo_is_saved        (FlowUndo     *undo);
+
+gboolean  flow_undo_can_undo        (FlowUndo     *undo);
+gboolean  flow_undo_can_redo        (FlowUndo     *undo);
+GArray   *flow_undo_undo            (FlowUndo     *undo,
+                                     GError      **error);
+GArray   *flow_undo_redo            (FlowUndo     *undo,
+                                     GError      **error);
+
+G_END_DECLS
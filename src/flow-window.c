@@ -8,14 +8,193 @@
 #include <ctype.h>
 #include <stdio.h>
 #include "flow-window.h"
+#include "flow-application.h"
+#include "flow-compression.h"
+#include "flow-diff.h"
+#include "flow-encoding.h"
+#include "flow-file-follower.h"
+#include "flow-file-item.h"
+#include "flow-file-loader.h"
+#include "flow-file-saver.h"
+#include "flow-ignore.h"
+#include "flow-journal.h"
+#include "flow-languages.h"
+#include "flow-mapped-viewer.h"
+#include "flow-piece-table.h"
+#include "flow-undo.h"
+#include "flow-workspace-index.h"
+
+/* Time spent inserting loaded text per main loop iteration, in microseconds. */
+#define TAB_LOAD_FRAME_BUDGET_US 8000
+/* Largest single gtk_text_buffer_insert() while loading. */
+#define TAB_LOAD_SLICE_SIZE (64 * 1024)
+#define TAB_LOAD_POLL_INTERVAL_MS 10
+/* Files at least this large open in the read-only memory-mapped viewer. */
+#define VIEWER_SIZE_THRESHOLD (G_GUINT64_CONSTANT (512) * 1024 * 1024)
+/* How much of a file is read to tell text from binary. */
+#define OPEN_SNIFF_SIZE 8192
+/* Lines a followed file keeps before the oldest are dropped. */
+#define FOLLOW_DEFAULT_MAX_LINES 100000
+/* Writes to an open file closer together than this are checked once. */
+#define TAB_MONITOR_RATE_LIMIT_MS 500
+/* Past this many MiB of loaded text, background tabs are hibernated. */
+#define TAB_MEMORY_DEFAULT_BUDGET_MB 512
+/* Rough per-line cost of a loaded tab beyond its text, which the piece
+ * table and the GtkTextBuffer each hold a copy of: btree nodes, line
+ * marks and highlighting tags. */
+#define TAB_MEMORY_LINE_OVERHEAD 96
+/* Per-tab cap on undo history, in MiB. */
+#define UNDO_DEFAULT_HISTORY_LIMIT_MB 64
+/* Directory entries the explorer asks for at a time. */
+#define FOLDER_LOAD_BATCH_SIZE 512
+/* Changes to an explorer directory closer together than this are applied as one. */
+#define FOLDER_WATCH_DEBOUNCE_MS 200
+/* Files listed by quick-open. */
+#define QUICK_OPEN_MAX_RESULTS 50
+#ifdef HAVE_ZSTD
+#define TAB_HIBERNATE_COMPRESSION FLOW_COMPRESSION_ZSTD
+#else
+#define TAB_HIBERNATE_COMPRESSION FLOW_COMPRESSION_GZIP
+#endif
 
 typedef struct {
+    FlowWindow *window;
+    AdwTabPage *page;
+    GtkWidget *root;
+    GtkWidget *viewer;
     GtkSourceView *text_view;
+    GtkTextBuffer *buffer;
     GtkScrolledWindow *scrolled;
+    GtkWidget *load_bar;
+    GtkProgressBar *load_progress;
     GFile *file;
+    FlowPieceTable *document;
+    gulong insert_handler;
+    gulong delete_handler;
+    FlowFileLoader *loader;
+    GBytes *load_chunk;
+    gsize load_chunk_offset;
+    guint load_source_id;
+    gboolean load_incomplete;
+    gboolean shelved;
+    gboolean shelved_modified;
+    FlowPieceTableSnapshot *refill_snapshot;
+    FlowPieceTableIter *refill_iter;
+    const gchar *refill_piece;
+    gsize refill_piece_len;
+    gboolean check_on_show;
+    const gchar *charset;
+    gboolean has_bom;
+    FlowCompression compression;
+    guint64 disk_size;
+    FlowPieceTableSnapshot *disk_snapshot;
+    GFileMonitor *monitor;
+    struct _ReloadRequest *reload_request;
+    FlowFileFollower *follower;
+    struct _SaveRequest *save_request;
+    gboolean save_again;
+    guint change_serial;
     gboolean is_welcome;
+    gboolean placeholder;
+    struct _OpenRequest *open_request;
+    gboolean restore_cursor;
+    gint restore_line;
+    gint restore_column;
+    gint64 last_used;
+    GBytes *hibernated;
+    struct _HibernateRequest *hibernate_request;
+    FlowJournal *journal;
+    gchar *recovered_path;
+    FlowUndo *undo;
+    gboolean undo_suspended;
+    gboolean undo_lost;
 } TabData;
 
+/* An in-flight save; outlives its tab if the tab is closed meanwhile. */
+typedef struct _SaveRequest {
+    TabData *data;
+    GFile *file;
+    guint change_serial;
+    gboolean retitle;
+    FlowCompression compression;
+    guint64 disk_size;
+    FlowPieceTableSnapshot *snapshot;
+} SaveRequest;
+
+/* A check of a tab's file against what it was loaded or saved as. */
+typedef struct _ReloadRequest {
+    TabData *data;
+    GFile *file;
+    FlowCompression compression;
+    FlowPieceTableSnapshot *snapshot;
+    FlowPieceTableSnapshot *disk_snapshot;
+    guint change_serial;
+    gboolean force;
+    GCancellable *cancellable;
+} ReloadRequest;
+
+/* Replaces @old_chars characters at @old_offset of the tab with bytes
+ * [new_start, new_start + new_len) of the new contents. */
+typedef struct {
+    gsize old_offset;
+    gsize old_chars;
+    gsize new_start;
+    gsize new_len;
+} ReloadHunk;
+
+/* Compression of a background tab's text before its editor is torn down. */
+typedef struct _HibernateRequest {
+    TabData *data;
+    FlowPieceTableSnapshot *snapshot;
+    guint change_serial;
+} HibernateRequest;
+
+/* Watches a directory shown in the explorer; owned by its store. */
+typedef struct {
+    GListStore *store;
+    GFile *folder;
+    GFileMonitor *monitor;
+    GHashTable *positions;      /* name -> position in the store + 1 */
+    GHashTable *pending;        /* names changed since the last patch */
+    struct _FolderPatch *patch; /* being looked up, if any */
+    guint patch_id;
+    gboolean loading;
+} FolderWatch;
+
+/* Names changed in a watched directory, looked up off the main thread. */
+typedef struct _FolderPatch {
+    FolderWatch *watch;         /* NULL once the watch is gone */
+    GFile *folder;
+    GPtrArray *names;
+    GArray *types;              /* GFileType of each name */
+} FolderPatch;
+
+/* The explorer's hold on a directory's model.  Its toggle ref tells when
+ * no row of the tree shows the model any more. */
+typedef struct {
+    FlowWindow *window;
+    GListModel *model;
+    gboolean unused;
+} FolderModelRef;
+
+/* A directory being read into the explorer. */
+typedef struct {
+    GListStore *store;          /* weak; gone once the explorer drops it */
+    GFile *folder;
+    FlowIgnore *ignore;
+    GFileEnumerator *enumerator;
+    GCancellable *cancellable;
+} FolderLoad;
+
+typedef struct {
+    gboolean unchanged;
+    GBytes *text;
+    GArray *hunks;
+    guint64 disk_size;
+    const gchar *charset;
+    gboolean has_bom;
+} ReloadResult;
+
 typedef struct {
     FlowWindow *window;
     GFile *directory;
@@ -49,7 +228,7 @@ struct _FlowWindow
     AdwViewStack *sidebar_stack;
     AdwTabView *tab_view;
     AdwTabBar *tab_bar;
-    GtkBox *file_list_container;
+    GtkListView *file_list_view;
     GtkLabel *no_folder_label;
     GtkButton *open_folder_button;
     GtkButton *toggle_sidebar_button;
@@ -61,8 +240,16 @@ struct _FlowWindow
     GtkPopover *command_popover;
     GtkSearchEntry *command_search;
     GtkListBox *command_list;
+    GtkPopover *quick_open_popover;
+    GtkSearchEntry *quick_open_search;
+    GtkListBox *quick_open_list;
+    GCancellable *quick_open_cancellable;
+    GCancellable *session_folder_cancellable;
+    gint quick_open_line;
+    gint quick_open_column;
     GtkSearchEntry *file_search;
     GtkLabel *sidebar_folder_label;
+    GtkBox *ai_sidebar_box;
     GtkBox *ai_message_list;
     GtkEntry *ai_message_entry;
     GtkButton *ai_send_button;
@@ -71,10 +258,39 @@ struct _FlowWindow
     GFile *current_folder;
     gboolean dark_mode;
     gchar *search_text;
+    GtkCustomSorter *file_sorter;
+    GtkCustomFilter *file_filter;
+    FlowIgnore *ignore;
+    gboolean show_ignored;
+    GtkTreeListModel *file_tree;
+    GHashTable *folder_models;      /* URI -> FolderModelRef of an expanded directory */
+    guint folder_models_sweep_id;
+    GtkSelectionModel *file_tree_selection;
+    FlowWorkspaceIndex *workspace_index;
+    GtkSelectionModel *file_results_selection;
     gboolean show_welcome;
     gchar *ai_model;
     gboolean ai_request_in_progress;
     GPtrArray *ai_conversation;
+    GSettings *settings;
+    FlowSaveDurability save_durability;
+    gboolean recompress_on_save;
+    guint follow_max_lines;
+    guint stats_idle_id;
+    gboolean restore_session;
+    gboolean session_saved;
+    GHashTable *expanded_folders;
+    guint tab_memory_budget_mb;
+    guint memory_idle_id;
+    guint undo_history_limit_mb;
+    guint startup_idle_id;
+    guint startup_step;
+    gboolean assistant_built;
+    gboolean commands_populated;
+    gboolean startup_timing;
+    gint64 init_started;
+    gint64 init_finished;
+    gint64 deferred_time;
 };
 
 G_DEFINE_FINAL_TYPE (FlowWindow, flow_window, ADW_TYPE_APPLICATION_WINDOW)
@@ -83,15 +299,27 @@ G_DEFINE_FINAL_TYPE (FlowWindow, flow_window, ADW_TYPE_APPLICATION_WINDOW)
 static TabData* tab_data_new (void);
 static void tab_data_free (TabData *data);
 static TabData* get_current_tab_data (FlowWindow *self);
-static void create_new_tab (FlowWindow *self, const gchar *title, GFile *file);
+static TabData* create_new_tab (FlowWindow *self, const gchar *title, GFile *file);
+static void open_file_in_new_tab (FlowWindow *self, GFile *file);
+static void open_file_in_text_tab (FlowWindow *self, GFile *file, TabData *placeholder);
+static gboolean open_file_in_viewer_tab (FlowWindow *self, GFile *file, gboolean hex, TabData *placeholder,
+                                         GError **error);
+static void tab_data_start_loading (TabData *data);
+static void tab_data_wake_from_disk (TabData *data);
+static void folder_watch_schedule (FolderWatch *watch);
+static void set_status_text (FlowWindow *self, const gchar *text);
+static void tab_data_save (TabData *data, GFile *file, gboolean retitle);
+static void tab_data_watch_file (TabData *data);
+static void tab_data_check_disk (TabData *data, gboolean force);
+static void tab_data_connect_stats (FlowWindow *self, TabData *data);
 static void create_welcome_tab (FlowWindow *self);
 static void apply_theme (FlowWindow *self);
 static void load_folder (FlowWindow *self, GFile *folder);
 static void update_sidebar_folder_label (FlowWindow *self, GFile *folder);
-static void load_folder_tree (FlowWindow *self, GFile *folder, GtkWidget *parent, gint depth);
-static void on_expander_activated (GtkExpander *expander, gpointer user_data);
 static void on_file_search_changed (GtkSearchEntry *entry, FlowWindow *self);
 static void update_stats (FlowWindow *self);
+static void queue_update_stats (FlowWindow *self);
+static void goto_line (FlowWindow *self, guint64 line);
 
 static void on_toggle_sidebar_clicked (GtkButton *button, FlowWindow *self);
 static void on_settings_clicked (GtkButton *button, FlowWindow *self);
@@ -99,13 +327,14 @@ static void on_theme_switch_toggled (GtkSwitch *sw, GParamSpec *pspec, FlowWindo
 static void show_preferences_window (FlowWindow *self);
 static void on_welcome_switch_toggled (GtkSwitch *sw, GParamSpec *pspec, FlowWindow *self);
 static void on_command_palette_clicked (GtkButton *button, FlowWindow *self);
+static void command_list_ensure (FlowWindow *self);
 static void on_open_folder_clicked (GtkButton *button, FlowWindow *self);
 static void on_command_activated (GtkListBox *box, GtkListBoxRow *row, FlowWindow *self);
 static void on_command_search_changed (GtkSearchEntry *entry, FlowWindow *self);
+static void quick_open_show (FlowWindow *self);
+static void on_workspace_index_ready (FlowWindow *self);
 static gboolean on_key_pressed (GtkEventControllerKey *controller, guint keyval, guint keycode, GdkModifierType state, FlowWindow *self);
 static gboolean on_tab_close_request (AdwTabView *view, AdwTabPage *page, FlowWindow *self);
-static void on_file_button_clicked (GtkButton *button, FlowWindow *self);
-static void on_file_row_activated (FlowWindow *self, gpointer user_data);
 static void on_page_attached (AdwTabView *view, AdwTabPage *page, gint position, FlowWindow *self);
 static void on_selected_page_changed (GObject *object, GParamSpec *pspec, FlowWindow *self);
 static void on_folder_dialog_response (GObject *source, GAsyncResult *result, gpointer user_data);
@@ -125,6 +354,14 @@ static gboolean header_has_chunked_encoding (const gchar *headers, gsize header_
 static gchar *decode_chunked_body (const gchar *body, gsize body_len, gsize *out_len, GError **error);
 static guint ai_model_index_from_name (const gchar *name);
 static void on_ai_model_selected (AdwComboRow *row, GParamSpec *pspec, FlowWindow *self);
+static void on_save_durability_selected (AdwComboRow *row, GParamSpec *pspec, FlowWindow *self);
+static void on_recompress_switch_toggled (GtkSwitch *sw, GParamSpec *pspec, FlowWindow *self);
+static void on_restore_session_switch_toggled (GtkSwitch *sw, GParamSpec *pspec, FlowWindow *self);
+static void on_show_ignored_switch_toggled (GtkSwitch *sw, GParamSpec *pspec, FlowWindow *self);
+static void on_follow_max_lines_changed (AdwSpinRow *row, GParamSpec *pspec, FlowWindow *self);
+static void on_tab_memory_budget_changed (AdwSpinRow *row, GParamSpec *pspec, FlowWindow *self);
+static void on_undo_history_limit_changed (AdwSpinRow *row, GParamSpec *pspec, FlowWindow *self);
+static void queue_memory_budget_check (FlowWindow *self);
 
 static AiMessage *ai_message_new (const gchar *role, const gchar *content);
 static void ai_message_free (AiMessage *msg);
@@ -140,6 +377,13 @@ static const gchar *AI_DEFAULT_MODEL = "gpt-5-nano";
 static const gchar *AI_HOST = "text.pollinations.ai";
 static const gchar *AI_PATH = "/openai";
 static const gchar *AI_REFERRER = "https://g4f.dev/";
+/* Indexed by FlowSaveDurability. */
+static const gchar *SAVE_DURABILITY_LABELS[] = {
+    "Leave to the system",
+    "Flush file",
+    "Flush file and folder",
+    NULL
+};
 static const gchar *AI_AVAILABLE_MODELS[] = {
     "gpt-5-nano",
     "gpt-5-mini",
@@ -185,10 +429,148 @@ ai_http_result_free (AiHttpResult *result)
     g_free (result);
 }
 
-static TabData*
-tab_data_new (void)
+static void
+on_load_cancel_clicked (GtkButton *button, TabData *data)
 {
-    TabData *data = g_new0 (TabData, 1);
+    if (data->loader)
+        flow_file_loader_cancel (data->loader);
+}
+
+/*
+ * Starts journaling the tab's unsaved edits, from its text as it was
+ * before the first of them.  Followed files and very large documents are
+ * left out.
+ */
+static void
+tab_data_journal_begin (TabData *data)
+{
+    FlowPieceTableSnapshot *base;
+    gchar *uri;
+    
+    if (data->journal || data->follower || data->load_incomplete ||
+        flow_piece_table_get_length (data->document) > FLOW_JOURNAL_MAX_BASE_SIZE)
+        return;
+    
+    uri = data->file ? g_file_get_uri (data->file) : NULL;
+    base = flow_piece_table_snapshot (data->document);
+    data->journal = flow_journal_new (NULL, uri, data->charset, data->has_bom, data->compression, base);
+    flow_piece_table_snapshot_unref (base);
+    g_free (uri);
+}
+
+/* Drops the journal once the tab has nothing left to recover. */
+static void
+tab_data_journal_discard (TabData *data)
+{
+    if (!data->journal)
+        return;
+    
+    flow_journal_discard (data->journal);
+    g_clear_pointer (&data->journal, flow_journal_unref);
+}
+
+static void
+tab_data_journal_compact (TabData *data)
+{
+    FlowPieceTableSnapshot *snapshot;
+    
+    if (!flow_journal_wants_compaction (data->journal))
+        return;
+    
+    snapshot = flow_piece_table_snapshot (data->document);
+    flow_journal_compact (data->journal, snapshot);
+    flow_piece_table_snapshot_unref (snapshot);
+}
+
+/* The piece table follows every change made to the buffer, so save and
+ * other whole-document operations never need to flatten the buffer. */
+static void
+on_buffer_insert_text (GtkTextBuffer *buffer, GtkTextIter *location, gchar *text, gint len, TabData *data)
+{
+    gsize offset = (gsize) gtk_text_iter_get_offset (location);
+    
+    tab_data_journal_begin (data);
+    flow_piece_table_insert (data->document, offset, text, (gsize) len);
+    data->change_serial++;
+    if (!data->undo_suspended)
+        flow_undo_record_insert (data->undo, offset, text, (gsize) len);
+    
+    if (data->journal) {
+        flow_journal_insert (data->journal, offset, text, (gsize) len);
+        tab_data_journal_compact (data);
+    }
+}
+
+static void
+on_buffer_delete_range (GtkTextBuffer *buffer, GtkTextIter *start, GtkTextIter *end, TabData *data)
+{
+    gint start_offset = gtk_text_iter_get_offset (start);
+    gint end_offset = gtk_text_iter_get_offset (end);
+    gsize offset = (gsize) MIN (start_offset, end_offset);
+    gsize n_chars = (gsize) ABS (end_offset - start_offset);
+    
+    tab_data_journal_begin (data);
+    if (!data->undo_suspended) {
+        gchar *deleted = gtk_text_iter_get_slice (start, end);
+        
+        flow_undo_record_delete (data->undo, offset, deleted, strlen (deleted));
+        g_free (deleted);
+    }
+    flow_piece_table_delete (data->document, offset, n_chars);
+    data->change_serial++;
+    
+    if (data->journal) {
+        flow_journal_delete (data->journal, offset, n_chars);
+        tab_data_journal_compact (data);
+    }
+}
+
+/* Saved, reloaded or undone back to what is on disk. */
+static void
+on_buffer_modified_changed (GtkTextBuffer *buffer, TabData *data)
+{
+    if (!gtk_text_buffer_get_modified (buffer))
+        tab_data_journal_discard (data);
+}
+
+/* A user action, such as typing over a selection, is undone as a whole. */
+static void
+on_buffer_begin_user_action (GtkTextBuffer *buffer, TabData *data)
+{
+    if (!data->undo_suspended)
+        flow_undo_begin_action (data->undo);
+}
+
+static void
+on_buffer_end_user_action (GtkTextBuffer *buffer, TabData *data)
+{
+    if (!data->undo_suspended)
+        flow_undo_end_action (data->undo);
+}
+
+/* Detaches the tab from its buffer and drops the reference to it. */
+static void
+tab_data_release_buffer (TabData *data)
+{
+    if (!data->buffer)
+        return;
+    
+    g_signal_handler_disconnect (data->buffer, data->insert_handler);
+    g_signal_handler_disconnect (data->buffer, data->delete_handler);
+    g_signal_handlers_disconnect_by_func (data->buffer, on_buffer_modified_changed, data);
+    g_signal_handlers_disconnect_by_func (data->buffer, on_buffer_begin_user_action, data);
+    g_signal_handlers_disconnect_by_func (data->buffer, on_buffer_end_user_action, data);
+    data->insert_handler = 0;
+    data->delete_handler = 0;
+    g_clear_object (&data->buffer);
+}
+
+/* Builds the editor of a text tab, into @data->root if it already has one. */
+static void
+tab_data_init_text (TabData *data)
+{
+    GtkTextBuffer *buffer;
+    GtkWidget *cancel_button;
     
     data->text_view = GTK_SOURCE_VIEW (gtk_source_view_new ());
     gtk_text_view_set_wrap_mode (GTK_TEXT_VIEW (data->text_view), GTK_WRAP_WORD_CHAR);
@@ -203,11 +585,77 @@ tab_data_new (void)
     gtk_source_view_set_auto_indent (data->text_view, TRUE);
     gtk_text_view_set_editable (GTK_TEXT_VIEW (data->text_view), TRUE);
     
+    data->document = flow_piece_table_new ();
+    buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
+    /* The page drops its child before its data, so the buffer is held
+     * here for the handlers to be disconnected from it. */
+    data->buffer = g_object_ref (buffer);
+    data->insert_handler = g_signal_connect (buffer, "insert-text", G_CALLBACK (on_buffer_insert_text), data);
+    data->delete_handler = g_signal_connect (buffer, "delete-range", G_CALLBACK (on_buffer_delete_range), data);
+    g_signal_connect (buffer, "modified-changed", G_CALLBACK (on_buffer_modified_changed), data);
+    g_signal_connect (buffer, "begin-user-action", G_CALLBACK (on_buffer_begin_user_action), data);
+    g_signal_connect (buffer, "end-user-action", G_CALLBACK (on_buffer_end_user_action), data);
+    
+    /* Undo history is kept by FlowUndo, which can bound its size, rather
+     * than by the buffer.  A hibernated tab keeps its history. */
+    gtk_text_buffer_set_enable_undo (buffer, FALSE);
+    if (!data->undo)
+        data->undo = flow_undo_new ();
+    
     data->scrolled = GTK_SCROLLED_WINDOW (gtk_scrolled_window_new ());
     gtk_scrolled_window_set_child (data->scrolled, GTK_WIDGET (data->text_view));
+    gtk_widget_set_vexpand (GTK_WIDGET (data->scrolled), TRUE);
+    
+    data->load_bar = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 8);
+    gtk_widget_set_margin_start (data->load_bar, 12);
+    gtk_widget_set_margin_end (data->load_bar, 12);
+    gtk_widget_set_margin_top (data->load_bar, 6);
+    gtk_widget_set_margin_bottom (data->load_bar, 6);
+    data->load_progress = GTK_PROGRESS_BAR (gtk_progress_bar_new ());
+    gtk_progress_bar_set_show_text (data->load_progress, TRUE);
+    gtk_widget_set_hexpand (GTK_WIDGET (data->load_progress), TRUE);
+    gtk_widget_set_valign (GTK_WIDGET (data->load_progress), GTK_ALIGN_CENTER);
+    gtk_box_append (GTK_BOX (data->load_bar), GTK_WIDGET (data->load_progress));
+    cancel_button = gtk_button_new_with_label ("Cancel");
+    gtk_widget_add_css_class (cancel_button, "flat");
+    g_signal_connect (cancel_button, "clicked", G_CALLBACK (on_load_cancel_clicked), data);
+    gtk_box_append (GTK_BOX (data->load_bar), cancel_button);
+    gtk_widget_set_visible (data->load_bar, FALSE);
+    
+    if (!data->root)
+        data->root = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+    gtk_box_append (GTK_BOX (data->root), data->load_bar);
+    gtk_box_append (GTK_BOX (data->root), GTK_WIDGET (data->scrolled));
     
-    data->file = NULL;
     data->is_welcome = FALSE;
+}
+
+static TabData*
+tab_data_new (void)
+{
+    TabData *data = g_new0 (TabData, 1);
+    
+    tab_data_init_text (data);
+    return data;
+}
+
+/*
+ * A tab restored from the last session that has not been looked at yet:
+ * only a title and an empty box.  The editor is built and the file read
+ * when the tab is first selected.
+ */
+static TabData*
+tab_data_new_placeholder (FlowWindow *self, GFile *file, gint line, gint column)
+{
+    TabData *data = g_new0 (TabData, 1);
+    
+    data->window = self;
+    data->file = g_object_ref (file);
+    data->root = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+    data->placeholder = TRUE;
+    data->restore_cursor = TRUE;
+    data->restore_line = line;
+    data->restore_column = column;
     
     return data;
 }
@@ -266,6 +714,7 @@ tab_data_new_welcome (FlowWindow *self)
     
     data->scrolled = GTK_SCROLLED_WINDOW (gtk_scrolled_window_new ());
     gtk_scrolled_window_set_child (data->scrolled, GTK_WIDGET (box));
+    data->root = GTK_WIDGET (data->scrolled);
     
     data->text_view = NULL;
     data->file = NULL;
@@ -277,6 +726,46 @@ tab_data_new_welcome (FlowWindow *self)
 static void
 tab_data_free (TabData *data)
 {
+    if (data->load_source_id)
+        g_source_remove (data->load_source_id);
+    if (data->loader) {
+        flow_file_loader_cancel (data->loader);
+        flow_file_loader_unref (data->loader);
+    }
+    if (data->load_chunk)
+        g_bytes_unref (data->load_chunk);
+    if (data->refill_iter)
+        flow_piece_table_iter_free (data->refill_iter);
+    if (data->refill_snapshot)
+        flow_piece_table_snapshot_unref (data->refill_snapshot);
+    if (data->follower) {
+        flow_file_follower_cancel (data->follower);
+        flow_file_follower_unref (data->follower);
+    }
+    if (data->monitor) {
+        g_signal_handlers_disconnect_by_data (data->monitor, data);
+        g_file_monitor_cancel (data->monitor);
+        g_object_unref (data->monitor);
+    }
+    if (data->reload_request) {
+        g_cancellable_cancel (data->reload_request->cancellable);
+        data->reload_request->data = NULL;
+    }
+    if (data->disk_snapshot)
+        flow_piece_table_snapshot_unref (data->disk_snapshot);
+    if (data->save_request)
+        data->save_request->data = NULL;
+    if (data->open_request)
+        data->open_request->placeholder = NULL;
+    if (data->hibernate_request)
+        data->hibernate_request->data = NULL;
+    if (data->hibernated)
+        g_bytes_unref (data->hibernated);
+    tab_data_journal_discard (data);
+    g_free (data->recovered_path);
+    tab_data_release_buffer (data);
+    flow_piece_table_free (data->document);
+    flow_undo_free (data->undo);
     if (data->file)
         g_object_unref (data->file);
     g_free (data);
@@ -291,255 +780,2361 @@ get_current_tab_data (FlowWindow *self)
     return g_object_get_data (G_OBJECT (page), "tab-data");
 }
 
+/* Picks syntax highlighting from the name of the tab's file. */
 static void
+tab_data_guess_language (TabData *data)
+{
+    GtkSourceLanguage *lang;
+    gchar *basename;
+    
+    if (!data->file)
+        return;
+    
+    basename = g_file_get_basename (data->file);
+    lang = flow_languages_guess (basename);
+    g_free (basename);
+    if (lang)
+        gtk_source_buffer_set_language (GTK_SOURCE_BUFFER (gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view))),
+                                        lang);
+}
+
+static TabData*
 create_new_tab (FlowWindow *self, const gchar *title, GFile *file)
 {
     TabData *data;
     AdwTabPage *page;
-    GtkSourceBuffer *buffer;
     
     data = tab_data_new ();
+    data->window = self;
     data->file = file ? g_object_ref (file) : NULL;
+    flow_undo_set_byte_cap (data->undo, (gsize) self->undo_history_limit_mb * 1024 * 1024);
     
-    page = adw_tab_view_append (self->tab_view, GTK_WIDGET (data->scrolled));
+    page = adw_tab_view_append (self->tab_view, data->root);
     adw_tab_page_set_title (page, title);
+    data->page = page;
     
     g_object_set_data_full (G_OBJECT (page), "tab-data", data, (GDestroyNotify) tab_data_free);
     
-    if (file) {
-        GtkSourceLanguageManager *lm = gtk_source_language_manager_get_default ();
-        GtkSourceLanguage *lang = gtk_source_language_manager_guess_language (lm, g_file_get_basename (file), NULL);
-        buffer = GTK_SOURCE_BUFFER (gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view)));
-        if (lang)
-            gtk_source_buffer_set_language (buffer, lang);
-    }
-    
+    tab_data_guess_language (data);
     apply_theme (self);
     adw_tab_view_set_selected_page (self->tab_view, page);
+    
+    return data;
 }
 
 static void
-create_welcome_tab (FlowWindow *self)
+set_status_text (FlowWindow *self, const gchar *text)
 {
-    TabData *data;
-    AdwTabPage *page;
+    if (self->status_label)
+        gtk_label_set_text (self->status_label, text);
+}
+
+/* Largest prefix of @len bytes at @text that ends on a character boundary. */
+static gsize
+utf8_slice_length (const gchar *text, gsize len, gsize available)
+{
+    if (len >= available)
+        return available;
+    while (len > 0 && ((guchar) text[len] & 0xC0) == 0x80)
+        len--;
+    return len;
+}
+
+/* Whether the tab's buffer is still being filled, from its file or from
+ * its piece table. */
+static gboolean
+tab_data_is_loading (TabData *data)
+{
+    return data->loader != NULL || data->refill_iter != NULL;
+}
+
+/* Puts the cursor back where it was before the tab's text was read. */
+static void
+tab_data_restore_cursor (TabData *data)
+{
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
+    GtkTextIter cursor;
     
-    if (!self->show_welcome)
+    if (!data->restore_cursor)
         return;
     
-    data = tab_data_new_welcome (self);
-    
-    page = adw_tab_view_append (self->tab_view, GTK_WIDGET (data->scrolled));
-    adw_tab_page_set_title (page, "Welcome");
-    
-    g_object_set_data_full (G_OBJECT (page), "tab-data", data, (GDestroyNotify) tab_data_free);
-    
-    adw_tab_view_set_selected_page (self->tab_view, page);
+    gtk_text_buffer_get_iter_at_line_offset (buffer, &cursor, data->restore_line, data->restore_column);
+    gtk_text_buffer_place_cursor (buffer, &cursor);
+    gtk_text_view_scroll_to_mark (GTK_TEXT_VIEW (data->text_view), gtk_text_buffer_get_insert (buffer),
+                                  0.0, TRUE, 0.0, 0.3);
+    data->restore_cursor = FALSE;
 }
 
 static void
-apply_theme (FlowWindow *self)
+tab_load_finish (TabData *data, GError *error)
 {
-    GtkSourceStyleSchemeManager *sm;
-    GtkSourceStyleScheme *scheme;
-    AdwStyleManager *style_manager;
-    const gchar *scheme_name;
-    guint n_pages, i;
+    FlowWindow *self = data->window;
+    GtkTextBuffer *buffer;
+    GtkTextIter start;
+    gboolean empty;
+    gboolean rehydrated = FALSE;
     
-    style_manager = adw_style_manager_get_default ();
+    buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
+    g_signal_handler_unblock (buffer, data->insert_handler);
+    g_signal_handler_unblock (buffer, data->delete_handler);
+    gtk_source_buffer_set_highlight_syntax (GTK_SOURCE_BUFFER (buffer), TRUE);
+    gtk_text_buffer_set_modified (buffer, FALSE);
+    gtk_text_buffer_get_start_iter (buffer, &start);
+    gtk_text_buffer_place_cursor (buffer, &start);
+    empty = gtk_text_buffer_get_char_count (buffer) == 0;
     
-    if (self->dark_mode) {
-        adw_style_manager_set_color_scheme (style_manager, ADW_COLOR_SCHEME_FORCE_DARK);
-        scheme_name = "Adwaita-dark";
+    gtk_widget_set_visible (data->load_bar, FALSE);
+    if (data->page)
+        adw_tab_page_set_loading (data->page, FALSE);
+    
+    /* Saving writes the text back the way it was found on disk.  A tab
+     * woken from hibernation was loaded from memory and keeps what it
+     * knew about its file.  Its text stays held until it has loaded. */
+    if (data->hibernated) {
+        rehydrated = TRUE;
     } else {
-        adw_style_manager_set_color_scheme (style_manager, ADW_COLOR_SCHEME_FORCE_LIGHT);
-        scheme_name = "Adwaita";
+        data->charset = flow_file_loader_get_charset (data->loader);
+        data->has_bom = flow_file_loader_get_has_bom (data->loader);
+        data->compression = flow_file_loader_get_compression (data->loader);
+        data->disk_size = flow_file_loader_get_bytes_read (data->loader);
     }
+    g_clear_pointer (&data->loader, flow_file_loader_unref);
     
-    sm = gtk_source_style_scheme_manager_get_default ();
-    scheme = gtk_source_style_scheme_manager_get_scheme (sm, scheme_name);
-    
-    if (!scheme)
+    if (!error) {
+        g_clear_pointer (&data->hibernated, g_bytes_unref);
+        gtk_text_view_set_editable (GTK_TEXT_VIEW (data->text_view), TRUE);
+        if (rehydrated) {
+            /* Quietly, as if it had never been unloaded. */
+        } else if (flow_encoding_is_utf8 (data->charset) && data->compression == FLOW_COMPRESSION_NONE) {
+            set_status_text (self, "Loaded");
+        } else {
+            GString *text = g_string_new ("Loaded");
+            if (!flow_encoding_is_utf8 (data->charset))
+                g_string_append_printf (text, " as %s", data->charset);
+            if (data->compression != FLOW_COMPRESSION_NONE)
+                g_string_append_printf (text, " (%s)", flow_compression_get_name (data->compression));
+            set_status_text (self, text->str);
+            g_string_free (text, TRUE);
+        }
+        if (data->undo_lost) {
+            set_status_text (self, "Could not wake the tab; reloaded it from disk and its undo history was lost");
+            data->undo_lost = FALSE;
+        }
+        if (data->recovered_path) {
+            /* Recovered edits were never saved; a new journal takes over
+             * the old one's file. */
+            FlowPieceTableSnapshot *base = flow_piece_table_snapshot (data->document);
+            gchar *uri = data->file ? g_file_get_uri (data->file) : NULL;
+            
+            data->journal = flow_journal_new (data->recovered_path, uri, data->charset, data->has_bom,
+                                              data->compression, base);
+            flow_piece_table_snapshot_unref (base);
+            g_free (uri);
+            g_clear_pointer (&data->recovered_path, g_free);
+            gtk_text_buffer_set_modified (buffer, TRUE);
+            flow_undo_mark_unsaved (data->undo);
+            set_status_text (self, "Recovered unsaved changes");
+        } else {
+            data->disk_snapshot = flow_piece_table_snapshot (data->document);
+        }
+        /* A woken tab carries on with the history it had. */
+        if (!rehydrated)
+            flow_undo_clear (data->undo);
+        tab_data_watch_file (data);
+        tab_data_restore_cursor (data);
+        /* The file may have changed while the tab was asleep. */
+        if (rehydrated && data->disk_snapshot)
+            tab_data_check_disk (data, FALSE);
+        queue_update_stats (self);
+        queue_memory_budget_check (self);
         return;
+    }
     
-    n_pages = adw_tab_view_get_n_pages (self->tab_view);
-    for (i = 0; i < n_pages; i++) {
-        AdwTabPage *page = adw_tab_view_get_nth_page (self->tab_view, i);
-        TabData *data = g_object_get_data (G_OBJECT (page), "tab-data");
-        if (data && data->text_view && !data->is_welcome) {
-            GtkSourceBuffer *buffer = GTK_SOURCE_BUFFER (gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view)));
-            if (GTK_SOURCE_IS_BUFFER (buffer))
-                gtk_source_buffer_set_style_scheme (buffer, scheme);
+    /* Keep whatever was read, but never let a partial file be saved over
+     * the original. */
+    data->load_incomplete = TRUE;
+    
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        /* The history was for the whole of the held text, not the part
+         * that made it back. */
+        if (rehydrated) {
+            g_clear_pointer (&data->hibernated, g_bytes_unref);
+            flow_undo_clear (data->undo);
+            data->undo_lost = TRUE;
         }
+        set_status_text (self, data->undo_lost ? "Loading cancelled; undo history was lost" : "Loading cancelled");
+        data->undo_lost = FALSE;
+        g_error_free (error);
+        return;
+    }
+    
+    /* A hibernated tab was unmodified, so its file has the same text.
+     * Recovered edits exist nowhere else and are kept instead. */
+    if (rehydrated && data->file && !data->recovered_path) {
+        g_warning ("Failed to wake tab, reading its file again: %s", error->message);
+        g_error_free (error);
+        tab_data_wake_from_disk (data);
+        return;
     }
+    
+    g_warning ("Failed to load file: %s", error->message);
+    set_status_text (self, data->undo_lost ? "Failed to load file; undo history was lost" : "Failed to load file");
+    data->undo_lost = FALSE;
+    g_error_free (error);
+    
+    if (empty && data->page && !rehydrated)
+        adw_tab_view_close_page (self->tab_view, data->page);
 }
 
+/* Replaces what a tab failed to wake with a fresh read of its file.  The
+ * undo history belonged to the held text and goes with it, which the
+ * status bar says once the file is read. */
 static void
-load_folder_tree (FlowWindow *self, GFile *folder, GtkWidget *parent, gint depth)
+tab_data_wake_from_disk (TabData *data)
 {
-    GFileEnumerator *enumerator;
-    GError *error = NULL;
-    GFileInfo *info;
-    GPtrArray *dirs;
-    GPtrArray *files;
-    guint i;
-    const gchar *search_text;
+    g_clear_pointer (&data->hibernated, g_bytes_unref);
     
-    if (depth > 10)
-        return;
-    
-    search_text = self->search_text;
+    g_signal_handler_block (data->buffer, data->insert_handler);
+    g_signal_handler_block (data->buffer, data->delete_handler);
+    gtk_text_buffer_set_text (data->buffer, "", 0);
+    g_signal_handler_unblock (data->buffer, data->insert_handler);
+    g_signal_handler_unblock (data->buffer, data->delete_handler);
     
-    dirs = g_ptr_array_new ();
-    files = g_ptr_array_new ();
+    flow_piece_table_free (data->document);
+    data->document = flow_piece_table_new ();
+    flow_undo_clear (data->undo);
+    data->undo_lost = TRUE;
     
-    enumerator = g_file_enumerate_children (folder,
-        G_FILE_ATTRIBUTE_STANDARD_NAME "," G_FILE_ATTRIBUTE_STANDARD_TYPE,
-        G_FILE_QUERY_INFO_NONE, NULL, &error);
+    tab_data_start_loading (data);
+}
+
+static gboolean
+tab_load_step (gpointer user_data)
+{
+    TabData *data = user_data;
+    GtkTextBuffer *buffer;
+    gint64 deadline;
+    gboolean finished = FALSE;
+    GError *error = NULL;
     
-    if (!enumerator) {
-        g_warning ("Failed to enumerate folder: %s", error->message);
-        g_error_free (error);
-        g_ptr_array_free (dirs, TRUE);
-        g_ptr_array_free (files, TRUE);
-        return;
-    }
+    data->load_source_id = 0;
+    buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
+    deadline = g_get_monotonic_time () + TAB_LOAD_FRAME_BUDGET_US;
     
-    while ((info = g_file_enumerator_next_file (enumerator, NULL, &error)) != NULL) {
-        const gchar *name;
-        GFileType type;
-        
-        name = g_file_info_get_name (info);
-        type = g_file_info_get_file_type (info);
+    do {
+        const gchar *chunk;
+        gsize chunk_len;
+        gsize slice;
+        GtkTextIter end;
         
-        if (search_text && *search_text && !strstr (name, search_text)) {
-            g_object_unref (info);
-            continue;
+        if (!data->load_chunk) {
+            data->load_chunk = flow_file_loader_pop_chunk (data->loader, &finished, &error);
+            data->load_chunk_offset = 0;
+            if (!data->load_chunk)
+                break;
+            /* The document shares the chunk; the buffer gets it in slices. */
+            flow_piece_table_append_bytes (data->document, data->load_chunk);
         }
         
-        if (type == G_FILE_TYPE_DIRECTORY)
-            g_ptr_array_add (dirs, g_object_ref (info));
-        else if (type == G_FILE_TYPE_REGULAR)
-            g_ptr_array_add (files, g_object_ref (info));
-        else
-            g_object_unref (info);
-    }
-    
-    if (error) {
-        g_warning ("Error during enumeration: %s", error->message);
-        g_error_free (error);
-    }
-    
-    g_object_unref (enumerator);
-    
-    for (i = 0; i < dirs->len; i++) {
-        GtkWidget *expander;
-        GtkWidget *box;
-        GtkWidget *icon;
-        GtkWidget *label;
-        GtkWidget *inner_box;
-        GFile *dir_file;
-        const gchar *name;
+        chunk = g_bytes_get_data (data->load_chunk, &chunk_len);
+        chunk += data->load_chunk_offset;
+        slice = utf8_slice_length (chunk, TAB_LOAD_SLICE_SIZE, chunk_len - data->load_chunk_offset);
         
-        info = g_ptr_array_index (dirs, i);
-        name = g_file_info_get_name (info);
-        dir_file = g_file_get_child (folder, name);
+        gtk_text_buffer_get_end_iter (buffer, &end);
+        gtk_text_buffer_insert (buffer, &end, chunk, (gint) slice);
         
-        box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 4);
-        icon = gtk_image_new_from_icon_name ("folder-symbolic");
-        gtk_image_set_pixel_size (GTK_IMAGE (icon), 16);
-        label = gtk_label_new (name);
-        gtk_label_set_xalign (GTK_LABEL (label), 0);
-        gtk_widget_set_hexpand (label, TRUE);
-        gtk_box_append (GTK_BOX (box), icon);
-        gtk_box_append (GTK_BOX (box), label);
-        
-        expander = gtk_expander_new (NULL);
-        gtk_expander_set_label_widget (GTK_EXPANDER (expander), box);
-        gtk_widget_add_css_class (expander, "file-tree-item");
-        
-        inner_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
-        gtk_widget_set_margin_start (inner_box, 12);
-        gtk_expander_set_child (GTK_EXPANDER (expander), inner_box);
-        
-        g_object_set_data_full (G_OBJECT (expander), "folder", dir_file, g_object_unref);
-        g_object_set_data (G_OBJECT (expander), "inner-box", inner_box);
-        g_object_set_data (G_OBJECT (expander), "window", self);
-        g_object_set_data (G_OBJECT (expander), "depth", GINT_TO_POINTER (depth));
-        g_signal_connect (expander, "activate", G_CALLBACK (on_expander_activated), self);
-        
-        gtk_box_append (GTK_BOX (parent), expander);
-        g_object_unref (info);
-    }
+        data->load_chunk_offset += slice;
+        if (data->load_chunk_offset >= chunk_len)
+            g_clear_pointer (&data->load_chunk, g_bytes_unref);
+    } while (g_get_monotonic_time () < deadline);
     
-    for (i = 0; i < files->len; i++) {
-        GtkWidget *button;
-        GtkWidget *box;
-        GtkWidget *icon;
-        GtkWidget *label;
-        GFile *file;
-        const gchar *name;
-        
-        info = g_ptr_array_index (files, i);
-        name = g_file_info_get_name (info);
-        file = g_file_get_child (folder, name);
-        
-        button = gtk_button_new ();
-        gtk_widget_add_css_class (button, "flat");
-        gtk_widget_add_css_class (button, "file-tree-item");
-        
-        box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 4);
-        icon = gtk_image_new_from_icon_name ("text-x-generic-symbolic");
-        gtk_image_set_pixel_size (GTK_IMAGE (icon), 16);
-        label = gtk_label_new (name);
-        gtk_label_set_xalign (GTK_LABEL (label), 0);
-        gtk_widget_set_hexpand (label, TRUE);
-        gtk_box_append (GTK_BOX (box), icon);
-        gtk_box_append (GTK_BOX (box), label);
-        
-        gtk_button_set_child (GTK_BUTTON (button), box);
-        g_object_set_data_full (G_OBJECT (button), "file", file, g_object_unref);
-        g_object_set_data (G_OBJECT (button), "window", self);
-        
-        g_signal_connect (button, "clicked", G_CALLBACK (on_file_button_clicked), self);
-        
-        gtk_box_append (GTK_BOX (parent), button);
-        g_object_unref (info);
+    if (finished) {
+        tab_load_finish (data, error);
+        return G_SOURCE_REMOVE;
     }
     
-    g_ptr_array_free (dirs, TRUE);
-    g_ptr_array_free (files, TRUE);
+    gtk_progress_bar_set_fraction (data->load_progress, flow_file_loader_get_fraction (data->loader));
+    
+    /* Keep inserting on idle while text is queued; otherwise poll for the
+     * worker at a low rate instead of spinning the main loop. */
+    if (data->load_chunk)
+        data->load_source_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, tab_load_step, data, NULL);
+    else
+        data->load_source_id = g_timeout_add_full (G_PRIORITY_DEFAULT_IDLE, TAB_LOAD_POLL_INTERVAL_MS,
+                                                   tab_load_step, data, NULL);
+    return G_SOURCE_REMOVE;
 }
 
 static void
-on_expander_activated (GtkExpander *expander, gpointer user_data)
+tab_data_start_loading (TabData *data)
 {
-    GFile *folder;
-    GtkWidget *inner_box;
-    FlowWindow *self;
-    gint depth;
-    gboolean expanded;
+    GtkTextBuffer *buffer;
+    
+    g_return_if_fail (data->file != NULL || data->hibernated != NULL);
+    g_return_if_fail (data->loader == NULL);
     
-    folder = g_object_get_data (G_OBJECT (expander), "folder");
-    inner_box = g_object_get_data (G_OBJECT (expander), "inner-box");
-    self = g_object_get_data (G_OBJECT (expander), "window");
-    depth = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (expander), "depth"));
+    buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
     
-    expanded = gtk_expander_get_expanded (expander);
+    /* Loading is not an edit: no undo steps, no re-highlighting per slice,
+     * and no typing into a half-loaded buffer.  Loaded chunks go into the
+     * piece table directly rather than through the buffer signals. */
+    g_signal_handler_block (buffer, data->insert_handler);
+    g_signal_handler_block (buffer, data->delete_handler);
+    gtk_source_buffer_set_highlight_syntax (GTK_SOURCE_BUFFER (buffer), FALSE);
+    gtk_text_view_set_editable (GTK_TEXT_VIEW (data->text_view), FALSE);
+    data->load_incomplete = FALSE;
     
-    if (!expanded) {
-        GtkWidget *child;
-        while ((child = gtk_widget_get_first_child (inner_box)))
-            gtk_box_remove (GTK_BOX (inner_box), child);
-        
-        load_folder_tree (self, folder, inner_box, depth + 1);
+    gtk_progress_bar_set_fraction (data->load_progress, 0.0);
+    gtk_widget_set_visible (data->load_bar, TRUE);
+    if (data->page)
+        adw_tab_page_set_loading (data->page, TRUE);
+    
+    if (data->hibernated)
+        data->loader = flow_file_loader_new_for_bytes (data->hibernated);
+    else
+        data->loader = flow_file_loader_new (data->file);
+    flow_file_loader_start (data->loader);
+    data->load_source_id = g_timeout_add_full (G_PRIORITY_DEFAULT_IDLE, TAB_LOAD_POLL_INTERVAL_MS,
+                                               tab_load_step, data, NULL);
+}
+
+/*
+ * Only idle text tabs are shelved: one still being filled, followed or
+ * compared with its file has its buffer in use, and the modified flag put
+ * back on showing must not race a save.
+ */
+static gboolean
+tab_data_can_shelve (TabData *data)
+{
+    if (!data->text_view || !data->document || data->is_welcome || data->shelved || data->load_incomplete)
+        return FALSE;
+    return !tab_data_is_loading (data) && !data->follower && !data->reload_request && !data->save_request;
+}
+
+/*
+ * Empties the buffer of a tab that is not shown, so that its text is held
+ * once, by the piece table, until it is shown again.  The document, undo
+ * history and journal stay as they are; only the cursor and the modified
+ * flag need keeping aside.
+ */
+static void
+tab_data_shelve (TabData *data)
+{
+    GtkTextBuffer *buffer = data->buffer;
+    GtkTextIter cursor;
+    
+    if (!data->restore_cursor) {
+        gtk_text_buffer_get_iter_at_mark (buffer, &cursor, gtk_text_buffer_get_insert (buffer));
+        data->restore_line = gtk_text_iter_get_line (&cursor);
+        data->restore_column = gtk_text_iter_get_line_offset (&cursor);
+        data->restore_cursor = TRUE;
     }
+    data->shelved_modified = gtk_text_buffer_get_modified (buffer);
+    
+    g_signal_handler_block (buffer, data->insert_handler);
+    g_signal_handler_block (buffer, data->delete_handler);
+    gtk_text_buffer_set_text (buffer, "", 0);
+    g_signal_handler_unblock (buffer, data->insert_handler);
+    g_signal_handler_unblock (buffer, data->delete_handler);
+    gtk_text_buffer_set_modified (buffer, data->shelved_modified);
+    
+    data->shelved = TRUE;
 }
 
 static void
-update_sidebar_folder_label (FlowWindow *self, GFile *folder)
+tab_refill_finish (TabData *data)
 {
-    GFile *target;
+    GtkTextBuffer *buffer = data->buffer;
+    
+    g_clear_pointer (&data->refill_iter, flow_piece_table_iter_free);
+    g_clear_pointer (&data->refill_snapshot, flow_piece_table_snapshot_unref);
+    data->refill_piece = NULL;
+    data->refill_piece_len = 0;
+    
+    g_signal_handler_unblock (buffer, data->insert_handler);
+    g_signal_handler_unblock (buffer, data->delete_handler);
+    gtk_source_buffer_set_highlight_syntax (GTK_SOURCE_BUFFER (buffer), TRUE);
+    gtk_text_buffer_set_modified (buffer, data->shelved_modified);
+    gtk_text_view_set_editable (GTK_TEXT_VIEW (data->text_view), TRUE);
+    tab_data_restore_cursor (data);
+    
+    /* The file changed while the tab was shelved. */
+    if (data->check_on_show) {
+        data->check_on_show = FALSE;
+        tab_data_check_disk (data, FALSE);
+    }
+    queue_update_stats (data->window);
+    /* Switched away from before it filled. */
+    queue_memory_budget_check (data->window);
+}
+
+/* Copies the piece table back into the buffer, a frame's worth at a time. */
+static gboolean
+tab_refill_step (gpointer user_data)
+{
+    TabData *data = user_data;
+    gint64 deadline;
+    
+    data->load_source_id = 0;
+    deadline = g_get_monotonic_time () + TAB_LOAD_FRAME_BUDGET_US;
+    
+    do {
+        GtkTextIter end;
+        gsize slice;
+        
+        if (data->refill_piece_len == 0 &&
+            !flow_piece_table_iter_next (data->refill_iter, &data->refill_piece, &data->refill_piece_len)) {
+            tab_refill_finish (data);
+            return G_SOURCE_REMOVE;
+        }
+        
+        slice = utf8_slice_length (data->refill_piece, TAB_LOAD_SLICE_SIZE, data->refill_piece_len);
+        gtk_text_buffer_get_end_iter (data->buffer, &end);
+        gtk_text_buffer_insert (data->buffer, &end, data->refill_piece, (gint) slice);
+        data->refill_piece += slice;
+        data->refill_piece_len -= slice;
+    } while (g_get_monotonic_time () < deadline);
+    
+    data->load_source_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, tab_refill_step, data, NULL);
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Fills the buffer of a shelved tab that is shown again.  Like loading it
+ * is not an edit, so the piece table is left alone.  The first frame's
+ * worth goes in at once, which for most files is all of it.
+ */
+static void
+tab_data_unshelve (TabData *data)
+{
+    GtkTextBuffer *buffer = data->buffer;
+    
+    if (!data->shelved)
+        return;
+    data->shelved = FALSE;
+    
+    g_signal_handler_block (buffer, data->insert_handler);
+    g_signal_handler_block (buffer, data->delete_handler);
+    gtk_source_buffer_set_highlight_syntax (GTK_SOURCE_BUFFER (buffer), FALSE);
+    gtk_text_view_set_editable (GTK_TEXT_VIEW (data->text_view), FALSE);
+    
+    data->refill_snapshot = flow_piece_table_snapshot (data->document);
+    data->refill_iter = flow_piece_table_iter_new (data->refill_snapshot);
+    tab_refill_step (data);
+}
+
+/* Opens @file as text, in a new tab or in place of @placeholder. */
+static void
+open_file_in_text_tab (FlowWindow *self, GFile *file, TabData *placeholder)
+{
+    gchar *basename;
+    TabData *data;
+    
+    if (placeholder) {
+        data = placeholder;
+        tab_data_init_text (data);
+        flow_undo_set_byte_cap (data->undo, (gsize) self->undo_history_limit_mb * 1024 * 1024);
+        tab_data_guess_language (data);
+        tab_data_connect_stats (self, data);
+        apply_theme (self);
+    } else {
+        basename = g_file_get_basename (file);
+        data = create_new_tab (self, basename, file);
+        g_free (basename);
+    }
+    
+    tab_data_start_loading (data);
+}
+
+/* Scrolls a restored viewer back to where it was once lines are known. */
+static void
+on_viewer_restore_indexing (FlowMappedViewer *viewer, GParamSpec *pspec, TabData *data)
+{
+    if (flow_mapped_viewer_get_indexing (viewer))
+        return;
+    
+    g_signal_handlers_disconnect_by_func (viewer, on_viewer_restore_indexing, data);
+    flow_mapped_viewer_goto_line (viewer, (guint64) data->restore_line);
+    data->restore_cursor = FALSE;
+}
+
+/* Opens @file in the mapped viewer, in a new tab or in place of
+ * @placeholder. */
+static gboolean
+open_file_in_viewer_tab (FlowWindow *self, GFile *file, gboolean hex, TabData *placeholder, GError **error)
+{
+    GtkWidget *viewer;
+    TabData *data;
+    AdwTabPage *page;
+    gchar *basename;
+    
+    viewer = g_object_ref_sink (hex ? flow_mapped_viewer_new_hex () : flow_mapped_viewer_new ());
+    if (!flow_mapped_viewer_load (FLOW_MAPPED_VIEWER (viewer), file, error)) {
+        g_object_unref (viewer);
+        return FALSE;
+    }
+    
+    if (placeholder) {
+        data = placeholder;
+        gtk_widget_set_vexpand (viewer, TRUE);
+        gtk_box_append (GTK_BOX (data->root), viewer);
+        page = data->page;
+    } else {
+        data = g_new0 (TabData, 1);
+        data->window = self;
+        data->root = viewer;
+        data->file = g_object_ref (file);
+        
+        basename = g_file_get_basename (file);
+        page = adw_tab_view_append (self->tab_view, data->root);
+        adw_tab_page_set_title (page, basename);
+        data->page = page;
+        g_free (basename);
+        
+        g_object_set_data_full (G_OBJECT (page), "tab-data", data, (GDestroyNotify) tab_data_free);
+    }
+    
+    data->viewer = viewer;
+    adw_tab_page_set_tooltip (page, hex ? "Read-only hex viewer" : "Read-only viewer");
+    g_object_unref (viewer);
+    
+    g_signal_connect_swapped (viewer, "notify::top-line", G_CALLBACK (queue_update_stats), self);
+    g_signal_connect_swapped (viewer, "notify::n-lines", G_CALLBACK (queue_update_stats), self);
+    if (data->restore_cursor) {
+        g_signal_connect (viewer, "notify::indexing", G_CALLBACK (on_viewer_restore_indexing), data);
+        on_viewer_restore_indexing (FLOW_MAPPED_VIEWER (viewer), NULL, data);
+    }
+    
+    if (placeholder)
+        queue_update_stats (self);
+    else
+        adw_tab_view_set_selected_page (self->tab_view, page);
+    return TRUE;
+}
+
+typedef struct _OpenRequest {
+    FlowWindow *window;
+    GFile *file;
+    guint64 size;
+    GInputStream *stream;
+    /* Restored tab to open into; cleared if it is closed meanwhile. */
+    TabData *placeholder;
+    gboolean for_placeholder;
+} OpenRequest;
+
+static void
+open_request_free (OpenRequest *request)
+{
+    if (request->placeholder)
+        request->placeholder->open_request = NULL;
+    if (request->stream)
+        g_input_stream_close_async (request->stream, G_PRIORITY_DEFAULT, NULL, NULL, NULL);
+    g_clear_object (&request->stream);
+    g_object_unref (request->file);
+    g_object_unref (request->window);
+    g_free (request);
+}
+
+/* Picks the kind of tab for a file from its size and first bytes. */
+static void
+open_request_route (OpenRequest *request, GBytes *head)
+{
+    GError *error = NULL;
+    gboolean binary = FALSE;
+    gboolean compressed = FALSE;
+    gboolean opened = FALSE;
+    
+    /* The restored tab this was for has been closed. */
+    if (request->for_placeholder && !request->placeholder) {
+        open_request_free (request);
+        return;
+    }
+    
+    if (head) {
+        gsize len;
+        const gchar *bytes = g_bytes_get_data (head, &len);
+        compressed = flow_compression_detect (bytes, len) != FLOW_COMPRESSION_NONE;
+        binary = !compressed && flow_encoding_looks_binary (bytes, len);
+    }
+    
+    /* Compressed files are streamed through a decompressor, which the
+     * mapped viewer cannot do, whatever their size. */
+    if (binary || (!compressed && request->size >= VIEWER_SIZE_THRESHOLD)) {
+        opened = open_file_in_viewer_tab (request->window, request->file, binary, request->placeholder, &error);
+        if (!opened) {
+            g_warning ("Failed to map file: %s", error->message);
+            g_error_free (error);
+        }
+    }
+    
+    /* A binary file that cannot be mapped is not worth loading as text. */
+    if (!opened && binary)
+        set_status_text (request->window, "Cannot open binary file");
+    else if (!opened)
+        open_file_in_text_tab (request->window, request->file, request->placeholder);
+    
+    open_request_free (request);
+}
+
+static void
+on_open_file_head_ready (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    OpenRequest *request = user_data;
+    GBytes *head;
+    
+    /* Read errors are reported by the tab that ends up opening the file. */
+    head = g_input_stream_read_bytes_finish (G_INPUT_STREAM (source), result, NULL);
+    open_request_route (request, head);
+    if (head)
+        g_bytes_unref (head);
+}
+
+static void
+on_open_file_read_ready (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    OpenRequest *request = user_data;
+    GFileInputStream *stream;
+    
+    stream = g_file_read_finish (G_FILE (source), result, NULL);
+    if (!stream) {
+        open_request_route (request, NULL);
+        return;
+    }
+    
+    request->stream = G_INPUT_STREAM (stream);
+    g_input_stream_read_bytes_async (request->stream, OPEN_SNIFF_SIZE, G_PRIORITY_DEFAULT, NULL,
+                                     on_open_file_head_ready, request);
+}
+
+/*
+ * Restored tabs are not checked for their files at startup, where that
+ * would hold up the first frame on a slow mount; one whose file went away
+ * since is closed when it is first shown rather than opened empty.
+ */
+static void
+open_request_drop_placeholder (OpenRequest *request)
+{
+    FlowWindow *self = request->window;
+    AdwTabPage *page = request->placeholder ? request->placeholder->page : NULL;
+    
+    g_object_ref (self);
+    open_request_free (request);
+    if (page) {
+        adw_tab_view_close_page (self->tab_view, page);
+        if (adw_tab_view_get_n_pages (self->tab_view) == 0)
+            create_welcome_tab (self);
+    }
+    g_object_unref (self);
+}
+
+static void
+on_open_file_info_ready (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    OpenRequest *request = user_data;
+    GFileInfo *info;
+    GError *error = NULL;
+    
+    info = g_file_query_info_finish (G_FILE (source), result, &error);
+    if (info) {
+        request->size = (guint64) g_file_info_get_size (info);
+        g_object_unref (info);
+    } else if (request->for_placeholder && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
+        g_error_free (error);
+        open_request_drop_placeholder (request);
+        return;
+    }
+    g_clear_error (&error);
+    
+    g_file_read_async (request->file, G_PRIORITY_DEFAULT, NULL, on_open_file_read_ready, request);
+}
+
+static void
+open_request_start (OpenRequest *request)
+{
+    g_file_query_info_async (request->file, G_FILE_ATTRIBUTE_STANDARD_SIZE, G_FILE_QUERY_INFO_NONE,
+                             G_PRIORITY_DEFAULT, NULL, on_open_file_info_ready, request);
+}
+
+static void
+open_file_in_new_tab (FlowWindow *self, GFile *file)
+{
+    OpenRequest *request = g_new0 (OpenRequest, 1);
+    
+    request->window = g_object_ref (self);
+    request->file = g_object_ref (file);
+    open_request_start (request);
+}
+
+/* Opens the file of a restored tab the first time it is shown. */
+static void
+tab_data_materialize (TabData *data)
+{
+    OpenRequest *request;
+    
+    if (!data->placeholder)
+        return;
+    data->placeholder = FALSE;
+    
+    /* Hibernated tabs were text and need no sniffing. */
+    if (data->hibernated) {
+        open_file_in_text_tab (data->window, data->file, data);
+        return;
+    }
+    
+    request = g_new0 (OpenRequest, 1);
+    request->window = g_object_ref (data->window);
+    request->file = g_object_ref (data->file);
+    request->placeholder = data;
+    request->for_placeholder = TRUE;
+    data->open_request = request;
+    open_request_start (request);
+}
+
+/* What a loaded text tab roughly costs in memory. */
+static guint64
+tab_data_estimate_memory (TabData *data)
+{
+    if (!data->text_view || !data->document || data->hibernate_request)
+        return 0;
+    
+    /* A shelved tab's text is held by the piece table alone. */
+    if (data->shelved)
+        return (guint64) flow_piece_table_get_length (data->document);
+    
+    return (guint64) flow_piece_table_get_length (data->document) * 2 +
+           (guint64) flow_piece_table_get_line_count (data->document) * TAB_MEMORY_LINE_OVERHEAD;
+}
+
+/*
+ * Only idle, unmodified text tabs are hibernated.  Their undo history
+ * stays with the tab and applies again once the same text is reloaded.
+ */
+static gboolean
+tab_data_can_hibernate (TabData *data)
+{
+    GtkTextBuffer *buffer;
+    
+    if (!data->text_view || !data->file || data->is_welcome || data->load_incomplete)
+        return FALSE;
+    if (tab_data_is_loading (data) || data->follower || data->save_request || data->reload_request)
+        return FALSE;
+    
+    buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
+    return !gtk_text_buffer_get_modified (buffer);
+}
+
+static void
+hibernate_request_free (HibernateRequest *request)
+{
+    flow_piece_table_snapshot_unref (request->snapshot);
+    g_free (request);
+}
+
+static void
+tab_hibernate_worker (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    HibernateRequest *request = task_data;
+    FlowPieceTableIter *iter;
+    GConverter *compressor;
+    GOutputStream *memory;
+    GOutputStream *stream;
+    GError *error = NULL;
+    const gchar *chunk;
+    gsize len;
+    
+    compressor = flow_compression_new_compressor (TAB_HIBERNATE_COMPRESSION, &error);
+    if (!compressor) {
+        g_task_return_error (task, error);
+        return;
+    }
+    
+    memory = g_memory_output_stream_new_resizable ();
+    stream = g_converter_output_stream_new (memory, compressor);
+    g_object_unref (compressor);
+    
+    iter = flow_piece_table_iter_new (request->snapshot);
+    while (flow_piece_table_iter_next (iter, &chunk, &len)) {
+        if (!g_output_stream_write_all (stream, chunk, len, NULL, cancellable, &error))
+            break;
+    }
+    flow_piece_table_iter_free (iter);
+    
+    if (!error)
+        g_output_stream_close (stream, cancellable, &error);
+    g_object_unref (stream);
+    
+    if (error)
+        g_task_return_error (task, error);
+    else
+        g_task_return_pointer (task, g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (memory)),
+                               (GDestroyNotify) g_bytes_unref);
+    g_object_unref (memory);
+}
+
+/*
+ * Tears down the editor of a tab whose text is now held compressed, and
+ * turns it back into a placeholder that reloads when next selected.  The
+ * file monitor goes too; the file is checked again on waking.
+ */
+static void
+tab_data_release_text (TabData *data, GBytes *compressed)
+{
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
+    GtkTextIter cursor;
+    
+    /* A shelved tab put its cursor aside already. */
+    if (!data->shelved) {
+        gtk_text_buffer_get_iter_at_mark (buffer, &cursor, gtk_text_buffer_get_insert (buffer));
+        data->restore_line = gtk_text_iter_get_line (&cursor);
+        data->restore_column = gtk_text_iter_get_line_offset (&cursor);
+        data->restore_cursor = TRUE;
+    }
+    data->shelved = FALSE;
+    data->check_on_show = FALSE;
+    
+    tab_data_release_buffer (data);
+    
+    gtk_box_remove (GTK_BOX (data->root), data->load_bar);
+    gtk_box_remove (GTK_BOX (data->root), GTK_WIDGET (data->scrolled));
+    data->text_view = NULL;
+    data->scrolled = NULL;
+    data->load_bar = NULL;
+    data->load_progress = NULL;
+    
+    g_clear_pointer (&data->document, flow_piece_table_free);
+    g_clear_pointer (&data->disk_snapshot, flow_piece_table_snapshot_unref);
+    if (data->monitor) {
+        g_signal_handlers_disconnect_by_data (data->monitor, data);
+        g_file_monitor_cancel (data->monitor);
+        g_clear_object (&data->monitor);
+    }
+    
+    data->hibernated = compressed;
+    data->placeholder = TRUE;
+}
+
+static void
+on_tab_hibernate_ready (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    HibernateRequest *request = user_data;
+    TabData *data = request->data;
+    GBytes *compressed;
+    GError *error = NULL;
+    
+    compressed = g_task_propagate_pointer (G_TASK (result), &error);
+    if (data)
+        data->hibernate_request = NULL;
+    
+    if (!compressed) {
+        g_warning ("Failed to hibernate tab: %s", error->message);
+        g_error_free (error);
+    } else if (data && data->change_serial == request->change_serial && tab_data_can_hibernate (data) &&
+               adw_tab_view_get_selected_page (data->window->tab_view) != data->page) {
+        tab_data_release_text (data, compressed);
+    } else {
+        /* Closed, shown or edited meanwhile. */
+        g_bytes_unref (compressed);
+    }
+    
+    hibernate_request_free (request);
+}
+
+static void
+tab_data_hibernate (TabData *data)
+{
+    HibernateRequest *request;
+    GTask *task;
+    
+    request = g_new0 (HibernateRequest, 1);
+    request->data = data;
+    request->snapshot = flow_piece_table_snapshot (data->document);
+    request->change_serial = data->change_serial;
+    data->hibernate_request = request;
+    
+    task = g_task_new (NULL, NULL, on_tab_hibernate_ready, request);
+    g_task_set_task_data (task, request, NULL);
+    g_task_run_in_thread (task, tab_hibernate_worker);
+    g_object_unref (task);
+}
+
+static gint
+compare_tab_last_used (gconstpointer a, gconstpointer b)
+{
+    const TabData *data_a = *(TabData * const *) a;
+    const TabData *data_b = *(TabData * const *) b;
+    
+    return (data_a->last_used > data_b->last_used) - (data_a->last_used < data_b->last_used);
+}
+
+/* Shelves background tabs, then hibernates them, least recently used
+ * first, until the loaded ones fit the memory budget. */
+static gboolean
+on_memory_budget_idle (gpointer user_data)
+{
+    FlowWindow *self = user_data;
+    AdwTabPage *selected;
+    GPtrArray *candidates;
+    guint64 budget;
+    guint64 total = 0;
+    gint n_pages;
+    gint i;
+    guint j;
+    
+    self->memory_idle_id = 0;
+    
+    budget = (guint64) self->tab_memory_budget_mb * 1024 * 1024;
+    selected = adw_tab_view_get_selected_page (self->tab_view);
+    candidates = g_ptr_array_new ();
+    
+    n_pages = adw_tab_view_get_n_pages (self->tab_view);
+    for (i = 0; i < n_pages; i++) {
+        AdwTabPage *page = adw_tab_view_get_nth_page (self->tab_view, i);
+        TabData *data = g_object_get_data (G_OBJECT (page), "tab-data");
+        
+        if (!data)
+            continue;
+        if (page != selected && tab_data_can_shelve (data))
+            tab_data_shelve (data);
+        total += tab_data_estimate_memory (data);
+        if (page != selected && !data->hibernate_request && tab_data_can_hibernate (data))
+            g_ptr_array_add (candidates, data);
+    }
+    
+    if (total > budget) {
+        g_ptr_array_sort (candidates, compare_tab_last_used);
+        for (j = 0; j < candidates->len && total > budget; j++) {
+            TabData *data = g_ptr_array_index (candidates, j);
+            
+            total -= MIN (total, tab_data_estimate_memory (data));
+            tab_data_hibernate (data);
+        }
+    }
+    
+    g_ptr_array_free (candidates, TRUE);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+queue_memory_budget_check (FlowWindow *self)
+{
+    if (self->memory_idle_id)
+        return;
+    self->memory_idle_id = g_idle_add_full (G_PRIORITY_LOW, on_memory_budget_idle, self, NULL);
+}
+
+static void
+save_request_free (SaveRequest *request)
+{
+    flow_piece_table_snapshot_unref (request->snapshot);
+    g_object_unref (request->file);
+    g_free (request);
+}
+
+static void
+on_tab_save_progress (guint64 written, guint64 total, gpointer user_data)
+{
+    SaveRequest *request = user_data;
+    gchar *text;
+    
+    if (!request->data)
+        return;
+    
+    text = g_strdup_printf ("Saving… %d%%", total > 0 ? (gint) (written * 100 / total) : 100);
+    set_status_text (request->data->window, text);
+    g_free (text);
+}
+
+static void
+on_tab_save_ready (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    SaveRequest *request = user_data;
+    TabData *data = request->data;
+    GError *error = NULL;
+    gboolean ok;
+    
+    ok = flow_file_save_finish (res, &error);
+    
+    if (!data) {
+        if (!ok) {
+            g_warning ("Failed to save file: %s", error->message);
+            g_error_free (error);
+        }
+        save_request_free (request);
+        return;
+    }
+    
+    data->save_request = NULL;
+    
+    if (ok) {
+        data->compression = request->compression;
+        data->disk_size = request->disk_size;
+        g_clear_pointer (&data->disk_snapshot, flow_piece_table_snapshot_unref);
+        data->disk_snapshot = flow_piece_table_snapshot_ref (request->snapshot);
+        if (request->retitle || !data->monitor)
+            tab_data_watch_file (data);
+        
+        /* Edits made while writing are not on disk yet. */
+        if (data->change_serial == request->change_serial) {
+            flow_undo_mark_saved (data->undo);
+            gtk_text_buffer_set_modified (gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view)), FALSE);
+        }
+        
+        if (request->retitle) {
+            gchar *basename = g_file_get_basename (request->file);
+            adw_tab_page_set_title (data->page, basename);
+            g_free (basename);
+            if (adw_tab_view_get_selected_page (data->window->tab_view) == data->page)
+                on_selected_page_changed (NULL, NULL, data->window);
+        }
+        set_status_text (data->window, "Saved");
+    } else {
+        gchar *text = g_strdup_printf ("Save failed: %s", error->message);
+        g_warning ("Failed to save file: %s", error->message);
+        set_status_text (data->window, text);
+        g_free (text);
+        g_error_free (error);
+    }
+    
+    if (data->save_again) {
+        data->save_again = FALSE;
+        if (data->file)
+            tab_data_save (data, data->file, !g_file_equal (data->file, request->file));
+    }
+    /* A tab is not shelved while it saves. */
+    queue_memory_budget_check (data->window);
+    
+    save_request_free (request);
+}
+
+/* Streams a snapshot of the tab's document to @file in the background. */
+static void
+tab_data_save (TabData *data, GFile *file, gboolean retitle)
+{
+    SaveRequest *request;
+    
+    if (data->save_request) {
+        data->save_again = TRUE;
+        return;
+    }
+    
+    request = g_new0 (SaveRequest, 1);
+    request->data = data;
+    request->file = g_object_ref (file);
+    request->change_serial = data->change_serial;
+    request->retitle = retitle;
+    request->compression = data->window->recompress_on_save ? data->compression : FLOW_COMPRESSION_NONE;
+    data->save_request = request;
+    
+    set_status_text (data->window, "Saving…");
+    
+    request->snapshot = flow_piece_table_snapshot (data->document);
+    /* Only plain UTF-8 has a size on disk known without re-reading it. */
+    if (flow_encoding_is_utf8 (data->charset) && request->compression == FLOW_COMPRESSION_NONE)
+        request->disk_size = flow_piece_table_snapshot_get_length (request->snapshot) + (data->has_bom ? 3 : 0);
+    else
+        request->disk_size = FLOW_FILE_FOLLOWER_OFFSET_END;
+    flow_file_save_async (file, request->snapshot, data->charset, data->has_bom, request->compression,
+                          data->window->save_durability, NULL,
+                          on_tab_save_progress, on_tab_save_ready, request);
+}
+
+/* Appends text the followed file has grown by, keeping the view pinned
+ * to the end if it was there and trimming the oldest lines. */
+static void
+on_tab_follow_text (FlowFileFollower *follower, GBytes *text, gboolean truncated, gpointer user_data)
+{
+    TabData *data = user_data;
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
+    GtkAdjustment *vadjustment = gtk_scrolled_window_get_vadjustment (data->scrolled);
+    GtkTextIter start, end;
+    const gchar *chars;
+    gsize len;
+    gint excess;
+    gboolean at_end;
+    
+    at_end = gtk_adjustment_get_value (vadjustment) >=
+             gtk_adjustment_get_upper (vadjustment) - gtk_adjustment_get_page_size (vadjustment) - 1.0;
+    
+    /* Followed text is not an edit the user could undo. */
+    data->undo_suspended = TRUE;
+    
+    if (truncated) {
+        gtk_text_buffer_get_bounds (buffer, &start, &end);
+        gtk_text_buffer_delete (buffer, &start, &end);
+        set_status_text (data->window, "File was truncated, following from the start");
+    }
+    
+    chars = g_bytes_get_data (text, &len);
+    if (len > 0) {
+        /* Like loading: the document shares the bytes, the buffer copies. */
+        g_signal_handler_block (buffer, data->insert_handler);
+        flow_piece_table_append_bytes (data->document, text);
+        gtk_text_buffer_get_end_iter (buffer, &end);
+        gtk_text_buffer_insert (buffer, &end, chars, (gint) len);
+        g_signal_handler_unblock (buffer, data->insert_handler);
+        data->change_serial++;
+    }
+    
+    excess = gtk_text_buffer_get_line_count (buffer) - (gint) data->window->follow_max_lines;
+    if (excess > 0) {
+        gtk_text_buffer_get_start_iter (buffer, &start);
+        gtk_text_buffer_get_iter_at_line (buffer, &end, excess);
+        gtk_text_buffer_delete (buffer, &start, &end);
+        /* The tab no longer holds the whole file; never save it back. */
+        data->load_incomplete = TRUE;
+    }
+    
+    data->undo_suspended = FALSE;
+    flow_undo_clear (data->undo);
+    flow_undo_mark_saved (data->undo);
+    gtk_text_buffer_set_modified (buffer, FALSE);
+    g_clear_pointer (&data->disk_snapshot, flow_piece_table_snapshot_unref);
+    data->disk_snapshot = flow_piece_table_snapshot (data->document);
+    
+    if (at_end) {
+        gtk_text_buffer_get_end_iter (buffer, &end);
+        gtk_text_buffer_place_cursor (buffer, &end);
+        gtk_text_view_scroll_mark_onscreen (GTK_TEXT_VIEW (data->text_view), gtk_text_buffer_get_insert (buffer));
+    }
+    
+    queue_update_stats (data->window);
+}
+
+/* Undoes the tab's last step, or redoes the last one undone. */
+static void
+tab_data_undo (TabData *data, gboolean redo)
+{
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
+    GArray *edits;
+    GError *error = NULL;
+    GtkTextIter cursor;
+    guint i;
+    
+    if (!gtk_text_view_get_editable (GTK_TEXT_VIEW (data->text_view)))
+        return;
+    
+    edits = redo ? flow_undo_redo (data->undo, &error) : flow_undo_undo (data->undo, &error);
+    if (!edits) {
+        if (error) {
+            g_warning ("%s", error->message);
+            set_status_text (data->window, error->message);
+            g_error_free (error);
+        } else {
+            set_status_text (data->window, redo ? "Nothing to redo" : "Nothing to undo");
+        }
+        return;
+    }
+    
+    gtk_text_buffer_get_iter_at_mark (buffer, &cursor, gtk_text_buffer_get_insert (buffer));
+    data->undo_suspended = TRUE;
+    for (i = 0; i < edits->len; i++) {
+        const FlowUndoEdit *edit = &g_array_index (edits, FlowUndoEdit, i);
+        GtkTextIter start, end;
+        
+        gtk_text_buffer_get_iter_at_offset (buffer, &start, (gint) edit->offset);
+        if (edit->kind == FLOW_UNDO_EDIT_INSERT) {
+            gtk_text_buffer_insert (buffer, &start, edit->text, (gint) edit->len);
+        } else {
+            gtk_text_buffer_get_iter_at_offset (buffer, &end, (gint) (edit->offset + edit->n_chars));
+            gtk_text_buffer_delete (buffer, &start, &end);
+        }
+        cursor = start;
+    }
+    data->undo_suspended = FALSE;
+    g_array_unref (edits);
+    
+    gtk_text_buffer_place_cursor (buffer, &cursor);
+    gtk_text_view_scroll_mark_onscreen (GTK_TEXT_VIEW (data->text_view), gtk_text_buffer_get_insert (buffer));
+    gtk_text_buffer_set_modified (buffer, !flow_undo_is_saved (data->undo));
+}
+
+/* Starts or stops following appends to the tab's file, like tail -f. */
+static void
+tab_data_toggle_follow (TabData *data)
+{
+    FlowWindow *self = data->window;
+    GtkTextBuffer *buffer;
+    GError *error = NULL;
+    
+    if (data->follower) {
+        flow_file_follower_cancel (data->follower);
+        g_clear_pointer (&data->follower, flow_file_follower_unref);
+        gtk_text_view_set_editable (GTK_TEXT_VIEW (data->text_view), TRUE);
+        set_status_text (self, "Stopped following");
+        queue_update_stats (self);
+        return;
+    }
+    
+    if (!data->file || !data->text_view) {
+        set_status_text (self, "Only files open as text can be followed");
+        return;
+    }
+    
+    if (tab_data_is_loading (data)) {
+        set_status_text (self, "File is still loading");
+        return;
+    }
+    
+    if (data->compression != FLOW_COMPRESSION_NONE || flow_encoding_is_utf16 (data->charset)) {
+        set_status_text (self, "Cannot follow a compressed or UTF-16 file");
+        return;
+    }
+    
+    buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
+    if (gtk_text_buffer_get_modified (buffer)) {
+        set_status_text (self, "Save changes before following the file");
+        return;
+    }
+    
+    data->follower = flow_file_follower_new (data->file, data->disk_size, data->charset,
+                                             on_tab_follow_text, data);
+    if (!flow_file_follower_start (data->follower, &error)) {
+        gchar *text = g_strdup_printf ("Cannot follow file: %s", error->message);
+        g_warning ("Failed to monitor file: %s", error->message);
+        set_status_text (self, text);
+        g_free (text);
+        g_error_free (error);
+        g_clear_pointer (&data->follower, flow_file_follower_unref);
+        return;
+    }
+    
+    /* Appends would race with typing; the tab is read-only meanwhile. */
+    gtk_text_view_set_editable (GTK_TEXT_VIEW (data->text_view), FALSE);
+    set_status_text (self, "Following file");
+    queue_update_stats (self);
+}
+
+static void
+reload_request_free (ReloadRequest *request)
+{
+    flow_piece_table_snapshot_unref (request->snapshot);
+    if (request->disk_snapshot)
+        flow_piece_table_snapshot_unref (request->disk_snapshot);
+    g_object_unref (request->cancellable);
+    g_object_unref (request->file);
+    g_free (request);
+}
+
+static void
+reload_result_free (ReloadResult *result)
+{
+    if (result->text)
+        g_bytes_unref (result->text);
+    if (result->hunks)
+        g_array_unref (result->hunks);
+    g_free (result);
+}
+
+static gsize
+utf8_count_chars (const gchar *text, gsize len)
+{
+    gsize n_chars = 0;
+    gsize i;
+    
+    for (i = 0; i < len; i++)
+        n_chars += ((guchar) text[i] & 0xC0) != 0x80;
+    return n_chars;
+}
+
+/* Contents of a snapshot as one string, for comparing on a worker. */
+static GString *
+snapshot_flatten (FlowPieceTableSnapshot *snapshot)
+{
+    FlowPieceTableIter *iter = flow_piece_table_iter_new (snapshot);
+    GString *text = g_string_sized_new (flow_piece_table_snapshot_get_length (snapshot));
+    const gchar *chunk;
+    gsize len;
+    
+    while (flow_piece_table_iter_next (iter, &chunk, &len))
+        g_string_append_len (text, chunk, (gssize) len);
+    flow_piece_table_iter_free (iter);
+    
+    return text;
+}
+
+/* Reads the whole file, decompressing it if it was stored compressed. */
+static gchar *
+reload_read_contents (GFile *file, FlowCompression compression, gsize *length,
+                      GCancellable *cancellable, GError **error)
+{
+    GFileInputStream *stream;
+    GConverter *decompressor;
+    GInputStream *decompressed;
+    GOutputStream *memory;
+    gchar *contents = NULL;
+    
+    if (compression == FLOW_COMPRESSION_NONE)
+        return g_file_load_contents (file, cancellable, &contents, length, NULL, error) ? contents : NULL;
+    
+    decompressor = flow_compression_new_decompressor (compression, error);
+    if (!decompressor)
+        return NULL;
+    
+    stream = g_file_read (file, cancellable, error);
+    if (!stream) {
+        g_object_unref (decompressor);
+        return NULL;
+    }
+    
+    decompressed = g_converter_input_stream_new (G_INPUT_STREAM (stream), decompressor);
+    memory = g_memory_output_stream_new_resizable ();
+    if (g_output_stream_splice (memory, decompressed,
+                                G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                                cancellable, error) >= 0) {
+        *length = g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (memory));
+        contents = g_memory_output_stream_steal_data (G_MEMORY_OUTPUT_STREAM (memory));
+    }
+    
+    g_object_unref (memory);
+    g_object_unref (decompressed);
+    g_object_unref (stream);
+    g_object_unref (decompressor);
+    
+    return contents;
+}
+
+/* Decodes file contents the way the loader would; takes @contents. */
+static gchar *
+reload_decode (gchar *contents, gsize length, gsize *text_len, const gchar **charset, gboolean *has_bom)
+{
+    gsize bom_len;
+    gchar *text = NULL;
+    
+    *charset = flow_encoding_detect (contents, length, &bom_len);
+    *has_bom = bom_len > 0;
+    
+    if (flow_encoding_is_utf8 (*charset) && g_utf8_validate_len (contents + bom_len, length - bom_len, NULL)) {
+        memmove (contents, contents + bom_len, length - bom_len);
+        *text_len = length - bom_len;
+        return contents;
+    }
+    
+    if (!flow_encoding_is_utf8 (*charset))
+        text = g_convert (contents + bom_len, (gssize) (length - bom_len), FLOW_ENCODING_UTF8, *charset,
+                          NULL, text_len, NULL);
+    if (!text) {
+        text = g_utf8_make_valid (contents + bom_len, (gssize) (length - bom_len));
+        *text_len = strlen (text);
+    }
+    
+    g_free (contents);
+    return text;
+}
+
+static void
+tab_reload_worker (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    ReloadRequest *request = task_data;
+    ReloadResult *result;
+    GString *current;
+    GArray *hunks;
+    GError *error = NULL;
+    gchar *contents;
+    gchar *text;
+    gsize length;
+    gsize text_len;
+    gsize char_pos = 0;
+    gsize byte_pos = 0;
+    guint i;
+    
+    (void)source_object;
+    
+    contents = reload_read_contents (request->file, request->compression, &length, cancellable, &error);
+    if (!contents) {
+        g_task_return_error (task, error);
+        return;
+    }
+    
+    result = g_new0 (ReloadResult, 1);
+    result->disk_size = request->compression == FLOW_COMPRESSION_NONE ? length : FLOW_FILE_FOLLOWER_OFFSET_END;
+    text = reload_decode (contents, length, &text_len, &result->charset, &result->has_bom);
+    result->text = g_bytes_new_take (text, text_len);
+    
+    /* Our own saves come back as change events too; they match what the
+     * tab last wrote and need nothing. */
+    if (request->disk_snapshot) {
+        GString *disk = snapshot_flatten (request->disk_snapshot);
+        result->unchanged = disk->len == text_len && memcmp (disk->str, text, text_len) == 0;
+        g_string_free (disk, TRUE);
+        if (result->unchanged) {
+            g_task_return_pointer (task, result, (GDestroyNotify) reload_result_free);
+            return;
+        }
+    }
+    
+    current = snapshot_flatten (request->snapshot);
+    hunks = flow_diff_lines (current->str, current->len, text, text_len, cancellable);
+    if (!hunks) {
+        g_string_free (current, TRUE);
+        reload_result_free (result);
+        g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Reload cancelled");
+        return;
+    }
+    
+    /* The buffer is addressed by characters, the diff by bytes. */
+    result->hunks = g_array_sized_new (FALSE, FALSE, sizeof (ReloadHunk), hunks->len);
+    for (i = 0; i < hunks->len; i++) {
+        const FlowDiffHunk *diff = &g_array_index (hunks, FlowDiffHunk, i);
+        ReloadHunk hunk;
+        
+        char_pos += utf8_count_chars (current->str + byte_pos, diff->old_start - byte_pos);
+        hunk.old_offset = char_pos;
+        hunk.old_chars = utf8_count_chars (current->str + diff->old_start, diff->old_end - diff->old_start);
+        hunk.new_start = diff->new_start;
+        hunk.new_len = diff->new_end - diff->new_start;
+        g_array_append_val (result->hunks, hunk);
+        
+        char_pos += hunk.old_chars;
+        byte_pos = diff->old_end;
+    }
+    
+    g_array_unref (hunks);
+    g_string_free (current, TRUE);
+    g_task_return_pointer (task, result, (GDestroyNotify) reload_result_free);
+}
+
+/* Edits the buffer into the new contents one changed hunk at a time, so
+ * marks, the cursor and highlighting outside the hunks are untouched and
+ * the whole reload is a single undoable step. */
+static void
+tab_data_apply_reload (TabData *data, ReloadResult *result)
+{
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
+    const gchar *text = g_bytes_get_data (result->text, NULL);
+    guint i;
+    
+    gtk_text_buffer_begin_user_action (buffer);
+    for (i = result->hunks->len; i > 0; i--) {
+        const ReloadHunk *hunk = &g_array_index (result->hunks, ReloadHunk, i - 1);
+        GtkTextIter start, end;
+        
+        gtk_text_buffer_get_iter_at_offset (buffer, &start, (gint) hunk->old_offset);
+        gtk_text_buffer_get_iter_at_offset (buffer, &end, (gint) (hunk->old_offset + hunk->old_chars));
+        gtk_text_buffer_delete (buffer, &start, &end);
+        gtk_text_buffer_insert (buffer, &start, text + hunk->new_start, (gint) hunk->new_len);
+    }
+    gtk_text_buffer_end_user_action (buffer);
+    flow_undo_mark_saved (data->undo);
+    gtk_text_buffer_set_modified (buffer, FALSE);
+}
+
+static void
+on_tab_reload_ready (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    ReloadRequest *request = user_data;
+    TabData *data = request->data;
+    ReloadResult *result;
+    GError *error = NULL;
+    gchar *text;
+    
+    (void)source_object;
+    
+    result = g_task_propagate_pointer (G_TASK (res), &error);
+    if (!data)
+        goto out;
+    
+    data->reload_request = NULL;
+    /* Nor while it is compared with its file. */
+    queue_memory_budget_check (data->window);
+    
+    if (!result) {
+        /* A file replaced by rename may be missing for a moment; the
+         * event for the new one follows. */
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
+            !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+            g_warning ("Failed to reload file: %s", error->message);
+        goto out;
+    }
+    
+    if (result->unchanged)
+        goto out;
+    
+    /* Typed into while the file was read: compare again. */
+    if (data->change_serial != request->change_serial) {
+        tab_data_check_disk (data, request->force);
+        goto out;
+    }
+    
+    if (!request->force && gtk_text_buffer_get_modified (gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view)))) {
+        set_status_text (data->window, "File changed on disk; use Reload File to discard your changes");
+        goto out;
+    }
+    
+    tab_data_apply_reload (data, result);
+    data->charset = result->charset;
+    data->has_bom = result->has_bom;
+    data->disk_size = result->disk_size;
+    g_clear_pointer (&data->disk_snapshot, flow_piece_table_snapshot_unref);
+    data->disk_snapshot = flow_piece_table_snapshot (data->document);
+    
+    text = g_strdup_printf ("Reloaded from disk (%u changed %s)", result->hunks->len,
+                            result->hunks->len == 1 ? "region" : "regions");
+    set_status_text (data->window, text);
+    g_free (text);
+    queue_update_stats (data->window);
+    
+out:
+    g_clear_pointer (&result, reload_result_free);
+    g_clear_error (&error);
+    reload_request_free (request);
+}
+
+/*
+ * Compares the tab with its file on disk in the background and brings it
+ * up to date with only the lines that changed.  Unless @force is set,
+ * unsaved edits are never overwritten.
+ */
+static void
+tab_data_check_disk (TabData *data, gboolean force)
+{
+    ReloadRequest *request;
+    GTask *task;
+    
+    if (!data->file || !data->text_view)
+        return;
+    
+    /* Compared once the tab is shown and its buffer filled again. */
+    if (data->shelved || (data->refill_iter && !force)) {
+        data->check_on_show = TRUE;
+        return;
+    }
+    
+    if (tab_data_is_loading (data) || data->follower || data->save_request)
+        return;
+    
+    /* Part of the file was never loaded; a diff would add it line by line. */
+    if (data->load_incomplete) {
+        if (force)
+            set_status_text (data->window, "Cannot reload a partially loaded file");
+        return;
+    }
+    
+    if (data->reload_request) {
+        g_cancellable_cancel (data->reload_request->cancellable);
+        data->reload_request->data = NULL;
+    }
+    
+    request = g_new0 (ReloadRequest, 1);
+    request->data = data;
+    request->file = g_object_ref (data->file);
+    request->compression = data->compression;
+    request->snapshot = flow_piece_table_snapshot (data->document);
+    if (data->disk_snapshot && !force)
+        request->disk_snapshot = flow_piece_table_snapshot_ref (data->disk_snapshot);
+    request->change_serial = data->change_serial;
+    request->force = force;
+    request->cancellable = g_cancellable_new ();
+    data->reload_request = request;
+    
+    task = g_task_new (NULL, request->cancellable, on_tab_reload_ready, request);
+    g_task_set_task_data (task, request, NULL);
+    g_task_run_in_thread (task, tab_reload_worker);
+    g_object_unref (task);
+}
+
+static void
+on_tab_file_changed (GFileMonitor      *monitor,
+                     GFile             *file,
+                     GFile             *other_file,
+                     GFileMonitorEvent  event,
+                     TabData           *data)
+{
+    switch (event) {
+        case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+        case G_FILE_MONITOR_EVENT_CREATED:
+            tab_data_check_disk (data, FALSE);
+            break;
+        case G_FILE_MONITOR_EVENT_DELETED:
+            if (adw_tab_view_get_selected_page (data->window->tab_view) == data->page)
+                set_status_text (data->window, "File was deleted on disk");
+            break;
+        default:
+            break;
+    }
+}
+
+/* Watches the tab's file for changes made outside of Flow. */
+static void
+tab_data_watch_file (TabData *data)
+{
+    GError *error = NULL;
+    
+    if (data->monitor) {
+        g_signal_handlers_disconnect_by_data (data->monitor, data);
+        g_file_monitor_cancel (data->monitor);
+        g_clear_object (&data->monitor);
+    }
+    
+    if (!data->file)
+        return;
+    
+    data->monitor = g_file_monitor_file (data->file, G_FILE_MONITOR_NONE, NULL, &error);
+    if (!data->monitor) {
+        g_warning ("Failed to monitor file: %s", error->message);
+        g_error_free (error);
+        return;
+    }
+    
+    g_file_monitor_set_rate_limit (data->monitor, TAB_MONITOR_RATE_LIMIT_MS);
+    g_signal_connect (data->monitor, "changed", G_CALLBACK (on_tab_file_changed), data);
+}
+
+static void
+create_welcome_tab (FlowWindow *self)
+{
+    TabData *data;
+    AdwTabPage *page;
+    
+    if (!self->show_welcome)
+        return;
+    
+    data = tab_data_new_welcome (self);
+    
+    page = adw_tab_view_append (self->tab_view, data->root);
+    adw_tab_page_set_title (page, "Welcome");
+    
+    g_object_set_data_full (G_OBJECT (page), "tab-data", data, (GDestroyNotify) tab_data_free);
+    
+    adw_tab_view_set_selected_page (self->tab_view, page);
+}
+
+static void
+apply_theme (FlowWindow *self)
+{
+    GtkSourceStyleScheme *scheme;
+    AdwStyleManager *style_manager;
+    const gchar *scheme_name;
+    guint n_pages, i;
+    
+    style_manager = adw_style_manager_get_default ();
+    
+    if (self->dark_mode) {
+        adw_style_manager_set_color_scheme (style_manager, ADW_COLOR_SCHEME_FORCE_DARK);
+        scheme_name = "Adwaita-dark";
+    } else {
+        adw_style_manager_set_color_scheme (style_manager, ADW_COLOR_SCHEME_FORCE_LIGHT);
+        scheme_name = "Adwaita";
+    }
+    
+    /* Looked up only once there is an editor to style: the first lookup
+     * scans every style scheme installed, which startup can do without. */
+    scheme = NULL;
+    n_pages = adw_tab_view_get_n_pages (self->tab_view);
+    for (i = 0; i < n_pages; i++) {
+        AdwTabPage *page = adw_tab_view_get_nth_page (self->tab_view, i);
+        TabData *data = g_object_get_data (G_OBJECT (page), "tab-data");
+        if (data && data->text_view && !data->is_welcome) {
+            GtkSourceBuffer *buffer = GTK_SOURCE_BUFFER (gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view)));
+            if (!scheme) {
+                scheme = flow_languages_get_style_scheme (scheme_name);
+                if (!scheme)
+                    return;
+            }
+            if (GTK_SOURCE_IS_BUFFER (buffer))
+                gtk_source_buffer_set_style_scheme (buffer, scheme);
+        }
+    }
+}
+
+static void
+cancel_and_unref (gpointer cancellable)
+{
+    g_cancellable_cancel (cancellable);
+    g_object_unref (cancellable);
+}
+
+static gint
+compare_positions (gconstpointer a, gconstpointer b)
+{
+    guint position_a = *(const guint *) a;
+    guint position_b = *(const guint *) b;
+    
+    return position_a < position_b ? -1 : position_a > position_b;
+}
+
+/* Appends @items to the watched store in one splice, noting where each went. */
+static void
+folder_watch_append (FolderWatch *watch, GPtrArray *items)
+{
+    guint n_items = g_list_model_get_n_items (G_LIST_MODEL (watch->store));
+    guint i;
+    
+    for (i = 0; i < items->len; i++)
+        g_hash_table_insert (watch->positions, g_strdup (flow_file_item_get_name (items->pdata[i])),
+                             GUINT_TO_POINTER (n_items + i + 1));
+    g_list_store_splice (watch->store, n_items, 0, items->pdata, items->len);
+}
+
+/*
+ * Takes the entries at @removed, sorted, out of the store and adds
+ * @added.  The store's order means nothing, since the sort model above
+ * it places the entries, so the entries at the end take the places of
+ * those removed: one splice swaps the end for @added, and one more per
+ * hole fills it.  No other entry moves, and no other position changes.
+ */
+static void
+folder_watch_splice (FolderWatch *watch, GArray *removed, GPtrArray *added)
+{
+    guint n_items = g_list_model_get_n_items (G_LIST_MODEL (watch->store));
+    guint tail = n_items - removed->len;
+    GPtrArray *movers = g_ptr_array_new_with_free_func (g_object_unref);
+    guint next = 0;
+    guint position;
+    guint i;
+    
+    /* The entries at the end that stay, one for each hole before it. */
+    for (position = tail; position < n_items; position++) {
+        while (next < removed->len && g_array_index (removed, guint, next) < position)
+            next++;
+        if (next < removed->len && g_array_index (removed, guint, next) == position)
+            continue;
+        g_ptr_array_add (movers, g_list_model_get_item (G_LIST_MODEL (watch->store), position));
+    }
+    
+    for (i = 0; i < added->len; i++)
+        g_hash_table_insert (watch->positions, g_strdup (flow_file_item_get_name (added->pdata[i])),
+                             GUINT_TO_POINTER (tail + i + 1));
+    g_list_store_splice (watch->store, tail, removed->len, added->pdata, added->len);
+    
+    for (i = 0; i < movers->len; i++) {
+        FlowFileItem *item = movers->pdata[i];
+        
+        position = g_array_index (removed, guint, i);
+        g_hash_table_insert (watch->positions, g_strdup (flow_file_item_get_name (item)),
+                             GUINT_TO_POINTER (position + 1));
+        g_list_store_splice (watch->store, position, 1, (gpointer *) &item, 1);
+    }
+    
+    g_ptr_array_unref (movers);
+}
+
+static void
+folder_patch_free (FolderPatch *patch)
+{
+    g_object_unref (patch->folder);
+    g_ptr_array_unref (patch->names);
+    g_array_unref (patch->types);
+    g_free (patch);
+}
+
+static void
+folder_patch_worker (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    FolderPatch *patch = task_data;
+    guint i;
+    
+    for (i = 0; i < patch->names->len; i++) {
+        GFile *file = g_file_get_child (patch->folder, patch->names->pdata[i]);
+        GFileInfo *info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                             G_FILE_QUERY_INFO_NONE, NULL, NULL);
+        GFileType type = info ? g_file_info_get_file_type (info) : G_FILE_TYPE_UNKNOWN;
+        
+        g_array_append_val (patch->types, type);
+        g_clear_object (&info);
+        g_object_unref (file);
+    }
+    
+    g_task_return_boolean (task, TRUE);
+}
+
+/* Brings the entries a patch looked up up to date, all in one go. */
+static void
+on_folder_patch_ready (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    FolderPatch *patch = user_data;
+    FolderWatch *watch = patch->watch;
+    GArray *removed;
+    GPtrArray *added;
+    guint i;
+    
+    if (!watch) {
+        folder_patch_free (patch);
+        return;
+    }
+    watch->patch = NULL;
+    
+    removed = g_array_new (FALSE, FALSE, sizeof (guint));
+    added = g_ptr_array_new_with_free_func (g_object_unref);
+    for (i = 0; i < patch->names->len; i++) {
+        const gchar *name = patch->names->pdata[i];
+        GFileType type = g_array_index (patch->types, GFileType, i);
+        gboolean shown = type == G_FILE_TYPE_DIRECTORY || type == G_FILE_TYPE_REGULAR;
+        guint position = GPOINTER_TO_UINT (g_hash_table_lookup (watch->positions, name));
+        
+        if (position > 0) {
+            FlowFileItem *item = g_list_model_get_item (G_LIST_MODEL (watch->store), position - 1);
+            gboolean unchanged = shown && flow_file_item_get_is_directory (item) == (type == G_FILE_TYPE_DIRECTORY);
+            
+            g_object_unref (item);
+            /* Left alone, a directory row keeps its children and state. */
+            if (unchanged)
+                continue;
+            position--;
+            g_array_append_val (removed, position);
+            g_hash_table_remove (watch->positions, name);
+        }
+        
+        if (shown) {
+            GFile *file = g_file_get_child (watch->folder, name);
+            
+            g_ptr_array_add (added, flow_file_item_new (file, name, type == G_FILE_TYPE_DIRECTORY));
+            g_object_unref (file);
+        }
+    }
+    
+    g_array_sort (removed, compare_positions);
+    if (removed->len > 0 || added->len > 0)
+        folder_watch_splice (watch, removed, added);
+    
+    g_array_unref (removed);
+    g_ptr_array_unref (added);
+    folder_patch_free (patch);
+    
+    /* Changes seen during the lookup were held back until now. */
+    folder_watch_schedule (watch);
+}
+
+/* Looks up the names changed since the last patch on a worker thread. */
+static gboolean
+folder_watch_patch (gpointer user_data)
+{
+    FolderWatch *watch = user_data;
+    FolderPatch *patch;
+    GHashTableIter iter;
+    gpointer name;
+    GTask *task;
+    
+    watch->patch_id = 0;
+    
+    patch = g_new0 (FolderPatch, 1);
+    patch->watch = watch;
+    patch->folder = g_object_ref (watch->folder);
+    patch->names = g_ptr_array_new_full (g_hash_table_size (watch->pending), g_free);
+    patch->types = g_array_sized_new (FALSE, FALSE, sizeof (GFileType), g_hash_table_size (watch->pending));
+    g_hash_table_iter_init (&iter, watch->pending);
+    while (g_hash_table_iter_next (&iter, &name, NULL)) {
+        g_ptr_array_add (patch->names, name);
+        g_hash_table_iter_steal (&iter);
+    }
+    watch->patch = patch;
+    
+    task = g_task_new (NULL, NULL, on_folder_patch_ready, patch);
+    g_task_set_task_data (task, patch, NULL);
+    g_task_run_in_thread (task, folder_patch_worker);
+    g_object_unref (task);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+folder_watch_schedule (FolderWatch *watch)
+{
+    if (!watch->loading && !watch->patch && !watch->patch_id && g_hash_table_size (watch->pending) > 0)
+        watch->patch_id = g_timeout_add (FOLDER_WATCH_DEBOUNCE_MS, folder_watch_patch, watch);
+}
+
+static void
+folder_watch_queue (FolderWatch *watch, GFile *file)
+{
+    GFile *parent = file ? g_file_get_parent (file) : NULL;
+    
+    /* Events about the folder itself are its parent's to handle. */
+    if (parent && g_file_equal (parent, watch->folder))
+        g_hash_table_add (watch->pending, g_file_get_basename (file));
+    g_clear_object (&parent);
+    
+    folder_watch_schedule (watch);
+}
+
+static void
+on_folder_changed (GFileMonitor      *monitor,
+                   GFile             *file,
+                   GFile             *other_file,
+                   GFileMonitorEvent  event,
+                   FolderWatch       *watch)
+{
+    switch (event) {
+        case G_FILE_MONITOR_EVENT_CREATED:
+        case G_FILE_MONITOR_EVENT_DELETED:
+        case G_FILE_MONITOR_EVENT_MOVED_IN:
+        case G_FILE_MONITOR_EVENT_MOVED_OUT:
+            folder_watch_queue (watch, file);
+            break;
+        case G_FILE_MONITOR_EVENT_RENAMED:
+            folder_watch_queue (watch, file);
+            folder_watch_queue (watch, other_file);
+            break;
+        default:
+            /* Contents and attributes do not show in the explorer. */
+            break;
+    }
+}
+
+static void
+folder_watch_free (FolderWatch *watch)
+{
+    if (watch->patch_id)
+        g_source_remove (watch->patch_id);
+    if (watch->patch)
+        watch->patch->watch = NULL;
+    if (watch->monitor) {
+        g_signal_handlers_disconnect_by_data (watch->monitor, watch);
+        g_file_monitor_cancel (watch->monitor);
+        g_object_unref (watch->monitor);
+    }
+    g_hash_table_unref (watch->pending);
+    g_hash_table_unref (watch->positions);
+    g_object_unref (watch->folder);
+    g_free (watch);
+}
+
+static void
+folder_load_free (FolderLoad *load)
+{
+    if (load->store) {
+        FolderWatch *watch = g_object_get_data (G_OBJECT (load->store), "folder-watch");
+        
+        /* Changes seen while reading were held back until now. */
+        watch->loading = FALSE;
+        folder_watch_schedule (watch);
+        g_object_remove_weak_pointer (G_OBJECT (load->store), (gpointer *) &load->store);
+    }
+    if (load->enumerator) {
+        g_file_enumerator_close_async (load->enumerator, G_PRIORITY_DEFAULT, NULL, NULL, NULL);
+        g_object_unref (load->enumerator);
+    }
+    g_object_unref (load->folder);
+    flow_ignore_unref (load->ignore);
+    g_object_unref (load->cancellable);
+    g_free (load);
+}
+
+static void
+on_folder_files_ready (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    FolderLoad *load = user_data;
+    GError *error = NULL;
+    GList *infos;
+    GList *l;
+    GPtrArray *items;
+    
+    infos = g_file_enumerator_next_files_finish (load->enumerator, res, &error);
+    
+    if (!infos || !load->store) {
+        if (error && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_warning ("Error during enumeration: %s", error->message);
+        g_clear_error (&error);
+        g_list_free_full (infos, g_object_unref);
+        folder_load_free (load);
+        return;
+    }
+    
+    items = g_ptr_array_new_with_free_func (g_object_unref);
+    for (l = infos; l; l = l->next) {
+        GFileType type = g_file_info_get_file_type (l->data);
+        
+        if (type == G_FILE_TYPE_DIRECTORY || type == G_FILE_TYPE_REGULAR)
+            g_ptr_array_add (items, flow_file_item_new_for_info (g_file_enumerator_get_container (load->enumerator),
+                                                                 l->data));
+    }
+    g_list_free_full (infos, g_object_unref);
+    
+    /* One splice per batch; the sort model places the new entries. */
+    folder_watch_append (g_object_get_data (G_OBJECT (load->store), "folder-watch"), items);
+    g_ptr_array_unref (items);
+    
+    g_file_enumerator_next_files_async (load->enumerator, FOLDER_LOAD_BATCH_SIZE, G_PRIORITY_DEFAULT,
+                                        load->cancellable, on_folder_files_ready, load);
+}
+
+static void
+on_folder_enumerate_ready (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    FolderLoad *load = user_data;
+    GError *error = NULL;
+    
+    load->enumerator = g_file_enumerate_children_finish (G_FILE (source_object), res, &error);
+    
+    if (!load->enumerator) {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_warning ("Failed to enumerate folder: %s", error->message);
+        g_error_free (error);
+        folder_load_free (load);
+        return;
+    }
+    
+    g_file_enumerator_next_files_async (load->enumerator, FOLDER_LOAD_BATCH_SIZE, G_PRIORITY_DEFAULT,
+                                        load->cancellable, on_folder_files_ready, load);
+}
+
+/* The folder's ignore rules are known, so its entries can be listed. */
+static void
+on_folder_ignore_ready (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    FolderLoad *load = user_data;
+    
+    if (!flow_ignore_load_dir_finish (load->ignore, res, NULL)) {
+        folder_load_free (load);
+        return;
+    }
+    
+    g_file_enumerate_children_async (load->folder,
+        G_FILE_ATTRIBUTE_STANDARD_NAME "," G_FILE_ATTRIBUTE_STANDARD_TYPE,
+        G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT, load->cancellable,
+        on_folder_enumerate_ready, load);
+}
+
+/* Path of @file inside the open folder; empty for the folder itself. */
+static gchar *
+explorer_relative_path (FlowWindow *self, GFile *file)
+{
+    gchar *relative = g_file_get_relative_path (self->current_folder, file);
+    
+    return relative ? relative : g_strdup ("");
+}
+
+/*
+ * Whether @item is ignored.  With @inherited, so is everything inside an
+ * ignored directory, which the explorer only lists when asked to.
+ */
+static gboolean
+file_item_is_ignored (FlowWindow *self, FlowFileItem *item, gboolean inherited)
+{
+    gchar *relative;
+    gchar *slash;
+    gboolean ignored;
+    
+    if (!self->ignore)
+        return FALSE;
+    
+    relative = explorer_relative_path (self, flow_file_item_get_file (item));
+    ignored = flow_ignore_is_ignored (self->ignore, relative, flow_file_item_get_is_directory (item));
+    while (inherited && !ignored && (slash = strrchr (relative, G_DIR_SEPARATOR))) {
+        *slash = '\0';
+        ignored = flow_ignore_is_ignored (self->ignore, relative, TRUE);
+    }
+    g_free (relative);
+    return ignored;
+}
+
+static gboolean
+file_filter_func (gpointer item, gpointer user_data)
+{
+    FlowWindow *self = user_data;
+    
+    /* Hidden directories are never listed, so the item alone decides. */
+    return self->show_ignored || !file_item_is_ignored (self, item, FALSE);
+}
+
+static void
+explorer_set_show_ignored (FlowWindow *self, gboolean show_ignored)
+{
+    if (self->show_ignored == show_ignored)
+        return;
+    
+    self->show_ignored = show_ignored;
+    gtk_filter_changed (GTK_FILTER (self->file_filter),
+                        show_ignored ? GTK_FILTER_CHANGE_LESS_STRICT : GTK_FILTER_CHANGE_MORE_STRICT);
+}
+
+/*
+ * The entries of @folder, directories first and ignored ones left out.
+ * The model starts empty; the folder's ignore files are read, then its
+ * entries in batches, and then it follows what is created and deleted
+ * there.  Dropping it stops all of that.
+ */
+static GListModel *
+folder_model_new (FlowWindow *self, GFile *folder)
+{
+    GListStore *store;
+    FolderWatch *watch;
+    FolderLoad *load;
+    GtkFilterListModel *filtered;
+    gchar *relative;
+    
+    store = g_list_store_new (FLOW_TYPE_FILE_ITEM);
+    
+    /* Watching starts first so nothing created during the read is missed. */
+    watch = g_new0 (FolderWatch, 1);
+    watch->store = store;
+    watch->folder = g_object_ref (folder);
+    watch->positions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    watch->pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    watch->loading = TRUE;
+    watch->monitor = g_file_monitor_directory (folder, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+    if (watch->monitor)
+        g_signal_connect (watch->monitor, "changed", G_CALLBACK (on_folder_changed), watch);
+    g_object_set_data_full (G_OBJECT (store), "folder-watch", watch, (GDestroyNotify) folder_watch_free);
+    
+    load = g_new0 (FolderLoad, 1);
+    load->store = store;
+    g_object_add_weak_pointer (G_OBJECT (store), (gpointer *) &load->store);
+    load->folder = g_object_ref (folder);
+    load->ignore = flow_ignore_ref (self->ignore);
+    load->cancellable = g_cancellable_new ();
+    g_object_set_data_full (G_OBJECT (store), "folder-load-cancellable",
+                            g_object_ref (load->cancellable), cancel_and_unref);
+    
+    relative = explorer_relative_path (self, folder);
+    flow_ignore_load_dir_async (self->ignore, relative, load->cancellable, on_folder_ignore_ready, load);
+    g_free (relative);
+    
+    filtered = gtk_filter_list_model_new (G_LIST_MODEL (store), g_object_ref (GTK_FILTER (self->file_filter)));
+    return G_LIST_MODEL (gtk_sort_list_model_new (G_LIST_MODEL (filtered),
+                                                  g_object_ref (GTK_SORTER (self->file_sorter))));
+}
+
+static gboolean
+folder_model_ref_is_unused (gpointer key, gpointer value, gpointer user_data)
+{
+    FolderModelRef *ref = value;
+    
+    return ref->unused;
+}
+
+/* Drops the models no row took back since they were let go. */
+static gboolean
+on_folder_models_sweep (gpointer user_data)
+{
+    FlowWindow *self = user_data;
+    
+    self->folder_models_sweep_id = 0;
+    g_hash_table_foreach_remove (self->folder_models, folder_model_ref_is_unused, NULL);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+on_folder_model_toggled (gpointer user_data, GObject *object, gboolean is_last_ref)
+{
+    FolderModelRef *ref = user_data;
+    FlowWindow *self = ref->window;
+    
+    ref->unused = is_last_ref;
+    if (is_last_ref && !self->folder_models_sweep_id)
+        self->folder_models_sweep_id = g_idle_add (on_folder_models_sweep, self);
+}
+
+static void
+folder_model_ref_free (FolderModelRef *ref)
+{
+    g_object_remove_toggle_ref (G_OBJECT (ref->model), on_folder_model_toggled, ref);
+    g_free (ref);
+}
+
+/*
+ * Children of a tree row.  A directory is only read once it is expanded.
+ * Its model is kept for as long as a row shows it, so a row the tree
+ * makes again when its parent's listing changes finds it again.  Once no
+ * row shows it, after a collapse or when the directory went away, the
+ * model and its file monitor are dropped on idle.
+ */
+static GListModel *
+create_folder_children (gpointer item, gpointer user_data)
+{
+    FlowWindow *self = user_data;
+    FolderModelRef *ref;
+    gchar *uri;
+    
+    if (!flow_file_item_get_is_directory (item))
+        return NULL;
+    
+    uri = g_file_get_uri (flow_file_item_get_file (item));
+    ref = g_hash_table_lookup (self->folder_models, uri);
+    if (ref) {
+        g_free (uri);
+        return g_object_ref (ref->model);
+    }
+    
+    /* The tree gets the model's own reference; the explorer's is the
+     * toggle ref. */
+    ref = g_new0 (FolderModelRef, 1);
+    ref->window = self;
+    ref->model = folder_model_new (self, flow_file_item_get_file (item));
+    g_object_add_toggle_ref (G_OBJECT (ref->model), on_folder_model_toggled, ref);
+    g_hash_table_insert (self->folder_models, uri, ref);
+    return ref->model;
+}
+
+static void
+on_file_row_expanded (GtkTreeListRow *row, GParamSpec *pspec, FlowWindow *self)
+{
+    FlowFileItem *item;
+    gchar *uri;
+    
+    /* A row whose parent collapsed has no item; it keeps its entry. */
+    item = gtk_tree_list_row_get_item (row);
+    if (!item)
+        return;
+    
+    uri = g_file_get_uri (flow_file_item_get_file (item));
+    if (gtk_tree_list_row_get_expanded (row))
+        g_hash_table_add (self->expanded_folders, uri);
+    else {
+        g_hash_table_remove (self->expanded_folders, uri);
+        g_free (uri);
+    }
+    
+    g_object_unref (item);
+}
+
+/* Re-expands the directories that were open when rows for them appear. */
+static void
+on_file_tree_items_changed (GListModel *model, guint position, guint removed, guint added, FlowWindow *self)
+{
+    GPtrArray *rows;
+    guint i;
+    
+    if (added == 0 || g_hash_table_size (self->expanded_folders) == 0)
+        return;
+    
+    /* Expanding a row changes the model, so collect the rows first. */
+    rows = g_ptr_array_new_with_free_func (g_object_unref);
+    for (i = position; i < position + added; i++) {
+        GtkTreeListRow *row = gtk_tree_list_model_get_row (GTK_TREE_LIST_MODEL (model), i);
+        FlowFileItem *item = gtk_tree_list_row_get_item (row);
+        gchar *uri = NULL;
+        
+        if (flow_file_item_get_is_directory (item))
+            uri = g_file_get_uri (flow_file_item_get_file (item));
+        
+        if (uri && g_hash_table_contains (self->expanded_folders, uri))
+            g_ptr_array_add (rows, row);
+        else
+            g_object_unref (row);
+        
+        g_free (uri);
+        g_object_unref (item);
+    }
+    
+    for (i = 0; i < rows->len; i++)
+        gtk_tree_list_row_set_expanded (g_ptr_array_index (rows, i), TRUE);
+    
+    g_ptr_array_unref (rows);
+}
+
+static void
+on_file_row_setup (GtkSignalListItemFactory *factory, GtkListItem *list_item, FlowWindow *self)
+{
+    GtkWidget *expander;
+    GtkWidget *box;
+    GtkWidget *icon;
+    GtkWidget *label;
+    
+    box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 4);
+    icon = gtk_image_new ();
+    gtk_image_set_pixel_size (GTK_IMAGE (icon), 16);
+    label = gtk_label_new (NULL);
+    gtk_label_set_xalign (GTK_LABEL (label), 0);
+    gtk_label_set_ellipsize (GTK_LABEL (label), PANGO_ELLIPSIZE_MIDDLE);
+    gtk_widget_set_hexpand (label, TRUE);
+    gtk_box_append (GTK_BOX (box), icon);
+    gtk_box_append (GTK_BOX (box), label);
+    
+    expander = gtk_tree_expander_new ();
+    gtk_tree_expander_set_child (GTK_TREE_EXPANDER (expander), box);
+    gtk_widget_add_css_class (expander, "file-tree-item");
+    
+    gtk_list_item_set_child (list_item, expander);
+}
+
+static void
+on_file_row_bind (GtkSignalListItemFactory *factory, GtkListItem *list_item, FlowWindow *self)
+{
+    GObject *object = gtk_list_item_get_item (list_item);
+    GtkWidget *expander = gtk_list_item_get_child (list_item);
+    GtkWidget *box = gtk_tree_expander_get_child (GTK_TREE_EXPANDER (expander));
+    GtkTreeListRow *row = NULL;
+    FlowFileItem *item;
+    
+    /* Search results are plain items rather than rows of the tree. */
+    if (GTK_IS_TREE_LIST_ROW (object)) {
+        row = GTK_TREE_LIST_ROW (object);
+        item = gtk_tree_list_row_get_item (row);
+    } else {
+        item = g_object_ref (FLOW_FILE_ITEM (object));
+    }
+    
+    gtk_tree_expander_set_list_row (GTK_TREE_EXPANDER (expander), row);
+    gtk_image_set_from_icon_name (GTK_IMAGE (gtk_widget_get_first_child (box)),
+                                  flow_file_item_get_is_directory (item) ? "folder-symbolic"
+                                                                          : "text-x-generic-symbolic");
+    gtk_label_set_text (GTK_LABEL (gtk_widget_get_last_child (box)), flow_file_item_get_name (item));
+    if (self->show_ignored && file_item_is_ignored (self, item, TRUE))
+        gtk_widget_add_css_class (box, "dim-label");
+    else
+        gtk_widget_remove_css_class (box, "dim-label");
+    
+    /* Only a row on screen can be toggled, so only those are watched. */
+    if (row)
+        g_signal_connect (row, "notify::expanded", G_CALLBACK (on_file_row_expanded), self);
+    
+    g_object_unref (item);
+}
+
+static void
+on_file_row_unbind (GtkSignalListItemFactory *factory, GtkListItem *list_item, FlowWindow *self)
+{
+    GObject *object = gtk_list_item_get_item (list_item);
+    
+    if (GTK_IS_TREE_LIST_ROW (object))
+        g_signal_handlers_disconnect_by_func (object, on_file_row_expanded, self);
+    gtk_tree_expander_set_list_row (GTK_TREE_EXPANDER (gtk_list_item_get_child (list_item)), NULL);
+}
+
+static void
+on_file_list_activate (GtkListView *list_view, guint position, FlowWindow *self)
+{
+    GObject *object;
+    FlowFileItem *item;
+    
+    object = g_list_model_get_item (G_LIST_MODEL (gtk_list_view_get_model (list_view)), position);
+    if (!object)
+        return;
+    
+    if (GTK_IS_TREE_LIST_ROW (object))
+        item = gtk_tree_list_row_get_item (GTK_TREE_LIST_ROW (object));
+    else
+        item = g_object_ref (FLOW_FILE_ITEM (object));
+    
+    if (flow_file_item_get_is_directory (item))
+        gtk_tree_list_row_set_expanded (GTK_TREE_LIST_ROW (object),
+                                        !gtk_tree_list_row_get_expanded (GTK_TREE_LIST_ROW (object)));
+    else
+        open_file_in_new_tab (self, flow_file_item_get_file (item));
+    
+    g_object_unref (item);
+    g_object_unref (object);
+}
+
+/*
+ * Shows the tree, or with a search the matching paths from the workspace
+ * index.  GtkSearchEntry already waits for a pause in typing.
+ */
+static void
+file_search_apply (FlowWindow *self)
+{
+    gboolean searching = self->search_text && *self->search_text && self->workspace_index;
+    
+    if (self->workspace_index)
+        flow_workspace_index_set_query (self->workspace_index, searching ? self->search_text : NULL);
+    
+    gtk_list_view_set_model (self->file_list_view,
+                             searching ? self->file_results_selection : self->file_tree_selection);
+}
+
+static GtkSelectionModel *
+file_selection_new (GListModel *model)
+{
+    GtkSingleSelection *selection = gtk_single_selection_new (model);
+    
+    gtk_single_selection_set_autoselect (selection, FALSE);
+    gtk_single_selection_set_can_unselect (selection, TRUE);
+    return GTK_SELECTION_MODEL (selection);
+}
+
+static void
+update_sidebar_folder_label (FlowWindow *self, GFile *folder)
+{
+    GFile *target;
     gchar *basename = NULL;
     gchar *path = NULL;
 
@@ -572,22 +3167,45 @@ update_sidebar_folder_label (FlowWindow *self, GFile *folder)
 static void
 load_folder (FlowWindow *self, GFile *folder)
 {
-    GtkWidget *child;
-    
-    while ((child = gtk_widget_get_first_child (GTK_WIDGET (self->file_list_container))))
-        gtk_box_remove (self->file_list_container, child);
+    GtkTreeListModel *tree;
+    gchar **ignore_patterns;
     
     gtk_widget_set_visible (GTK_WIDGET (self->open_folder_button), FALSE);
     gtk_widget_set_visible (GTK_WIDGET (self->no_folder_label), FALSE);
     
-    load_folder_tree (self, folder, GTK_WIDGET (self->file_list_container), 0);
-    
-    if (folder)
-        g_object_ref (folder);
-
+    /* Set first: the explorer models find paths relative to it. */
+    g_object_ref (folder);
     if (self->current_folder)
         g_object_unref (self->current_folder);
     self->current_folder = folder;
+    
+    ignore_patterns = self->settings ? g_settings_get_strv (self->settings, "ignore-patterns") : NULL;
+    g_clear_pointer (&self->ignore, flow_ignore_unref);
+    self->ignore = flow_ignore_new (folder, (const gchar * const *) ignore_patterns);
+    
+    g_hash_table_remove_all (self->folder_models);
+    tree = gtk_tree_list_model_new (folder_model_new (self, folder), FALSE, FALSE,
+                                    create_folder_children, self, NULL);
+    g_signal_connect_after (tree, "items-changed", G_CALLBACK (on_file_tree_items_changed), self);
+    on_file_tree_items_changed (G_LIST_MODEL (tree), 0, 0,
+                                g_list_model_get_n_items (G_LIST_MODEL (tree)), self);
+    
+    /* file_tree is borrowed from the selection that owns it. */
+    g_clear_object (&self->file_tree_selection);
+    self->file_tree_selection = file_selection_new (G_LIST_MODEL (tree));
+    self->file_tree = tree;
+    
+    g_clear_object (&self->file_results_selection);
+    if (self->workspace_index)
+        g_signal_handlers_disconnect_by_data (self->workspace_index, self);
+    g_clear_object (&self->workspace_index);
+    self->workspace_index = flow_workspace_index_new (folder, (const gchar * const *) ignore_patterns);
+    g_strfreev (ignore_patterns);
+    g_signal_connect_swapped (self->workspace_index, "notify::ready",
+                              G_CALLBACK (on_workspace_index_ready), self);
+    self->file_results_selection = file_selection_new (g_object_ref (G_LIST_MODEL (self->workspace_index)));
+    
+    file_search_apply (self);
     update_sidebar_folder_label (self, self->current_folder);
 }
 
@@ -600,11 +3218,33 @@ update_stats (FlowWindow *self)
     gint line, col;
     GtkTextMark *mark;
     gchar *pos_text;
+    GString *text;
     
     data = get_current_tab_data (self);
     if (!data || data->is_welcome)
         return;
     
+    if (data->viewer && flow_mapped_viewer_get_hex (FLOW_MAPPED_VIEWER (data->viewer))) {
+        if (self->position_label) {
+            pos_text = g_strdup_printf ("Offset 0x%08" G_GINT64_MODIFIER "x",
+                                        flow_mapped_viewer_get_top_offset (FLOW_MAPPED_VIEWER (data->viewer)));
+            gtk_label_set_text (self->position_label, pos_text);
+            g_free (pos_text);
+        }
+        return;
+    }
+    
+    if (data->viewer) {
+        if (self->position_label) {
+            pos_text = g_strdup_printf ("Ln %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT,
+                                        flow_mapped_viewer_get_top_line (FLOW_MAPPED_VIEWER (data->viewer)) + 1,
+                                        flow_mapped_viewer_get_n_lines (FLOW_MAPPED_VIEWER (data->viewer)));
+            gtk_label_set_text (self->position_label, pos_text);
+            g_free (pos_text);
+        }
+        return;
+    }
+    
     if (!data->text_view)
         return;
     
@@ -617,9 +3257,60 @@ update_stats (FlowWindow *self)
     if (!self->position_label)
         return;
 
-    pos_text = g_strdup_printf ("Ln %d, Col %d", line, col);
-    gtk_label_set_text (self->position_label, pos_text);
-    g_free (pos_text);
+    text = g_string_new (NULL);
+    g_string_printf (text, "Ln %d, Col %d", line, col);
+    if (!flow_encoding_is_utf8 (data->charset))
+        g_string_append_printf (text, " · %s", data->charset);
+    if (data->follower)
+        g_string_append (text, " · Following");
+    gtk_label_set_text (self->position_label, text->str);
+    g_string_free (text, TRUE);
+}
+
+static gboolean
+update_stats_idle (gpointer user_data)
+{
+    FlowWindow *self = FLOW_WINDOW (user_data);
+    
+    self->stats_idle_id = 0;
+    update_stats (self);
+    return G_SOURCE_REMOVE;
+}
+
+/* Coalesces bursts of cursor and buffer changes into one update. */
+static void
+queue_update_stats (FlowWindow *self)
+{
+    if (self->stats_idle_id)
+        return;
+    self->stats_idle_id = g_idle_add_full (G_PRIORITY_LOW, update_stats_idle, self, NULL);
+}
+
+/* Moves the cursor of the current tab to @line (1-based). */
+static void
+goto_line (FlowWindow *self, guint64 line)
+{
+    TabData *data = get_current_tab_data (self);
+    GtkTextBuffer *buffer;
+    GtkTextIter iter;
+    
+    if (!data || data->is_welcome || line == 0)
+        return;
+    
+    if (data->viewer) {
+        flow_mapped_viewer_goto_line (FLOW_MAPPED_VIEWER (data->viewer), line - 1);
+        return;
+    }
+    
+    if (!data->text_view)
+        return;
+    
+    buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
+    gtk_text_buffer_get_iter_at_line (buffer, &iter, (gint) MIN (line - 1, (guint64) G_MAXINT));
+    gtk_text_buffer_place_cursor (buffer, &iter);
+    gtk_text_view_scroll_to_mark (GTK_TEXT_VIEW (data->text_view), gtk_text_buffer_get_insert (buffer),
+                                  0.0, TRUE, 0.0, 0.3);
+    gtk_widget_grab_focus (GTK_WIDGET (data->text_view));
 }
 
 static void
@@ -651,10 +3342,18 @@ show_preferences_window (FlowWindow *self)
     AdwActionRow *row;
     GtkSwitch *theme_switch;
     GtkSwitch *welcome_switch;
+    GtkSwitch *recompress_switch;
+    GtkSwitch *session_switch;
+    GtkSwitch *ignored_switch;
+    AdwSpinRow *follow_row;
+    AdwSpinRow *budget_row;
+    AdwSpinRow *undo_row;
     AdwPreferencesGroup *ai_group;
     AdwComboRow *model_row;
     GtkStringList *model_list;
     GtkWidget *model_icon;
+    AdwComboRow *durability_row;
+    GtkStringList *durability_list;
     const gchar *current_model;
     guint selected_index;
     
@@ -692,6 +3391,77 @@ show_preferences_window (FlowWindow *self)
     adw_action_row_set_activatable_widget (row, GTK_WIDGET (welcome_switch));
     adw_preferences_group_add (group, GTK_WIDGET (row));
     
+    adw_preferences_page_add (page, group);
+    
+    group = ADW_PREFERENCES_GROUP (adw_preferences_group_new ());
+    adw_preferences_group_set_title (group, "Files");
+    
+    durability_row = ADW_COMBO_ROW (adw_combo_row_new ());
+    adw_preferences_row_set_title (ADW_PREFERENCES_ROW (durability_row), "Save Durability");
+    adw_action_row_set_subtitle (ADW_ACTION_ROW (durability_row), "Flush saved files to disk before replacing the original");
+    durability_list = gtk_string_list_new (SAVE_DURABILITY_LABELS);
+    adw_combo_row_set_model (durability_row, G_LIST_MODEL (durability_list));
+    adw_combo_row_set_selected (durability_row, (guint) self->save_durability);
+    g_signal_connect (durability_row, "notify::selected", G_CALLBACK (on_save_durability_selected), self);
+    g_object_unref (durability_list);
+    adw_preferences_group_add (group, GTK_WIDGET (durability_row));
+    
+    row = ADW_ACTION_ROW (adw_action_row_new ());
+    adw_preferences_row_set_title (ADW_PREFERENCES_ROW (row), "Recompress on Save");
+    adw_action_row_set_subtitle (row, "Save gzip, zstd and xz files compressed again");
+    recompress_switch = GTK_SWITCH (gtk_switch_new ());
+    gtk_switch_set_active (recompress_switch, self->recompress_on_save);
+    gtk_widget_set_valign (GTK_WIDGET (recompress_switch), GTK_ALIGN_CENTER);
+    g_signal_connect (recompress_switch, "notify::active", G_CALLBACK (on_recompress_switch_toggled), self);
+    adw_action_row_add_suffix (row, GTK_WIDGET (recompress_switch));
+    adw_action_row_set_activatable_widget (row, GTK_WIDGET (recompress_switch));
+    adw_preferences_group_add (group, GTK_WIDGET (row));
+    
+    follow_row = ADW_SPIN_ROW (adw_spin_row_new_with_range (1000, 10000000, 1000));
+    adw_preferences_row_set_title (ADW_PREFERENCES_ROW (follow_row), "Follow Mode Line Limit");
+    adw_action_row_set_subtitle (ADW_ACTION_ROW (follow_row), "Oldest lines of a followed file are dropped past this");
+    adw_spin_row_set_value (follow_row, self->follow_max_lines);
+    g_signal_connect (follow_row, "notify::value", G_CALLBACK (on_follow_max_lines_changed), self);
+    adw_preferences_group_add (group, GTK_WIDGET (follow_row));
+    
+    budget_row = ADW_SPIN_ROW (adw_spin_row_new_with_range (32, 65536, 32));
+    adw_preferences_row_set_title (ADW_PREFERENCES_ROW (budget_row), "Tab Memory Budget (MiB)");
+    adw_action_row_set_subtitle (ADW_ACTION_ROW (budget_row),
+                                 "Unused tabs past this are unloaded until shown again");
+    adw_spin_row_set_value (budget_row, self->tab_memory_budget_mb);
+    g_signal_connect (budget_row, "notify::value", G_CALLBACK (on_tab_memory_budget_changed), self);
+    adw_preferences_group_add (group, GTK_WIDGET (budget_row));
+    
+    undo_row = ADW_SPIN_ROW (adw_spin_row_new_with_range (1, 4096, 16));
+    adw_preferences_row_set_title (ADW_PREFERENCES_ROW (undo_row), "Undo History Limit (MiB)");
+    adw_action_row_set_subtitle (ADW_ACTION_ROW (undo_row),
+                                 "Oldest undo steps of a tab are forgotten past this");
+    adw_spin_row_set_value (undo_row, self->undo_history_limit_mb);
+    g_signal_connect (undo_row, "notify::value", G_CALLBACK (on_undo_history_limit_changed), self);
+    adw_preferences_group_add (group, GTK_WIDGET (undo_row));
+    
+    row = ADW_ACTION_ROW (adw_action_row_new ());
+    adw_preferences_row_set_title (ADW_PREFERENCES_ROW (row), "Restore Session");
+    adw_action_row_set_subtitle (row, "Reopen the last folder and tabs on startup");
+    session_switch = GTK_SWITCH (gtk_switch_new ());
+    gtk_switch_set_active (session_switch, self->restore_session);
+    gtk_widget_set_valign (GTK_WIDGET (session_switch), GTK_ALIGN_CENTER);
+    g_signal_connect (session_switch, "notify::active", G_CALLBACK (on_restore_session_switch_toggled), self);
+    adw_action_row_add_suffix (row, GTK_WIDGET (session_switch));
+    adw_action_row_set_activatable_widget (row, GTK_WIDGET (session_switch));
+    adw_preferences_group_add (group, GTK_WIDGET (row));
+    
+    row = ADW_ACTION_ROW (adw_action_row_new ());
+    adw_preferences_row_set_title (ADW_PREFERENCES_ROW (row), "Show Ignored Files");
+    adw_action_row_set_subtitle (row, "List files that .gitignore and the ignore patterns leave out, dimmed");
+    ignored_switch = GTK_SWITCH (gtk_switch_new ());
+    gtk_switch_set_active (ignored_switch, self->show_ignored);
+    gtk_widget_set_valign (GTK_WIDGET (ignored_switch), GTK_ALIGN_CENTER);
+    g_signal_connect (ignored_switch, "notify::active", G_CALLBACK (on_show_ignored_switch_toggled), self);
+    adw_action_row_add_suffix (row, GTK_WIDGET (ignored_switch));
+    adw_action_row_set_activatable_widget (row, GTK_WIDGET (ignored_switch));
+    adw_preferences_group_add (group, GTK_WIDGET (row));
+    
     adw_preferences_page_add (page, group);
 
     current_model = self->ai_model ? self->ai_model : AI_DEFAULT_MODEL;
@@ -719,6 +3489,100 @@ show_preferences_window (FlowWindow *self)
     gtk_window_present (GTK_WINDOW (prefs));
 }
 
+static void
+on_save_durability_selected (AdwComboRow *row, GParamSpec *pspec, FlowWindow *self)
+{
+    guint index = adw_combo_row_get_selected (row);
+    
+    (void)pspec;
+    
+    if (index > FLOW_SAVE_DURABILITY_FSYNC_DIRECTORY)
+        return;
+    
+    self->save_durability = (FlowSaveDurability) index;
+    if (self->settings)
+        g_settings_set_string (self->settings, "save-durability",
+                               flow_save_durability_to_string (self->save_durability));
+}
+
+static void
+on_recompress_switch_toggled (GtkSwitch *sw, GParamSpec *pspec, FlowWindow *self)
+{
+    (void)pspec;
+    
+    self->recompress_on_save = gtk_switch_get_active (sw);
+    if (self->settings)
+        g_settings_set_boolean (self->settings, "recompress-on-save", self->recompress_on_save);
+}
+
+static void
+on_restore_session_switch_toggled (GtkSwitch *sw, GParamSpec *pspec, FlowWindow *self)
+{
+    (void)pspec;
+    
+    self->restore_session = gtk_switch_get_active (sw);
+    if (self->settings)
+        g_settings_set_boolean (self->settings, "restore-session", self->restore_session);
+}
+
+static void
+on_show_ignored_switch_toggled (GtkSwitch *sw, GParamSpec *pspec, FlowWindow *self)
+{
+    (void)pspec;
+    
+    explorer_set_show_ignored (self, gtk_switch_get_active (sw));
+    if (self->settings)
+        g_settings_set_boolean (self->settings, "show-ignored", self->show_ignored);
+}
+
+static void
+on_tab_memory_budget_changed (AdwSpinRow *row, GParamSpec *pspec, FlowWindow *self)
+{
+    (void)pspec;
+    
+    self->tab_memory_budget_mb = (guint) adw_spin_row_get_value (row);
+    if (self->settings)
+        g_settings_set_int (self->settings, "tab-memory-budget", (gint) self->tab_memory_budget_mb);
+    queue_memory_budget_check (self);
+}
+
+/* Applies the undo history limit to every open tab. */
+static void
+apply_undo_history_limit (FlowWindow *self)
+{
+    guint n_pages = (guint) adw_tab_view_get_n_pages (self->tab_view);
+    guint i;
+    
+    for (i = 0; i < n_pages; i++) {
+        AdwTabPage *page = adw_tab_view_get_nth_page (self->tab_view, (gint) i);
+        TabData *data = g_object_get_data (G_OBJECT (page), "tab-data");
+        
+        if (data && data->undo)
+            flow_undo_set_byte_cap (data->undo, (gsize) self->undo_history_limit_mb * 1024 * 1024);
+    }
+}
+
+static void
+on_undo_history_limit_changed (AdwSpinRow *row, GParamSpec *pspec, FlowWindow *self)
+{
+    (void)pspec;
+    
+    self->undo_history_limit_mb = (guint) adw_spin_row_get_value (row);
+    if (self->settings)
+        g_settings_set_int (self->settings, "undo-history-limit", (gint) self->undo_history_limit_mb);
+    apply_undo_history_limit (self);
+}
+
+static void
+on_follow_max_lines_changed (AdwSpinRow *row, GParamSpec *pspec, FlowWindow *self)
+{
+    (void)pspec;
+    
+    self->follow_max_lines = (guint) adw_spin_row_get_value (row);
+    if (self->settings)
+        g_settings_set_int (self->settings, "follow-max-lines", (gint) self->follow_max_lines);
+}
+
 static void
 on_settings_clicked (GtkButton *button, FlowWindow *self)
 {
@@ -728,19 +3592,24 @@ on_settings_clicked (GtkButton *button, FlowWindow *self)
 static void
 on_command_palette_clicked (GtkButton *button, FlowWindow *self)
 {
+    command_list_ensure (self);
     gtk_popover_popup (self->command_popover);
     gtk_widget_grab_focus (GTK_WIDGET (self->command_search));
 }
 
+static void
+open_goto_line (FlowWindow *self)
+{
+    on_command_palette_clicked (NULL, self);
+    gtk_editable_set_text (GTK_EDITABLE (self->command_search), ":");
+    gtk_editable_set_position (GTK_EDITABLE (self->command_search), -1);
+}
+
 static void
 execute_command (FlowWindow *self, const gchar *command)
 {
     GtkFileDialog *dialog;
     TabData *data;
-    GtkTextBuffer *buffer;
-    GtkTextIter start, end;
-    gchar *text;
-    GError *error = NULL;
     
     gtk_popover_popdown (self->command_popover);
     
@@ -753,10 +3622,27 @@ execute_command (FlowWindow *self, const gchar *command)
         g_object_unref (dialog);
     } else if (g_strcmp0 (command, "Save File") == 0) {
         data = get_current_tab_data (self);
-        if (!data || data->is_welcome)
+        if (!data || data->is_welcome || !data->text_view)
+            return;
+        
+        if (tab_data_is_loading (data)) {
+            set_status_text (self, "File is still loading");
+            return;
+        }
+        
+        if (data->follower) {
+            set_status_text (self, "Stop following before saving");
             return;
+        }
+        
+        if (data->load_incomplete) {
+            set_status_text (self, "Cannot save a partially loaded file");
+            return;
+        }
         
-        if (!data->file) {
+        /* Without recompression, plain text must not replace the
+         * compressed original; ask for a new name instead. */
+        if (!data->file || (data->compression != FLOW_COMPRESSION_NONE && !self->recompress_on_save)) {
             dialog = gtk_file_dialog_new ();
             gtk_file_dialog_set_title (dialog, "Save File");
             gtk_file_dialog_save (dialog, GTK_WINDOW (self), NULL, on_save_dialog_response, self);
@@ -764,19 +3650,7 @@ execute_command (FlowWindow *self, const gchar *command)
             return;
         }
         
-        buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
-        gtk_text_buffer_get_bounds (buffer, &start, &end);
-        text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
-        
-        if (!g_file_replace_contents (data->file, text, strlen (text), NULL, FALSE,
-                                       G_FILE_CREATE_NONE, NULL, NULL, &error)) {
-            g_warning ("Failed to save file: %s", error->message);
-            g_error_free (error);
-        } else {
-            if (self->status_label)
-                gtk_label_set_text (self->status_label, "Saved");
-        }
-        g_free (text);
+        tab_data_save (data, data->file, FALSE);
     } else if (g_strcmp0 (command, "Open Folder") == 0) {
         dialog = gtk_file_dialog_new ();
         gtk_file_dialog_set_title (dialog, "Open Folder");
@@ -785,6 +3659,28 @@ execute_command (FlowWindow *self, const gchar *command)
     } else if (g_strcmp0 (command, "Toggle Theme") == 0) {
         self->dark_mode = !self->dark_mode;
         apply_theme (self);
+    } else if (g_strcmp0 (command, "Toggle Ignored Files") == 0) {
+        explorer_set_show_ignored (self, !self->show_ignored);
+        if (self->settings)
+            g_settings_set_boolean (self->settings, "show-ignored", self->show_ignored);
+    } else if (g_strcmp0 (command, "Go to File") == 0) {
+        quick_open_show (self);
+    } else if (g_strcmp0 (command, "Go to Line") == 0) {
+        open_goto_line (self);
+    } else if (g_str_has_prefix (command, "Go to Line ")) {
+        goto_line (self, g_ascii_strtoull (command + strlen ("Go to Line "), NULL, 10));
+    } else if (g_strcmp0 (command, "Undo") == 0 || g_strcmp0 (command, "Redo") == 0) {
+        data = get_current_tab_data (self);
+        if (data && !data->is_welcome && data->text_view && !tab_data_is_loading (data))
+            tab_data_undo (data, g_strcmp0 (command, "Redo") == 0);
+    } else if (g_strcmp0 (command, "Reload File") == 0) {
+        data = get_current_tab_data (self);
+        if (data && !data->is_welcome)
+            tab_data_check_disk (data, TRUE);
+    } else if (g_strcmp0 (command, "Toggle Follow Mode") == 0) {
+        data = get_current_tab_data (self);
+        if (data && !data->is_welcome)
+            tab_data_toggle_follow (data);
     } else if (g_strcmp0 (command, "Close Tab") == 0) {
         AdwTabPage *page = adw_tab_view_get_selected_page (self->tab_view);
         if (page)
@@ -814,8 +3710,15 @@ populate_command_list (FlowWindow *self, const gchar *search_text)
         "New File",
         "Open File",
         "Save File",
+        "Reload File",
+        "Undo",
+        "Redo",
         "Open Folder",
+        "Go to File",
         "Close Tab",
+        "Go to Line",
+        "Toggle Follow Mode",
+        "Toggle Ignored Files",
         "Toggle Theme",
         NULL
     };
@@ -824,6 +3727,21 @@ populate_command_list (FlowWindow *self, const gchar *search_text)
     while ((child = gtk_widget_get_first_child (GTK_WIDGET (self->command_list))))
         gtk_list_box_remove (self->command_list, child);
     
+    /* ":N" jumps to line N. */
+    if (search_text && search_text[0] == ':') {
+        guint64 line = g_ascii_strtoull (search_text + 1, NULL, 10);
+        gchar *label = line > 0 ? g_strdup_printf ("Go to Line %" G_GUINT64_FORMAT, line)
+                                : g_strdup ("Go to Line (type a line number)");
+        
+        child = gtk_list_box_row_new ();
+        gtk_list_box_row_set_child (GTK_LIST_BOX_ROW (child), gtk_label_new (label));
+        gtk_label_set_xalign (GTK_LABEL (gtk_list_box_row_get_child (GTK_LIST_BOX_ROW (child))), 0);
+        gtk_list_box_row_set_activatable (GTK_LIST_BOX_ROW (child), line > 0);
+        gtk_list_box_append (self->command_list, child);
+        g_free (label);
+        return;
+    }
+    
     for (i = 0; commands[i] != NULL; i++) {
         if (search_text && *search_text && !g_str_match_string (search_text, commands[i], TRUE))
             continue;
@@ -842,6 +3760,158 @@ on_command_search_changed (GtkSearchEntry *entry, FlowWindow *self)
     populate_command_list (self, text);
 }
 
+static void
+on_command_search_activate (GtkSearchEntry *entry, FlowWindow *self)
+{
+    GtkListBoxRow *row = gtk_list_box_get_row_at_index (self->command_list, 0);
+    
+    if (row && gtk_list_box_row_get_activatable (row))
+        on_command_activated (self->command_list, row, self);
+}
+
+/*
+ * Splits a quick-open query of the form "path:line" or
+ * "path:line:column" into the path to search for and the position.
+ */
+static gchar *
+quick_open_parse_query (const gchar *query, gint *line, gint *column)
+{
+    gchar *path = g_strdup (query);
+    guint64 numbers[2];
+    gchar *colon;
+    gint n = 0;
+    
+    *line = 0;
+    *column = 0;
+    
+    /* "name:" while the line number is still being typed. */
+    if (g_str_has_suffix (path, ":"))
+        path[strlen (path) - 1] = '\0';
+    
+    while (n < 2 && (colon = strrchr (path, ':')) && colon[1] &&
+           strspn (colon + 1, "0123456789") == strlen (colon + 1)) {
+        numbers[n++] = g_ascii_strtoull (colon + 1, NULL, 10);
+        *colon = '\0';
+    }
+    
+    if (n == 2) {
+        *line = (gint) MIN (numbers[1], G_MAXINT);
+        *column = (gint) MIN (numbers[0], G_MAXINT);
+    } else if (n == 1) {
+        *line = (gint) MIN (numbers[0], G_MAXINT);
+    }
+    
+    return path;
+}
+
+static void
+on_quick_open_results (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    FlowWindow *self;
+    GPtrArray *matches;
+    GtkWidget *child;
+    GtkListBoxRow *first;
+    guint i;
+    
+    /* Cancelled when a newer query started or the window went away. */
+    matches = flow_workspace_index_search_finish (FLOW_WORKSPACE_INDEX (source_object), res, NULL);
+    if (!matches)
+        return;
+    
+    self = FLOW_WINDOW (user_data);
+    
+    while ((child = gtk_widget_get_first_child (GTK_WIDGET (self->quick_open_list))))
+        gtk_list_box_remove (self->quick_open_list, child);
+    
+    for (i = 0; i < matches->len; i++) {
+        const gchar *path = g_ptr_array_index (matches, i);
+        GtkWidget *label = gtk_label_new (path);
+        
+        gtk_label_set_xalign (GTK_LABEL (label), 0);
+        gtk_label_set_ellipsize (GTK_LABEL (label), PANGO_ELLIPSIZE_START);
+        child = gtk_list_box_row_new ();
+        gtk_list_box_row_set_child (GTK_LIST_BOX_ROW (child), label);
+        g_object_set_data_full (G_OBJECT (child), "path", g_strdup (path), g_free);
+        gtk_list_box_append (self->quick_open_list, child);
+    }
+    
+    first = gtk_list_box_get_row_at_index (self->quick_open_list, 0);
+    if (first)
+        gtk_list_box_select_row (self->quick_open_list, first);
+    
+    g_ptr_array_unref (matches);
+}
+
+static void
+on_quick_open_search_changed (GtkSearchEntry *entry, FlowWindow *self)
+{
+    gchar *path;
+    
+    if (self->quick_open_cancellable) {
+        g_cancellable_cancel (self->quick_open_cancellable);
+        g_clear_object (&self->quick_open_cancellable);
+    }
+    
+    if (!self->workspace_index)
+        return;
+    
+    path = quick_open_parse_query (gtk_editable_get_text (GTK_EDITABLE (entry)),
+                                   &self->quick_open_line, &self->quick_open_column);
+    self->quick_open_cancellable = g_cancellable_new ();
+    flow_workspace_index_search_async (self->workspace_index, path, QUICK_OPEN_MAX_RESULTS,
+                                       self->quick_open_cancellable, on_quick_open_results, self);
+    g_free (path);
+}
+
+/* Searches again once paths typed before the index was ready exist. */
+static void
+on_workspace_index_ready (FlowWindow *self)
+{
+    if (gtk_widget_get_visible (GTK_WIDGET (self->quick_open_popover)))
+        on_quick_open_search_changed (self->quick_open_search, self);
+}
+
+static void
+on_quick_open_activated (GtkListBox *box, GtkListBoxRow *row, FlowWindow *self)
+{
+    const gchar *path;
+    GFile *file;
+    
+    if (!row || !self->workspace_index)
+        return;
+    
+    path = g_object_get_data (G_OBJECT (row), "path");
+    file = g_file_resolve_relative_path (flow_workspace_index_get_root (self->workspace_index), path);
+    
+    gtk_popover_popdown (self->quick_open_popover);
+    flow_window_open_file (self, file, self->quick_open_line, self->quick_open_column, TRUE);
+    g_object_unref (file);
+}
+
+static void
+on_quick_open_search_activate (GtkSearchEntry *entry, FlowWindow *self)
+{
+    GtkListBoxRow *row = gtk_list_box_get_selected_row (self->quick_open_list);
+    
+    if (!row)
+        row = gtk_list_box_get_row_at_index (self->quick_open_list, 0);
+    if (row)
+        on_quick_open_activated (self->quick_open_list, row, self);
+}
+
+static void
+quick_open_show (FlowWindow *self)
+{
+    if (!self->workspace_index) {
+        set_status_text (self, "Open a folder to go to its files");
+        return;
+    }
+    
+    gtk_popover_popup (self->quick_open_popover);
+    gtk_widget_grab_focus (GTK_WIDGET (self->quick_open_search));
+    gtk_editable_select_region (GTK_EDITABLE (self->quick_open_search), 0, -1);
+}
+
 static void
 ai_append_message_widget (FlowWindow *self, const gchar *text, gboolean is_user)
 {
@@ -1481,36 +4551,15 @@ on_open_dialog_response (GObject *source, GAsyncResult *result, gpointer user_da
     FlowWindow *self = FLOW_WINDOW (user_data);
     GError *error = NULL;
     GFile *file;
-    gchar *contents;
-    gsize length;
     
     file = gtk_file_dialog_open_finish (GTK_FILE_DIALOG (source), result, &error);
     if (file) {
-        if (g_file_load_contents (file, NULL, &contents, &length, NULL, &error)) {
-            gchar *basename;
-            TabData *data;
-            GtkTextBuffer *buffer;
-            
-            basename = g_file_get_basename (file);
-            create_new_tab (self, basename, file);
-            
-            data = get_current_tab_data (self);
-            if (data) {
-                buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
-                gtk_text_buffer_set_text (buffer, contents, length);
-            }
-            
-            g_free (basename);
-            g_free (contents);
-        } else if (error) {
-            g_warning ("Failed to load file: %s", error->message);
-            g_error_free (error);
-        }
+        open_file_in_new_tab (self, file);
         g_object_unref (file);
     } else if (error && !g_error_matches (error, GTK_DIALOG_ERROR, GTK_DIALOG_ERROR_DISMISSED)) {
         g_warning ("Failed to open file: %s", error->message);
     }
-    if (error && error->code != GTK_DIALOG_ERROR_DISMISSED)
+    if (error)
         g_error_free (error);
 }
 
@@ -1524,28 +4573,12 @@ on_save_dialog_response (GObject *source, GAsyncResult *result, gpointer user_da
     file = gtk_file_dialog_save_finish (GTK_FILE_DIALOG (source), result, &error);
     if (file) {
         TabData *data = get_current_tab_data (self);
-        if (data) {
-            GtkTextBuffer *buffer;
-            GtkTextIter start, end;
-            gchar *text;
-            
+        if (data && data->text_view) {
             if (data->file)
                 g_object_unref (data->file);
             data->file = g_object_ref (file);
             
-            buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
-            gtk_text_buffer_get_bounds (buffer, &start, &end);
-            text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
-            
-            if (g_file_replace_contents (file, text, strlen (text), NULL, FALSE,
-                                        G_FILE_CREATE_NONE, NULL, NULL, &error)) {
-                gchar *basename = g_file_get_basename (file);
-                AdwTabPage *page = adw_tab_view_get_selected_page (self->tab_view);
-                if (page)
-                    adw_tab_page_set_title (page, basename);
-                g_free (basename);
-            }
-            g_free (text);
+            tab_data_save (data, file, TRUE);
         }
         g_object_unref (file);
     }
@@ -1593,49 +4626,9 @@ on_file_search_changed (GtkSearchEntry *entry, FlowWindow *self)
     text = gtk_editable_get_text (GTK_EDITABLE (entry));
     
     g_free (self->search_text);
-    self->search_text = g_strdup (text);
-    
-    if (self->current_folder)
-        load_folder (self, self->current_folder);
-}
-
-static void
-on_file_row_activated (FlowWindow *self, gpointer user_data)
-{
-    GFile *file;
-    gchar *contents;
-    gsize length;
-    GError *error = NULL;
-    GtkWidget *button;
-    
-    button = GTK_WIDGET (user_data);
-    if (!button)
-        return;
-    
-    file = g_object_get_data (G_OBJECT (button), "file");
-    
-    if (!file)
-        return;
+    self->search_text = g_strdup (text);
     
-    if (g_file_load_contents (file, NULL, &contents, &length, NULL, &error)) {
-        gchar *basename;
-        TabData *data;
-        
-        basename = g_file_get_basename (file);
-        create_new_tab (self, basename, file);
-        
-        data = get_current_tab_data (self);
-        if (data) {
-            GtkTextBuffer *buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
-            gtk_text_buffer_set_text (buffer, contents, length);
-        }
-        
-        g_free (basename);
-        g_free (contents);
-    } else {
-        g_warning ("Failed to load file: %s", error->message);
-        g_error_free (error);
-    }
+    file_search_apply (self);
 }
 
 static gboolean
@@ -1649,6 +4642,12 @@ static void
 on_selected_page_changed (GObject *object, GParamSpec *pspec, FlowWindow *self)
 {
     TabData *data = get_current_tab_data (self);
+    if (data)
+        data->last_used = g_get_monotonic_time ();
+    if (data && data->placeholder)
+        tab_data_materialize (data);
+    if (data && data->shelved)
+        tab_data_unshelve (data);
     if (data && data->file) {
         gchar *basename = g_file_get_basename (data->file);
         adw_window_title_set_title (self->title_widget, basename);
@@ -1657,17 +4656,33 @@ on_selected_page_changed (GObject *object, GParamSpec *pspec, FlowWindow *self)
         adw_window_title_set_title (self->title_widget, "Flow");
     }
     update_stats (self);
+    queue_memory_budget_check (self);
+}
+
+static void
+on_buffer_mark_set (GtkTextBuffer *buffer, GtkTextIter *location, GtkTextMark *mark, FlowWindow *self)
+{
+    /* Selection bounds, spell checking and search all move marks; only
+     * the cursor matters for the position label. */
+    if (mark == gtk_text_buffer_get_insert (buffer))
+        queue_update_stats (self);
+}
+
+static void
+tab_data_connect_stats (FlowWindow *self, TabData *data)
+{
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
+    
+    g_signal_connect_swapped (buffer, "changed", G_CALLBACK (queue_update_stats), self);
+    g_signal_connect (buffer, "mark-set", G_CALLBACK (on_buffer_mark_set), self);
 }
 
 static void
 on_page_attached (AdwTabView *view, AdwTabPage *page, gint position, FlowWindow *self)
 {
     TabData *data = g_object_get_data (G_OBJECT (page), "tab-data");
-    if (data && !data->is_welcome && data->text_view) {
-        GtkTextBuffer *buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
-        g_signal_connect_swapped (buffer, "changed", G_CALLBACK (update_stats), self);
-        g_signal_connect_swapped (buffer, "mark-set", G_CALLBACK (update_stats), self);
-    }
+    if (data && !data->is_welcome && data->text_view)
+        tab_data_connect_stats (self, data);
 }
 
 static gboolean
@@ -1679,6 +4694,9 @@ on_key_pressed (GtkEventControllerKey *controller, guint keyval, guint keycode,
     if (ctrl && shift && keyval == GDK_KEY_P) {
         on_command_palette_clicked (NULL, self);
         return TRUE;
+    } else if (ctrl && !shift && keyval == GDK_KEY_p) {
+        quick_open_show (self);
+        return TRUE;
     } else if (ctrl && shift && keyval == GDK_KEY_O) {
         GtkFileDialog *dialog = gtk_file_dialog_new ();
         gtk_file_dialog_set_title (dialog, "Open Folder");
@@ -1697,11 +4715,20 @@ on_key_pressed (GtkEventControllerKey *controller, guint keyval, guint keycode,
     } else if (ctrl && !shift && keyval == GDK_KEY_s) {
         execute_command (self, "Save File");
         return TRUE;
+    } else if (ctrl && !shift && keyval == GDK_KEY_z) {
+        execute_command (self, "Undo");
+        return TRUE;
+    } else if (ctrl && ((shift && keyval == GDK_KEY_Z) || (!shift && keyval == GDK_KEY_y))) {
+        execute_command (self, "Redo");
+        return TRUE;
     } else if (ctrl && !shift && keyval == GDK_KEY_w) {
         AdwTabPage *page = adw_tab_view_get_selected_page (self->tab_view);
         if (page)
             adw_tab_view_close_page (self->tab_view, page);
         return TRUE;
+    } else if (ctrl && !shift && keyval == GDK_KEY_g) {
+        open_goto_line (self);
+        return TRUE;
     } else if (ctrl && !shift && keyval == GDK_KEY_t) {
         self->dark_mode = !self->dark_mode;
         apply_theme (self);
@@ -1711,10 +4738,262 @@ on_key_pressed (GtkEventControllerKey *controller, guint keyval, guint keycode,
     return FALSE;
 }
 
+/*
+ * Records the open tabs, their positions, the folder and which of its
+ * directories are expanded.  Placeholder tabs keep the position they were
+ * restored with, so a session survives even if most tabs were never shown.
+ */
+static void
+session_save (FlowWindow *self)
+{
+    GVariantBuilder tabs;
+    GVariantBuilder folders;
+    GHashTableIter iter;
+    gpointer key;
+    gint n_pages;
+    gint selected = -1;
+    gint saved = 0;
+    gint i;
+    gchar *folder_uri;
+    
+    if (self->session_saved || !self->settings)
+        return;
+    self->session_saved = TRUE;
+    
+    if (!self->restore_session) {
+        g_settings_reset (self->settings, "session-tabs");
+        g_settings_reset (self->settings, "session-selected-tab");
+        g_settings_reset (self->settings, "session-folder");
+        g_settings_reset (self->settings, "session-expanded-folders");
+        g_settings_sync ();
+        return;
+    }
+    
+    g_variant_builder_init (&tabs, G_VARIANT_TYPE ("a(sii)"));
+    n_pages = self->tab_view ? adw_tab_view_get_n_pages (self->tab_view) : 0;
+    for (i = 0; i < n_pages; i++) {
+        AdwTabPage *page = adw_tab_view_get_nth_page (self->tab_view, i);
+        TabData *data = g_object_get_data (G_OBJECT (page), "tab-data");
+        gint line = 0;
+        gint column = 0;
+        gchar *uri;
+        
+        if (!data || data->is_welcome || !data->file)
+            continue;
+        
+        if (data->placeholder || data->restore_cursor) {
+            line = data->restore_line;
+            column = data->restore_column;
+        } else if (data->text_view) {
+            GtkTextBuffer *buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
+            GtkTextIter cursor;
+            
+            gtk_text_buffer_get_iter_at_mark (buffer, &cursor, gtk_text_buffer_get_insert (buffer));
+            line = gtk_text_iter_get_line (&cursor);
+            column = gtk_text_iter_get_line_offset (&cursor);
+        } else if (data->viewer) {
+            line = (gint) MIN (flow_mapped_viewer_get_top_line (FLOW_MAPPED_VIEWER (data->viewer)),
+                               (guint64) G_MAXINT);
+        }
+        
+        if (page == adw_tab_view_get_selected_page (self->tab_view))
+            selected = saved;
+        
+        uri = g_file_get_uri (data->file);
+        g_variant_builder_add (&tabs, "(sii)", uri, line, column);
+        g_free (uri);
+        saved++;
+    }
+    g_settings_set_value (self->settings, "session-tabs", g_variant_builder_end (&tabs));
+    g_settings_set_int (self->settings, "session-selected-tab", MAX (selected, 0));
+    
+    folder_uri = self->current_folder ? g_file_get_uri (self->current_folder) : g_strdup ("");
+    g_settings_set_string (self->settings, "session-folder", folder_uri);
+    g_free (folder_uri);
+    
+    g_variant_builder_init (&folders, G_VARIANT_TYPE_STRING_ARRAY);
+    if (self->current_folder && self->expanded_folders) {
+        g_hash_table_iter_init (&iter, self->expanded_folders);
+        while (g_hash_table_iter_next (&iter, &key, NULL)) {
+            GFile *dir = g_file_new_for_uri (key);
+            
+            if (g_file_has_prefix (dir, self->current_folder))
+                g_variant_builder_add (&folders, "s", key);
+            g_object_unref (dir);
+        }
+    }
+    g_settings_set_value (self->settings, "session-expanded-folders", g_variant_builder_end (&folders));
+    
+    g_settings_sync ();
+}
+
+/* Adds an unselected tab for @file that reads it only when first shown. */
+static TabData*
+append_placeholder_tab (FlowWindow *self, GFile *file, gint line, gint column)
+{
+    TabData *data = tab_data_new_placeholder (self, file, line, column);
+    gchar *basename = g_file_get_basename (file);
+    
+    data->page = adw_tab_view_append (self->tab_view, data->root);
+    adw_tab_page_set_title (data->page, basename);
+    g_object_set_data_full (G_OBJECT (data->page), "tab-data", data, (GDestroyNotify) tab_data_free);
+    g_free (basename);
+    
+    return data;
+}
+
+/* Opens the session's folder once it is known to still be one, unless
+ * another folder was opened meanwhile. */
 static void
-on_file_button_clicked (GtkButton *button, FlowWindow *self)
+on_session_folder_info_ready (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
-    on_file_row_activated (self, button);
+    FlowWindow *self;
+    GFileInfo *info;
+    GError *error = NULL;
+    
+    /* Cancelled when the window went away. */
+    info = g_file_query_info_finish (G_FILE (source_object), res, &error);
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_error_free (error);
+        return;
+    }
+    g_clear_error (&error);
+    
+    self = FLOW_WINDOW (user_data);
+    g_clear_object (&self->session_folder_cancellable);
+    
+    if (info && g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY && !self->current_folder)
+        load_folder (self, G_FILE (source_object));
+    g_clear_object (&info);
+}
+
+/*
+ * Reopens the last session.  Tabs come back as placeholders; only the one
+ * that ends up selected reads its file now.  Returns the number of tabs.
+ */
+static guint
+session_restore (FlowWindow *self)
+{
+    GVariant *tabs;
+    GVariantIter iter;
+    const gchar *uri;
+    gchar **folders;
+    gchar *folder_uri;
+    gint line;
+    gint column;
+    gint selected;
+    guint n_tabs = 0;
+    guint i;
+    
+    if (!self->settings || !self->restore_session)
+        return 0;
+    
+    folders = g_settings_get_strv (self->settings, "session-expanded-folders");
+    for (i = 0; folders[i]; i++)
+        g_hash_table_add (self->expanded_folders, g_strdup (folders[i]));
+    g_strfreev (folders);
+    
+    folder_uri = g_settings_get_string (self->settings, "session-folder");
+    if (*folder_uri) {
+        GFile *folder = g_file_new_for_uri (folder_uri);
+        
+        self->session_folder_cancellable = g_cancellable_new ();
+        g_file_query_info_async (folder, G_FILE_ATTRIBUTE_STANDARD_TYPE, G_FILE_QUERY_INFO_NONE,
+                                 G_PRIORITY_DEFAULT, self->session_folder_cancellable,
+                                 on_session_folder_info_ready, self);
+        g_object_unref (folder);
+    }
+    g_free (folder_uri);
+    
+    /* Files that went away since are dropped when their tab is first
+     * shown; see open_request_drop_placeholder(). */
+    tabs = g_settings_get_value (self->settings, "session-tabs");
+    g_variant_iter_init (&iter, tabs);
+    while (g_variant_iter_next (&iter, "(&sii)", &uri, &line, &column)) {
+        GFile *file = g_file_new_for_uri (uri);
+        
+        append_placeholder_tab (self, file, MAX (line, 0), MAX (column, 0));
+        g_object_unref (file);
+        n_tabs++;
+    }
+    g_variant_unref (tabs);
+    
+    if (n_tabs > 0) {
+        AdwTabPage *page;
+        
+        selected = g_settings_get_int (self->settings, "session-selected-tab");
+        page = adw_tab_view_get_nth_page (self->tab_view, (gint) MIN ((guint) MAX (selected, 0), n_tabs - 1));
+        adw_tab_view_set_selected_page (self->tab_view, page);
+        /* The first page appended was selected without the placeholder
+         * having been registered yet. */
+        tab_data_materialize (g_object_get_data (G_OBJECT (page), "tab-data"));
+    }
+    
+    return n_tabs;
+}
+
+static void
+journal_recover_worker (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    g_task_return_pointer (task, flow_journal_recover (cancellable), (GDestroyNotify) g_ptr_array_unref);
+}
+
+/* Opens a tab for each document whose unsaved edits outlived a crash. */
+static void
+on_journals_recovered (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    FlowWindow *self = FLOW_WINDOW (source_object);
+    GPtrArray *recoveries;
+    guint i;
+    
+    recoveries = g_task_propagate_pointer (G_TASK (res), NULL);
+    if (!recoveries)
+        return;
+    
+    for (i = 0; i < recoveries->len; i++) {
+        FlowJournalRecovery *recovery = g_ptr_array_index (recoveries, i);
+        GFile *file = recovery->uri ? g_file_new_for_uri (recovery->uri) : NULL;
+        gchar *basename = file ? g_file_get_basename (file) : g_strdup ("Untitled");
+        gchar *title = g_strdup_printf ("%s (recovered)", basename);
+        TabData *data;
+        
+        data = create_new_tab (self, title, file);
+        data->charset = recovery->charset;
+        data->has_bom = recovery->has_bom;
+        data->compression = recovery->compression;
+        data->hibernated = g_bytes_ref (recovery->text);
+        data->recovered_path = g_strdup (recovery->path);
+        tab_data_start_loading (data);
+        
+        g_free (title);
+        g_free (basename);
+        g_clear_object (&file);
+    }
+    
+    g_ptr_array_unref (recoveries);
+}
+
+/* Journals are per process, so only the first window looks for them. */
+static void
+journal_recover_start (FlowWindow *self)
+{
+    static gboolean recovered = FALSE;
+    GTask *task;
+    
+    if (recovered)
+        return;
+    recovered = TRUE;
+    
+    task = g_task_new (self, NULL, on_journals_recovered, NULL);
+    g_task_run_in_thread (task, journal_recover_worker);
+    g_object_unref (task);
+}
+
+static gboolean
+on_close_request (GtkWindow *window, FlowWindow *self)
+{
+    session_save (self);
+    return FALSE;
 }
 
 static void
@@ -1722,13 +5001,61 @@ flow_window_dispose (GObject *object)
 {
     FlowWindow *self = FLOW_WINDOW (object);
     
+    session_save (self);
+    
     if (self->current_folder) {
         g_object_unref (self->current_folder);
         self->current_folder = NULL;
     }
+    g_clear_pointer (&self->expanded_folders, g_hash_table_unref);
     
     g_free (self->search_text);
     self->search_text = NULL;
+    
+    self->file_tree = NULL;
+    if (self->file_list_view)
+        gtk_list_view_set_model (self->file_list_view, NULL);
+    g_clear_object (&self->file_tree_selection);
+    g_clear_pointer (&self->folder_models, g_hash_table_unref);
+    if (self->folder_models_sweep_id) {
+        g_source_remove (self->folder_models_sweep_id);
+        self->folder_models_sweep_id = 0;
+    }
+    g_clear_object (&self->file_results_selection);
+    if (self->workspace_index)
+        g_signal_handlers_disconnect_by_data (self->workspace_index, self);
+    g_clear_object (&self->workspace_index);
+    g_clear_object (&self->file_sorter);
+    g_clear_object (&self->file_filter);
+    g_clear_pointer (&self->ignore, flow_ignore_unref);
+    
+    if (self->quick_open_cancellable) {
+        g_cancellable_cancel (self->quick_open_cancellable);
+        g_clear_object (&self->quick_open_cancellable);
+    }
+    if (self->session_folder_cancellable) {
+        g_cancellable_cancel (self->session_folder_cancellable);
+        g_clear_object (&self->session_folder_cancellable);
+    }
+    if (self->quick_open_popover) {
+        gtk_widget_unparent (GTK_WIDGET (self->quick_open_popover));
+        self->quick_open_popover = NULL;
+    }
+    
+    g_clear_object (&self->settings);
+    
+    if (self->stats_idle_id) {
+        g_source_remove (self->stats_idle_id);
+        self->stats_idle_id = 0;
+    }
+    if (self->memory_idle_id) {
+        g_source_remove (self->memory_idle_id);
+        self->memory_idle_id = 0;
+    }
+    if (self->startup_idle_id) {
+        g_source_remove (self->startup_idle_id);
+        self->startup_idle_id = 0;
+    }
 
     g_free (self->ai_model);
     self->ai_model = NULL;
@@ -1755,22 +5082,190 @@ flow_window_class_init (FlowWindowClass *klass)
     gtk_widget_class_bind_template_child (widget_class, FlowWindow, sidebar_stack);
     gtk_widget_class_bind_template_child (widget_class, FlowWindow, tab_view);
     gtk_widget_class_bind_template_child (widget_class, FlowWindow, tab_bar);
-    gtk_widget_class_bind_template_child (widget_class, FlowWindow, file_list_container);
+    gtk_widget_class_bind_template_child (widget_class, FlowWindow, file_list_view);
     gtk_widget_class_bind_template_child (widget_class, FlowWindow, no_folder_label);
     gtk_widget_class_bind_template_child (widget_class, FlowWindow, open_folder_button);
     gtk_widget_class_bind_template_child (widget_class, FlowWindow, toggle_sidebar_button);
     gtk_widget_class_bind_template_child (widget_class, FlowWindow, settings_button);
     gtk_widget_class_bind_template_child (widget_class, FlowWindow, command_palette_button);
+    gtk_widget_class_bind_template_child (widget_class, FlowWindow, status_label);
+    gtk_widget_class_bind_template_child (widget_class, FlowWindow, position_label);
     gtk_widget_class_bind_template_child (widget_class, FlowWindow, title_widget);
     gtk_widget_class_bind_template_child (widget_class, FlowWindow, command_popover);
+    gtk_widget_class_bind_template_child (widget_class, FlowWindow, quick_open_popover);
+    gtk_widget_class_bind_template_child (widget_class, FlowWindow, quick_open_search);
+    gtk_widget_class_bind_template_child (widget_class, FlowWindow, quick_open_list);
     gtk_widget_class_bind_template_child (widget_class, FlowWindow, command_search);
     gtk_widget_class_bind_template_child (widget_class, FlowWindow, command_list);
     gtk_widget_class_bind_template_child (widget_class, FlowWindow, file_search);
     gtk_widget_class_bind_template_child (widget_class, FlowWindow, sidebar_folder_label);
-    gtk_widget_class_bind_template_child (widget_class, FlowWindow, ai_message_list);
-    gtk_widget_class_bind_template_child (widget_class, FlowWindow, ai_message_entry);
-    gtk_widget_class_bind_template_child (widget_class, FlowWindow, ai_send_button);
-    gtk_widget_class_bind_template_child (widget_class, FlowWindow, ai_spinner);
+    gtk_widget_class_bind_template_child (widget_class, FlowWindow, ai_sidebar_box);
+}
+
+/* Running uninstalled, the schema may be missing; fall back to defaults. */
+static GSettings *
+flow_window_create_settings (void)
+{
+    GSettingsSchemaSource *source = g_settings_schema_source_get_default ();
+    GSettingsSchema *schema;
+    GSettings *settings;
+    
+    if (!source)
+        return NULL;
+    
+    schema = g_settings_schema_source_lookup (source, "ink.coda.Flow", TRUE);
+    if (!schema)
+        return NULL;
+    
+    settings = g_settings_new_full (schema, NULL, NULL);
+    g_settings_schema_unref (schema);
+    return settings;
+}
+
+static void
+on_save_durability_changed (GSettings *settings, const gchar *key, FlowWindow *self)
+{
+    gchar *value = g_settings_get_string (settings, key);
+    
+    self->save_durability = flow_save_durability_from_string (value);
+    g_free (value);
+}
+
+static void
+on_recompress_on_save_changed (GSettings *settings, const gchar *key, FlowWindow *self)
+{
+    self->recompress_on_save = g_settings_get_boolean (settings, key);
+}
+
+static void
+on_follow_max_lines_settings_changed (GSettings *settings, const gchar *key, FlowWindow *self)
+{
+    self->follow_max_lines = (guint) g_settings_get_int (settings, key);
+}
+
+static void
+on_tab_memory_budget_settings_changed (GSettings *settings, const gchar *key, FlowWindow *self)
+{
+    self->tab_memory_budget_mb = (guint) g_settings_get_int (settings, key);
+    queue_memory_budget_check (self);
+}
+
+static void
+on_undo_history_limit_settings_changed (GSettings *settings, const gchar *key, FlowWindow *self)
+{
+    self->undo_history_limit_mb = (guint) g_settings_get_int (settings, key);
+    apply_undo_history_limit (self);
+}
+
+static void
+on_restore_session_changed (GSettings *settings, const gchar *key, FlowWindow *self)
+{
+    self->restore_session = g_settings_get_boolean (settings, key);
+}
+
+static void
+on_show_ignored_changed (GSettings *settings, const gchar *key, FlowWindow *self)
+{
+    explorer_set_show_ignored (self, g_settings_get_boolean (settings, key));
+}
+
+/* Builds the assistant sidebar page, the first time it is needed. */
+static void
+assistant_panel_ensure (FlowWindow *self)
+{
+    GtkBuilder *builder;
+    
+    if (self->assistant_built)
+        return;
+    self->assistant_built = TRUE;
+    
+    builder = gtk_builder_new_from_resource ("/ink/coda/Flow/flow-assistant.ui");
+    self->ai_message_list = GTK_BOX (gtk_builder_get_object (builder, "ai_message_list"));
+    self->ai_message_entry = GTK_ENTRY (gtk_builder_get_object (builder, "ai_message_entry"));
+    self->ai_send_button = GTK_BUTTON (gtk_builder_get_object (builder, "ai_send_button"));
+    self->ai_spinner = GTK_SPINNER (gtk_builder_get_object (builder, "ai_spinner"));
+    gtk_box_append (self->ai_sidebar_box, GTK_WIDGET (gtk_builder_get_object (builder, "assistant_panel")));
+    g_object_unref (builder);
+    
+    g_signal_connect (self->ai_send_button, "clicked", G_CALLBACK (on_ai_send_clicked), self);
+    g_signal_connect (self->ai_message_entry, "activate", G_CALLBACK (on_ai_entry_activate), self);
+    ai_request_set_busy (self, FALSE);
+}
+
+static void
+on_sidebar_page_changed (FlowWindow *self)
+{
+    if (adw_view_stack_get_visible_child (self->sidebar_stack) == GTK_WIDGET (self->ai_sidebar_box))
+        assistant_panel_ensure (self);
+}
+
+static void
+command_list_ensure (FlowWindow *self)
+{
+    if (self->commands_populated)
+        return;
+    self->commands_populated = TRUE;
+    populate_command_list (self, NULL);
+}
+
+/* One line per phase, easy for CI to pick up. */
+static void
+startup_report (const gchar *phase, gint64 usec)
+{
+    g_printerr ("flow-startup: %s %.1f ms\n", phase, usec / 1000.0);
+}
+
+static void
+on_first_frame_painted (GdkFrameClock *clock, FlowWindow *self)
+{
+    GtkApplication *app = gtk_window_get_application (GTK_WINDOW (self));
+    
+    g_signal_handlers_disconnect_by_func (clock, on_first_frame_painted, self);
+    
+    startup_report ("window-init", self->init_finished - self->init_started);
+    startup_report ("first-frame", g_get_monotonic_time () - self->init_started);
+    if (FLOW_IS_APPLICATION (app))
+        startup_report ("first-frame-since-launch",
+                        g_get_monotonic_time () - flow_application_get_start_time (FLOW_APPLICATION (app)));
+}
+
+/* With FLOW_STARTUP_TIMING set, reports how long the first frame took. */
+static void
+on_window_realize (GtkWidget *widget, FlowWindow *self)
+{
+    GdkFrameClock *clock = gtk_widget_get_frame_clock (widget);
+    
+    if (self->startup_timing && clock)
+        g_signal_connect_object (clock, "after-paint", G_CALLBACK (on_first_frame_painted), self, 0);
+}
+
+/* Deferred construction, one step per idle so input is never held up. */
+static gboolean
+on_startup_idle (gpointer user_data)
+{
+    FlowWindow *self = user_data;
+    gint64 start = g_get_monotonic_time ();
+    
+    switch (self->startup_step++) {
+        case 0:
+            /* Mostly on a worker thread; started first to overlap the rest. */
+            flow_languages_warm_up ();
+            break;
+        case 1:
+            command_list_ensure (self);
+            break;
+        case 2:
+            assistant_panel_ensure (self);
+            break;
+        default:
+            self->startup_idle_id = 0;
+            if (self->startup_timing)
+                startup_report ("deferred", self->deferred_time);
+            return G_SOURCE_REMOVE;
+    }
+    
+    self->deferred_time += g_get_monotonic_time () - start;
+    return G_SOURCE_CONTINUE;
 }
 
 static void
@@ -1779,30 +5274,81 @@ flow_window_init (FlowWindow *self)
     GtkCssProvider *provider;
     GdkDisplay *display;
     GtkEventController *key_controller;
+    GtkListItemFactory *factory;
+    static gboolean css_installed = FALSE;
     const gchar *css = 
         "sourceview { background-color: @view_bg_color; }"
         ".file-tree-item { min-height: 28px; padding: 2px 4px; }"
         ".file-tree-item > box { min-height: 24px; }"
-        ".file-tree-item expander-title-box { min-height: 24px; padding: 0; }"
         ".file-tree-item image { margin: 0 4px; }"
         ".file-tree-item label { font-size: 0.9em; }";
     
+    self->startup_timing = g_getenv ("FLOW_STARTUP_TIMING") != NULL;
+    self->init_started = g_get_monotonic_time ();
+    
     gtk_widget_init_template (GTK_WIDGET (self));
+    gtk_widget_set_parent (GTK_WIDGET (self->quick_open_popover), GTK_WIDGET (self->title_widget));
     
     self->current_folder = NULL;
     self->dark_mode = TRUE;
     self->search_text = NULL;
     self->show_welcome = TRUE;
+    self->save_durability = FLOW_SAVE_DURABILITY_FSYNC;
+    self->recompress_on_save = TRUE;
+    self->follow_max_lines = FOLLOW_DEFAULT_MAX_LINES;
+    self->restore_session = TRUE;
+    self->tab_memory_budget_mb = TAB_MEMORY_DEFAULT_BUDGET_MB;
+    self->undo_history_limit_mb = UNDO_DEFAULT_HISTORY_LIMIT_MB;
+    self->expanded_folders = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    self->folder_models = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                 (GDestroyNotify) folder_model_ref_free);
+    self->file_sorter = gtk_custom_sorter_new (flow_file_item_compare, NULL, NULL);
+    self->file_filter = gtk_custom_filter_new (file_filter_func, self, NULL);
     
-    provider = gtk_css_provider_new ();
-    gtk_css_provider_load_from_string (provider, css);
+    self->settings = flow_window_create_settings ();
+    if (self->settings) {
+        g_signal_connect (self->settings, "changed::save-durability",
+                          G_CALLBACK (on_save_durability_changed), self);
+        on_save_durability_changed (self->settings, "save-durability", self);
+        g_signal_connect (self->settings, "changed::recompress-on-save",
+                          G_CALLBACK (on_recompress_on_save_changed), self);
+        on_recompress_on_save_changed (self->settings, "recompress-on-save", self);
+        g_signal_connect (self->settings, "changed::follow-max-lines",
+                          G_CALLBACK (on_follow_max_lines_settings_changed), self);
+        on_follow_max_lines_settings_changed (self->settings, "follow-max-lines", self);
+        g_signal_connect (self->settings, "changed::restore-session",
+                          G_CALLBACK (on_restore_session_changed), self);
+        on_restore_session_changed (self->settings, "restore-session", self);
+        g_signal_connect (self->settings, "changed::tab-memory-budget",
+                          G_CALLBACK (on_tab_memory_budget_settings_changed), self);
+        on_tab_memory_budget_settings_changed (self->settings, "tab-memory-budget", self);
+        g_signal_connect (self->settings, "changed::undo-history-limit",
+                          G_CALLBACK (on_undo_history_limit_settings_changed), self);
+        on_undo_history_limit_settings_changed (self->settings, "undo-history-limit", self);
+        g_signal_connect (self->settings, "changed::show-ignored",
+                          G_CALLBACK (on_show_ignored_changed), self);
+        on_show_ignored_changed (self->settings, "show-ignored", self);
+    }
+    
+    /* The provider applies to the whole display, so every later window
+     * already has it. */
     display = gdk_display_get_default ();
-    if (display) {
+    if (display && !css_installed) {
+        provider = gtk_css_provider_new ();
+        gtk_css_provider_load_from_string (provider, css);
         gtk_style_context_add_provider_for_display (display,
                                                     GTK_STYLE_PROVIDER (provider),
                                                     GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+        g_object_unref (provider);
+        css_installed = TRUE;
     }
-    g_object_unref (provider);
+    
+    factory = gtk_signal_list_item_factory_new ();
+    g_signal_connect (factory, "setup", G_CALLBACK (on_file_row_setup), self);
+    g_signal_connect (factory, "bind", G_CALLBACK (on_file_row_bind), self);
+    g_signal_connect (factory, "unbind", G_CALLBACK (on_file_row_unbind), self);
+    gtk_list_view_set_factory (self->file_list_view, factory);
+    g_object_unref (factory);
     
     key_controller = GTK_EVENT_CONTROLLER (gtk_event_controller_key_new ());
     g_signal_connect (key_controller, "key-pressed", G_CALLBACK (on_key_pressed), self);
@@ -1815,26 +5361,31 @@ flow_window_init (FlowWindow *self)
     g_signal_connect (self->tab_view, "page-attached", G_CALLBACK (on_page_attached), self);
     g_signal_connect (self->tab_view, "notify::selected-page", G_CALLBACK (on_selected_page_changed), self);
     g_signal_connect (self->command_search, "search-changed", G_CALLBACK (on_command_search_changed), self);
+    g_signal_connect (self->command_search, "activate", G_CALLBACK (on_command_search_activate), self);
     g_signal_connect (self->command_list, "row-activated", G_CALLBACK (on_command_activated), self);
+    g_signal_connect (self->quick_open_search, "search-changed", G_CALLBACK (on_quick_open_search_changed), self);
+    g_signal_connect (self->quick_open_search, "activate", G_CALLBACK (on_quick_open_search_activate), self);
+    g_signal_connect (self->quick_open_list, "row-activated", G_CALLBACK (on_quick_open_activated), self);
     g_signal_connect (self->file_search, "search-changed", G_CALLBACK (on_file_search_changed), self);
+    g_signal_connect (self->file_list_view, "activate", G_CALLBACK (on_file_list_activate), self);
+    g_signal_connect (self, "close-request", G_CALLBACK (on_close_request), self);
+    g_signal_connect_swapped (self->command_popover, "show", G_CALLBACK (command_list_ensure), self);
+    g_signal_connect_swapped (self->sidebar_stack, "notify::visible-child", G_CALLBACK (on_sidebar_page_changed), self);
+    g_signal_connect (self, "realize", G_CALLBACK (on_window_realize), self);
 
     self->ai_model = g_strdup (AI_DEFAULT_MODEL);
     self->ai_request_in_progress = FALSE;
     self->ai_conversation = g_ptr_array_new_with_free_func ((GDestroyNotify) ai_message_free);
-    if (self->ai_spinner) {
-        gtk_widget_set_visible (GTK_WIDGET (self->ai_spinner), FALSE);
-        gtk_spinner_set_spinning (self->ai_spinner, FALSE);
-    }
-    if (self->ai_send_button)
-        g_signal_connect (self->ai_send_button, "clicked", G_CALLBACK (on_ai_send_clicked), self);
-    if (self->ai_message_entry)
-        g_signal_connect (self->ai_message_entry, "activate", G_CALLBACK (on_ai_entry_activate), self);
-    ai_request_set_busy (self, FALSE);
     update_sidebar_folder_label (self, NULL);
     
-    populate_command_list (self, NULL);
-    create_welcome_tab (self);
+    if (session_restore (self) == 0)
+        create_welcome_tab (self);
+    journal_recover_start (self);
     apply_theme (self);
+    
+    /* Whatever the first frame does not show is built after it. */
+    self->startup_idle_id = g_idle_add_full (G_PRIORITY_LOW, on_startup_idle, self, NULL);
+    self->init_finished = g_get_monotonic_time ();
 }
 
 AdwApplicationWindow *
@@ -1844,3 +5395,86 @@ flow_window_new (AdwApplication *application)
                          "application", application,
                          NULL);
 }
+
+/* Tab already showing @file, if any. */
+static TabData*
+find_tab_for_file (FlowWindow *self, GFile *file)
+{
+    gint n_pages = adw_tab_view_get_n_pages (self->tab_view);
+    gint i;
+    
+    for (i = 0; i < n_pages; i++) {
+        AdwTabPage *page = adw_tab_view_get_nth_page (self->tab_view, i);
+        TabData *data = g_object_get_data (G_OBJECT (page), "tab-data");
+        
+        if (data && data->file && g_file_equal (data->file, file))
+            return data;
+    }
+    
+    return NULL;
+}
+
+/**
+ * flow_window_open_file:
+ * @self: a #FlowWindow
+ * @file: the file to open
+ * @line: line to put the cursor on, counted from 1, or 0 for none
+ * @column: column on @line, counted from 1, or 0 for its start
+ * @select: whether to show the tab
+ *
+ * Opens @file in a tab, or goes back to the tab already showing it.  A
+ * tab that is not selected reads its file only once it is shown, so
+ * opening many files at once costs little more than one.
+ */
+void
+flow_window_open_file (FlowWindow *self,
+                       GFile      *file,
+                       gint        line,
+                       gint        column,
+                       gboolean    select)
+{
+    TabData *data;
+    TabData *welcome = NULL;
+    
+    g_return_if_fail (FLOW_IS_WINDOW (self));
+    g_return_if_fail (G_IS_FILE (file));
+    
+    /* A lone welcome tab gives way to the first file opened. */
+    if (adw_tab_view_get_n_pages (self->tab_view) == 1) {
+        welcome = g_object_get_data (G_OBJECT (adw_tab_view_get_nth_page (self->tab_view, 0)), "tab-data");
+        if (welcome && !welcome->is_welcome)
+            welcome = NULL;
+    }
+    
+    data = find_tab_for_file (self, file);
+    if (!data) {
+        data = append_placeholder_tab (self, file, MAX (line - 1, 0), MAX (column - 1, 0));
+        data->restore_cursor = line > 0;
+    } else if (line > 0) {
+        if (data->viewer) {
+            flow_mapped_viewer_goto_line (FLOW_MAPPED_VIEWER (data->viewer), (guint64) line - 1);
+        } else if (data->text_view && !data->shelved && !tab_data_is_loading (data)) {
+            GtkTextBuffer *buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (data->text_view));
+            GtkTextIter cursor;
+            
+            gtk_text_buffer_get_iter_at_line_offset (buffer, &cursor, line - 1, MAX (column - 1, 0));
+            gtk_text_buffer_place_cursor (buffer, &cursor);
+            gtk_text_view_scroll_to_mark (GTK_TEXT_VIEW (data->text_view), gtk_text_buffer_get_insert (buffer),
+                                          0.0, TRUE, 0.0, 0.3);
+        } else {
+            /* Still to be read; the cursor is placed once it is. */
+            data->restore_cursor = TRUE;
+            data->restore_line = line - 1;
+            data->restore_column = MAX (column - 1, 0);
+        }
+    }
+    
+    if (select || welcome)
+        adw_tab_view_set_selected_page (self->tab_view, data->page);
+    /* The first page of an empty view is selected as it is appended,
+     * before it is known to be a placeholder. */
+    if (adw_tab_view_get_selected_page (self->tab_view) == data->page)
+        tab_data_materialize (data);
+    if (welcome)
+        adw_tab_view_close_page (self->tab_view, welcome->page);
+}
@@ -28,6 +28,11 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (FlowWindow, flow_window, FLOW, WINDOW, AdwApplicationWindow)
 
-AdwApplicationWindow *flow_window_new (AdwApplication *application);
+AdwApplicationWindow *flow_window_new       (AdwApplication *application);
+void                  flow_window_open_file (FlowWindow     *self,
+                                             GFile          *file,
+                                             gint            line,
+                                             gint            column,
+                                             gboolean        select);
 
 G_END_DECLS
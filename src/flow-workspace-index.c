@@ -0,0 +1,1350 @@
+/* flow-workspace-index.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * An index is one block of memory laid out the way it is cached on disk,
+ * so a cached index is used straight from its mapping:
+ *
+ *   header     IndexHeader: magic, counts and where each section starts
+ *   paths      relative paths of the files, each ending in a nul byte
+ *   offsets    u32 start of each path, then the end of the last
+ *   masks      u64 character mask of each path, for fuzzy searches
+ *   sizes      u64 size of each file
+ *   mtimes     i64 modification time of each file, in microseconds
+ *   dirs       IndexDir for each directory, parents before children
+ *   dir names  relative path of each directory, nul-terminated
+ *
+ * Numbers are in host byte order; a cache from another host fails the
+ * byte order check and is rebuilt.  Sections start on 8-byte boundaries.
+ *
+ * Opening a folder maps its cache, if any, on the build thread, which
+ * checks every path and directory in it before the index uses it; the
+ * index is ready as soon as that is done.  A FlowCrawler then walks the
+ * folder again on a pool of threads, and the directories it streams
+ * back are put in order as they arrive.  A directory whose modification
+ * time is unchanged has the same entries, so its files and subdirectory
+ * names are taken from the cache without reading it.  Only if some
+ * directory changed is the new index swapped in and cached.
+ *
+ * Ignored files and directories are left out, and an ignored directory
+ * is never read.  The ignore files are read again on every walk, since
+ * editing one need not touch its directory; the header keeps a digest
+ * of them, and a walk that ends with another digest starts over without
+ * the cache, whose directories were filtered by the old rules.
+ *
+ * The paths are stored back to back, each ending in a nul byte.  A query
+ * never contains a nul, so one scan of the whole block finds every match
+ * and cannot run across two paths.  When the query only grows longer,
+ * the previous matches are the only candidates and just those are
+ * searched.
+ *
+ * Fuzzy searches split the paths into one slice per core.  Each slice
+ * first tests a block of character masks in a loop simple enough for the
+ * compiler to vectorize, then scores only the paths that pass, keeping
+ * its best few.  The slices' best are merged at the end.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "flow-workspace-index.h"
+#include "flow-crawler.h"
+#include "flow-file-item.h"
+#include "flow-fuzzy.h"
+#include "flow-ignore.h"
+
+#define INDEX_MAGIC "FLOWIDX1"
+#define INDEX_VERSION 3
+#define INDEX_BYTE_ORDER 0x01020304
+#define INDEX_NO_PARENT G_MAXUINT32
+/* Bounds that keep a whole index under 4 GiB. */
+#define INDEX_MAX_PATHS_SIZE (1024 * 1024 * 1024)
+#define INDEX_MAX_FILES (16 * 1024 * 1024)
+/* Paths whose masks are tested before any of them is scored. */
+#define SEARCH_BLOCK_SIZE 4096
+/* Fewest paths worth a thread of their own. */
+#define SEARCH_MIN_SLICE 32768
+
+typedef struct {
+    gchar magic[8];
+    guint32 version;
+    guint32 byte_order;
+    guint32 n_paths;
+    guint32 n_dirs;
+    guint64 paths_offset;
+    guint64 paths_len;
+    guint64 offsets_offset;
+    guint64 masks_offset;
+    guint64 sizes_offset;
+    guint64 mtimes_offset;
+    guint64 dirs_offset;
+    guint64 dir_names_offset;
+    guint64 dir_names_len;
+    guint64 ignore_digest;
+} IndexHeader;
+
+typedef struct {
+    gint64 mtime;           /* microseconds, or 0 if unknown */
+    guint32 name;           /* offset of its relative path in dir names */
+    guint32 parent;         /* index of the parent, or INDEX_NO_PARENT */
+    guint32 first_file;
+    guint32 n_files;
+} IndexDir;
+
+/* A complete index, never changed once made, shared with searches. */
+typedef struct {
+    GBytes *bytes;
+    const gchar *paths;
+    gsize paths_len;
+    const guint32 *offsets;
+    const guint64 *masks;
+    const guint64 *sizes;
+    const gint64 *mtimes;
+    guint n_paths;
+    const IndexDir *dirs;
+    guint n_dirs;
+    const gchar *dir_names;
+    guint64 ignore_digest;
+} IndexData;
+
+/* An index being built, section by section. */
+typedef struct {
+    GString *paths;
+    GArray *offsets;
+    GArray *masks;
+    GArray *sizes;
+    GArray *mtimes;
+    GArray *dirs;
+    GString *dir_names;
+} IndexBuilder;
+
+typedef struct {
+    FlowWorkspaceIndex *index;  /* only while the build is not cancelled */
+    GFile *root;
+    gchar **ignore_patterns;
+    IndexData *cached;
+    gchar *cache_path;
+} IndexBuild;
+
+/* A cache read on the build thread, on its way to the index. */
+typedef struct {
+    FlowWorkspaceIndex *index;
+    GCancellable *cancellable;
+    IndexData *data;
+} IndexCacheLoad;
+
+typedef struct {
+    gchar *relative;
+    guint32 parent;
+} PendingDir;
+
+/* The directories of a cached index, by path and as a tree. */
+typedef struct {
+    IndexData *data;
+    GHashTable *dirs;       /* relative path -> index + 1 */
+    guint32 *first_child;
+    guint32 *next_sibling;
+} CachedTree;
+
+/* A walk being put in order as the crawler's directories come in. */
+typedef struct {
+    IndexBuilder *builder;
+    CachedTree *tree;
+    FlowIgnore *ignore;
+    GHashTable *walked;     /* relative path -> FlowCrawlerDir, not yet added */
+    GArray *pending;        /* PendingDir, next to add at the end */
+} IndexWalk;
+
+typedef struct {
+    guint index;
+    guint length;
+    gint score;
+} SearchMatch;
+
+typedef struct {
+    IndexData *data;
+    const FlowFuzzyPattern *pattern;
+    GCancellable *cancellable;
+    guint start;
+    guint end;
+    guint limit;
+    GArray *matches;        /* SearchMatch */
+} SearchSlice;
+
+typedef struct {
+    IndexData *data;
+    FlowFuzzyPattern *pattern;
+    guint limit;
+} SearchData;
+
+struct _FlowWorkspaceIndex
+{
+    GObject parent_instance;
+
+    GFile *root;
+    gchar **ignore_patterns;
+    gchar *cache_path;
+    GCancellable *cancellable;
+    gboolean ready;
+    IndexData *data;
+
+    gchar *query;
+    GArray *matches;        /* guint32 indices of matching paths */
+};
+
+static void flow_workspace_index_list_model_init (GListModelInterface *iface);
+
+G_DEFINE_FINAL_TYPE_WITH_CODE (FlowWorkspaceIndex, flow_workspace_index, G_TYPE_OBJECT,
+                               G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, flow_workspace_index_list_model_init))
+
+enum {
+    PROP_0,
+    PROP_ROOT,
+    PROP_IGNORE_PATTERNS,
+    PROP_READY,
+    N_PROPS
+};
+
+static GParamSpec *properties[N_PROPS];
+
+static void
+index_data_clear (gpointer data)
+{
+    g_bytes_unref (((IndexData *) data)->bytes);
+}
+
+static IndexData *
+index_data_ref (IndexData *data)
+{
+    return g_atomic_rc_box_acquire (data);
+}
+
+static void
+index_data_unref (IndexData *data)
+{
+    g_atomic_rc_box_release_full (data, index_data_clear);
+}
+
+static gboolean
+section_fits (gsize size, guint64 offset, guint64 len, guint alignment)
+{
+    return offset % alignment == 0 && offset <= size && len <= size - offset;
+}
+
+/* Whether directory @index is named as one more step down from its
+ * parent, or is the root and has no name. */
+static gboolean
+index_dir_name_valid (IndexData *data, guint index)
+{
+    const IndexDir *dir = &data->dirs[index];
+    const gchar *name = data->dir_names + dir->name;
+    const gchar *component = name;
+    const gchar *parent;
+    gsize parent_len;
+
+    if (dir->parent == INDEX_NO_PARENT)
+        return *name == '\0';
+
+    parent = data->dir_names + data->dirs[dir->parent].name;
+    parent_len = strlen (parent);
+    if (parent_len > 0) {
+        if (strncmp (name, parent, parent_len) != 0 || name[parent_len] != G_DIR_SEPARATOR)
+            return FALSE;
+        component = name + parent_len + 1;
+    }
+
+    return *component != '\0' && strchr (component, G_DIR_SEPARATOR) == NULL &&
+           strcmp (component, ".") != 0 && strcmp (component, "..") != 0;
+}
+
+/* Reads the index in @bytes, or returns NULL if it is not a whole one. */
+static IndexData *
+index_data_new (GBytes *bytes)
+{
+    const guint8 *base;
+    const IndexHeader *header;
+    IndexData *data;
+    gsize size;
+    guint i;
+
+    base = g_bytes_get_data (bytes, &size);
+    header = (const IndexHeader *) base;
+
+    if (size < sizeof (IndexHeader) || memcmp (header->magic, INDEX_MAGIC, sizeof header->magic) != 0 ||
+        header->version != INDEX_VERSION || header->byte_order != INDEX_BYTE_ORDER)
+        return NULL;
+
+    if (!section_fits (size, header->paths_offset, header->paths_len, 1) ||
+        !section_fits (size, header->offsets_offset, ((guint64) header->n_paths + 1) * sizeof (guint32), 4) ||
+        !section_fits (size, header->masks_offset, (guint64) header->n_paths * sizeof (guint64), 8) ||
+        !section_fits (size, header->sizes_offset, (guint64) header->n_paths * sizeof (guint64), 8) ||
+        !section_fits (size, header->mtimes_offset, (guint64) header->n_paths * sizeof (gint64), 8) ||
+        !section_fits (size, header->dirs_offset, (guint64) header->n_dirs * sizeof (IndexDir), 8) ||
+        !section_fits (size, header->dir_names_offset, header->dir_names_len, 1))
+        return NULL;
+
+    data = g_atomic_rc_box_new0 (IndexData);
+    data->bytes = g_bytes_ref (bytes);
+    data->paths = (const gchar *) base + header->paths_offset;
+    data->paths_len = header->paths_len;
+    data->offsets = (const guint32 *) (gconstpointer) (base + header->offsets_offset);
+    data->masks = (const guint64 *) (gconstpointer) (base + header->masks_offset);
+    data->sizes = (const guint64 *) (gconstpointer) (base + header->sizes_offset);
+    data->mtimes = (const gint64 *) (gconstpointer) (base + header->mtimes_offset);
+    data->n_paths = header->n_paths;
+    data->dirs = (const IndexDir *) (gconstpointer) (base + header->dirs_offset);
+    data->n_dirs = header->n_dirs;
+    data->dir_names = (const gchar *) base + header->dir_names_offset;
+    data->ignore_digest = header->ignore_digest;
+
+    /* Every path and name must end inside its section, every parent come
+     * before its children, and every directory be named one step below
+     * its parent, or the walk could loop. */
+    if (data->offsets[0] != 0 || data->offsets[data->n_paths] != data->paths_len ||
+        data->n_dirs == 0 || data->dirs[0].parent != INDEX_NO_PARENT ||
+        header->dir_names_len == 0 || data->dir_names[header->dir_names_len - 1] != '\0')
+        goto invalid;
+
+    for (i = 0; i < data->n_paths; i++) {
+        if (data->offsets[i + 1] <= data->offsets[i] || data->paths[data->offsets[i + 1] - 1] != '\0')
+            goto invalid;
+    }
+
+    for (i = 0; i < data->n_dirs; i++) {
+        const IndexDir *dir = &data->dirs[i];
+
+        if (dir->name >= header->dir_names_len || (i > 0 && dir->parent >= i) ||
+            dir->first_file > data->n_paths || dir->n_files > data->n_paths - dir->first_file ||
+            !index_dir_name_valid (data, i))
+            goto invalid;
+    }
+
+    return data;
+
+invalid:
+    index_data_unref (data);
+    return NULL;
+}
+
+static guint32
+index_path_start (IndexData *data, guint index)
+{
+    return data->offsets[index];
+}
+
+/* Length of path @index, without its nul. */
+static guint32
+index_path_length (IndexData *data, guint index)
+{
+    return data->offsets[index + 1] - data->offsets[index] - 1;
+}
+
+static gchar *
+index_cache_path (GFile *root)
+{
+    gchar *uri = g_file_get_uri (root);
+    gchar *checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, uri, -1);
+    gchar *name = g_strconcat (checksum, ".index", NULL);
+    gchar *path = g_build_filename (g_get_user_cache_dir (), "flow", "workspaces", name, NULL);
+
+    g_free (name);
+    g_free (checksum);
+    g_free (uri);
+    return path;
+}
+
+static IndexBuilder *
+index_builder_new (void)
+{
+    IndexBuilder *builder = g_new0 (IndexBuilder, 1);
+
+    builder->paths = g_string_new (NULL);
+    builder->offsets = g_array_new (FALSE, FALSE, sizeof (guint32));
+    builder->masks = g_array_new (FALSE, FALSE, sizeof (guint64));
+    builder->sizes = g_array_new (FALSE, FALSE, sizeof (guint64));
+    builder->mtimes = g_array_new (FALSE, FALSE, sizeof (gint64));
+    builder->dirs = g_array_new (FALSE, FALSE, sizeof (IndexDir));
+    builder->dir_names = g_string_new (NULL);
+    return builder;
+}
+
+static void
+index_builder_free (IndexBuilder *builder)
+{
+    g_string_free (builder->paths, TRUE);
+    g_array_unref (builder->offsets);
+    g_array_unref (builder->masks);
+    g_array_unref (builder->sizes);
+    g_array_unref (builder->mtimes);
+    g_array_unref (builder->dirs);
+    g_string_free (builder->dir_names, TRUE);
+    g_free (builder);
+}
+
+static guint32
+index_builder_add_dir (IndexBuilder *builder, const gchar *relative, guint32 parent, gint64 mtime)
+{
+    IndexDir dir = { 0 };
+
+    dir.mtime = mtime;
+    dir.name = builder->dir_names->len;
+    dir.parent = parent;
+    dir.first_file = builder->masks->len;
+    g_string_append_len (builder->dir_names, relative, strlen (relative) + 1);
+    g_array_append_val (builder->dirs, dir);
+    return builder->dirs->len - 1;
+}
+
+/* Adds a file of the directory added last; FALSE once the index is full. */
+static gboolean
+index_builder_add_file (IndexBuilder *builder,
+                        const gchar  *relative_dir,
+                        const gchar  *name,
+                        guint64       mask,
+                        guint64       size,
+                        gint64        mtime)
+{
+    guint32 offset = builder->paths->len;
+    gsize dir_len = strlen (relative_dir);
+
+    if (builder->masks->len >= INDEX_MAX_FILES ||
+        builder->paths->len + dir_len + strlen (name) + 2 > INDEX_MAX_PATHS_SIZE)
+        return FALSE;
+
+    g_array_append_val (builder->offsets, offset);
+    if (dir_len > 0) {
+        g_string_append_len (builder->paths, relative_dir, dir_len);
+        g_string_append_c (builder->paths, G_DIR_SEPARATOR);
+    }
+    g_string_append (builder->paths, name);
+    if (mask == 0)
+        mask = flow_fuzzy_char_mask (builder->paths->str + offset, builder->paths->len - offset);
+    g_string_append_c (builder->paths, '\0');
+
+    g_array_append_val (builder->masks, mask);
+    g_array_append_val (builder->sizes, size);
+    g_array_append_val (builder->mtimes, mtime);
+    g_array_index (builder->dirs, IndexDir, builder->dirs->len - 1).n_files++;
+    return TRUE;
+}
+
+static guint64
+index_append_section (GByteArray *out, gconstpointer section, gsize len)
+{
+    static const guint8 padding[8];
+    guint64 offset;
+
+    g_byte_array_append (out, padding, (8 - out->len % 8) % 8);
+    offset = out->len;
+    g_byte_array_append (out, section, len);
+    return offset;
+}
+
+static GBytes *
+index_builder_finish (IndexBuilder *builder, guint64 ignore_digest)
+{
+    IndexHeader header = { { 0 } };
+    GByteArray *out;
+    guint32 end = builder->paths->len;
+
+    g_array_append_val (builder->offsets, end);
+
+    memcpy (header.magic, INDEX_MAGIC, sizeof header.magic);
+    header.version = INDEX_VERSION;
+    header.byte_order = INDEX_BYTE_ORDER;
+    header.n_paths = builder->masks->len;
+    header.n_dirs = builder->dirs->len;
+    header.ignore_digest = ignore_digest;
+
+    out = g_byte_array_sized_new (sizeof header + builder->paths->len + builder->dir_names->len +
+                                  builder->masks->len * 28 + builder->dirs->len * sizeof (IndexDir) + 64);
+    g_byte_array_set_size (out, sizeof header);
+    header.paths_offset = index_append_section (out, builder->paths->str, builder->paths->len);
+    header.paths_len = builder->paths->len;
+    header.offsets_offset = index_append_section (out, builder->offsets->data,
+                                                  builder->offsets->len * sizeof (guint32));
+    header.masks_offset = index_append_section (out, builder->masks->data, builder->masks->len * sizeof (guint64));
+    header.sizes_offset = index_append_section (out, builder->sizes->data, builder->sizes->len * sizeof (guint64));
+    header.mtimes_offset = index_append_section (out, builder->mtimes->data, builder->mtimes->len * sizeof (gint64));
+    header.dirs_offset = index_append_section (out, builder->dirs->data, builder->dirs->len * sizeof (IndexDir));
+    header.dir_names_offset = index_append_section (out, builder->dir_names->str, builder->dir_names->len);
+    header.dir_names_len = builder->dir_names->len;
+    memcpy (out->data, &header, sizeof header);
+
+    return g_byte_array_free_to_bytes (out);
+}
+
+static void
+index_build_free (IndexBuild *build)
+{
+    g_object_unref (build->root);
+    g_strfreev (build->ignore_patterns);
+    if (build->cached)
+        index_data_unref (build->cached);
+    g_free (build->cache_path);
+    g_free (build);
+}
+
+static void
+pending_push (GArray *pending, const gchar *relative, const gchar *name, guint32 parent)
+{
+    PendingDir dir;
+
+    dir.relative = *relative ? g_build_filename (relative, name, NULL) : g_strdup (name);
+    dir.parent = parent;
+    g_array_append_val (pending, dir);
+}
+
+static CachedTree *
+cached_tree_new (IndexData *data)
+{
+    CachedTree *tree = g_new0 (CachedTree, 1);
+    guint i;
+
+    tree->data = data;
+    tree->dirs = g_hash_table_new (g_str_hash, g_str_equal);
+    tree->first_child = g_new (guint32, data->n_dirs);
+    tree->next_sibling = g_new (guint32, data->n_dirs);
+    memset (tree->first_child, 0xff, data->n_dirs * sizeof (guint32));
+    for (i = data->n_dirs; i > 0; i--) {
+        const IndexDir *dir = &data->dirs[i - 1];
+
+        g_hash_table_insert (tree->dirs, (gpointer) (data->dir_names + dir->name), GUINT_TO_POINTER (i));
+        tree->next_sibling[i - 1] = INDEX_NO_PARENT;
+        if (dir->parent != INDEX_NO_PARENT) {
+            tree->next_sibling[i - 1] = tree->first_child[dir->parent];
+            tree->first_child[dir->parent] = i - 1;
+        }
+    }
+
+    return tree;
+}
+
+static void
+cached_tree_free (CachedTree *tree)
+{
+    if (!tree)
+        return;
+
+    g_hash_table_unref (tree->dirs);
+    g_free (tree->first_child);
+    g_free (tree->next_sibling);
+    g_free (tree);
+}
+
+/* The cached directory @relative, if its modification time is @mtime. */
+static const IndexDir *
+cached_tree_lookup (CachedTree *tree, const gchar *relative, gint64 mtime)
+{
+    guint index = GPOINTER_TO_UINT (g_hash_table_lookup (tree->dirs, relative));
+
+    if (index == 0 || mtime == 0 || tree->data->dirs[index - 1].mtime != mtime)
+        return NULL;
+    return &tree->data->dirs[index - 1];
+}
+
+/* Lets the crawler skip directories the cache has as they are. */
+static GPtrArray *
+cached_tree_reuse (const gchar *relative, gint64 mtime, gpointer user_data)
+{
+    CachedTree *tree = user_data;
+    const IndexDir *dir = cached_tree_lookup (tree, relative, mtime);
+    GPtrArray *subdirs;
+    guint32 child;
+
+    if (!dir)
+        return NULL;
+
+    subdirs = g_ptr_array_new_with_free_func (g_free);
+    for (child = tree->first_child[dir - tree->data->dirs]; child != INDEX_NO_PARENT;
+         child = tree->next_sibling[child]) {
+        const gchar *name = tree->data->dir_names + tree->data->dirs[child].name;
+        const gchar *slash = strrchr (name, G_DIR_SEPARATOR);
+
+        g_ptr_array_add (subdirs, g_strdup (slash ? slash + 1 : name));
+    }
+    return subdirs;
+}
+
+/* Adds @dir, at the top of @walk's pending stack, and queues its
+ * subdirectories in its place. */
+static void
+index_walk_add (IndexWalk *walk, FlowCrawlerDir *dir)
+{
+    PendingDir current = g_array_index (walk->pending, PendingDir, walk->pending->len - 1);
+    guint32 index;
+    guint i;
+
+    g_array_set_size (walk->pending, walk->pending->len - 1);
+    index = index_builder_add_dir (walk->builder, current.relative, current.parent, dir->mtime);
+
+    if (dir->read) {
+        for (i = 0; i < dir->files->len; i++) {
+            const FlowCrawlerFile *file = &g_array_index (dir->files, FlowCrawlerFile, i);
+
+            if (!index_builder_add_file (walk->builder, current.relative, file->name, 0, file->size, file->mtime))
+                break;
+        }
+    } else {
+        IndexData *cached = walk->tree->data;
+        const IndexDir *old = cached_tree_lookup (walk->tree, current.relative, dir->mtime);
+
+        /* Files ignored only now mean the rules changed, and the
+         * caller will walk again without the cache. */
+        for (i = old->first_file; i < old->first_file + old->n_files; i++) {
+            const gchar *path = cached->paths + index_path_start (cached, i);
+            const gchar *slash = strrchr (path, G_DIR_SEPARATOR);
+
+            if (flow_ignore_is_ignored (walk->ignore, path, FALSE))
+                continue;
+            if (!index_builder_add_file (walk->builder, current.relative, slash ? slash + 1 : path,
+                                         cached->masks[i], cached->sizes[i], cached->mtimes[i]))
+                break;
+        }
+    }
+
+    /* Pushed in reverse so the first directory is added next. */
+    for (i = dir->subdirs->len; i > 0; i--)
+        pending_push (walk->pending, current.relative, dir->subdirs->pdata[i - 1], index);
+
+    g_free (current.relative);
+}
+
+/*
+ * Adds every directory that is next in depth-first order and has been
+ * walked, and lets it go.  Once the crawl is @over, one that never came
+ * was the close of a link cycle and is passed over.
+ */
+static void
+index_walk_drain (IndexWalk *walk, gboolean over)
+{
+    while (walk->pending->len > 0) {
+        PendingDir *top = &g_array_index (walk->pending, PendingDir, walk->pending->len - 1);
+        FlowCrawlerDir *dir = g_hash_table_lookup (walk->walked, top->relative);
+
+        if (dir) {
+            index_walk_add (walk, dir);
+            g_hash_table_remove (walk->walked, dir->relative);
+        } else if (over) {
+            g_free (top->relative);
+            g_array_set_size (walk->pending, walk->pending->len - 1);
+        } else {
+            break;
+        }
+    }
+}
+
+/*
+ * Walks @root with a FlowCrawler, pruning what @ignore leaves out.
+ * Directories @cached has with the same modification time are copied
+ * from it rather than read; @changed is set if any was not.  The
+ * crawler returns directories in whatever order its threads finish
+ * them, so they are put together here depth first, each in name order
+ * with its files first, as one thread walking would have.  Each is
+ * added as soon as those before it are, so only the ones that came
+ * early are held; the crawler works deep first, and that stays a few.
+ */
+static IndexBuilder *
+index_walk (GFile        *root,
+            IndexData    *cached,
+            FlowIgnore   *ignore,
+            GCancellable *cancellable,
+            gboolean     *changed)
+{
+    IndexWalk walk;
+    FlowCrawler *crawler = flow_crawler_new (root, ignore);
+    FlowCrawlerDir *dir;
+    PendingDir top;
+    guint i;
+
+    walk.builder = index_builder_new ();
+    walk.tree = cached ? cached_tree_new (cached) : NULL;
+    walk.ignore = ignore;
+    walk.walked = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) flow_crawler_dir_free);
+    walk.pending = g_array_new (FALSE, FALSE, sizeof (PendingDir));
+
+    top.relative = g_strdup ("");
+    top.parent = INDEX_NO_PARENT;
+    g_array_append_val (walk.pending, top);
+
+    *changed = cached == NULL;
+
+    if (walk.tree)
+        flow_crawler_set_reuse_func (crawler, cached_tree_reuse, walk.tree);
+    flow_crawler_start (crawler, cancellable);
+    while ((dir = flow_crawler_next (crawler))) {
+        if (dir->read)
+            *changed = TRUE;
+        g_hash_table_insert (walk.walked, dir->relative, dir);
+        if (!g_cancellable_is_cancelled (cancellable))
+            index_walk_drain (&walk, FALSE);
+    }
+    flow_crawler_free (crawler);
+
+    if (!g_cancellable_is_cancelled (cancellable))
+        index_walk_drain (&walk, TRUE);
+
+    for (i = 0; i < walk.pending->len; i++)
+        g_free (g_array_index (walk.pending, PendingDir, i).relative);
+    g_array_unref (walk.pending);
+    g_hash_table_unref (walk.walked);
+    cached_tree_free (walk.tree);
+    return walk.builder;
+}
+
+/* First occurrence of @needle in @haystack, whose length is @len. */
+static const gchar *
+find_bytes (const gchar *haystack, gsize len, const gchar *needle, gsize needle_len)
+{
+    while (len >= needle_len) {
+        const gchar *p = memchr (haystack, needle[0], len - needle_len + 1);
+
+        if (!p)
+            return NULL;
+        if (memcmp (p, needle, needle_len) == 0)
+            return p;
+
+        len -= p + 1 - haystack;
+        haystack = p + 1;
+    }
+
+    return NULL;
+}
+
+/* Index of the path containing byte @offset of the block. */
+static guint
+index_path_at (IndexData *data, guint32 offset)
+{
+    guint low = 0;
+    guint high = data->n_paths;
+
+    while (high - low > 1) {
+        guint mid = low + (high - low) / 2;
+
+        if (index_path_start (data, mid) <= offset)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+static GArray *
+index_match_all (IndexData *data, const gchar *query, gsize query_len)
+{
+    GArray *matches = g_array_new (FALSE, FALSE, sizeof (guint32));
+    const gchar *pos = data->paths;
+    const gchar *end = data->paths + data->paths_len;
+    const gchar *hit;
+
+    while ((hit = find_bytes (pos, end - pos, query, query_len))) {
+        guint32 index = index_path_at (data, hit - data->paths);
+
+        g_array_append_val (matches, index);
+        pos = data->paths + index_path_start (data, index + 1);
+    }
+
+    return matches;
+}
+
+static GArray *
+index_match_within (IndexData *data, GArray *candidates, const gchar *query, gsize query_len)
+{
+    GArray *matches = g_array_new (FALSE, FALSE, sizeof (guint32));
+    guint i;
+
+    for (i = 0; i < candidates->len; i++) {
+        guint32 index = g_array_index (candidates, guint32, i);
+
+        if (find_bytes (data->paths + index_path_start (data, index), index_path_length (data, index),
+                        query, query_len))
+            g_array_append_val (matches, index);
+    }
+
+    return matches;
+}
+
+static void
+index_update_matches (FlowWorkspaceIndex *self, gboolean narrowing)
+{
+    guint old_len = self->matches ? self->matches->len : 0;
+    GArray *matches = NULL;
+
+    if (self->data && self->query && *self->query) {
+        gsize query_len = strlen (self->query);
+
+        if (narrowing && self->matches)
+            matches = index_match_within (self->data, self->matches, self->query, query_len);
+        else
+            matches = index_match_all (self->data, self->query, query_len);
+    }
+
+    g_clear_pointer (&self->matches, g_array_unref);
+    self->matches = matches;
+
+    if (old_len > 0 || (matches && matches->len > 0))
+        g_list_model_items_changed (G_LIST_MODEL (self), 0, old_len, matches ? matches->len : 0);
+}
+
+static void
+index_set_data (FlowWorkspaceIndex *self, IndexData *data)
+{
+    gboolean was_ready = self->ready;
+
+    if (self->data)
+        index_data_unref (self->data);
+    self->data = data;
+    self->ready = TRUE;
+
+    /* Indices into the old paths mean nothing in the new ones. */
+    index_update_matches (self, FALSE);
+    if (!was_ready)
+        g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_READY]);
+}
+
+static void
+on_index_built (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    FlowWorkspaceIndex *self;
+    GError *error = NULL;
+    IndexData *data;
+
+    /* A cancelled build means the index is already gone. */
+    data = g_task_propagate_pointer (G_TASK (res), &error);
+    if (error) {
+        g_error_free (error);
+        return;
+    }
+
+    self = FLOW_WORKSPACE_INDEX (user_data);
+    if (data)
+        index_set_data (self, data);
+    else if (!self->ready) {
+        /* Only a cache can be unchanged, and a cache makes it ready. */
+        self->ready = TRUE;
+        g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_READY]);
+    }
+}
+
+/* The cached index of the folder, if there is a sound one. */
+static IndexData *
+index_load_cache (const gchar *cache_path)
+{
+    GMappedFile *mapping;
+    IndexData *data;
+    GBytes *bytes;
+
+    mapping = g_mapped_file_new (cache_path, FALSE, NULL);
+    if (!mapping)
+        return NULL;
+
+    bytes = g_mapped_file_get_bytes (mapping);
+    g_mapped_file_unref (mapping);
+    data = index_data_new (bytes);
+    g_bytes_unref (bytes);
+
+    if (!data)
+        g_unlink (cache_path);
+    return data;
+}
+
+static void
+index_cache_load_free (IndexCacheLoad *load)
+{
+    g_object_unref (load->cancellable);
+    index_data_unref (load->data);
+    g_free (load);
+}
+
+/* Hands a cache the build thread found sound to the index. */
+static gboolean
+on_index_cache_loaded (gpointer user_data)
+{
+    IndexCacheLoad *load = user_data;
+
+    /* Dropping the index cancels its build first. */
+    if (!g_cancellable_is_cancelled (load->cancellable) && !load->index->data)
+        index_set_data (load->index, index_data_ref (load->data));
+    return G_SOURCE_REMOVE;
+}
+
+/* Brings the cached index up to date; returns NULL when nothing differs. */
+static void
+index_build_worker (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    IndexBuild *build = task_data;
+    FlowIgnore *ignore = flow_ignore_new (build->root, (const gchar * const *) build->ignore_patterns);
+    IndexBuilder *builder;
+    gboolean changed;
+    GError *error = NULL;
+    IndexData *data;
+    GBytes *bytes;
+
+    /* Checking a cache reads all of it, so it is done here and the
+     * index gets it once it is known to be sound. */
+    build->cached = index_load_cache (build->cache_path);
+    if (build->cached) {
+        IndexCacheLoad *load = g_new0 (IndexCacheLoad, 1);
+
+        load->index = build->index;
+        load->cancellable = g_object_ref (cancellable);
+        load->data = index_data_ref (build->cached);
+        g_main_context_invoke_full (g_task_get_context (task), G_PRIORITY_DEFAULT,
+                                    on_index_cache_loaded, load, (GDestroyNotify) index_cache_load_free);
+    }
+
+    builder = index_walk (build->root, build->cached, ignore, cancellable, &changed);
+
+    /* The cache was filtered by other rules and may lack what they hid. */
+    if (build->cached && flow_ignore_get_digest (ignore) != build->cached->ignore_digest &&
+        !g_cancellable_is_cancelled (cancellable)) {
+        index_builder_free (builder);
+        flow_ignore_unref (ignore);
+        ignore = flow_ignore_new (build->root, (const gchar * const *) build->ignore_patterns);
+        builder = index_walk (build->root, NULL, ignore, cancellable, &changed);
+    }
+
+    if (g_cancellable_set_error_if_cancelled (cancellable, &error)) {
+        index_builder_free (builder);
+        flow_ignore_unref (ignore);
+        g_task_return_error (task, error);
+        return;
+    }
+
+    if (!changed) {
+        index_builder_free (builder);
+        flow_ignore_unref (ignore);
+        g_task_return_pointer (task, NULL, NULL);
+        return;
+    }
+
+    bytes = index_builder_finish (builder, flow_ignore_get_digest (ignore));
+    index_builder_free (builder);
+    flow_ignore_unref (ignore);
+    data = index_data_new (bytes);
+
+    if (data) {
+        gchar *directory = g_path_get_dirname (build->cache_path);
+        gsize size;
+        gconstpointer contents = g_bytes_get_data (bytes, &size);
+
+        /* The cache only saves time; failing to write it is not an error. */
+        if (g_mkdir_with_parents (directory, 0700) == 0)
+            g_file_set_contents_full (build->cache_path, contents, (gssize) size,
+                                      G_FILE_SET_CONTENTS_CONSISTENT, 0600, NULL);
+        g_free (directory);
+    }
+    g_bytes_unref (bytes);
+
+    g_task_return_pointer (task, data, data ? (GDestroyNotify) index_data_unref : NULL);
+}
+
+/* Indexes @root, leaving out what @ignore_patterns and its ignore files do. */
+FlowWorkspaceIndex *
+flow_workspace_index_new (GFile *root, const gchar * const *ignore_patterns)
+{
+    g_return_val_if_fail (G_IS_FILE (root), NULL);
+
+    return g_object_new (FLOW_TYPE_WORKSPACE_INDEX,
+                         "root", root,
+                         "ignore-patterns", ignore_patterns,
+                         NULL);
+}
+
+GFile *
+flow_workspace_index_get_root (FlowWorkspaceIndex *self)
+{
+    g_return_val_if_fail (FLOW_IS_WORKSPACE_INDEX (self), NULL);
+
+    return self->root;
+}
+
+gboolean
+flow_workspace_index_is_ready (FlowWorkspaceIndex *self)
+{
+    g_return_val_if_fail (FLOW_IS_WORKSPACE_INDEX (self), FALSE);
+
+    return self->ready;
+}
+
+/* Number of files indexed; zero until the index is ready. */
+guint
+flow_workspace_index_get_n_paths (FlowWorkspaceIndex *self)
+{
+    g_return_val_if_fail (FLOW_IS_WORKSPACE_INDEX (self), 0);
+
+    return self->data ? self->data->n_paths : 0;
+}
+
+/* Path of file @index relative to the root, owned by the index. */
+const gchar *
+flow_workspace_index_get_path (FlowWorkspaceIndex *self, guint index)
+{
+    g_return_val_if_fail (FLOW_IS_WORKSPACE_INDEX (self), NULL);
+    g_return_val_if_fail (index < flow_workspace_index_get_n_paths (self), NULL);
+
+    return self->data->paths + index_path_start (self->data, index);
+}
+
+/*
+ * Makes the model the paths containing @query, case-sensitively.  Set
+ * before the index is ready, the query applies once it is.
+ */
+void
+flow_workspace_index_set_query (FlowWorkspaceIndex *self, const gchar *query)
+{
+    gboolean narrowing;
+
+    g_return_if_fail (FLOW_IS_WORKSPACE_INDEX (self));
+
+    if (g_strcmp0 (self->query, query) == 0)
+        return;
+
+    narrowing = self->query && *self->query && query && strstr (query, self->query);
+    g_free (self->query);
+    self->query = g_strdup (query);
+    index_update_matches (self, narrowing);
+}
+
+/* Best first; equal scores prefer the shorter path, then index order. */
+static gint
+compare_matches (gconstpointer a, gconstpointer b)
+{
+    const SearchMatch *match_a = a;
+    const SearchMatch *match_b = b;
+
+    if (match_a->score != match_b->score)
+        return match_a->score > match_b->score ? -1 : 1;
+    if (match_a->length != match_b->length)
+        return match_a->length < match_b->length ? -1 : 1;
+    return match_a->index < match_b->index ? -1 : match_a->index > match_b->index;
+}
+
+static void
+matches_truncate (GArray *matches, guint limit)
+{
+    g_array_sort (matches, compare_matches);
+    if (matches->len > limit)
+        g_array_set_size (matches, limit);
+}
+
+static gpointer
+search_slice_run (gpointer user_data)
+{
+    SearchSlice *slice = user_data;
+    IndexData *data = slice->data;
+    guint64 need = flow_fuzzy_pattern_get_mask (slice->pattern);
+    guint8 passed[SEARCH_BLOCK_SIZE];
+    guint block;
+
+    for (block = slice->start; block < slice->end; block += SEARCH_BLOCK_SIZE) {
+        guint n = MIN (SEARCH_BLOCK_SIZE, slice->end - block);
+        const guint64 *masks = data->masks + block;
+        guint i;
+
+        if (g_cancellable_is_cancelled (slice->cancellable))
+            break;
+
+        for (i = 0; i < n; i++)
+            passed[i] = (masks[i] & need) == need;
+
+        for (i = 0; i < n; i++) {
+            SearchMatch match;
+
+            if (!passed[i])
+                continue;
+
+            match.index = block + i;
+            match.length = index_path_length (data, match.index);
+            if (flow_fuzzy_match (slice->pattern, data->paths + index_path_start (data, match.index),
+                                  match.length, &match.score))
+                g_array_append_val (slice->matches, match);
+        }
+
+        if (slice->matches->len > 4 * slice->limit)
+            matches_truncate (slice->matches, slice->limit);
+    }
+
+    matches_truncate (slice->matches, slice->limit);
+    return NULL;
+}
+
+static void
+search_data_free (SearchData *search)
+{
+    if (search->data)
+        index_data_unref (search->data);
+    flow_fuzzy_pattern_free (search->pattern);
+    g_free (search);
+}
+
+static void
+search_worker (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    SearchData *search = task_data;
+    IndexData *data = search->data;
+    guint n_slices = CLAMP (data->n_paths / SEARCH_MIN_SLICE, 1, g_get_num_processors ());
+    SearchSlice *slices = g_new0 (SearchSlice, n_slices);
+    GThread **threads = g_new0 (GThread *, n_slices);
+    GArray *matches = g_array_new (FALSE, FALSE, sizeof (SearchMatch));
+    GPtrArray *paths;
+    GError *error = NULL;
+    guint i;
+
+    for (i = 0; i < n_slices; i++) {
+        slices[i].data = data;
+        slices[i].pattern = search->pattern;
+        slices[i].cancellable = cancellable;
+        slices[i].start = (guint64) data->n_paths * i / n_slices;
+        slices[i].end = (guint64) data->n_paths * (i + 1) / n_slices;
+        slices[i].limit = search->limit;
+        slices[i].matches = g_array_new (FALSE, FALSE, sizeof (SearchMatch));
+    }
+
+    /* This thread takes the first slice itself. */
+    for (i = 1; i < n_slices; i++)
+        threads[i] = g_thread_try_new ("flow-search", search_slice_run, &slices[i], NULL);
+    search_slice_run (&slices[0]);
+
+    for (i = 0; i < n_slices; i++) {
+        if (i > 0 && threads[i])
+            g_thread_join (threads[i]);
+        else if (i > 0)
+            search_slice_run (&slices[i]);
+        g_array_append_vals (matches, slices[i].matches->data, slices[i].matches->len);
+        g_array_unref (slices[i].matches);
+    }
+    g_free (threads);
+    g_free (slices);
+
+    matches_truncate (matches, search->limit);
+
+    if (g_cancellable_set_error_if_cancelled (cancellable, &error)) {
+        g_array_unref (matches);
+        g_task_return_error (task, error);
+        return;
+    }
+
+    /* Paths, not indices: the index may be replaced before they are read. */
+    paths = g_ptr_array_new_full (matches->len, g_free);
+    for (i = 0; i < matches->len; i++) {
+        guint index = g_array_index (matches, SearchMatch, i).index;
+
+        g_ptr_array_add (paths, g_strdup (data->paths + index_path_start (data, index)));
+    }
+    g_array_unref (matches);
+
+    g_task_return_pointer (task, paths, (GDestroyNotify) g_ptr_array_unref);
+}
+
+/*
+ * Finds the @limit paths that best match @query fuzzily, on worker
+ * threads.  Before the index is ready nothing matches.
+ */
+void
+flow_workspace_index_search_async (FlowWorkspaceIndex  *self,
+                                   const gchar         *query,
+                                   guint                limit,
+                                   GCancellable        *cancellable,
+                                   GAsyncReadyCallback  callback,
+                                   gpointer             user_data)
+{
+    SearchData *search;
+    GTask *task;
+
+    g_return_if_fail (FLOW_IS_WORKSPACE_INDEX (self));
+
+    search = g_new0 (SearchData, 1);
+    search->data = self->data ? index_data_ref (self->data) : NULL;
+    search->pattern = flow_fuzzy_pattern_new (query);
+    search->limit = MAX (limit, 1);
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_task_data (task, search, (GDestroyNotify) search_data_free);
+
+    if (!search->data || flow_fuzzy_pattern_is_empty (search->pattern))
+        g_task_return_pointer (task, g_ptr_array_new_with_free_func (g_free), (GDestroyNotify) g_ptr_array_unref);
+    else
+        g_task_run_in_thread (task, search_worker);
+
+    g_object_unref (task);
+}
+
+/* The relative paths found, best first. */
+GPtrArray *
+flow_workspace_index_search_finish (FlowWorkspaceIndex  *self,
+                                    GAsyncResult        *result,
+                                    GError             **error)
+{
+    g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+
+    return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static GType
+flow_workspace_index_get_item_type (GListModel *model)
+{
+    return FLOW_TYPE_FILE_ITEM;
+}
+
+static guint
+flow_workspace_index_get_n_items (GListModel *model)
+{
+    FlowWorkspaceIndex *self = FLOW_WORKSPACE_INDEX (model);
+
+    return self->matches ? self->matches->len : 0;
+}
+
+static gpointer
+flow_workspace_index_get_item (GListModel *model, guint position)
+{
+    FlowWorkspaceIndex *self = FLOW_WORKSPACE_INDEX (model);
+    const gchar *path;
+    FlowFileItem *item;
+    GFile *file;
+
+    if (!self->matches || position >= self->matches->len)
+        return NULL;
+
+    path = flow_workspace_index_get_path (self, g_array_index (self->matches, guint32, position));
+    file = g_file_resolve_relative_path (self->root, path);
+    item = flow_file_item_new (file, path, FALSE);
+    g_object_unref (file);
+    return item;
+}
+
+static void
+flow_workspace_index_list_model_init (GListModelInterface *iface)
+{
+    iface->get_item_type = flow_workspace_index_get_item_type;
+    iface->get_n_items = flow_workspace_index_get_n_items;
+    iface->get_item = flow_workspace_index_get_item;
+}
+
+static void
+flow_workspace_index_constructed (GObject *object)
+{
+    FlowWorkspaceIndex *self = FLOW_WORKSPACE_INDEX (object);
+    IndexBuild *build;
+    GTask *task;
+
+    G_OBJECT_CLASS (flow_workspace_index_parent_class)->constructed (object);
+
+    self->cache_path = index_cache_path (self->root);
+
+    build = g_new0 (IndexBuild, 1);
+    build->index = self;
+    build->root = g_object_ref (self->root);
+    build->ignore_patterns = g_strdupv (self->ignore_patterns);
+    build->cache_path = g_strdup (self->cache_path);
+
+    /* No source object, so dropping the index cancels the build. */
+    task = g_task_new (NULL, self->cancellable, on_index_built, self);
+    g_task_set_task_data (task, build, (GDestroyNotify) index_build_free);
+    g_task_set_priority (task, G_PRIORITY_LOW);
+    g_task_run_in_thread (task, index_build_worker);
+    g_object_unref (task);
+}
+
+static void
+flow_workspace_index_finalize (GObject *object)
+{
+    FlowWorkspaceIndex *self = FLOW_WORKSPACE_INDEX (object);
+
+    g_cancellable_cancel (self->cancellable);
+    g_clear_object (&self->cancellable);
+    g_clear_object (&self->root);
+    g_strfreev (self->ignore_patterns);
+    g_free (self->cache_path);
+    if (self->data)
+        index_data_unref (self->data);
+    g_free (self->query);
+    g_clear_pointer (&self->matches, g_array_unref);
+
+    G_OBJECT_CLASS (flow_workspace_index_parent_class)->finalize (object);
+}
+
+static void
+flow_workspace_index_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+    FlowWorkspaceIndex *self = FLOW_WORKSPACE_INDEX (object);
+
+    switch (prop_id) {
+        case PROP_ROOT:
+            g_value_set_object (value, self->root);
+            break;
+        case PROP_IGNORE_PATTERNS:
+            g_value_set_boxed (value, self->ignore_patterns);
+            break;
+        case PROP_READY:
+            g_value_set_boolean (value, self->ready);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+flow_workspace_index_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+    FlowWorkspaceIndex *self = FLOW_WORKSPACE_INDEX (object);
+
+    switch (prop_id) {
+        case PROP_ROOT:
+            self->root = g_value_dup_object (value);
+            break;
+        case PROP_IGNORE_PATTERNS:
+            self->ignore_patterns = g_value_dup_boxed (value);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+flow_workspace_index_class_init (FlowWorkspaceIndexClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->constructed = flow_workspace_index_constructed;
+    object_class->finalize = flow_workspace_index_finalize;
+    object_class->get_property = flow_workspace_index_get_property;
+    object_class->set_property = flow_workspace_index_set_property;
+
+    properties[PROP_ROOT] =
+        g_param_spec_object ("root", NULL, NULL, G_TYPE_FILE,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+    properties[PROP_IGNORE_PATTERNS] =
+        g_param_spec_boxed ("ignore-patterns", NULL, NULL, G_TYPE_STRV,
+                            G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+    properties[PROP_READY] =
+        g_param_spec_boolean ("ready", NULL, NULL, FALSE,
+                              G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+    g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+flow_workspace_index_init (FlowWorkspaceIndex *self)
+{
+    self->cancellable = g_cancellable_new ();
+}
@@ -0,0 +1,62 @@
+/* flow-workspace-index.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Every file under a folder, read on a worker thread and kept as
+ * relative paths in one block of memory.  The block is cached on disk
+ * and mapped back the next time the folder is opened, then brought up to
+ * date in the background.  What the global ignore patterns or the
+ * folder's ignore files exclude is left out, and ignored directories
+ * are never read.  The index is also the list model of the paths
+ * matching its query; items are FlowFileItems made only when a row asks
+ * for them.  An empty query matches nothing.
+ * Fuzzy searches for quick-open run separately and leave the model be.
+ */
+#define FLOW_TYPE_WORKSPACE_INDEX (flow_workspace_index_get_type())
+
+G_DECLARE_FINAL_TYPE (FlowWorkspaceIndex, flow_workspace_index, FLOW, WORKSPACE_INDEX, GObject)
+
+FlowWorkspaceIndex *flow_workspace_index_new           (GFile               *root,
+                                                        const gchar * const *ignore_patterns);
+GFile              *flow_workspace_index_get_root      (FlowWorkspaceIndex  *self);
+gboolean            flow_workspace_index_is_ready      (FlowWorkspaceIndex  *self);
+guint               flow_workspace_index_get_n_paths   (FlowWorkspaceIndex  *self);
+const gchar        *flow_workspace_index_get_path      (FlowWorkspaceIndex  *self,
+                                                        guint                index);
+void                flow_workspace_index_set_query     (FlowWorkspaceIndex  *self,
+                                                        const gchar         *query);
+
+void                flow_workspace_index_search_async  (FlowWorkspaceIndex  *self,
+                                                        const gchar         *query,
+                                                        guint                limit,
+                                                        GCancellable        *cancellable,
+                                                        GAsyncReadyCallback  callback,
+                                                        gpointer             user_data);
+GPtrArray          *flow_workspace_index_search_finish (FlowWorkspaceIndex  *self,
+                                                        GAsyncResult        *result,
+                                                        GError             **error);
+
+G_END_DECLS
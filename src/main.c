@@ -35,7 +35,7 @@ main (int   argc,
 	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
 	textdomain (GETTEXT_PACKAGE);
 
-	app = flow_application_new ("ink.coda.Flow", G_APPLICATION_DEFAULT_FLAGS);
+	app = flow_application_new ("ink.coda.Flow", G_APPLICATION_HANDLES_OPEN);
 	ret = g_application_run (G_APPLICATION (app), argc, argv);
 
 	return ret;
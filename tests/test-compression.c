@@ -0,0 +1,140 @@
+/* test-compression.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include "test-util.h"
+
+/* Reads @bytes back through a converter input stream, as the loader does. */
+static GBytes *
+decompress (FlowCompression compression, GBytes *bytes, GError **error)
+{
+    GInputStream *memory = g_memory_input_stream_new_from_bytes (bytes);
+    GOutputStream *sink = g_memory_output_stream_new_resizable ();
+    GConverter *converter;
+    GInputStream *stream;
+    GBytes *result = NULL;
+
+    converter = flow_compression_new_decompressor (compression, error);
+    g_assert_nonnull (converter);
+    stream = g_converter_input_stream_new (memory, converter);
+    if (g_output_stream_splice (sink, stream, G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                                NULL, error) >= 0)
+        result = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (sink));
+
+    g_object_unref (stream);
+    g_object_unref (converter);
+    g_object_unref (sink);
+    g_object_unref (memory);
+
+    return result;
+}
+
+static void
+test_round_trip (gconstpointer user_data)
+{
+    FlowCompression compression = GPOINTER_TO_INT (user_data);
+    GBytes *text;
+    GBytes *compressed;
+    GBytes *result;
+    GError *error = NULL;
+
+    text = test_util_make_text ();
+    compressed = test_util_compress (compression, text);
+    if (!compressed) {
+        g_bytes_unref (text);
+        return;
+    }
+    g_assert_cmpint (flow_compression_detect (g_bytes_get_data (compressed, NULL), g_bytes_get_size (compressed)),
+                     ==, compression);
+
+    result = decompress (compression, compressed, &error);
+    g_assert_no_error (error);
+    g_assert_true (g_bytes_equal (result, text));
+
+    g_bytes_unref (result);
+    g_bytes_unref (compressed);
+    g_bytes_unref (text);
+}
+
+static void
+test_empty (gconstpointer user_data)
+{
+    FlowCompression compression = GPOINTER_TO_INT (user_data);
+    GBytes *empty;
+    GBytes *compressed;
+    GBytes *result;
+    GError *error = NULL;
+
+    empty = g_bytes_new_static ("", 0);
+    compressed = test_util_compress (compression, empty);
+    if (!compressed) {
+        g_bytes_unref (empty);
+        return;
+    }
+    result = decompress (compression, compressed, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (g_bytes_get_size (result), ==, 0);
+
+    g_bytes_unref (result);
+    g_bytes_unref (compressed);
+    g_bytes_unref (empty);
+}
+
+/* A stream cut short must fail rather than pass for a shorter text. */
+static void
+test_truncated (gconstpointer user_data)
+{
+    FlowCompression compression = GPOINTER_TO_INT (user_data);
+    GBytes *text;
+    GBytes *compressed;
+    GBytes *truncated;
+    GBytes *result;
+    GError *error = NULL;
+
+    text = test_util_make_text ();
+    compressed = test_util_compress (compression, text);
+    if (!compressed) {
+        g_bytes_unref (text);
+        return;
+    }
+    truncated = g_bytes_new_from_bytes (compressed, 0, g_bytes_get_size (compressed) / 2);
+
+    result = decompress (compression, truncated, &error);
+    g_assert_null (result);
+    g_assert_nonnull (error);
+    g_error_free (error);
+
+    g_bytes_unref (truncated);
+    g_bytes_unref (compressed);
+    g_bytes_unref (text);
+}
+
+int
+main (int argc, char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    test_util_add_compression_func ("/compression", "/round-trip", test_round_trip);
+    test_util_add_compression_func ("/compression", "/empty", test_empty);
+    test_util_add_compression_func ("/compression", "/truncated", test_truncated);
+
+    return g_test_run ();
+}
@@ -0,0 +1,223 @@
+/* test-diff.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "flow-diff.h"
+
+static GArray *
+diff (const gchar *old_text, const gchar *new_text)
+{
+    GArray *hunks = flow_diff_lines (old_text, strlen (old_text), new_text, strlen (new_text), NULL);
+
+    g_assert_nonnull (hunks);
+    return hunks;
+}
+
+/* Applies @hunks to @old_text the way reloading a tab does, last first so
+ * earlier offsets stay valid, and checks that gives @new_text. */
+static void
+assert_applies (const gchar *old_text, const gchar *new_text, GArray *hunks)
+{
+    GString *text = g_string_new (old_text);
+    guint i;
+
+    for (i = 0; i < hunks->len; i++) {
+        const FlowDiffHunk *hunk = &g_array_index (hunks, FlowDiffHunk, i);
+
+        g_assert_cmpuint (hunk->old_start, <=, hunk->old_end);
+        g_assert_cmpuint (hunk->new_start, <=, hunk->new_end);
+        g_assert_true (hunk->old_start < hunk->old_end || hunk->new_start < hunk->new_end);
+        if (i > 0)
+            g_assert_cmpuint (hunk->old_start, >, g_array_index (hunks, FlowDiffHunk, i - 1).old_end);
+    }
+
+    for (i = hunks->len; i-- > 0;) {
+        const FlowDiffHunk *hunk = &g_array_index (hunks, FlowDiffHunk, i);
+
+        g_string_erase (text, (gssize) hunk->old_start, (gssize) (hunk->old_end - hunk->old_start));
+        g_string_insert_len (text, (gssize) hunk->old_start, new_text + hunk->new_start,
+                             (gssize) (hunk->new_end - hunk->new_start));
+    }
+    g_assert_cmpstr (text->str, ==, new_text);
+
+    g_string_free (text, TRUE);
+}
+
+static void
+assert_hunk (GArray *hunks, guint index, gsize old_start, gsize old_end, gsize new_start, gsize new_end)
+{
+    const FlowDiffHunk *hunk;
+
+    g_assert_cmpuint (index, <, hunks->len);
+    hunk = &g_array_index (hunks, FlowDiffHunk, index);
+    g_assert_cmpuint (hunk->old_start, ==, old_start);
+    g_assert_cmpuint (hunk->old_end, ==, old_end);
+    g_assert_cmpuint (hunk->new_start, ==, new_start);
+    g_assert_cmpuint (hunk->new_end, ==, new_end);
+}
+
+static void
+test_identical (void)
+{
+    GArray *hunks = diff ("a\nb\n", "a\nb\n");
+
+    g_assert_cmpuint (hunks->len, ==, 0);
+    g_array_unref (hunks);
+
+    hunks = diff ("", "");
+    g_assert_cmpuint (hunks->len, ==, 0);
+    g_array_unref (hunks);
+}
+
+static void
+test_empty (void)
+{
+    GArray *hunks = diff ("", "one\ntwo\n");
+
+    g_assert_cmpuint (hunks->len, ==, 1);
+    assert_hunk (hunks, 0, 0, 0, 0, 8);
+    assert_applies ("", "one\ntwo\n", hunks);
+    g_array_unref (hunks);
+
+    hunks = diff ("one\ntwo\n", "");
+    g_assert_cmpuint (hunks->len, ==, 1);
+    assert_hunk (hunks, 0, 0, 8, 0, 0);
+    assert_applies ("one\ntwo\n", "", hunks);
+    g_array_unref (hunks);
+}
+
+static void
+test_insert (void)
+{
+    static const gchar *old_text = "a\nb\nc\n";
+    static const gchar *new_text = "a\nx\ny\nb\nc\nz\n";
+    GArray *hunks = diff (old_text, new_text);
+
+    g_assert_cmpuint (hunks->len, ==, 2);
+    assert_hunk (hunks, 0, 2, 2, 2, 6);
+    assert_hunk (hunks, 1, 6, 6, 10, 12);
+    assert_applies (old_text, new_text, hunks);
+    g_array_unref (hunks);
+}
+
+static void
+test_delete (void)
+{
+    static const gchar *old_text = "a\nx\ny\nb\nc\nz\n";
+    static const gchar *new_text = "a\nb\nc\n";
+    GArray *hunks = diff (old_text, new_text);
+
+    g_assert_cmpuint (hunks->len, ==, 2);
+    assert_hunk (hunks, 0, 2, 6, 2, 2);
+    assert_hunk (hunks, 1, 10, 12, 6, 6);
+    assert_applies (old_text, new_text, hunks);
+    g_array_unref (hunks);
+}
+
+/* A last line without a newline is a line, and gaining one changes it. */
+static void
+test_final_line (void)
+{
+    GArray *hunks = diff ("a\nb", "a\nb\n");
+
+    g_assert_cmpuint (hunks->len, ==, 1);
+    assert_hunk (hunks, 0, 2, 3, 2, 4);
+    assert_applies ("a\nb", "a\nb\n", hunks);
+    g_array_unref (hunks);
+}
+
+/* Lines end at "\n", so "\r" stays part of the line it ends: a changed
+ * CRLF line covers its "\r\n", and only a change of line ending is a
+ * change of the line. */
+static void
+test_crlf (void)
+{
+    static const gchar *old_text = "one\r\ntwo\r\nthree\r\n";
+    static const gchar *new_text = "one\r\nTWO\r\nthree\r\n";
+    static const gchar *lf_text = "one\r\ntwo\nthree\r\n";
+    GArray *hunks = diff (old_text, new_text);
+
+    g_assert_cmpuint (hunks->len, ==, 1);
+    assert_hunk (hunks, 0, 5, 10, 5, 10);
+    assert_applies (old_text, new_text, hunks);
+    g_array_unref (hunks);
+
+    hunks = diff (old_text, lf_text);
+    g_assert_cmpuint (hunks->len, ==, 1);
+    assert_hunk (hunks, 0, 5, 10, 5, 9);
+    assert_applies (old_text, lf_text, hunks);
+    g_array_unref (hunks);
+
+    /* A lone "\r" does not end a line. */
+    hunks = diff ("a\rb\n", "a\rc\n");
+    g_assert_cmpuint (hunks->len, ==, 1);
+    assert_hunk (hunks, 0, 0, 4, 0, 4);
+    g_array_unref (hunks);
+}
+
+/* Random line edits always give hunks that turn one text into the other. */
+static void
+test_random (void)
+{
+    guint round;
+
+    for (round = 0; round < 500; round++) {
+        GString *old_text = g_string_new (NULL);
+        GString *new_text = g_string_new (NULL);
+        gint n_old = g_random_int_range (0, 40);
+        gint n_new = g_random_int_range (0, 40);
+        GArray *hunks;
+        gint i;
+
+        for (i = 0; i < n_old; i++)
+            g_string_append_printf (old_text, "%c\n", 'a' + g_random_int_range (0, 4));
+        for (i = 0; i < n_new; i++)
+            g_string_append_printf (new_text, "%c%s", 'a' + g_random_int_range (0, 4),
+                                    g_random_int_range (0, 8) == 0 ? "\r\n" : "\n");
+        if (old_text->len > 0 && g_random_boolean ())
+            g_string_truncate (old_text, old_text->len - 1);
+
+        hunks = diff (old_text->str, new_text->str);
+        assert_applies (old_text->str, new_text->str, hunks);
+        g_array_unref (hunks);
+
+        g_string_free (old_text, TRUE);
+        g_string_free (new_text, TRUE);
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/diff/identical", test_identical);
+    g_test_add_func ("/diff/empty", test_empty);
+    g_test_add_func ("/diff/insert", test_insert);
+    g_test_add_func ("/diff/delete", test_delete);
+    g_test_add_func ("/diff/final-line", test_final_line);
+    g_test_add_func ("/diff/crlf", test_crlf);
+    g_test_add_func ("/diff/random", test_random);
+
+    return g_test_run ();
+}
@@ -0,0 +1,215 @@
+/* test-file-loader.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * A hibernated tab is woken by loading its compressed text from memory,
+ * so these tests compress text the way the window does and read it back
+ * through flow_file_loader_new_for_bytes().  The same entry point feeds
+ * the encoding tests from memory.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "flow-encoding.h"
+#include "flow-file-loader.h"
+#include "test-util.h"
+
+/* Drains @loader as the window's load step does, without a main loop. */
+static GBytes *
+load (FlowFileLoader *loader, GError **error)
+{
+    GByteArray *text = g_byte_array_new ();
+    gboolean finished = FALSE;
+
+    flow_file_loader_start (loader);
+    while (!finished) {
+        GBytes *chunk = flow_file_loader_pop_chunk (loader, &finished, error);
+
+        if (chunk) {
+            g_byte_array_append (text, g_bytes_get_data (chunk, NULL), (guint) g_bytes_get_size (chunk));
+            g_bytes_unref (chunk);
+        } else if (!finished) {
+            g_usleep (1000);
+        }
+    }
+
+    return g_byte_array_free_to_bytes (text);
+}
+
+static void
+test_wake (gconstpointer user_data)
+{
+    FlowCompression compression = GPOINTER_TO_INT (user_data);
+    FlowFileLoader *loader;
+    GBytes *text;
+    GBytes *compressed;
+    GBytes *result;
+    GError *error = NULL;
+
+    text = test_util_make_text ();
+    compressed = test_util_compress (compression, text);
+    if (!compressed) {
+        g_bytes_unref (text);
+        return;
+    }
+
+    loader = flow_file_loader_new_for_bytes (compressed);
+    result = load (loader, &error);
+    g_assert_no_error (error);
+    g_assert_cmpint (flow_file_loader_get_compression (loader), ==, compression);
+    g_assert_true (flow_encoding_is_utf8 (flow_file_loader_get_charset (loader)));
+    g_assert_true (g_bytes_equal (result, text));
+
+    flow_file_loader_unref (loader);
+    g_bytes_unref (result);
+    g_bytes_unref (compressed);
+    g_bytes_unref (text);
+}
+
+/* A damaged blob must report an error, which the window answers by
+ * reading the file again, rather than pass for a shorter text. */
+static void
+test_wake_truncated (gconstpointer user_data)
+{
+    FlowCompression compression = GPOINTER_TO_INT (user_data);
+    FlowFileLoader *loader;
+    GBytes *text;
+    GBytes *compressed;
+    GBytes *truncated;
+    GBytes *result;
+    GError *error = NULL;
+
+    text = test_util_make_text ();
+    compressed = test_util_compress (compression, text);
+    if (!compressed) {
+        g_bytes_unref (text);
+        return;
+    }
+
+    truncated = g_bytes_new_from_bytes (compressed, 0, g_bytes_get_size (compressed) / 2);
+    loader = flow_file_loader_new_for_bytes (truncated);
+    result = load (loader, &error);
+    g_assert_nonnull (error);
+    g_error_free (error);
+
+    flow_file_loader_unref (loader);
+    g_bytes_unref (result);
+    g_bytes_unref (truncated);
+    g_bytes_unref (compressed);
+    g_bytes_unref (text);
+}
+
+/* Loads @raw, consuming it, and checks it was read as @charset. */
+static void
+assert_legacy_load (GString *raw, const gchar *charset)
+{
+    FlowFileLoader *loader;
+    GBytes *bytes;
+    GBytes *result;
+    gchar *expected;
+    gsize expected_len = 0;
+    GError *error = NULL;
+
+    expected = g_convert (raw->str, (gssize) raw->len, FLOW_ENCODING_UTF8, charset, NULL, &expected_len, &error);
+    g_assert_no_error (error);
+
+    bytes = g_string_free_to_bytes (raw);
+    loader = flow_file_loader_new_for_bytes (bytes);
+    result = load (loader, &error);
+    g_assert_no_error (error);
+    g_assert_cmpstr (flow_file_loader_get_charset (loader), ==, charset);
+    g_assert_cmpmem (g_bytes_get_data (result, NULL), g_bytes_get_size (result), expected, expected_len);
+
+    flow_file_loader_unref (loader);
+    g_bytes_unref (result);
+    g_bytes_unref (bytes);
+    g_free (expected);
+}
+
+static void
+append_filler (GString *raw)
+{
+    gsize end = raw->len + TEST_TEXT_SIZE;
+
+    while (raw->len < end)
+        g_string_append (raw, "plain ascii filler line\n");
+}
+
+/* A byte Windows-1252 leaves undefined, well past the block the encoding
+ * is sniffed from, must still turn the whole file into ISO-8859-1 so it
+ * loads without replacement characters and saves back unchanged. */
+static void
+test_legacy_settled_late (void)
+{
+    GString *raw = g_string_new ("\x93quoted\x94 caf\xe9\n");
+
+    append_filler (raw);
+    g_string_append (raw, "\x81\n");
+    assert_legacy_load (raw, FLOW_ENCODING_LATIN1);
+}
+
+/* C1 bytes that are all defined keep Windows-1252 to the end. */
+static void
+test_legacy_kept (void)
+{
+    GString *raw = g_string_new ("\x93quoted\x94 caf\xe9\n");
+
+    append_filler (raw);
+    g_string_append (raw, "\x80 and \x9f\n");
+    assert_legacy_load (raw, FLOW_ENCODING_LEGACY);
+}
+
+/* Text loaded before the first C1 byte reads the same either way, and
+ * an encoding first noticed past a long ASCII start settles the same. */
+static void
+test_legacy_ascii_start (void)
+{
+    GString *raw = g_string_new (NULL);
+
+    append_filler (raw);
+    g_string_append (raw, "caf\xe9\n");
+    append_filler (raw);
+    g_string_append (raw, "\x93quoted\x94\n");
+    append_filler (raw);
+    g_string_append (raw, "\x8d\n");
+    assert_legacy_load (raw, FLOW_ENCODING_LATIN1);
+
+    raw = g_string_new (NULL);
+    append_filler (raw);
+    g_string_append (raw, "caf\xe9 \x93quoted\x94\n");
+    append_filler (raw);
+    assert_legacy_load (raw, FLOW_ENCODING_LEGACY);
+}
+
+int
+main (int argc, char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    test_util_add_compression_func ("/file-loader/wake", "", test_wake);
+    test_util_add_compression_func ("/file-loader/wake", "/truncated", test_wake_truncated);
+    g_test_add_func ("/file-loader/legacy/settled-late", test_legacy_settled_late);
+    g_test_add_func ("/file-loader/legacy/kept", test_legacy_kept);
+    g_test_add_func ("/file-loader/legacy/ascii-start", test_legacy_ascii_start);
+
+    return g_test_run ();
+}
@@ -0,0 +1,146 @@
+/* test-fuzzy.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "flow-fuzzy.h"
+
+/* Returns G_MININT for no match. */
+static gint
+score (const gchar *query, const gchar *path)
+{
+    FlowFuzzyPattern *pattern = flow_fuzzy_pattern_new (query);
+    gint result = 0;
+
+    if (!flow_fuzzy_match (pattern, path, strlen (path), &result))
+        result = G_MININT;
+    flow_fuzzy_pattern_free (pattern);
+
+    return result;
+}
+
+/* @query ranks the paths in the order given, best first. */
+static void
+assert_order (const gchar *query, const gchar * const *paths)
+{
+    gint previous = G_MAXINT;
+    guint i;
+
+    for (i = 0; paths[i]; i++) {
+        gint current = score (query, paths[i]);
+
+        if (current >= previous)
+            g_test_message ("\"%s\" ranks %s (%d) no lower than %s (%d)",
+                            query, paths[i], current, paths[i - 1], previous);
+        g_assert_cmpint (current, >, G_MININT);
+        g_assert_cmpint (current, <, previous);
+        previous = current;
+    }
+}
+
+static void
+test_match (void)
+{
+    g_assert_cmpint (score ("fwc", "src/flow-window.c"), >, G_MININT);
+    g_assert_cmpint (score ("wfc", "src/flow-window.c"), ==, G_MININT);
+    g_assert_cmpint (score ("flowx", "src/flow-window.c"), ==, G_MININT);
+    /* Spaces in the query are ignored. */
+    g_assert_cmpint (score ("flow win", "src/flow-window.c"), ==, score ("flowwin", "src/flow-window.c"));
+    /* Anything matches nothing, at no score. */
+    g_assert_cmpint (score ("", "src/flow-window.c"), ==, 0);
+}
+
+/* Lower-case queries ignore case; one upper-case letter makes it count. */
+static void
+test_case (void)
+{
+    g_assert_cmpint (score ("readme", "README.md"), >, G_MININT);
+    g_assert_cmpint (score ("README", "README.md"), >, G_MININT);
+    g_assert_cmpint (score ("Readme", "README.md"), ==, G_MININT);
+    g_assert_cmpint (score ("Readme", "docs/Readme.txt"), >, G_MININT);
+}
+
+static void
+test_order (void)
+{
+    /* Consecutive letters beat scattered ones. */
+    static const gchar * const window[] = {
+        "src/window.c",
+        "src/flow-window.c",
+        "src/wide/in/dow.c",
+        NULL
+    };
+    /* Word starts beat letters inside words. */
+    static const gchar * const fb[] = {
+        "src/foo-bar.c",
+        "src/foobar.c",
+        "src/afoobbar.c",
+        NULL
+    };
+    /* The last component is tried first. */
+    static const gchar * const win[] = {
+        "src/flow-window.c",
+        "src/w/i/n.c",
+        NULL
+    };
+    /* camelCase humps count as word starts. */
+    static const gchar * const camel[] = {
+        "FooBar.java",
+        "Foobar.java",
+        NULL
+    };
+
+    assert_order ("window", window);
+    assert_order ("fb", fb);
+    assert_order ("win", win);
+    assert_order ("fb", camel);
+}
+
+/* A text whose mask misses a bit of the pattern's cannot match. */
+static void
+test_mask (void)
+{
+    static const gchar *path = "src/flow-window.c";
+    guint64 text_mask = flow_fuzzy_char_mask (path, strlen (path));
+    FlowFuzzyPattern *hit = flow_fuzzy_pattern_new ("FWC");
+    FlowFuzzyPattern *miss = flow_fuzzy_pattern_new ("fwz");
+
+    g_assert_cmpuint (flow_fuzzy_pattern_get_mask (hit) & ~text_mask, ==, 0);
+    g_assert_cmpuint (flow_fuzzy_pattern_get_mask (miss) & ~text_mask, !=, 0);
+    g_assert_false (flow_fuzzy_pattern_is_empty (hit));
+
+    flow_fuzzy_pattern_free (miss);
+    flow_fuzzy_pattern_free (hit);
+}
+
+int
+main (int argc, char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/fuzzy/match", test_match);
+    g_test_add_func ("/fuzzy/case", test_case);
+    g_test_add_func ("/fuzzy/order", test_order);
+    g_test_add_func ("/fuzzy/mask", test_mask);
+
+    return g_test_run ();
+}
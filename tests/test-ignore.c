@@ -0,0 +1,228 @@
+/* test-ignore.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+
+#include "flow-ignore.h"
+
+typedef struct {
+    gchar *path;
+    GPtrArray *files;
+} Folder;
+
+static void
+folder_write (Folder *folder, const gchar *relative, const gchar *contents)
+{
+    gchar *path = g_build_filename (folder->path, relative, NULL);
+    gchar *dir = g_path_get_dirname (path);
+    GError *error = NULL;
+
+    g_assert_cmpint (g_mkdir_with_parents (dir, 0700), ==, 0);
+    g_file_set_contents (path, contents, -1, &error);
+    g_assert_no_error (error);
+
+    g_ptr_array_add (folder->files, path);
+    g_free (dir);
+}
+
+/* A matcher over a fresh folder holding @files, a NULL-terminated list
+ * of relative path and contents pairs, with each directory loaded. */
+static FlowIgnore *
+folder_open (Folder *folder, const gchar * const *files, const gchar * const *patterns, const gchar * const *dirs)
+{
+    GError *error = NULL;
+    FlowIgnore *ignore;
+    GFile *root;
+    guint i;
+
+    folder->path = g_dir_make_tmp ("flow-ignore-XXXXXX", &error);
+    g_assert_no_error (error);
+    folder->files = g_ptr_array_new_with_free_func (g_free);
+
+    for (i = 0; files[i]; i += 2)
+        folder_write (folder, files[i], files[i + 1]);
+
+    root = g_file_new_for_path (folder->path);
+    ignore = flow_ignore_new (root, patterns);
+    flow_ignore_load_dir (ignore, "", NULL);
+    for (i = 0; dirs && dirs[i]; i++)
+        flow_ignore_load_dir (ignore, dirs[i], NULL);
+    g_object_unref (root);
+
+    return ignore;
+}
+
+/* Removes the files, then their directories, deepest first. */
+static void
+folder_close (Folder *folder, FlowIgnore *ignore)
+{
+    guint i;
+
+    flow_ignore_unref (ignore);
+
+    for (i = folder->files->len; i > 0; i--) {
+        gchar *dir = g_path_get_dirname (g_ptr_array_index (folder->files, i - 1));
+
+        g_unlink (g_ptr_array_index (folder->files, i - 1));
+        while (g_strcmp0 (dir, folder->path) != 0 && g_rmdir (dir) == 0) {
+            gchar *parent = g_path_get_dirname (dir);
+
+            g_free (dir);
+            dir = parent;
+        }
+        g_free (dir);
+    }
+    g_rmdir (folder->path);
+
+    g_ptr_array_unref (folder->files);
+    g_free (folder->path);
+}
+
+static void
+test_negation (void)
+{
+    static const gchar * const files[] = {
+        ".gitignore", "*.log\n!keep.log\n",
+        "sub/.gitignore", "!debug.log\nlocal.log\n",
+        NULL
+    };
+    static const gchar * const dirs[] = { "sub", NULL };
+    Folder folder;
+    FlowIgnore *ignore = folder_open (&folder, files, NULL, dirs);
+
+    g_assert_true (flow_ignore_is_ignored (ignore, "error.log", FALSE));
+    g_assert_false (flow_ignore_is_ignored (ignore, "keep.log", FALSE));
+    g_assert_false (flow_ignore_is_ignored (ignore, "notes.txt", FALSE));
+    /* A deeper file overrides the folder's... */
+    g_assert_false (flow_ignore_is_ignored (ignore, "sub/debug.log", FALSE));
+    /* ...and rules it does not decide fall through to it. */
+    g_assert_true (flow_ignore_is_ignored (ignore, "sub/error.log", FALSE));
+    g_assert_false (flow_ignore_is_ignored (ignore, "sub/keep.log", FALSE));
+    g_assert_true (flow_ignore_is_ignored (ignore, "sub/local.log", FALSE));
+
+    folder_close (&folder, ignore);
+}
+
+static void
+test_double_star (void)
+{
+    static const gchar * const files[] = {
+        ".gitignore", "**/cache\ndocs/**/*.tmp\nlogs/**\n",
+        NULL
+    };
+    Folder folder;
+    FlowIgnore *ignore = folder_open (&folder, files, NULL, NULL);
+
+    g_assert_true (flow_ignore_is_ignored (ignore, "cache", TRUE));
+    g_assert_true (flow_ignore_is_ignored (ignore, "a/b/cache", TRUE));
+    g_assert_false (flow_ignore_is_ignored (ignore, "a/b/cached", TRUE));
+    /* "**" followed by a slash may match no directories at all. */
+    g_assert_true (flow_ignore_is_ignored (ignore, "docs/x.tmp", FALSE));
+    g_assert_true (flow_ignore_is_ignored (ignore, "docs/a/b/x.tmp", FALSE));
+    g_assert_false (flow_ignore_is_ignored (ignore, "src/docs/x.tmp", FALSE));
+    g_assert_true (flow_ignore_is_ignored (ignore, "logs/a/b", FALSE));
+    g_assert_false (flow_ignore_is_ignored (ignore, "logs2/a", FALSE));
+
+    folder_close (&folder, ignore);
+}
+
+static void
+test_directory_only (void)
+{
+    static const gchar * const files[] = {
+        ".gitignore", "build/\n",
+        NULL
+    };
+    Folder folder;
+    FlowIgnore *ignore = folder_open (&folder, files, NULL, NULL);
+
+    g_assert_true (flow_ignore_is_ignored (ignore, "build", TRUE));
+    g_assert_true (flow_ignore_is_ignored (ignore, "src/build", TRUE));
+    g_assert_false (flow_ignore_is_ignored (ignore, "build", FALSE));
+    g_assert_false (flow_ignore_is_ignored (ignore, "src/build", FALSE));
+
+    folder_close (&folder, ignore);
+}
+
+/* A slash at the start or in the middle ties a pattern to its directory;
+ * without one it matches a name at any depth. */
+static void
+test_anchored (void)
+{
+    static const gchar * const files[] = {
+        ".gitignore", "/root.txt\ndoc/out.html\nany.txt\n",
+        "sub/.gitignore", "/here.txt\n",
+        NULL
+    };
+    static const gchar * const dirs[] = { "sub", NULL };
+    Folder folder;
+    FlowIgnore *ignore = folder_open (&folder, files, NULL, dirs);
+
+    g_assert_true (flow_ignore_is_ignored (ignore, "root.txt", FALSE));
+    g_assert_false (flow_ignore_is_ignored (ignore, "sub/root.txt", FALSE));
+    g_assert_true (flow_ignore_is_ignored (ignore, "doc/out.html", FALSE));
+    g_assert_false (flow_ignore_is_ignored (ignore, "sub/doc/out.html", FALSE));
+    g_assert_true (flow_ignore_is_ignored (ignore, "any.txt", FALSE));
+    g_assert_true (flow_ignore_is_ignored (ignore, "sub/deep/any.txt", FALSE));
+    /* Anchored to the directory of the file that holds it. */
+    g_assert_true (flow_ignore_is_ignored (ignore, "sub/here.txt", FALSE));
+    g_assert_false (flow_ignore_is_ignored (ignore, "here.txt", FALSE));
+    g_assert_false (flow_ignore_is_ignored (ignore, "sub/deep/here.txt", FALSE));
+
+    folder_close (&folder, ignore);
+}
+
+/* Global patterns come last, so the folder's files can undo them. */
+static void
+test_global (void)
+{
+    static const gchar * const files[] = {
+        ".gitignore", "!vendor\n",
+        ".git/info/exclude", "secret.txt\n",
+        NULL
+    };
+    static const gchar * const patterns[] = { "node_modules", "vendor", NULL };
+    Folder folder;
+    FlowIgnore *ignore = folder_open (&folder, files, patterns, NULL);
+
+    g_assert_true (flow_ignore_is_ignored (ignore, "node_modules", TRUE));
+    g_assert_true (flow_ignore_is_ignored (ignore, "web/node_modules", TRUE));
+    g_assert_false (flow_ignore_is_ignored (ignore, "vendor", TRUE));
+    g_assert_true (flow_ignore_is_ignored (ignore, "secret.txt", FALSE));
+    g_assert_true (flow_ignore_is_ignored (ignore, "a/secret.txt", FALSE));
+
+    folder_close (&folder, ignore);
+}
+
+int
+main (int argc, char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/ignore/negation", test_negation);
+    g_test_add_func ("/ignore/double-star", test_double_star);
+    g_test_add_func ("/ignore/directory-only", test_directory_only);
+    g_test_add_func ("/ignore/anchored", test_anchored);
+    g_test_add_func ("/ignore/global", test_global);
+
+    return g_test_run ();
+}
@@ -0,0 +1,113 @@
+/* test-location.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+
+#include "flow-location.h"
+
+/* Resolves @arg as the launched process does, then splits it as the
+ * primary instance does, and checks the path and location found. */
+static void
+assert_location (const gchar *arg, const gchar *cwd, const gchar *expected_path, gint expected_line,
+                 gint expected_column)
+{
+    gchar *resolved = flow_location_resolve_arg (arg, cwd);
+    GFile *file = g_file_new_for_commandline_arg_and_cwd (resolved ? resolved : arg, cwd);
+    GFile *split;
+    gchar *path;
+    gint line;
+    gint column;
+
+    split = flow_location_split (file, &line, &column);
+    path = g_file_get_path (split);
+    g_assert_cmpstr (path, ==, expected_path);
+    g_assert_cmpint (line, ==, expected_line);
+    g_assert_cmpint (column, ==, expected_column);
+
+    g_free (path);
+    g_object_unref (split);
+    g_object_unref (file);
+    g_free (resolved);
+}
+
+/* With no directory part GIO takes "main.c:" for a URI scheme. */
+static void
+test_bare_name (void)
+{
+    assert_location ("main.c:42", "/work", "/work/main.c", 42, 0);
+    assert_location ("main.c:42:7", "/work", "/work/main.c", 42, 7);
+    assert_location ("main.c:42:", "/work", "/work/main.c", 42, 0);
+    assert_location ("main.c", "/work", "/work/main.c", 0, 0);
+}
+
+static void
+test_with_directory (void)
+{
+    gchar *resolved = flow_location_resolve_arg ("src/main.c:42", "/work");
+
+    /* GIO reads these as paths already. */
+    g_assert_null (resolved);
+    assert_location ("src/main.c:42:7", "/work", "/work/src/main.c", 42, 7);
+    assert_location ("./main.c:42", "/work", "/work/main.c", 42, 0);
+    assert_location ("/abs/main.c:9", "/work", "/abs/main.c", 9, 0);
+}
+
+static void
+test_uri (void)
+{
+    g_assert_null (flow_location_resolve_arg ("https://example.com/main.c:42", "/work"));
+    g_assert_null (flow_location_resolve_arg ("file:///work/main.c", "/work"));
+}
+
+/* A file whose name really ends in a location opens as named. */
+static void
+test_existing_name (void)
+{
+    GError *error = NULL;
+    gchar *dir = g_dir_make_tmp ("flow-location-XXXXXX", &error);
+    gchar *path;
+
+    g_assert_no_error (error);
+    path = g_build_filename (dir, "notes:12", NULL);
+    g_file_set_contents (path, "", 0, &error);
+    g_assert_no_error (error);
+
+    assert_location ("notes:12", dir, path, 0, 0);
+
+    g_unlink (path);
+    g_rmdir (dir);
+    g_free (path);
+    g_free (dir);
+}
+
+int
+main (int argc, char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/location/bare-name", test_bare_name);
+    g_test_add_func ("/location/with-directory", test_with_directory);
+    g_test_add_func ("/location/uri", test_uri);
+    g_test_add_func ("/location/existing-name", test_existing_name);
+
+    return g_test_run ();
+}
@@ -0,0 +1,253 @@
+/* test-piece-table.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "flow-piece-table.h"
+
+/* Loaded chunks are cut into pieces of at most this many bytes. */
+#define PIECE_SIZE (64 * 1024)
+
+/* Flattens @table through a snapshot, as saving does. */
+static gchar *
+table_text (FlowPieceTable *table)
+{
+    FlowPieceTableSnapshot *snapshot = flow_piece_table_snapshot (table);
+    FlowPieceTableIter *iter = flow_piece_table_iter_new (snapshot);
+    GString *text = g_string_new (NULL);
+    const gchar *data;
+    gsize len;
+
+    while (flow_piece_table_iter_next (iter, &data, &len))
+        g_string_append_len (text, data, (gssize) len);
+
+    flow_piece_table_iter_free (iter);
+    flow_piece_table_snapshot_unref (snapshot);
+
+    return g_string_free (text, FALSE);
+}
+
+static void
+append_chunk (FlowPieceTable *table, const gchar *text)
+{
+    GBytes *bytes = g_bytes_new (text, strlen (text));
+
+    flow_piece_table_append_bytes (table, bytes);
+    g_bytes_unref (bytes);
+}
+
+static void
+assert_text (FlowPieceTable *table, const gchar *expected)
+{
+    gchar *text = table_text (table);
+    const gchar *p;
+    gsize lines = 1;
+
+    g_assert_cmpstr (text, ==, expected);
+    g_assert_cmpuint (flow_piece_table_get_length (table), ==, strlen (expected));
+    g_assert_cmpuint (flow_piece_table_get_char_count (table), ==, g_utf8_strlen (expected, -1));
+
+    for (p = expected; (p = strchr (p, '\n')) != NULL; p++)
+        lines++;
+    g_assert_cmpuint (flow_piece_table_get_line_count (table), ==, lines);
+
+    g_free (text);
+}
+
+static void
+test_insert (void)
+{
+    FlowPieceTable *table = flow_piece_table_new ();
+
+    assert_text (table, "");
+
+    flow_piece_table_insert (table, 0, "world", 5);
+    flow_piece_table_insert (table, 0, "hello ", 6);
+    flow_piece_table_insert (table, 11, "!\n", 2);
+    flow_piece_table_insert (table, 5, ",", 1);
+    assert_text (table, "hello, world!\n");
+
+    flow_piece_table_free (table);
+}
+
+/* Edits that start, end or span where one loaded chunk meets the next,
+ * with multi-byte characters on either side. */
+static void
+test_chunk_boundaries (void)
+{
+    FlowPieceTable *table = flow_piece_table_new ();
+
+    append_chunk (table, "abc\n");
+    append_chunk (table, "d\xc3\xa9" "f\n");
+    append_chunk (table, "\xe2\x82\xacgh\n");
+    assert_text (table, "abc\nd\xc3\xa9" "f\n\xe2\x82\xacgh\n");
+
+    /* Right on the first boundary, then inside the second chunk. */
+    flow_piece_table_insert (table, 4, "X", 1);
+    flow_piece_table_insert (table, 7, "\xc3\xbc", 2);
+    assert_text (table, "abc\nXd\xc3\xa9\xc3\xbc" "f\n\xe2\x82\xacgh\n");
+
+    /* Across both boundaries at once. */
+    flow_piece_table_delete (table, 2, 8);
+    assert_text (table, "ab\xe2\x82\xacgh\n");
+
+    /* Everything. */
+    flow_piece_table_delete (table, 0, 6);
+    assert_text (table, "");
+
+    flow_piece_table_free (table);
+}
+
+/* A chunk longer than a piece is split without cutting a character in
+ * half, and edits around the split see one continuous text. */
+static void
+test_large_chunk (void)
+{
+    FlowPieceTable *table = flow_piece_table_new ();
+    GString *text = g_string_new (NULL);
+    GString *expected;
+
+    while (text->len < PIECE_SIZE - 1)
+        g_string_append_c (text, text->len % 64 == 63 ? '\n' : 'a');
+    /* A two-byte character straddling the piece size. */
+    g_string_append (text, "\xc3\xa9tail\n");
+
+    append_chunk (table, text->str);
+    assert_text (table, text->str);
+
+    expected = g_string_new (text->str);
+    flow_piece_table_delete (table, PIECE_SIZE - 2, 3);
+    g_string_erase (expected, PIECE_SIZE - 2, 4);
+    flow_piece_table_insert (table, PIECE_SIZE - 2, "\xc3\xa8", 2);
+    g_string_insert_len (expected, PIECE_SIZE - 2, "\xc3\xa8", 2);
+    assert_text (table, expected->str);
+
+    g_assert_cmpuint (flow_piece_table_get_line_offset (table, 1), ==, 64);
+
+    g_string_free (expected, TRUE);
+    g_string_free (text, TRUE);
+    flow_piece_table_free (table);
+}
+
+static void
+test_line_offset (void)
+{
+    FlowPieceTable *table = flow_piece_table_new ();
+
+    append_chunk (table, "one\n\xc3\xa9t\xc3\xa9\n");
+    append_chunk (table, "three");
+    flow_piece_table_insert (table, 4, "zero\n", 5);
+
+    g_assert_cmpuint (flow_piece_table_get_line_offset (table, 0), ==, 0);
+    g_assert_cmpuint (flow_piece_table_get_line_offset (table, 1), ==, 4);
+    g_assert_cmpuint (flow_piece_table_get_line_offset (table, 2), ==, 9);
+    g_assert_cmpuint (flow_piece_table_get_line_offset (table, 3), ==, 13);
+    /* Past the last line is the end of the text. */
+    g_assert_cmpuint (flow_piece_table_get_line_offset (table, 9), ==, 18);
+
+    flow_piece_table_free (table);
+}
+
+/* A snapshot keeps the text it was taken with while editing goes on. */
+static void
+test_snapshot (void)
+{
+    FlowPieceTable *table = flow_piece_table_new ();
+    FlowPieceTableSnapshot *snapshot;
+    FlowPieceTableIter *iter;
+    GString *text = g_string_new (NULL);
+    const gchar *data;
+    gsize len;
+
+    append_chunk (table, "before\n");
+    snapshot = flow_piece_table_snapshot (table);
+    flow_piece_table_insert (table, 0, "after ", 6);
+    flow_piece_table_delete (table, 6, 3);
+    flow_piece_table_clear (table);
+
+    g_assert_cmpuint (flow_piece_table_snapshot_get_length (snapshot), ==, 7);
+    iter = flow_piece_table_iter_new (snapshot);
+    while (flow_piece_table_iter_next (iter, &data, &len))
+        g_string_append_len (text, data, (gssize) len);
+    g_assert_cmpstr (text->str, ==, "before\n");
+
+    flow_piece_table_iter_free (iter);
+    flow_piece_table_snapshot_unref (snapshot);
+    g_string_free (text, TRUE);
+    flow_piece_table_free (table);
+}
+
+/* Random edits against a plain string. */
+static void
+test_random_edits (void)
+{
+    static const gchar * const pieces[] = { "a", "bc", "\n", "\xc3\xa9", "\xe2\x82\xac\n", "xyz\n" };
+    FlowPieceTable *table = flow_piece_table_new ();
+    GString *expected = g_string_new (NULL);
+    guint i;
+
+    for (i = 0; i < 8; i++) {
+        append_chunk (table, "chunk \xc3\xa9\n");
+        g_string_append (expected, "chunk \xc3\xa9\n");
+    }
+
+    for (i = 0; i < 2000; i++) {
+        gsize n_chars = (gsize) g_utf8_strlen (expected->str, -1);
+        gsize offset = (gsize) g_random_int_range (0, (gint32) n_chars + 1);
+        gsize start = (gsize) (g_utf8_offset_to_pointer (expected->str, (glong) offset) - expected->str);
+
+        if (n_chars > 0 && g_random_int_range (0, 3) == 0) {
+            gsize count = (gsize) g_random_int_range (0, 8);
+            gsize end;
+
+            count = MIN (count, n_chars - offset);
+            end = (gsize) (g_utf8_offset_to_pointer (expected->str, (glong) (offset + count)) - expected->str);
+
+            flow_piece_table_delete (table, offset, count);
+            g_string_erase (expected, (gssize) start, (gssize) (end - start));
+        } else {
+            const gchar *piece = pieces[g_random_int_range (0, G_N_ELEMENTS (pieces))];
+
+            flow_piece_table_insert (table, offset, piece, strlen (piece));
+            g_string_insert_len (expected, (gssize) start, piece, -1);
+        }
+    }
+    assert_text (table, expected->str);
+
+    g_string_free (expected, TRUE);
+    flow_piece_table_free (table);
+}
+
+int
+main (int argc, char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/piece-table/insert", test_insert);
+    g_test_add_func ("/piece-table/chunk-boundaries", test_chunk_boundaries);
+    g_test_add_func ("/piece-table/large-chunk", test_large_chunk);
+    g_test_add_func ("/piece-table/line-offset", test_line_offset);
+    g_test_add_func ("/piece-table/snapshot", test_snapshot);
+    g_test_add_func ("/piece-table/random-edits", test_random_edits);
+
+    return g_test_run ();
+}
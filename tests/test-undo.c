@@ -0,0 +1,149 @@
+/* test-undo.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "flow-undo.h"
+
+/* Enough steps of this size to push most of them into the spill file. */
+#define STEP_SIZE (64 * 1024)
+#define N_STEPS   96
+
+/* Each step inserts STEP_SIZE bytes of its own, so no two steps merge. */
+static gchar *
+make_step_text (guint step)
+{
+    GString *text = g_string_sized_new (STEP_SIZE);
+
+    while (text->len < STEP_SIZE)
+        g_string_append_printf (text, "step %u, line %u\n", step, (guint) text->len);
+    g_string_truncate (text, STEP_SIZE);
+
+    return g_string_free (text, FALSE);
+}
+
+static void
+record_steps (FlowUndo *undo)
+{
+    guint i;
+
+    for (i = 0; i < N_STEPS; i++) {
+        gchar *text = make_step_text (i);
+
+        flow_undo_record_insert (undo, (gsize) i * STEP_SIZE, text, STEP_SIZE);
+        g_free (text);
+    }
+}
+
+static void
+assert_edit (GArray *edits, FlowUndoEditKind kind, guint step)
+{
+    gchar *text = make_step_text (step);
+    const FlowUndoEdit *edit;
+
+    g_assert_nonnull (edits);
+    g_assert_cmpuint (edits->len, ==, 1);
+
+    edit = &g_array_index (edits, FlowUndoEdit, 0);
+    g_assert_cmpint (edit->kind, ==, kind);
+    g_assert_cmpuint (edit->offset, ==, (gsize) step * STEP_SIZE);
+    g_assert_cmpuint (edit->n_chars, ==, STEP_SIZE);
+    g_assert_cmpmem (edit->text, edit->len, text, STEP_SIZE);
+
+    g_free (text);
+}
+
+/* Every step comes back intact, whether it stayed in memory or was
+ * compressed into the spill file. */
+static void
+test_spill_round_trip (void)
+{
+    FlowUndo *undo = flow_undo_new ();
+    GError *error = NULL;
+    guint i;
+
+    record_steps (undo);
+
+    for (i = N_STEPS; i-- > 0;) {
+        GArray *edits = flow_undo_undo (undo, &error);
+
+        g_assert_no_error (error);
+        assert_edit (edits, FLOW_UNDO_EDIT_DELETE, i);
+        g_array_unref (edits);
+    }
+    g_assert_false (flow_undo_can_undo (undo));
+    g_assert_true (flow_undo_is_saved (undo));
+
+    for (i = 0; i < N_STEPS; i++) {
+        GArray *edits = flow_undo_redo (undo, &error);
+
+        g_assert_no_error (error);
+        assert_edit (edits, FLOW_UNDO_EDIT_INSERT, i);
+        g_array_unref (edits);
+    }
+    g_assert_false (flow_undo_can_redo (undo));
+
+    flow_undo_free (undo);
+}
+
+/* Steps spilled again after being read back still come back intact. */
+static void
+test_spill_again (void)
+{
+    FlowUndo *undo = flow_undo_new ();
+    GError *error = NULL;
+    GArray *edits;
+    guint i;
+
+    record_steps (undo);
+
+    for (i = N_STEPS; i-- > N_STEPS / 2;) {
+        edits = flow_undo_undo (undo, &error);
+        g_assert_no_error (error);
+        g_array_unref (edits);
+    }
+    for (i = N_STEPS / 2; i < N_STEPS; i++) {
+        edits = flow_undo_redo (undo, &error);
+        g_assert_no_error (error);
+        g_array_unref (edits);
+    }
+
+    for (i = N_STEPS; i-- > 0;) {
+        edits = flow_undo_undo (undo, &error);
+        g_assert_no_error (error);
+        assert_edit (edits, FLOW_UNDO_EDIT_DELETE, i);
+        g_array_unref (edits);
+    }
+
+    flow_undo_free (undo);
+}
+
+int
+main (int argc, char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/undo/spill/round-trip", test_spill_round_trip);
+    g_test_add_func ("/undo/spill/again", test_spill_again);
+
+    return g_test_run ();
+}
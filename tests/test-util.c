@@ -0,0 +1,89 @@
+/* test-util.c
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include "test-util.h"
+
+/* Plain lines with a few multi-byte characters, about TEST_TEXT_SIZE long. */
+GBytes *
+test_util_make_text (void)
+{
+    GString *text = g_string_sized_new (TEST_TEXT_SIZE);
+    guint line = 0;
+
+    while (text->len < TEST_TEXT_SIZE)
+        g_string_append_printf (text, "line %u: héllo wörld, the quick brown fox\n", line++);
+
+    return g_string_free_to_bytes (text);
+}
+
+/* Returns NULL and skips the test when @compression is not built in. */
+GBytes *
+test_util_compress (FlowCompression compression, GBytes *bytes)
+{
+    GError *error = NULL;
+    GConverter *compressor = flow_compression_new_compressor (compression, &error);
+    GOutputStream *memory;
+    GOutputStream *stream;
+    GBytes *compressed;
+
+    if (!compressor) {
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED);
+        g_test_skip (error->message);
+        g_error_free (error);
+        return NULL;
+    }
+
+    memory = g_memory_output_stream_new_resizable ();
+    stream = g_converter_output_stream_new (memory, compressor);
+    g_assert_true (g_output_stream_write_all (stream, g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes),
+                                              NULL, NULL, &error));
+    g_assert_no_error (error);
+    g_assert_true (g_output_stream_close (stream, NULL, &error));
+    g_assert_no_error (error);
+
+    compressed = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (memory));
+    g_object_unref (stream);
+    g_object_unref (compressor);
+    g_object_unref (memory);
+
+    return compressed;
+}
+
+/* Adds @func once per format, at @prefix/<format name>@suffix, with the
+ * format as its data. */
+void
+test_util_add_compression_func (const gchar *prefix, const gchar *suffix, GTestDataFunc func)
+{
+    static const FlowCompression formats[] = {
+        FLOW_COMPRESSION_GZIP,
+        FLOW_COMPRESSION_ZSTD,
+        FLOW_COMPRESSION_XZ,
+    };
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+        gchar *path = g_strconcat (prefix, "/", flow_compression_get_name (formats[i]), suffix, NULL);
+
+        g_test_add_data_func (path, GINT_TO_POINTER (formats[i]), func);
+        g_free (path);
+    }
+}
@@ -0,0 +1,41 @@
+/* test-util.h
+ *
+ * Copyright 2025 Artem
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "flow-compression.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Fixtures shared by the tests that push text through a compressor: a
+ * text large enough to span several converter buffers and ZSTD blocks,
+ * and the compressor the window hibernates tabs with.
+ */
+#define TEST_TEXT_SIZE (512 * 1024)
+
+GBytes *test_util_make_text             (void);
+GBytes *test_util_compress              (FlowCompression  compression,
+                                         GBytes          *bytes);
+void    test_util_add_compression_func  (const gchar     *prefix,
+                                         const gchar     *suffix,
+                                         GTestDataFunc    func);
+
+G_END_DECLS